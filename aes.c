@@ -5,17 +5,19 @@
 */
 
 #include "aes.h"
+#include "aesBitslice.h"
+#include "aesTable.h"
+#include "aesVperm.h"
+#include "aesni.h"
 #include "field.h"
+#include "stats.h"
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 
-/**
-   Return the sBox substitution value for a given byte value.
-   @param v byte input value.
-   @return substitution for the given byte.
-*/
-static byte substBox( byte v )
+byte substBox( byte v )
 {
   // Forward-direction replacement map for the sBox.
   static const byte rule[] =
@@ -56,12 +58,7 @@ static byte substBox( byte v )
   return rule[ v ];
 }
 
-/**
-   Return the inverse sBox substitution value for a given byte value.
-   @param v byte input value.
-   @return inverse substitution for the given byte.
-*/
-static byte invSubstBox( byte v )
+byte invSubstBox( byte v )
 {
   // Inverse-direction replacement map for the sBox.
   static const byte irule[] =
@@ -153,6 +150,22 @@ void generateSubkeys( byte subkey[ ROUNDS + 1 ][ BLOCK_SIZE ], byte const key[ B
   }
 }
 
+void generateInvSubkeys( byte invSubkey[ ROUNDS + 1 ][ BLOCK_SIZE ], byte const subkey[ ROUNDS + 1 ][ BLOCK_SIZE ] ) {
+  for ( int i = 0; i < ROUNDS + 1; i++ ) {
+    for ( int j = 0; j < BLOCK_SIZE; j++ ) {
+      invSubkey[i][j] = subkey[ROUNDS - i][j];
+    }
+
+    // unMixColumns is linear, so it can be applied to the middle subkeys ahead of time.
+    if ( i != 0 && i != ROUNDS ) {
+      byte square[BLOCK_ROWS][BLOCK_COLS];
+      blockToSquare( square, invSubkey[i] );
+      unMixColumns( square );
+      squareToBlock( invSubkey[i], square );
+    }
+  }
+}
+
 void addSubkey( byte data[ BLOCK_SIZE ], byte const key[ BLOCK_SIZE ] ) {
   for ( int i = 0; i < BLOCK_SIZE; i++ ) {
     data[i] = fieldAdd( data[i], key[i] );
@@ -277,12 +290,157 @@ void unMixColumns( byte square[ BLOCK_ROWS ][ BLOCK_COLS ] )
   }
 }
 
-void encryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] ) {
-  byte subKey[ROUNDS + 1][BLOCK_SIZE];
-  generateSubkeys( subKey, key );
+/**
+   Expand the key for the reference engine, which only needs the byte subkeys.
+   @param ctx the context to fill in.
+   @param key the key to expand.
+*/
+static void referenceExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] )
+{
+  generateSubkeys( ctx->subkey, key );
+  generateInvSubkeys( ctx->invSubkey, ctx->subkey );
+}
+
+/**
+   The reference engine runs everywhere.
+   @return true.
+*/
+static bool referenceSupported( void )
+{
+  return true;
+}
+
+/**
+   Encrypt a sequence of blocks with the reference rounds, one block at a time.
+   @param ctx the context holding the expanded key.
+   @param in the blocks to encrypt.
+   @param out where the encrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+static void referenceEncrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  for ( size_t i = 0; i < nblocks; i++ ) {
+    memmove( out + i * BLOCK_SIZE, in + i * BLOCK_SIZE, BLOCK_SIZE );
+    aesEncryptReference( ctx, out + i * BLOCK_SIZE );
+  }
+}
+
+/**
+   Decrypt a sequence of blocks with the reference rounds, one block at a time.
+   @param ctx the context holding the expanded key.
+   @param in the blocks to decrypt.
+   @param out where the decrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+static void referenceDecrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  for ( size_t i = 0; i < nblocks; i++ ) {
+    memmove( out + i * BLOCK_SIZE, in + i * BLOCK_SIZE, BLOCK_SIZE );
+    aesDecryptReference( ctx, out + i * BLOCK_SIZE );
+  }
+}
+
+/** The byte-wise reference engine, always available as the last fallback. */
+static AesEngine const referenceEngine = {
+  "reference", referenceSupported, referenceExpandKey, referenceEncrypt, referenceDecrypt
+};
+
+/** Every engine built into the program, in order of preference: the AES instructions, widest first, then the
+    constant-time vector permute and bitsliced engines, which don't leak timing through the cache, then the
+    lookup-based ones. */
+static AesEngine const *const engines[] = {
+  &vaesEngine,
+  &aesniEngine,
+  &vpermEngine,
+  &bitsliceEngine,
+  &tableEngine,
+  &referenceEngine,
+  NULL
+};
+
+/** Engine new contexts are initialized for. */
+static AesEngine const *defaultEngine = NULL;
+
+/** Makes sure the default engine is only chosen once. */
+static pthread_once_t defaultOnce = PTHREAD_ONCE_INIT;
+
+/**
+   Choose the default engine: the one named in AES_ENGINE if it's usable, otherwise the fastest supported one.
+*/
+static void chooseDefaultEngine( void )
+{
+  char const *name = getenv( "AES_ENGINE" );
+  if ( name )
+    defaultEngine = aesFindEngine( name );
+
+  for ( int i = 0; !defaultEngine && engines[i]; i++ ) {
+    if ( engines[i]->supported() )
+      defaultEngine = engines[i];
+  }
+}
+
+AesEngine const *const *aesEngineList( void ) {
+  return engines;
+}
+
+AesEngine const *aesFindEngine( char const *name ) {
+  for ( int i = 0; engines[i]; i++ ) {
+    if ( strcmp( engines[i]->name, name ) == 0 )
+      return engines[i]->supported() ? engines[i] : NULL;
+  }
+  return NULL;
+}
+
+AesEngine const *aesGetEngine( void ) {
+  pthread_once( &defaultOnce, chooseDefaultEngine );
+  return defaultEngine;
+}
+
+bool aesSetEngine( char const *name ) {
+  AesEngine const *engine = aesFindEngine( name );
+  if ( !engine )
+    return false;
+
+  // Make sure a later aesGetEngine() doesn't replace this choice.
+  pthread_once( &defaultOnce, chooseDefaultEngine );
+  defaultEngine = engine;
+  return true;
+}
+
+void aesInitCtxEngine( AesContext *ctx, byte const key[ BLOCK_SIZE ], AesEngine const *engine ) {
+  STATS_START( start );
+  ctx->engine = engine;
+  engine->expandKey( ctx, key );
+  STATS_STOP( STAT_KEY, start, 1 );
+  STATS_ENGINE( engine->name );
+}
+
+void aesInitCtx( AesContext *ctx, byte const key[ BLOCK_SIZE ] ) {
+  aesInitCtxEngine( ctx, key, aesGetEngine() );
+}
+
+void aesEncryptWithCtx( AesContext const *ctx, byte data[ BLOCK_SIZE ] ) {
+  ctx->engine->encrypt( ctx, data, data, 1 );
+}
+
+void aesDecryptWithCtx( AesContext const *ctx, byte data[ BLOCK_SIZE ] ) {
+  ctx->engine->decrypt( ctx, data, data, 1 );
+}
+
+void encryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks ) {
+  STATS_COUNT( STAT_BLOCKS, nblocks );
+  ctx->engine->encrypt( ctx, in, out, nblocks );
+}
+
+void decryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks ) {
+  STATS_COUNT( STAT_BLOCKS, nblocks );
+  ctx->engine->decrypt( ctx, in, out, nblocks );
+}
+
+void aesEncryptReference( AesContext const *ctx, byte data[ BLOCK_SIZE ] ) {
   byte square[BLOCK_ROWS][BLOCK_COLS];
 
-  addSubkey( data, subKey[0] );
+  addSubkey( data, ctx->subkey[0] );
 
   for ( int i = 1; i < ROUNDS + 1; i++ ) {
     for ( int j = 0; j < BLOCK_SIZE; j++ ) {
@@ -294,17 +452,15 @@ void encryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] ) {
       mixColumns( square );
     }
     squareToBlock( data, square );
-    addSubkey( data, subKey[i] );
+    addSubkey( data, ctx->subkey[i] );
   }
 }
 
-void decryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] ) {
-  byte subKey[ROUNDS + 1][BLOCK_SIZE];
-  generateSubkeys( subKey, key );
+void aesDecryptReference( AesContext const *ctx, byte data[ BLOCK_SIZE ] ) {
   byte square[BLOCK_ROWS][BLOCK_COLS];
 
   for ( int i = ROUNDS; i > 0; i-- ) {
-    addSubkey( data, subKey[i] );
+    addSubkey( data, ctx->subkey[i] );
     blockToSquare( square, data );
     if ( i != INDEX10 ) {
       unMixColumns( square );
@@ -315,5 +471,17 @@ void decryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] ) {
       data[j] = invSubstBox( data[j] );
     }
   }
-  addSubkey( data, subKey[0] );
+  addSubkey( data, ctx->subkey[0] );
+}
+
+void encryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] ) {
+  AesContext ctx;
+  aesInitCtx( &ctx, key );
+  aesEncryptWithCtx( &ctx, data );
+}
+
+void decryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] ) {
+  AesContext ctx;
+  aesInitCtx( &ctx, key );
+  aesDecryptWithCtx( &ctx, data );
 }
@@ -10,6 +10,9 @@
 #define _AES_H_
 
 #include "field.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /** Number of bytes in an AES key or an AES block. */
 #define BLOCK_SIZE 16
@@ -68,8 +71,83 @@
 /** Represents index 15 in array operations */
 #define INDEX15 15
 
-/** Required number of command line arguments */
-#define NUMARGS 4
+/** An implementation of the AES rounds, chosen at run time.  The fields are described below with the struct. */
+typedef struct AesEngine AesEngine;
+
+/**
+ * Expanded key for AES. It's filled in once from a 16-byte key by aesInitCtx(), then reused for every
+ * block encrypted or decrypted with that key, so the key schedule doesn't have to be recomputed per block.
+*/
+typedef struct {
+  /** Subkeys for each of the rounds, as computed by generateSubkeys(). */
+  byte subkey[ ROUNDS + 1 ][ BLOCK_SIZE ];
+
+  /** Subkeys for the equivalent inverse cipher, as computed by generateInvSubkeys(). */
+  byte invSubkey[ ROUNDS + 1 ][ BLOCK_SIZE ];
+
+  /** The encryption subkeys packed as 32-bit column words, for the T-table engine. */
+  uint32_t encWords[ ( ROUNDS + 1 ) * BLOCK_COLS ];
+
+  /** The inverse cipher subkeys packed as 32-bit column words, for the T-table engine. */
+  uint32_t decWords[ ( ROUNDS + 1 ) * BLOCK_COLS ];
+
+  /** The encryption subkeys, each repeated for four blocks and split into eight bit planes, for the bitsliced engine. */
+  uint64_t sliceKeys[ ( ROUNDS + 1 ) * BBITS ];
+
+  /** Engine the subkeys were expanded for, and that encrypts and decrypts with this context. */
+  AesEngine const *engine;
+} AesContext;
+
+/** Table of functions for one implementation of the AES rounds. */
+struct AesEngine {
+  /** Short name for the engine, used to select it by name. */
+  char const *name;
+
+  /**
+   * Reports whether the engine can run on this host.
+   * @return true if the processor supports everything the engine needs
+  */
+  bool ( *supported )( void );
+
+  /**
+   * Fills in the subkeys in the context that this engine uses, starting from the key.
+   * @param ctx the context to fill in
+   * @param key the key to expand
+  */
+  void ( *expandKey )( AesContext *ctx, byte const key[ BLOCK_SIZE ] );
+
+  /**
+   * Encrypts a sequence of 16-byte blocks.
+   * @param ctx the context holding the expanded key
+   * @param in the blocks to encrypt
+   * @param out where the encrypted blocks go, which may be the same as in
+   * @param nblocks the number of blocks
+  */
+  void ( *encrypt )( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+  /**
+   * Decrypts a sequence of 16-byte blocks.
+   * @param ctx the context holding the expanded key
+   * @param in the blocks to decrypt
+   * @param out where the decrypted blocks go, which may be the same as in
+   * @param nblocks the number of blocks
+  */
+  void ( *decrypt )( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+};
+
+/**
+ * This function returns the sBox substitution value for a given byte value.
+ * @param v byte input value
+ * @return substitution for the given byte
+*/
+byte substBox( byte v );
+
+/**
+ * This function returns the inverse sBox substitution value for a given byte value.
+ * @param v byte input value
+ * @return inverse substitution for the given byte
+*/
+byte invSubstBox( byte v );
 
 /**
  * This function computes the g function used in generating the subkeys from the original, 16-byte key. It takes
@@ -88,6 +166,15 @@ void gFunction( byte dest[ WORD_SIZE ], byte const src[ WORD_SIZE ], int r );
 */
 void generateSubkeys( byte subkey[ ROUNDS + 1 ][ BLOCK_SIZE ], byte const key[ BLOCK_SIZE ] );
 
+/**
+ * This function fills in the subkeys for the equivalent inverse cipher, used by the faster decryption engines. These are
+ * the subkeys in reverse order, with unMixColumns applied to all but the first and last, so they can be added after the
+ * unMixColumns step of a decryption round instead of before it.
+ * @param invSubkey the array which will contain the inverse cipher subkeys
+ * @param subkey the subkeys computed by generateSubkeys()
+*/
+void generateInvSubkeys( byte invSubkey[ ROUNDS + 1 ][ BLOCK_SIZE ], byte const subkey[ ROUNDS + 1 ][ BLOCK_SIZE ] );
+
 /**
  * This function adds the given subkey (key) to the given data array.
  * @param data the data array to add the subkey to
@@ -154,4 +241,101 @@ void encryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] );
 */
 void decryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] );
 
+/**
+ * This function initializes an AES context from the given key, for the engine returned by aesGetEngine(). It generates
+ * the 11 subkeys once, so the context can then be used to encrypt or decrypt any number of blocks without repeating the
+ * key schedule.
+ * @param ctx the context to initialize
+ * @param key the key the context will encrypt and decrypt with
+*/
+void aesInitCtx( AesContext *ctx, byte const key[ BLOCK_SIZE ] );
+
+/**
+ * This function initializes an AES context from the given key, for a specific engine.
+ * @param ctx the context to initialize
+ * @param key the key the context will encrypt and decrypt with
+ * @param engine the engine the context will use, which must be supported on this host
+*/
+void aesInitCtxEngine( AesContext *ctx, byte const key[ BLOCK_SIZE ], AesEngine const *engine );
+
+/**
+ * This function encrypts a 16-byte block of data in place using the subkeys already expanded in the given context.
+ * It runs the engine the context was initialized for.
+ * @param ctx the context holding the expanded key
+ * @param data the data to perform the encryption on
+*/
+void aesEncryptWithCtx( AesContext const *ctx, byte data[ BLOCK_SIZE ] );
+
+/**
+ * This function decrypts a 16-byte block of data in place using the subkeys already expanded in the given context.
+ * It runs the engine the context was initialized for.
+ * @param ctx the context holding the expanded key
+ * @param data the data to perform the decryption on
+*/
+void aesDecryptWithCtx( AesContext const *ctx, byte data[ BLOCK_SIZE ] );
+
+/**
+ * This function encrypts a sequence of independent 16-byte blocks (ECB) with the given context. The engines keep
+ * several blocks in flight through each round, so this is much faster than calling aesEncryptWithCtx() in a loop.
+ * @param ctx the context holding the expanded key
+ * @param in the blocks to encrypt
+ * @param out where the encrypted blocks go; this may be the same as in, but they must not partially overlap
+ * @param nblocks the number of blocks
+*/
+void encryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * This function decrypts a sequence of independent 16-byte blocks (ECB) with the given context.
+ * @param ctx the context holding the expanded key
+ * @param in the blocks to decrypt
+ * @param out where the decrypted blocks go; this may be the same as in, but they must not partially overlap
+ * @param nblocks the number of blocks
+*/
+void decryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * This function encrypts a 16-byte block of data in place with the byte-wise reference rounds (substBox, shiftRows,
+ * mixColumns and addSubkey on byte arrays). It's slower than aesEncryptWithCtx(), but it's kept as the reference the
+ * faster engines are checked against.
+ * @param ctx the context holding the expanded key
+ * @param data the data to perform the encryption on
+*/
+void aesEncryptReference( AesContext const *ctx, byte data[ BLOCK_SIZE ] );
+
+/**
+ * This function decrypts a 16-byte block of data in place with the byte-wise reference rounds.
+ * @param ctx the context holding the expanded key
+ * @param data the data to perform the decryption on
+*/
+void aesDecryptReference( AesContext const *ctx, byte data[ BLOCK_SIZE ] );
+
+/**
+ * This function returns the list of all engines built into the program, fastest first, ending with a null pointer.
+ * Some of them may not be supported on this host.
+ * @return the list of engines
+*/
+AesEngine const *const *aesEngineList( void );
+
+/**
+ * This function looks up an engine by name.
+ * @param name the name of the engine
+ * @return the engine, or NULL if there's no engine with that name or it isn't supported on this host
+*/
+AesEngine const *aesFindEngine( char const *name );
+
+/**
+ * This function returns the engine new contexts are initialized for. Unless aesSetEngine() has been called, this is
+ * chosen the first time it's needed: the engine named by the AES_ENGINE environment variable if there is one, otherwise
+ * the fastest engine this host supports.
+ * @return the current default engine
+*/
+AesEngine const *aesGetEngine( void );
+
+/**
+ * This function changes the engine new contexts are initialized for.
+ * @param name the name of the engine to use
+ * @return true if the engine was found and is supported on this host, false if the default was left unchanged
+*/
+bool aesSetEngine( char const *name );
+
 #endif
@@ -0,0 +1,496 @@
+/**
+  @file aesBench.c
+  @author Jimin Yu, jyu34
+  Throughput benchmark for the AES engines and cipher modes. For every combination of engine, mode, message size,
+  thread count and key change frequency asked for, it encrypts messages until enough time has passed to measure, and
+  reports GB/s and cycles per byte as a table, JSON or CSV.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "aes.h"
+#include "modes.h"
+#include "parallel.h"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+/** Most values in any of the lists given on the command line. */
+#define MAX_LIST 32
+
+/** Default message sizes, in bytes. */
+#define DEFAULT_SIZES "16,256,4K,64K,1M"
+
+/** Default number of seconds to spend on each measurement. */
+#define DEFAULT_MIN_TIME 0.2
+
+/** Seconds a batch of messages should take before it stops growing, so reading the clock costs next to nothing. */
+#define BATCH_TIME 1e-3
+
+/** Nanoseconds in a second. */
+#define NANOS 1e9
+
+/** Bytes in a gigabyte, for GB/s. */
+#define GIGABYTE 1e9
+
+/** Bytes in a kilobyte, for size suffixes. */
+#define KILO 1024
+
+/** Ways of writing the results. */
+typedef enum { FORMAT_TEXT, FORMAT_JSON, FORMAT_CSV } Format;
+
+/** The operations that can be measured. */
+typedef enum { BENCH_ECB_ENC, BENCH_ECB_DEC, BENCH_CTR, BENCH_CBC_ENC, BENCH_CBC_DEC, BENCH_GCM_ENC,
+               BENCH_MODES } BenchMode;
+
+/** Names of the operations, in BenchMode order. */
+static char const *const modeNames[ BENCH_MODES ] = { "ecb-enc", "ecb-dec", "ctr", "cbc-enc", "cbc-dec", "gcm-enc" };
+
+/** Everything asked for on the command line. */
+typedef struct {
+  /** The engines to measure. */
+  AesEngine const *engines[ MAX_LIST ];
+  int engineCount;
+
+  /** The operations to measure. */
+  BenchMode modes[ MAX_LIST ];
+  int modeCount;
+
+  /** Message sizes, in bytes. */
+  size_t sizes[ MAX_LIST ];
+  int sizeCount;
+
+  /** Thread counts. */
+  int threads[ MAX_LIST ];
+  int threadCount;
+
+  /** Messages per key; 0 means the key never changes. */
+  int rekeys[ MAX_LIST ];
+  int rekeyCount;
+
+  /** Seconds to spend on each measurement. */
+  double minTime;
+
+  /** How to write the results. */
+  Format format;
+} BenchOptions;
+
+/** One measurement. */
+typedef struct {
+  /** Messages processed. */
+  long messages;
+
+  /** Wall clock seconds. */
+  double seconds;
+
+  /** Time stamp counter ticks, or 0 where there isn't one. */
+  double cycles;
+} Measurement;
+
+/**
+   Read a clock that only goes forward.
+   @return the time in seconds.
+*/
+static double now( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec / NANOS;
+}
+
+/**
+   Read the processor's time stamp counter.
+   @return the count, or 0 if the processor doesn't have one.
+*/
+static double cycleCount( void )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/**
+   Print the usage message and exit.
+*/
+static void usage( void )
+{
+  fprintf( stderr, "usage: aesBench [--engine E,...] [--mode M,...] [--sizes N,...] [-j N,...] [--rekey N,...]\n"
+                   "                [--min-time S] [--json|--csv]\n" );
+  exit( EXIT_FAILURE );
+}
+
+/**
+   Parse a size with an optional K, M or G suffix.
+   @param text the size.
+   @return the number of bytes.
+*/
+static size_t parseSize( char const *text )
+{
+  char *end;
+  unsigned long long n = strtoull( text, &end, 10 );
+  if ( end == text )
+    usage();
+  if ( *end == 'K' )
+    n *= KILO, end++;
+  else if ( *end == 'M' )
+    n *= KILO * KILO, end++;
+  else if ( *end == 'G' )
+    n *= KILO * KILO * KILO, end++;
+  if ( *end != '\0' )
+    usage();
+  return n;
+}
+
+/**
+   Split a comma-separated list, calling a function on each item.
+   @param text the list, which is modified.
+   @param fn called with each item and the options.
+   @param opts the options being filled in.
+*/
+static void parseList( char *text, void ( *fn )( char const *item, BenchOptions *opts ), BenchOptions *opts )
+{
+  for ( char *item = strtok( text, "," ); item; item = strtok( NULL, "," ) )
+    fn( item, opts );
+}
+
+/**
+   Add an engine to the options by name.
+   @param item the engine's name.
+   @param opts the options.
+*/
+static void addEngine( char const *item, BenchOptions *opts )
+{
+  AesEngine const *engine = aesFindEngine( item );
+  if ( !engine ) {
+    fprintf( stderr, "Engine not available: %s\n", item );
+    exit( EXIT_FAILURE );
+  }
+  if ( opts->engineCount == MAX_LIST )
+    usage();
+  opts->engines[ opts->engineCount++ ] = engine;
+}
+
+/**
+   Add an operation to the options by name.
+   @param item the operation's name.
+   @param opts the options.
+*/
+static void addMode( char const *item, BenchOptions *opts )
+{
+  for ( int m = 0; m < BENCH_MODES; m++ ) {
+    if ( strcmp( item, modeNames[ m ] ) == 0 && opts->modeCount < MAX_LIST ) {
+      opts->modes[ opts->modeCount++ ] = m;
+      return;
+    }
+  }
+  usage();
+}
+
+/**
+   Add a message size to the options.
+   @param item the size, with an optional suffix.
+   @param opts the options.
+*/
+static void addSize( char const *item, BenchOptions *opts )
+{
+  size_t size = parseSize( item );
+  if ( size < BLOCK_SIZE || size % BLOCK_SIZE != 0 || opts->sizeCount == MAX_LIST )
+    usage();
+  opts->sizes[ opts->sizeCount++ ] = size;
+}
+
+/**
+   Add a thread count to the options.
+   @param item the count, or auto.
+   @param opts the options.
+*/
+static void addThreads( char const *item, BenchOptions *opts )
+{
+  int n = strcmp( item, "auto" ) == 0 ? parallelCpuCount() : atoi( item );
+  if ( n < 1 || opts->threadCount == MAX_LIST )
+    usage();
+  opts->threads[ opts->threadCount++ ] = n;
+}
+
+/**
+   Add a key change frequency to the options.
+   @param item the number of messages per key, 0 for never.
+   @param opts the options.
+*/
+static void addRekey( char const *item, BenchOptions *opts )
+{
+  int n = atoi( item );
+  if ( n < 0 || opts->rekeyCount == MAX_LIST )
+    usage();
+  opts->rekeys[ opts->rekeyCount++ ] = n;
+}
+
+/**
+   Parse the command line, filling in defaults for anything not given.
+   @param opts the options to fill in.
+   @param argc the number of command line arguments.
+   @param argv the command line arguments.
+*/
+static void parseBenchOptions( BenchOptions *opts, int argc, char *argv[] )
+{
+  memset( opts, 0, sizeof( BenchOptions ) );
+  opts->minTime = DEFAULT_MIN_TIME;
+  opts->format = FORMAT_TEXT;
+
+  for ( int i = 1; i < argc; i++ ) {
+    char *value = i + 1 < argc ? argv[ i + 1 ] : NULL;
+    if ( strcmp( argv[ i ], "--json" ) == 0 )
+      opts->format = FORMAT_JSON;
+    else if ( strcmp( argv[ i ], "--csv" ) == 0 )
+      opts->format = FORMAT_CSV;
+    else if ( !value )
+      usage();
+    else if ( strcmp( argv[ i ], "--engine" ) == 0 )
+      parseList( argv[ ++i ], addEngine, opts );
+    else if ( strcmp( argv[ i ], "--mode" ) == 0 )
+      parseList( argv[ ++i ], addMode, opts );
+    else if ( strcmp( argv[ i ], "--sizes" ) == 0 )
+      parseList( argv[ ++i ], addSize, opts );
+    else if ( strcmp( argv[ i ], "-j" ) == 0 )
+      parseList( argv[ ++i ], addThreads, opts );
+    else if ( strcmp( argv[ i ], "--rekey" ) == 0 )
+      parseList( argv[ ++i ], addRekey, opts );
+    else if ( strcmp( argv[ i ], "--min-time" ) == 0 && ( opts->minTime = atof( argv[ ++i ] ) ) > 0 )
+      continue;
+    else
+      usage();
+  }
+
+  // Every engine this host supports, every mode, one thread and a key that never changes, unless told otherwise.
+  AesEngine const *const *engines = aesEngineList();
+  if ( opts->engineCount == 0 ) {
+    for ( int e = 0; engines[ e ]; e++ ) {
+      if ( engines[ e ]->supported() )
+        opts->engines[ opts->engineCount++ ] = engines[ e ];
+    }
+  }
+  if ( opts->modeCount == 0 ) {
+    for ( int m = 0; m < BENCH_MODES; m++ )
+      opts->modes[ opts->modeCount++ ] = m;
+  }
+  if ( opts->sizeCount == 0 ) {
+    char sizes[] = DEFAULT_SIZES;
+    parseList( sizes, addSize, opts );
+  }
+  if ( opts->threadCount == 0 )
+    opts->threads[ opts->threadCount++ ] = 1;
+  if ( opts->rekeyCount == 0 )
+    opts->rekeys[ opts->rekeyCount++ ] = 0;
+}
+
+/** IV for every message; the benchmark only cares how fast the messages go. */
+static byte const benchIv[ BLOCK_SIZE ] = { 0 };
+
+/**
+   Set up a key for a measurement: expand it, and for GCM work out the hash key and its tables too, so they're only
+   worked out again when the benchmark rekeys.
+   @param ctx the context to fill in.
+   @param gcm the GCM state to fill in, used only for GCM.
+   @param key the key.
+   @param engine the engine.
+   @param mode the operation.
+*/
+static void setKey( AesContext *ctx, GcmContext *gcm, byte const key[ BLOCK_SIZE ], AesEngine const *engine,
+                    BenchMode mode )
+{
+  aesInitCtxEngine( ctx, key, engine );
+  if ( mode == BENCH_GCM_ENC )
+    gcmInit( gcm, ctx, benchIv );
+}
+
+/**
+   Process one message with the given operation.
+   @param mode the operation.
+   @param pool the pool to run on, or NULL.
+   @param ctx the expanded key.
+   @param gcm GCM state from setKey(), started again for each message.
+   @param in the message.
+   @param out where the result goes.
+   @param size the message size, a multiple of the block size.
+*/
+static void runOnce( BenchMode mode, WorkerPool *pool, AesContext const *ctx, GcmContext *gcm, byte const *in,
+                     byte *out, size_t size )
+{
+  size_t nblocks = size / BLOCK_SIZE;
+  switch ( mode ) {
+  case BENCH_ECB_ENC:
+    parallelEncryptBlocks( pool, ctx, in, out, nblocks );
+    break;
+  case BENCH_ECB_DEC:
+    parallelDecryptBlocks( pool, ctx, in, out, nblocks );
+    break;
+  case BENCH_CTR:
+    parallelCtrCrypt( pool, ctx, benchIv, 0, in, out, size );
+    break;
+  case BENCH_CBC_ENC: {
+    // One chain can't be split across threads.
+    CbcStream stream = { in, out, nblocks };
+    memcpy( stream.iv, benchIv, BLOCK_SIZE );
+    cbcEncryptStreams( ctx, &stream, 1 );
+    break;
+  }
+  case BENCH_CBC_DEC: {
+    byte chain[ BLOCK_SIZE ] = { 0 };
+    parallelCbcDecrypt( pool, ctx, chain, in, out, nblocks );
+    break;
+  }
+  default: {
+    byte tag[ GCM_TAG_SIZE ];
+    gcmRestart( gcm, benchIv );
+    gcmEncrypt( gcm, pool, in, out, size );
+    gcmFinal( gcm, tag );
+    break;
+  }
+  }
+}
+
+/**
+   Measure one combination: process messages until the minimum time has passed, setting up the key again every
+   rekey messages. The clock is read once per batch of messages, not once per message, and the batch doubles until it
+   takes at least BATCH_TIME, so small messages aren't mostly timing the clock.
+   @param opts the options, for the minimum time.
+   @param engine the engine.
+   @param mode the operation.
+   @param pool the pool to run on, or NULL.
+   @param rekey messages per key, 0 for never.
+   @param in the messages.
+   @param out where the results go.
+   @param size the message size.
+   @return the measurement.
+*/
+static Measurement measure( BenchOptions const *opts, AesEngine const *engine, BenchMode mode, WorkerPool *pool,
+                            int rekey, byte const *in, byte *out, size_t size )
+{
+  byte key[ BLOCK_SIZE ] = {
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+  AesContext ctx;
+  GcmContext gcm;
+  setKey( &ctx, &gcm, key, engine, mode );
+
+  // One untimed run, to fault in the buffers and build any tables.
+  runOnce( mode, pool, &ctx, &gcm, in, out, size );
+
+  Measurement m = { 0 };
+  long batch = 1;
+  double start = now();
+  double startCycles = cycleCount();
+  do {
+    for ( long i = 0; i < batch; i++ ) {
+      if ( rekey && m.messages % rekey == 0 ) {
+        key[ 0 ]++;
+        setKey( &ctx, &gcm, key, engine, mode );
+      }
+      runOnce( mode, pool, &ctx, &gcm, in, out, size );
+      m.messages++;
+    }
+    double batchStart = m.seconds;
+    m.seconds = now() - start;
+    if ( m.seconds - batchStart < BATCH_TIME )
+      batch *= 2;
+  } while ( m.seconds < opts->minTime );
+  m.cycles = cycleCount() - startCycles;
+  return m;
+}
+
+/**
+   Print the heading for the results.
+   @param format how the results are written.
+*/
+static void printHeader( Format format )
+{
+  if ( format == FORMAT_TEXT )
+    printf( "%-10s %-8s %12s %7s %6s %12s %10s %12s\n", "engine", "mode", "size", "threads", "rekey", "messages",
+            "GB/s", "cycles/byte" );
+  else if ( format == FORMAT_CSV )
+    printf( "engine,mode,size,threads,rekey,messages,seconds,gbps,cycles_per_byte\n" );
+  else
+    printf( "[\n" );
+}
+
+/**
+   Print one result.
+   @param format how the results are written.
+   @param first true for the first result.
+   @param engine the engine.
+   @param mode the operation.
+   @param size the message size.
+   @param threads the thread count.
+   @param rekey messages per key.
+   @param m the measurement.
+*/
+static void printResult( Format format, bool first, AesEngine const *engine, BenchMode mode, size_t size, int threads,
+                         int rekey, Measurement const *m )
+{
+  double bytes = (double) m->messages * size;
+  double gbps = bytes / m->seconds / GIGABYTE;
+  double cpb = m->cycles / bytes;
+  if ( format == FORMAT_TEXT )
+    printf( "%-10s %-8s %12zu %7d %6d %12ld %10.3f %12.2f\n", engine->name, modeNames[ mode ], size, threads, rekey,
+            m->messages, gbps, cpb );
+  else if ( format == FORMAT_CSV )
+    printf( "%s,%s,%zu,%d,%d,%ld,%.6f,%.4f,%.4f\n", engine->name, modeNames[ mode ], size, threads, rekey,
+            m->messages, m->seconds, gbps, cpb );
+  else
+    printf( "%s  {\"engine\": \"%s\", \"mode\": \"%s\", \"size\": %zu, \"threads\": %d, \"rekey\": %d, "
+            "\"messages\": %ld, \"seconds\": %.6f, \"gbps\": %.4f, \"cyclesPerByte\": %.4f}",
+            first ? "" : ",\n", engine->name, modeNames[ mode ], size, threads, rekey, m->messages, m->seconds,
+            gbps, cpb );
+}
+
+int main( int argc, char *argv[] )
+{
+  BenchOptions opts;
+  parseBenchOptions( &opts, argc, argv );
+
+  size_t most = 0;
+  for ( int s = 0; s < opts.sizeCount; s++ )
+    most = opts.sizes[ s ] > most ? opts.sizes[ s ] : most;
+  byte *in = malloc( most + GCM_TAG_SIZE );
+  byte *out = malloc( most + GCM_TAG_SIZE );
+  if ( !in || !out ) {
+    fprintf( stderr, "Not enough memory for %zu byte messages\n", most );
+    exit( EXIT_FAILURE );
+  }
+  for ( size_t i = 0; i < most; i++ )
+    in[ i ] = i * 7 + 1;
+
+  printHeader( opts.format );
+  bool first = true;
+  for ( int t = 0; t < opts.threadCount; t++ ) {
+    WorkerPool *pool = poolCreate( opts.threads[ t ] );
+    for ( int e = 0; e < opts.engineCount; e++ ) {
+      for ( int m = 0; m < opts.modeCount; m++ ) {
+        for ( int s = 0; s < opts.sizeCount; s++ ) {
+          for ( int r = 0; r < opts.rekeyCount; r++ ) {
+            Measurement result = measure( &opts, opts.engines[ e ], opts.modes[ m ], pool, opts.rekeys[ r ], in, out,
+                                          opts.sizes[ s ] );
+            printResult( opts.format, first, opts.engines[ e ], opts.modes[ m ], opts.sizes[ s ], opts.threads[ t ],
+                         opts.rekeys[ r ], &result );
+            first = false;
+            fflush( stdout );
+          }
+        }
+      }
+    }
+    poolDestroy( pool );
+  }
+  if ( opts.format == FORMAT_JSON )
+    printf( "\n]\n" );
+
+  free( in );
+  free( out );
+  return EXIT_SUCCESS;
+}
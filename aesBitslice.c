@@ -0,0 +1,576 @@
+/**
+ * @file aesBitslice.c
+ * @author Jimin Yu, jyu34
+ * This file implements the bitsliced AES engine. Four blocks are transposed so that each of eight 64-bit words holds
+ * one bit of every byte of all four blocks. substBox is then a fixed Boolean circuit (the one by Boyar and Peralta,
+ * which computes the field inverse and the affine map in 113 gates), and shiftRows and mixColumns are shifts,
+ * rotations and XORs of whole words. Nothing indexes memory with a secret value and nothing branches on one, so the
+ * engine runs in the same time for every key and block, unlike the table lookups in aes.c and aesTable.c.
+*/
+
+#include "aesBitslice.h"
+#include "aes.h"
+#include "field.h"
+#include <string.h>
+
+/** Number of 64-bit words in a bitsliced state, one for each bit of a byte. */
+#define PLANES BBITS
+
+/** Number of 32-bit words in a block. */
+#define BLOCK_WORDS 4
+
+/** Number of bits to shift to get to the second byte of a word. */
+#define SHIFT1 8
+
+/** Number of bits to shift to get to the third byte of a word. */
+#define SHIFT2 16
+
+/** Number of bits to shift to get to the top byte of a word. */
+#define SHIFT3 24
+
+/** Number of bits in half of a 64-bit word. */
+#define HALF_BITS 32
+
+/** Bytes substituted at a time by bitsliceSubstBytes(), a full state. */
+#define SUBST_BYTES ( SLICE_BLOCKS * BLOCK_SIZE )
+
+/** Round constants for the key schedule. */
+static byte const roundConstant[ ROUNDS + 1 ] = { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36 };
+
+/**
+   Swap the bits selected by lo in y with the bits selected by hi in x, s places further up. This is one step of
+   transposing the bits of eight words.
+   @param x the first word.
+   @param y the second word.
+   @param lo mask of bits that stay in x.
+   @param hi mask of bits that stay in y.
+   @param s distance between swapped bits.
+*/
+static inline void swapBits( uint64_t *x, uint64_t *y, uint64_t lo, uint64_t hi, int s )
+{
+  uint64_t a = *x, b = *y;
+  *x = ( a & lo ) | ( ( b & lo ) << s );
+  *y = ( ( a & hi ) >> s ) | ( b & hi );
+}
+
+/**
+   Transpose the state between byte order and bit planes. Each group of eight bits in the same place across the
+   words is transposed as an 8x8 matrix, so doing it twice gets the original back.
+   @param q the eight words of the state.
+*/
+static void ortho( uint64_t q[ PLANES ] )
+{
+  for ( int i = 0; i < PLANES; i += INDEX2 )
+    swapBits( &q[ i ], &q[ i + 1 ], 0x5555555555555555, 0xAAAAAAAAAAAAAAAA, 1 );
+  for ( int i = 0; i < PLANES; i += INDEX4 ) {
+    swapBits( &q[ i ], &q[ i + INDEX2 ], 0x3333333333333333, 0xCCCCCCCCCCCCCCCC, INDEX2 );
+    swapBits( &q[ i + 1 ], &q[ i + INDEX3 ], 0x3333333333333333, 0xCCCCCCCCCCCCCCCC, INDEX2 );
+  }
+  for ( int i = 0; i < INDEX4; i++ )
+    swapBits( &q[ i ], &q[ i + INDEX4 ], 0x0F0F0F0F0F0F0F0F, 0xF0F0F0F0F0F0F0F0, INDEX4 );
+}
+
+/**
+   Load four bytes as a little-endian word.
+   @param p the bytes.
+   @return the word.
+*/
+static inline uint32_t loadLittle( byte const *p )
+{
+  return p[ 0 ] | ( (uint32_t) p[ 1 ] << SHIFT1 ) | ( (uint32_t) p[ INDEX2 ] << SHIFT2 ) |
+    ( (uint32_t) p[ INDEX3 ] << SHIFT3 );
+}
+
+/**
+   Store a word as four little-endian bytes.
+   @param p where the bytes go.
+   @param w the word.
+*/
+static inline void storeLittle( byte *p, uint32_t w )
+{
+  p[ 0 ] = w;
+  p[ 1 ] = w >> SHIFT1;
+  p[ INDEX2 ] = w >> SHIFT2;
+  p[ INDEX3 ] = w >> SHIFT3;
+}
+
+/**
+   Spread the bytes of one block across two words, leaving a zero byte after each one so that ortho() lines the
+   same row and column of the four blocks up next to each other.
+   @param q0 gets the first and third columns.
+   @param q1 gets the second and fourth columns.
+   @param block the 16 bytes of the block.
+*/
+static void interleaveIn( uint64_t *q0, uint64_t *q1, byte const *block )
+{
+  uint64_t x[ BLOCK_WORDS ];
+  for ( int i = 0; i < BLOCK_WORDS; i++ ) {
+    x[ i ] = loadLittle( block + i * WORD_SIZE );
+    x[ i ] |= x[ i ] << SHIFT2;
+    x[ i ] &= 0x0000FFFF0000FFFF;
+    x[ i ] |= x[ i ] << SHIFT1;
+    x[ i ] &= 0x00FF00FF00FF00FF;
+  }
+  *q0 = x[ 0 ] | ( x[ INDEX2 ] << SHIFT1 );
+  *q1 = x[ 1 ] | ( x[ INDEX3 ] << SHIFT1 );
+}
+
+/**
+   Gather one block back from two words, the reverse of interleaveIn().
+   @param block where the 16 bytes go.
+   @param q0 the first and third columns.
+   @param q1 the second and fourth columns.
+*/
+static void interleaveOut( byte *block, uint64_t q0, uint64_t q1 )
+{
+  uint64_t x[ BLOCK_WORDS ] = {
+    q0 & 0x00FF00FF00FF00FF, q1 & 0x00FF00FF00FF00FF,
+    ( q0 >> SHIFT1 ) & 0x00FF00FF00FF00FF, ( q1 >> SHIFT1 ) & 0x00FF00FF00FF00FF };
+  for ( int i = 0; i < BLOCK_WORDS; i++ ) {
+    x[ i ] |= x[ i ] >> SHIFT1;
+    x[ i ] &= 0x0000FFFF0000FFFF;
+    storeLittle( block + i * WORD_SIZE, (uint32_t) x[ i ] | (uint32_t) ( x[ i ] >> SHIFT2 ) );
+  }
+}
+
+/**
+   Load up to SLICE_BLOCKS blocks into a bitsliced state. Missing blocks are zero.
+   @param q the state to fill in.
+   @param in the blocks.
+   @param nblocks the number of blocks, at most SLICE_BLOCKS.
+*/
+static void loadState( uint64_t q[ PLANES ], byte const *in, size_t nblocks )
+{
+  byte zero[ BLOCK_SIZE ] = { 0 };
+  for ( int i = 0; i < SLICE_BLOCKS; i++ )
+    interleaveIn( &q[ i ], &q[ i + SLICE_BLOCKS ], i < nblocks ? in + i * BLOCK_SIZE : zero );
+  ortho( q );
+}
+
+/**
+   Store up to SLICE_BLOCKS blocks from a bitsliced state.
+   @param out where the blocks go.
+   @param q the state, which is transposed back in the process.
+   @param nblocks the number of blocks, at most SLICE_BLOCKS.
+*/
+static void storeState( byte *out, uint64_t q[ PLANES ], size_t nblocks )
+{
+  ortho( q );
+  for ( int i = 0; i < nblocks; i++ )
+    interleaveOut( out + i * BLOCK_SIZE, q[ i ], q[ i + SLICE_BLOCKS ] );
+}
+
+/**
+   Apply substBox to every byte of the state with the Boyar-Peralta circuit: a linear layer into 22 intermediate
+   values, a nonlinear layer that inverts in the field through its GF(16) subfield, and a linear layer out that also
+   applies the sBox's affine map.
+   @param q the eight bit planes of the state, q[ 0 ] holding the low bit of each byte.
+*/
+static void sliceSbox( uint64_t q[ PLANES ] )
+{
+  uint64_t x0 = q[ INDEX7 ], x1 = q[ INDEX6 ], x2 = q[ INDEX5 ], x3 = q[ INDEX4 ];
+  uint64_t x4 = q[ INDEX3 ], x5 = q[ INDEX2 ], x6 = q[ 1 ], x7 = q[ 0 ];
+
+  // Top linear transformation.
+  uint64_t y14 = x3 ^ x5;
+  uint64_t y13 = x0 ^ x6;
+  uint64_t y9 = x0 ^ x3;
+  uint64_t y8 = x0 ^ x5;
+  uint64_t t0 = x1 ^ x2;
+  uint64_t y1 = t0 ^ x7;
+  uint64_t y4 = y1 ^ x3;
+  uint64_t y12 = y13 ^ y14;
+  uint64_t y2 = y1 ^ x0;
+  uint64_t y5 = y1 ^ x6;
+  uint64_t y3 = y5 ^ y8;
+  uint64_t t1 = x4 ^ y12;
+  uint64_t y15 = t1 ^ x5;
+  uint64_t y20 = t1 ^ x1;
+  uint64_t y6 = y15 ^ x7;
+  uint64_t y10 = y15 ^ t0;
+  uint64_t y11 = y20 ^ y9;
+  uint64_t y7 = x7 ^ y11;
+  uint64_t y17 = y10 ^ y11;
+  uint64_t y19 = y10 ^ y8;
+  uint64_t y16 = t0 ^ y11;
+  uint64_t y21 = y13 ^ y16;
+  uint64_t y18 = x0 ^ y16;
+
+  // Nonlinear section.
+  uint64_t t2 = y12 & y15;
+  uint64_t t3 = y3 & y6;
+  uint64_t t4 = t3 ^ t2;
+  uint64_t t5 = y4 & x7;
+  uint64_t t6 = t5 ^ t2;
+  uint64_t t7 = y13 & y16;
+  uint64_t t8 = y5 & y1;
+  uint64_t t9 = t8 ^ t7;
+  uint64_t t10 = y2 & y7;
+  uint64_t t11 = t10 ^ t7;
+  uint64_t t12 = y9 & y11;
+  uint64_t t13 = y14 & y17;
+  uint64_t t14 = t13 ^ t12;
+  uint64_t t15 = y8 & y10;
+  uint64_t t16 = t15 ^ t12;
+  uint64_t t17 = t4 ^ t14;
+  uint64_t t18 = t6 ^ t16;
+  uint64_t t19 = t9 ^ t14;
+  uint64_t t20 = t11 ^ t16;
+  uint64_t t21 = t17 ^ y20;
+  uint64_t t22 = t18 ^ y19;
+  uint64_t t23 = t19 ^ y21;
+  uint64_t t24 = t20 ^ y18;
+
+  uint64_t t25 = t21 ^ t22;
+  uint64_t t26 = t21 & t23;
+  uint64_t t27 = t24 ^ t26;
+  uint64_t t28 = t25 & t27;
+  uint64_t t29 = t28 ^ t22;
+  uint64_t t30 = t23 ^ t24;
+  uint64_t t31 = t22 ^ t26;
+  uint64_t t32 = t31 & t30;
+  uint64_t t33 = t32 ^ t24;
+  uint64_t t34 = t23 ^ t33;
+  uint64_t t35 = t27 ^ t33;
+  uint64_t t36 = t24 & t35;
+  uint64_t t37 = t36 ^ t34;
+  uint64_t t38 = t27 ^ t36;
+  uint64_t t39 = t29 & t38;
+  uint64_t t40 = t25 ^ t39;
+
+  uint64_t t41 = t40 ^ t37;
+  uint64_t t42 = t29 ^ t33;
+  uint64_t t43 = t29 ^ t40;
+  uint64_t t44 = t33 ^ t37;
+  uint64_t t45 = t42 ^ t41;
+  uint64_t z0 = t44 & y15;
+  uint64_t z1 = t37 & y6;
+  uint64_t z2 = t33 & x7;
+  uint64_t z3 = t43 & y16;
+  uint64_t z4 = t40 & y1;
+  uint64_t z5 = t29 & y7;
+  uint64_t z6 = t42 & y11;
+  uint64_t z7 = t45 & y17;
+  uint64_t z8 = t41 & y10;
+  uint64_t z9 = t44 & y12;
+  uint64_t z10 = t37 & y3;
+  uint64_t z11 = t33 & y4;
+  uint64_t z12 = t43 & y13;
+  uint64_t z13 = t40 & y5;
+  uint64_t z14 = t29 & y2;
+  uint64_t z15 = t42 & y9;
+  uint64_t z16 = t45 & y14;
+  uint64_t z17 = t41 & y8;
+
+  // Bottom linear transformation.
+  uint64_t t46 = z15 ^ z16;
+  uint64_t t47 = z10 ^ z11;
+  uint64_t t48 = z5 ^ z13;
+  uint64_t t49 = z9 ^ z10;
+  uint64_t t50 = z2 ^ z12;
+  uint64_t t51 = z2 ^ z5;
+  uint64_t t52 = z7 ^ z8;
+  uint64_t t53 = z0 ^ z3;
+  uint64_t t54 = z6 ^ z7;
+  uint64_t t55 = z16 ^ z17;
+  uint64_t t56 = z12 ^ t48;
+  uint64_t t57 = t50 ^ t53;
+  uint64_t t58 = z4 ^ t46;
+  uint64_t t59 = z3 ^ t54;
+  uint64_t t60 = t46 ^ t57;
+  uint64_t t61 = z14 ^ t57;
+  uint64_t t62 = t52 ^ t58;
+  uint64_t t63 = t49 ^ t58;
+  uint64_t t64 = z4 ^ t59;
+  uint64_t t65 = t61 ^ t62;
+  uint64_t t66 = z1 ^ t63;
+  uint64_t s0 = t59 ^ t63;
+  uint64_t s6 = t56 ^ ~t62;
+  uint64_t s7 = t48 ^ ~t60;
+  uint64_t t67 = t64 ^ t65;
+  uint64_t s3 = t53 ^ t66;
+  uint64_t s4 = t51 ^ t66;
+  uint64_t s5 = t47 ^ t65;
+  uint64_t s1 = t64 ^ ~s3;
+  uint64_t s2 = t55 ^ ~t67;
+
+  q[ INDEX7 ] = s0;
+  q[ INDEX6 ] = s1;
+  q[ INDEX5 ] = s2;
+  q[ INDEX4 ] = s3;
+  q[ INDEX3 ] = s4;
+  q[ INDEX2 ] = s5;
+  q[ 1 ] = s6;
+  q[ 0 ] = s7;
+}
+
+/**
+   Apply the inverse of the sBox's affine map to every byte of the state. It's linear apart from the constant, so in
+   bit planes it's just XORs and complements.
+   @param q the eight bit planes of the state.
+*/
+static void sliceInvAffine( uint64_t q[ PLANES ] )
+{
+  uint64_t q0 = ~q[ 0 ], q1 = ~q[ 1 ], q2 = q[ INDEX2 ], q3 = q[ INDEX3 ];
+  uint64_t q4 = q[ INDEX4 ], q5 = ~q[ INDEX5 ], q6 = ~q[ INDEX6 ], q7 = q[ INDEX7 ];
+  q[ INDEX7 ] = q1 ^ q4 ^ q6;
+  q[ INDEX6 ] = q0 ^ q3 ^ q5;
+  q[ INDEX5 ] = q7 ^ q2 ^ q4;
+  q[ INDEX4 ] = q6 ^ q1 ^ q3;
+  q[ INDEX3 ] = q5 ^ q0 ^ q2;
+  q[ INDEX2 ] = q4 ^ q7 ^ q1;
+  q[ 1 ] = q3 ^ q6 ^ q0;
+  q[ 0 ] = q2 ^ q5 ^ q7;
+}
+
+/**
+   Apply invSubstBox to every byte of the state. The sBox is an affine map A after the field inverse, so the inverse
+   sBox is the inverse followed by A^-1, and the inverse is A^-1 after the sBox: A^-1( S( A^-1( x ) ) ).
+   @param q the eight bit planes of the state.
+*/
+static void sliceInvSbox( uint64_t q[ PLANES ] )
+{
+  sliceInvAffine( q );
+  sliceSbox( q );
+  sliceInvAffine( q );
+}
+
+/**
+   Add a bitsliced subkey to the state.
+   @param q the eight bit planes of the state.
+   @param key the eight bit planes of the subkey.
+*/
+static inline void sliceAddKey( uint64_t q[ PLANES ], uint64_t const key[ PLANES ] )
+{
+  for ( int i = 0; i < PLANES; i++ )
+    q[ i ] ^= key[ i ];
+}
+
+/**
+   Do shiftRows on every bit plane. Each 16-bit group of a plane holds one row of the four blocks, four bits per
+   column, so rotating a row is moving its nibbles.
+   @param q the eight bit planes of the state.
+*/
+static void sliceShiftRows( uint64_t q[ PLANES ] )
+{
+  for ( int i = 0; i < PLANES; i++ ) {
+    uint64_t x = q[ i ];
+    q[ i ] = ( x & 0x000000000000FFFF ) |
+      ( ( x & 0x00000000FFF00000 ) >> INDEX4 ) | ( ( x & 0x00000000000F0000 ) << INDEX12 ) |
+      ( ( x & 0x0000FF0000000000 ) >> INDEX8 ) | ( ( x & 0x000000FF00000000 ) << INDEX8 ) |
+      ( ( x & 0xF000000000000000 ) >> INDEX12 ) | ( ( x & 0x0FFF000000000000 ) << INDEX4 );
+  }
+}
+
+/**
+   Do unShiftRows on every bit plane, moving the nibbles of each row the other way.
+   @param q the eight bit planes of the state.
+*/
+static void sliceUnShiftRows( uint64_t q[ PLANES ] )
+{
+  for ( int i = 0; i < PLANES; i++ ) {
+    uint64_t x = q[ i ];
+    q[ i ] = ( x & 0x000000000000FFFF ) |
+      ( ( x & 0x000000000FFF0000 ) << INDEX4 ) | ( ( x & 0x00000000F0000000 ) >> INDEX12 ) |
+      ( ( x & 0x000000FF00000000 ) << INDEX8 ) | ( ( x & 0x0000FF0000000000 ) >> INDEX8 ) |
+      ( ( x & 0x000F000000000000 ) << INDEX12 ) | ( ( x & 0xFFF0000000000000 ) >> INDEX4 );
+  }
+}
+
+/**
+   Swap the halves of a word, which moves each row of a plane two rows along.
+   @param x the word.
+   @return the word with its halves swapped.
+*/
+static inline uint64_t swapHalves( uint64_t x )
+{
+  return ( x << HALF_BITS ) | ( x >> HALF_BITS );
+}
+
+/**
+   Do mixColumns on the state. Rotating a plane by 16 bits moves each row one row along, and multiplying by 02 is a
+   shift from each plane to the next with the bit that falls off the top folded back in at planes 0, 1, 3 and 4,
+   the bits of REDUCER.
+   @param q the eight bit planes of the state.
+*/
+static void sliceMixColumns( uint64_t q[ PLANES ] )
+{
+  uint64_t r[ PLANES ];
+  for ( int i = 0; i < PLANES; i++ )
+    r[ i ] = ( q[ i ] >> SHIFT2 ) | ( q[ i ] << ( HALF_BITS + SHIFT2 ) );
+
+  uint64_t q0 = q[ 0 ], q1 = q[ 1 ], q2 = q[ INDEX2 ], q3 = q[ INDEX3 ];
+  uint64_t q4 = q[ INDEX4 ], q5 = q[ INDEX5 ], q6 = q[ INDEX6 ], q7 = q[ INDEX7 ];
+  q[ 0 ] = q7 ^ r[ INDEX7 ] ^ r[ 0 ] ^ swapHalves( q0 ^ r[ 0 ] );
+  q[ 1 ] = q0 ^ r[ 0 ] ^ q7 ^ r[ INDEX7 ] ^ r[ 1 ] ^ swapHalves( q1 ^ r[ 1 ] );
+  q[ INDEX2 ] = q1 ^ r[ 1 ] ^ r[ INDEX2 ] ^ swapHalves( q2 ^ r[ INDEX2 ] );
+  q[ INDEX3 ] = q2 ^ r[ INDEX2 ] ^ q7 ^ r[ INDEX7 ] ^ r[ INDEX3 ] ^ swapHalves( q3 ^ r[ INDEX3 ] );
+  q[ INDEX4 ] = q3 ^ r[ INDEX3 ] ^ q7 ^ r[ INDEX7 ] ^ r[ INDEX4 ] ^ swapHalves( q4 ^ r[ INDEX4 ] );
+  q[ INDEX5 ] = q4 ^ r[ INDEX4 ] ^ r[ INDEX5 ] ^ swapHalves( q5 ^ r[ INDEX5 ] );
+  q[ INDEX6 ] = q5 ^ r[ INDEX5 ] ^ r[ INDEX6 ] ^ swapHalves( q6 ^ r[ INDEX6 ] );
+  q[ INDEX7 ] = q6 ^ r[ INDEX6 ] ^ r[ INDEX7 ] ^ swapHalves( q7 ^ r[ INDEX7 ] );
+}
+
+/**
+   Do unMixColumns on the state. The unMixColumns matrix is the mixColumns matrix times the matrix with 05 on the
+   diagonal and 04 two rows along, so this applies that simpler matrix and then sliceMixColumns(). Multiplying by 04
+   is two multiplications by 02.
+   @param q the eight bit planes of the state.
+*/
+static void sliceUnMixColumns( uint64_t q[ PLANES ] )
+{
+  // u = 04 * ( x + the value two rows along ), for every byte.
+  uint64_t u[ PLANES ];
+  for ( int i = 0; i < PLANES; i++ )
+    u[ i ] = q[ i ] ^ swapHalves( q[ i ] );
+  for ( int n = 0; n < INDEX2; n++ ) {
+    uint64_t top = u[ INDEX7 ];
+    for ( int i = INDEX7; i > 0; i-- )
+      u[ i ] = u[ i - 1 ];
+    u[ 0 ] = top;
+    u[ 1 ] ^= top;
+    u[ INDEX3 ] ^= top;
+    u[ INDEX4 ] ^= top;
+  }
+
+  for ( int i = 0; i < PLANES; i++ )
+    q[ i ] ^= u[ i ];
+  sliceMixColumns( q );
+}
+
+/**
+   Encrypt one bitsliced state of SLICE_BLOCKS blocks.
+   @param keys the bitsliced subkeys.
+   @param q the eight bit planes of the state.
+*/
+static void sliceEncrypt( uint64_t const *keys, uint64_t q[ PLANES ] )
+{
+  sliceAddKey( q, keys );
+  for ( int i = 1; i < ROUNDS; i++ ) {
+    sliceSbox( q );
+    sliceShiftRows( q );
+    sliceMixColumns( q );
+    sliceAddKey( q, keys + i * PLANES );
+  }
+  sliceSbox( q );
+  sliceShiftRows( q );
+  sliceAddKey( q, keys + ROUNDS * PLANES );
+}
+
+/**
+   Decrypt one bitsliced state of SLICE_BLOCKS blocks, running the rounds backward with the encryption subkeys.
+   @param keys the bitsliced subkeys.
+   @param q the eight bit planes of the state.
+*/
+static void sliceDecrypt( uint64_t const *keys, uint64_t q[ PLANES ] )
+{
+  sliceAddKey( q, keys + ROUNDS * PLANES );
+  for ( int i = ROUNDS - 1; i > 0; i-- ) {
+    sliceUnShiftRows( q );
+    sliceInvSbox( q );
+    sliceAddKey( q, keys + i * PLANES );
+    sliceUnMixColumns( q );
+  }
+  sliceUnShiftRows( q );
+  sliceInvSbox( q );
+  sliceAddKey( q, keys );
+}
+
+/**
+   Run a sequence of bytes through a bitsliced substitution a state at a time.
+   @param data the bytes to substitute.
+   @param len the number of bytes.
+   @param fn the substitution.
+*/
+static void substBytes( byte *data, size_t len, void ( *fn )( uint64_t q[ PLANES ] ) )
+{
+  for ( size_t i = 0; i < len; i += SUBST_BYTES ) {
+    size_t n = len - i < SUBST_BYTES ? len - i : SUBST_BYTES;
+    byte buf[ SUBST_BYTES ] = { 0 };
+    memcpy( buf, data + i, n );
+
+    uint64_t q[ PLANES ];
+    loadState( q, buf, SLICE_BLOCKS );
+    fn( q );
+    storeState( buf, q, SLICE_BLOCKS );
+    memcpy( data + i, buf, n );
+  }
+}
+
+void bitsliceSubstBytes( byte *data, size_t len )
+{
+  substBytes( data, len, sliceSbox );
+}
+
+void bitsliceInvSubstBytes( byte *data, size_t len )
+{
+  substBytes( data, len, sliceInvSbox );
+}
+
+void bitsliceExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] )
+{
+  // The same schedule as generateSubkeys(), with the sBox lookups in gFunction() done by the circuit.
+  memcpy( ctx->subkey[ 0 ], key, BLOCK_SIZE );
+  for ( int i = 1; i <= ROUNDS; i++ ) {
+    byte const *prev = ctx->subkey[ i - 1 ];
+    byte g[ WORD_SIZE ] = { prev[ INDEX13 ], prev[ INDEX14 ], prev[ INDEX15 ], prev[ INDEX12 ] };
+    bitsliceSubstBytes( g, WORD_SIZE );
+    g[ 0 ] ^= roundConstant[ i ];
+
+    for ( int j = 0; j < BLOCK_SIZE; j++ )
+      ctx->subkey[ i ][ j ] = prev[ j ] ^ ( j < WORD_SIZE ? g[ j ] : ctx->subkey[ i ][ j - WORD_SIZE ] );
+  }
+
+  // Each subkey goes into all four blocks of a state.
+  for ( int i = 0; i <= ROUNDS; i++ ) {
+    byte copies[ SLICE_BLOCKS * BLOCK_SIZE ];
+    for ( int b = 0; b < SLICE_BLOCKS; b++ )
+      memcpy( copies + b * BLOCK_SIZE, ctx->subkey[ i ], BLOCK_SIZE );
+    loadState( ctx->sliceKeys + i * PLANES, copies, SLICE_BLOCKS );
+  }
+
+  // The inverse cipher subkeys aren't used here, but every engine fills them in; unMixColumns is done on bit planes
+  // so it doesn't look anything up either.
+  for ( int i = 0; i <= ROUNDS; i++ ) {
+    uint64_t q[ PLANES ];
+    memcpy( q, ctx->sliceKeys + ( ROUNDS - i ) * PLANES, sizeof( q ) );
+    if ( i != 0 && i != ROUNDS )
+      sliceUnMixColumns( q );
+    storeState( ctx->invSubkey[ i ], q, 1 );
+  }
+}
+
+void bitsliceEncrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  for ( size_t i = 0; i < nblocks; i += SLICE_BLOCKS ) {
+    size_t n = nblocks - i < SLICE_BLOCKS ? nblocks - i : SLICE_BLOCKS;
+    uint64_t q[ PLANES ];
+    loadState( q, in + i * BLOCK_SIZE, n );
+    sliceEncrypt( ctx->sliceKeys, q );
+    storeState( out + i * BLOCK_SIZE, q, n );
+  }
+}
+
+void bitsliceDecrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  for ( size_t i = 0; i < nblocks; i += SLICE_BLOCKS ) {
+    size_t n = nblocks - i < SLICE_BLOCKS ? nblocks - i : SLICE_BLOCKS;
+    uint64_t q[ PLANES ];
+    loadState( q, in + i * BLOCK_SIZE, n );
+    sliceDecrypt( ctx->sliceKeys, q );
+    storeState( out + i * BLOCK_SIZE, q, n );
+  }
+}
+
+/**
+   The bitsliced engine only needs 64-bit integers, so it runs everywhere.
+   @return true.
+*/
+static bool bitsliceSupported( void )
+{
+  return true;
+}
+
+AesEngine const bitsliceEngine = {
+  "bitslice", bitsliceSupported, bitsliceExpandKey, bitsliceEncrypt, bitsliceDecrypt
+};
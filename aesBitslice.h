@@ -0,0 +1,64 @@
+/**
+ * @file aesBitslice.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for aesBitslice.c, the bitsliced constant-time AES engine. It contains all function
+ * declarations.
+*/
+
+/** Macro used for unit testing */
+#ifndef _AES_BITSLICE_H_
+/** Macro used for unit testing */
+#define _AES_BITSLICE_H_
+
+#include "aes.h"
+
+/** Number of blocks the bitsliced engine encrypts or decrypts together. */
+#define SLICE_BLOCKS 4
+
+/** The bitsliced engine, for the dispatch table in aes.c. */
+extern AesEngine const bitsliceEngine;
+
+/**
+ * This function replaces each byte with its substBox value, computed with the bitsliced Boolean circuit instead of
+ * a table lookup, so the time it takes doesn't depend on the values.
+ * @param data the bytes to substitute
+ * @param len the number of bytes
+*/
+void bitsliceSubstBytes( byte *data, size_t len );
+
+/**
+ * This function replaces each byte with its invSubstBox value, computed with the bitsliced Boolean circuit.
+ * @param data the bytes to substitute
+ * @param len the number of bytes
+*/
+void bitsliceInvSubstBytes( byte *data, size_t len );
+
+/**
+ * This function fills in the byte subkeys, the inverse cipher subkeys and the bitsliced subkeys the engine uses.
+ * The key schedule runs its substitutions through the same circuit as the rounds, so it's constant-time too.
+ * @param ctx the context to fill in
+ * @param key the key to expand
+*/
+void bitsliceExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] );
+
+/**
+ * This function encrypts a sequence of 16-byte blocks. SLICE_BLOCKS blocks are transposed into eight 64-bit words,
+ * one for each bit position of every byte, so substBox becomes a circuit of ANDs and XORs on whole words and
+ * shiftRows and mixColumns become shifts and rotations. There are no table lookups or data-dependent branches.
+ * @param ctx the context holding the expanded key
+ * @param in the blocks to encrypt
+ * @param out where the encrypted blocks go, which may be the same as in
+ * @param nblocks the number of blocks
+*/
+void bitsliceEncrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * This function decrypts a sequence of 16-byte blocks, the same way as bitsliceEncrypt() with the inverse steps.
+ * @param ctx the context holding the expanded key
+ * @param in the blocks to decrypt
+ * @param out where the decrypted blocks go, which may be the same as in
+ * @param nblocks the number of blocks
+*/
+void bitsliceDecrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+#endif
@@ -0,0 +1,296 @@
+/**
+ * @file aesTable.c
+ * @author Jimin Yu, jyu34
+ * This file implements the T-table AES engine. Instead of working on a 4x4 square of bytes, it keeps the state as four
+ * 32-bit column words and merges substBox, shiftRows and mixColumns into lookups in tables built from the sBox and
+ * fieldMul(). The byte-wise code in aes.c is kept as the reference this engine is tested against.
+*/
+
+#include "aesTable.h"
+#include "aes.h"
+#include "field.h"
+#include <pthread.h>
+
+/** Number of entries in each lookup table, one for every byte value. */
+#define TABLE_SIZE 256
+
+/** Number of bits to shift to get to the second byte of a column word. */
+#define SHIFT1 8
+
+/** Number of bits to shift to get to the third byte of a column word. */
+#define SHIFT2 16
+
+/** Number of bits to shift to get to the top byte of a column word. */
+#define SHIFT3 24
+
+/** Number of independent blocks encrypted or decrypted together, a round at a time. */
+#define LANES 4
+
+/** Number of bits in a column word. */
+#define WORD_BITS 32
+
+/** Mask for the low byte of a word. */
+#define BYTE_MASK 0xFF
+
+/** Encryption tables. Te0[ v ] is the mixColumns column for sBox( v ) in the top row, Te1..Te3 are its rotations. */
+static uint32_t te[ BLOCK_ROWS ][ TABLE_SIZE ];
+
+/** Decryption tables. Td0[ v ] is the unMixColumns column for invSubstBox( v ) in the top row. */
+static uint32_t td[ BLOCK_ROWS ][ TABLE_SIZE ];
+
+/** Copies of the sBox and inverse sBox for the last round, which has no mixColumns. */
+static byte sbox[ TABLE_SIZE ];
+
+/** Inverse sBox used in the last decryption round. */
+static byte isbox[ TABLE_SIZE ];
+
+/** Makes sure the tables are only built once, even if several threads set up keys at the same time. */
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+/**
+   Pack four bytes into a column word, with the first byte in the most significant position.
+   @param b0 the byte for the top row.
+   @param b1 the byte for the second row.
+   @param b2 the byte for the third row.
+   @param b3 the byte for the bottom row.
+   @return the packed word.
+*/
+static uint32_t packWord( byte b0, byte b1, byte b2, byte b3 )
+{
+  return ( (uint32_t) b0 << SHIFT3 ) | ( (uint32_t) b1 << SHIFT2 ) | ( (uint32_t) b2 << SHIFT1 ) | b3;
+}
+
+/**
+   Rotate a column word right by the given number of bits.
+   @param w the word to rotate.
+   @param n the number of bits, between 1 and 31.
+   @return the rotated word.
+*/
+static uint32_t rotateRight( uint32_t w, int n )
+{
+  return ( w >> n ) | ( w << ( WORD_BITS - n ) );
+}
+
+/**
+   Load four bytes from data as a column word.
+   @param data pointer to the first byte of the column.
+   @return the column word.
+*/
+static uint32_t loadWord( byte const *data )
+{
+  return packWord( data[ 0 ], data[ 1 ], data[ INDEX2 ], data[ INDEX3 ] );
+}
+
+/**
+   Store a column word as four bytes.
+   @param data pointer to where the first byte of the column goes.
+   @param w the column word to store.
+*/
+static void storeWord( byte *data, uint32_t w )
+{
+  data[ 0 ] = w >> SHIFT3;
+  data[ 1 ] = w >> SHIFT2;
+  data[ INDEX2 ] = w >> SHIFT1;
+  data[ INDEX3 ] = w;
+}
+
+/**
+   Build the lookup tables from the sBox, the inverse sBox and fieldMul().
+*/
+static void buildTables( void )
+{
+  for ( int v = 0; v < TABLE_SIZE; v++ ) {
+    byte s = substBox( v );
+    byte is = invSubstBox( v );
+    sbox[ v ] = s;
+    isbox[ v ] = is;
+
+    // First column of the mixColumns matrix is 02, 01, 01, 03.
+    te[ 0 ][ v ] = packWord( fieldMul( 0x02, s ), s, s, fieldMul( 0x03, s ) );
+
+    // First column of the unMixColumns matrix is 0E, 09, 0D, 0B.
+    td[ 0 ][ v ] = packWord( fieldMul( 0x0E, is ), fieldMul( 0x09, is ), fieldMul( 0x0D, is ), fieldMul( 0x0B, is ) );
+
+    for ( int r = 1; r < BLOCK_ROWS; r++ ) {
+      te[ r ][ v ] = rotateRight( te[ 0 ][ v ], r * BBITS );
+      td[ r ][ v ] = rotateRight( td[ 0 ][ v ], r * BBITS );
+    }
+  }
+}
+
+void tableExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] )
+{
+  pthread_once( &tablesOnce, buildTables );
+
+  generateSubkeys( ctx->subkey, key );
+  generateInvSubkeys( ctx->invSubkey, ctx->subkey );
+  for ( int i = 0; i <= ROUNDS; i++ ) {
+    for ( int c = 0; c < BLOCK_COLS; c++ ) {
+      ctx->encWords[ i * BLOCK_COLS + c ] = loadWord( ctx->subkey[ i ] + c * WORD_SIZE );
+      ctx->decWords[ i * BLOCK_COLS + c ] = loadWord( ctx->invSubkey[ i ] + c * WORD_SIZE );
+    }
+  }
+}
+
+/**
+   Do one middle encryption round on a state, with substBox, shiftRows and mixColumns done as table lookups.
+   @param s the four column words of the state, replaced with the result.
+   @param rk the four words of the subkey for this round.
+*/
+static inline void encryptRound( uint32_t s[ BLOCK_COLS ], uint32_t const *rk )
+{
+  uint32_t t0 = te[ 0 ][ s[ 0 ] >> SHIFT3 ] ^ te[ 1 ][ ( s[ 1 ] >> SHIFT2 ) & BYTE_MASK ] ^
+    te[ INDEX2 ][ ( s[ INDEX2 ] >> SHIFT1 ) & BYTE_MASK ] ^ te[ INDEX3 ][ s[ INDEX3 ] & BYTE_MASK ] ^ rk[ 0 ];
+  uint32_t t1 = te[ 0 ][ s[ 1 ] >> SHIFT3 ] ^ te[ 1 ][ ( s[ INDEX2 ] >> SHIFT2 ) & BYTE_MASK ] ^
+    te[ INDEX2 ][ ( s[ INDEX3 ] >> SHIFT1 ) & BYTE_MASK ] ^ te[ INDEX3 ][ s[ 0 ] & BYTE_MASK ] ^ rk[ 1 ];
+  uint32_t t2 = te[ 0 ][ s[ INDEX2 ] >> SHIFT3 ] ^ te[ 1 ][ ( s[ INDEX3 ] >> SHIFT2 ) & BYTE_MASK ] ^
+    te[ INDEX2 ][ ( s[ 0 ] >> SHIFT1 ) & BYTE_MASK ] ^ te[ INDEX3 ][ s[ 1 ] & BYTE_MASK ] ^ rk[ INDEX2 ];
+  uint32_t t3 = te[ 0 ][ s[ INDEX3 ] >> SHIFT3 ] ^ te[ 1 ][ ( s[ 0 ] >> SHIFT2 ) & BYTE_MASK ] ^
+    te[ INDEX2 ][ ( s[ 1 ] >> SHIFT1 ) & BYTE_MASK ] ^ te[ INDEX3 ][ s[ INDEX2 ] & BYTE_MASK ] ^ rk[ INDEX3 ];
+  s[ 0 ] = t0;
+  s[ 1 ] = t1;
+  s[ INDEX2 ] = t2;
+  s[ INDEX3 ] = t3;
+}
+
+/**
+   Do the last encryption round on a state, substBox and shiftRows only, and store the result.
+   @param out where the 16 encrypted bytes go.
+   @param s the four column words of the state.
+   @param rk the four words of the last subkey.
+*/
+static inline void encryptLast( byte *out, uint32_t const s[ BLOCK_COLS ], uint32_t const *rk )
+{
+  for ( int c = 0; c < BLOCK_COLS; c++ ) {
+    storeWord( out + c * WORD_SIZE,
+               packWord( sbox[ s[ c ] >> SHIFT3 ],
+                         sbox[ ( s[ ( c + 1 ) % BLOCK_COLS ] >> SHIFT2 ) & BYTE_MASK ],
+                         sbox[ ( s[ ( c + INDEX2 ) % BLOCK_COLS ] >> SHIFT1 ) & BYTE_MASK ],
+                         sbox[ s[ ( c + INDEX3 ) % BLOCK_COLS ] & BYTE_MASK ] ) ^ rk[ c ] );
+  }
+}
+
+/**
+   Do one middle decryption round on a state, with invSubstBox, unShiftRows and unMixColumns done as table lookups.
+   @param s the four column words of the state, replaced with the result.
+   @param rk the four words of the inverse cipher subkey for this round.
+*/
+static inline void decryptRound( uint32_t s[ BLOCK_COLS ], uint32_t const *rk )
+{
+  uint32_t t0 = td[ 0 ][ s[ 0 ] >> SHIFT3 ] ^ td[ 1 ][ ( s[ INDEX3 ] >> SHIFT2 ) & BYTE_MASK ] ^
+    td[ INDEX2 ][ ( s[ INDEX2 ] >> SHIFT1 ) & BYTE_MASK ] ^ td[ INDEX3 ][ s[ 1 ] & BYTE_MASK ] ^ rk[ 0 ];
+  uint32_t t1 = td[ 0 ][ s[ 1 ] >> SHIFT3 ] ^ td[ 1 ][ ( s[ 0 ] >> SHIFT2 ) & BYTE_MASK ] ^
+    td[ INDEX2 ][ ( s[ INDEX3 ] >> SHIFT1 ) & BYTE_MASK ] ^ td[ INDEX3 ][ s[ INDEX2 ] & BYTE_MASK ] ^ rk[ 1 ];
+  uint32_t t2 = td[ 0 ][ s[ INDEX2 ] >> SHIFT3 ] ^ td[ 1 ][ ( s[ 1 ] >> SHIFT2 ) & BYTE_MASK ] ^
+    td[ INDEX2 ][ ( s[ 0 ] >> SHIFT1 ) & BYTE_MASK ] ^ td[ INDEX3 ][ s[ INDEX3 ] & BYTE_MASK ] ^ rk[ INDEX2 ];
+  uint32_t t3 = td[ 0 ][ s[ INDEX3 ] >> SHIFT3 ] ^ td[ 1 ][ ( s[ INDEX2 ] >> SHIFT2 ) & BYTE_MASK ] ^
+    td[ INDEX2 ][ ( s[ 1 ] >> SHIFT1 ) & BYTE_MASK ] ^ td[ INDEX3 ][ s[ 0 ] & BYTE_MASK ] ^ rk[ INDEX3 ];
+  s[ 0 ] = t0;
+  s[ 1 ] = t1;
+  s[ INDEX2 ] = t2;
+  s[ INDEX3 ] = t3;
+}
+
+/**
+   Do the last decryption round on a state, invSubstBox and unShiftRows only, and store the result.
+   @param out where the 16 decrypted bytes go.
+   @param s the four column words of the state.
+   @param rk the four words of the last inverse cipher subkey.
+*/
+static inline void decryptLast( byte *out, uint32_t const s[ BLOCK_COLS ], uint32_t const *rk )
+{
+  for ( int c = 0; c < BLOCK_COLS; c++ ) {
+    storeWord( out + c * WORD_SIZE,
+               packWord( isbox[ s[ c ] >> SHIFT3 ],
+                         isbox[ ( s[ ( c + INDEX3 ) % BLOCK_COLS ] >> SHIFT2 ) & BYTE_MASK ],
+                         isbox[ ( s[ ( c + INDEX2 ) % BLOCK_COLS ] >> SHIFT1 ) & BYTE_MASK ],
+                         isbox[ s[ ( c + 1 ) % BLOCK_COLS ] & BYTE_MASK ] ) ^ rk[ c ] );
+  }
+}
+
+/**
+   Encrypt up to LANES blocks together, a round at a time, so the lookups for independent blocks can overlap.
+   @param rk the encryption subkey words.
+   @param in the blocks to encrypt.
+   @param out where the encrypted blocks go, which may be the same as in.
+   @param lanes how many blocks to encrypt, between 1 and LANES.
+*/
+static inline void encryptLanes( uint32_t const *rk, byte const *in, byte *out, int lanes )
+{
+  uint32_t s[ LANES ][ BLOCK_COLS ];
+  for ( int b = 0; b < lanes; b++ ) {
+    for ( int c = 0; c < BLOCK_COLS; c++ ) {
+      s[ b ][ c ] = loadWord( in + b * BLOCK_SIZE + c * WORD_SIZE ) ^ rk[ c ];
+    }
+  }
+
+  for ( int i = 1; i < ROUNDS; i++ ) {
+    for ( int b = 0; b < lanes; b++ ) {
+      encryptRound( s[ b ], rk + i * BLOCK_COLS );
+    }
+  }
+
+  for ( int b = 0; b < lanes; b++ ) {
+    encryptLast( out + b * BLOCK_SIZE, s[ b ], rk + ROUNDS * BLOCK_COLS );
+  }
+}
+
+/**
+   Decrypt up to LANES blocks together, a round at a time.
+   @param rk the inverse cipher subkey words.
+   @param in the blocks to decrypt.
+   @param out where the decrypted blocks go, which may be the same as in.
+   @param lanes how many blocks to decrypt, between 1 and LANES.
+*/
+static inline void decryptLanes( uint32_t const *rk, byte const *in, byte *out, int lanes )
+{
+  uint32_t s[ LANES ][ BLOCK_COLS ];
+  for ( int b = 0; b < lanes; b++ ) {
+    for ( int c = 0; c < BLOCK_COLS; c++ ) {
+      s[ b ][ c ] = loadWord( in + b * BLOCK_SIZE + c * WORD_SIZE ) ^ rk[ c ];
+    }
+  }
+
+  for ( int i = 1; i < ROUNDS; i++ ) {
+    for ( int b = 0; b < lanes; b++ ) {
+      decryptRound( s[ b ], rk + i * BLOCK_COLS );
+    }
+  }
+
+  for ( int b = 0; b < lanes; b++ ) {
+    decryptLast( out + b * BLOCK_SIZE, s[ b ], rk + ROUNDS * BLOCK_COLS );
+  }
+}
+
+void tableEncrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  size_t i = 0;
+  for ( ; i + LANES <= nblocks; i += LANES ) {
+    encryptLanes( ctx->encWords, in + i * BLOCK_SIZE, out + i * BLOCK_SIZE, LANES );
+  }
+  if ( i < nblocks ) {
+    encryptLanes( ctx->encWords, in + i * BLOCK_SIZE, out + i * BLOCK_SIZE, nblocks - i );
+  }
+}
+
+void tableDecrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  size_t i = 0;
+  for ( ; i + LANES <= nblocks; i += LANES ) {
+    decryptLanes( ctx->decWords, in + i * BLOCK_SIZE, out + i * BLOCK_SIZE, LANES );
+  }
+  if ( i < nblocks ) {
+    decryptLanes( ctx->decWords, in + i * BLOCK_SIZE, out + i * BLOCK_SIZE, nblocks - i );
+  }
+}
+
+/**
+   The T-table engine only needs plain C, so it runs everywhere.
+   @return true.
+*/
+static bool tableSupported( void )
+{
+  return true;
+}
+
+AesEngine const tableEngine = { "table", tableSupported, tableExpandKey, tableEncrypt, tableDecrypt };
@@ -0,0 +1,44 @@
+/**
+ * @file aesTable.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for aesTable.c, the T-table AES engine. It contains all function declarations.
+*/
+
+/** Macro used for unit testing */
+#ifndef _AES_TABLE_H_
+/** Macro used for unit testing */
+#define _AES_TABLE_H_
+
+#include "aes.h"
+
+/** The T-table engine, for the dispatch table in aes.c. */
+extern AesEngine const tableEngine;
+
+/**
+ * This function fills in the byte subkeys and the 32-bit encryption and decryption subkeys the T-table engine uses.
+ * @param ctx the context to fill in
+ * @param key the key to expand
+*/
+void tableExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] );
+
+/**
+ * This function encrypts a sequence of 16-byte blocks. It keeps the state as four 32-bit columns and does substBox,
+ * shiftRows and mixColumns for a round with 16 lookups in the Te0..Te3 tables. Four blocks at a time go through each
+ * round together, so their lookups can overlap.
+ * @param ctx the context holding the expanded key
+ * @param in the blocks to encrypt
+ * @param out where the encrypted blocks go, which may be the same as in
+ * @param nblocks the number of blocks
+*/
+void tableEncrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * This function decrypts a sequence of 16-byte blocks, using lookups in the Td0..Td3 tables for each round.
+ * @param ctx the context holding the expanded key
+ * @param in the blocks to decrypt
+ * @param out where the decrypted blocks go, which may be the same as in
+ * @param nblocks the number of blocks
+*/
+void tableDecrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+#endif
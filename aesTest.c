@@ -9,9 +9,10 @@
 #include <string.h>
 
 #include "aes.h"
+#include "aesBitslice.h"
 
 /** Number of tests we should have, if they're all turned on. */
-#define EXPECTED_TOTAL 38
+#define EXPECTED_TOTAL 48
 
 /** Total number or tests we tried. */
 static int totalTests = 0;
@@ -321,6 +322,170 @@ int main()
     TestCase( memcmp( data, expected, BLOCK_SIZE ) == 0 );
   }
 
+  ////////////////////////////////////////////////////////////////////////
+  // Test aesInitCtx(), aesEncryptWithCtx() and aesDecryptWithCtx()
+
+  {
+    // FIPS-197 example key.
+    byte key[ BLOCK_SIZE ] = {
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+      0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+
+    AesContext ctx;
+    aesInitCtx( &ctx, key );
+
+    // The context should hold the same subkeys generateSubkeys() computes.
+    byte subkey[ ROUNDS + 1 ][ BLOCK_SIZE ];
+    generateSubkeys( subkey, key );
+    TestCase( memcmp( ctx.subkey, subkey, sizeof( subkey ) ) == 0 );
+
+    // FIPS-197 example plaintext, encrypted twice with the same context.
+    byte plain[ BLOCK_SIZE ] = {
+      0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+      0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+    byte expected[ BLOCK_SIZE ] = {
+      0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30,
+      0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A };
+
+    byte first[ BLOCK_SIZE ];
+    byte second[ BLOCK_SIZE ];
+    memcpy( first, plain, BLOCK_SIZE );
+    memcpy( second, plain, BLOCK_SIZE );
+    aesEncryptWithCtx( &ctx, first );
+    aesEncryptWithCtx( &ctx, second );
+    TestCase( memcmp( first, expected, BLOCK_SIZE ) == 0 &&
+              memcmp( second, expected, BLOCK_SIZE ) == 0 );
+
+    // Decrypting with the same context should give back the plaintext.
+    aesDecryptWithCtx( &ctx, first );
+    TestCase( memcmp( first, plain, BLOCK_SIZE ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test the bitsliced sBox circuits against the tables for every byte value.
+
+  {
+    byte forward[ 256 ];
+    byte inverse[ 256 ];
+    for ( int i = 0; i < 256; i++ )
+      forward[ i ] = inverse[ i ] = i;
+    bitsliceSubstBytes( forward, sizeof( forward ) );
+    bitsliceInvSubstBytes( inverse, sizeof( inverse ) );
+
+    int forwardMatches = 1;
+    int inverseMatches = 1;
+    for ( int i = 0; i < 256; i++ ) {
+      if ( forward[ i ] != substBox( i ) )
+        forwardMatches = 0;
+      if ( inverse[ i ] != invSubstBox( i ) )
+        inverseMatches = 0;
+    }
+    TestCase( forwardMatches );
+    TestCase( inverseMatches );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test every engine this host supports against the byte-wise reference rounds.
+
+  {
+    // Pseudo-random keys and blocks, so the same ones are used every run.
+    srand( 1 );
+    int keysMatch = 1;
+    int encryptMatches = 1;
+    int decryptMatches = 1;
+    AesEngine const *const *engines = aesEngineList();
+    for ( int e = 0; engines[ e ]; e++ ) {
+      if ( !engines[ e ]->supported() )
+        continue;
+
+      for ( int k = 0; k < 16; k++ ) {
+        byte key[ BLOCK_SIZE ];
+        for ( int i = 0; i < BLOCK_SIZE; i++ )
+          key[ i ] = rand();
+
+        AesContext ctx;
+        aesInitCtxEngine( &ctx, key, engines[ e ] );
+
+        // Every engine should produce the same byte subkeys.
+        byte subkey[ ROUNDS + 1 ][ BLOCK_SIZE ];
+        byte invSubkey[ ROUNDS + 1 ][ BLOCK_SIZE ];
+        generateSubkeys( subkey, key );
+        generateInvSubkeys( invSubkey, subkey );
+        if ( memcmp( ctx.subkey, subkey, sizeof( subkey ) ) != 0 ||
+             memcmp( ctx.invSubkey, invSubkey, sizeof( invSubkey ) ) != 0 )
+          keysMatch = 0;
+
+        for ( int b = 0; b < 64; b++ ) {
+          byte fast[ BLOCK_SIZE ];
+          byte slow[ BLOCK_SIZE ];
+          for ( int i = 0; i < BLOCK_SIZE; i++ )
+            fast[ i ] = slow[ i ] = rand();
+
+          aesEncryptWithCtx( &ctx, fast );
+          aesEncryptReference( &ctx, slow );
+          if ( memcmp( fast, slow, BLOCK_SIZE ) != 0 )
+            encryptMatches = 0;
+
+          aesDecryptWithCtx( &ctx, fast );
+          aesDecryptReference( &ctx, slow );
+          if ( memcmp( fast, slow, BLOCK_SIZE ) != 0 )
+            decryptMatches = 0;
+        }
+      }
+    }
+    TestCase( keysMatch );
+    TestCase( encryptMatches );
+    TestCase( decryptMatches );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test encryptBlocks() and decryptBlocks() for every engine, with a
+  // block count that isn't a multiple of how many blocks engines keep in
+  // flight.
+
+  {
+    // Random key, and 37 blocks of pseudo-random data.
+    byte key[ BLOCK_SIZE ] = {
+      0x34, 0x27, 0x15, 0xA1, 0xDB, 0xF3, 0x3C, 0x72,
+      0x09, 0xBA, 0x87, 0x7D, 0xC2, 0x1F, 0x73, 0x1A };
+    byte plain[ 37 * BLOCK_SIZE ];
+    srand( 2 );
+    for ( int i = 0; i < sizeof( plain ); i++ )
+      plain[ i ] = rand();
+
+    // Expected results, one block at a time through the reference rounds.
+    AesContext ref;
+    aesInitCtxEngine( &ref, key, aesFindEngine( "reference" ) );
+    byte expected[ sizeof( plain ) ];
+    memcpy( expected, plain, sizeof( plain ) );
+    for ( int i = 0; i < sizeof( plain ); i += BLOCK_SIZE )
+      aesEncryptReference( &ref, expected + i );
+
+    int encryptMatches = 1;
+    int decryptMatches = 1;
+    AesEngine const *const *engines = aesEngineList();
+    for ( int e = 0; engines[ e ]; e++ ) {
+      if ( !engines[ e ]->supported() )
+        continue;
+
+      AesContext ctx;
+      aesInitCtxEngine( &ctx, key, engines[ e ] );
+
+      // Out of place.
+      byte out[ sizeof( plain ) ];
+      encryptBlocks( &ctx, plain, out, sizeof( plain ) / BLOCK_SIZE );
+      if ( memcmp( out, expected, sizeof( plain ) ) != 0 )
+        encryptMatches = 0;
+
+      // In place.
+      decryptBlocks( &ctx, out, out, sizeof( plain ) / BLOCK_SIZE );
+      if ( memcmp( out, plain, sizeof( plain ) ) != 0 )
+        decryptMatches = 0;
+    }
+    TestCase( encryptMatches );
+    TestCase( decryptMatches );
+  }
+
   // Once you move the #ifdef DISABLE_TESTS to here, you've enabled
   // all the tests.
 
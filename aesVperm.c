@@ -0,0 +1,376 @@
+/**
+ * @file aesVperm.c
+ * @author Jimin Yu, jyu34
+ * This file implements the vector permute AES engine, after Hamburg's technique. A whole block sits in one SSE
+ * register. substBox is done by viewing each byte as an element i t + k of GF(16)[t] / ( t^2 + a t + a ), where the
+ * inverse only needs reciprocals in GF(16) of single nibbles and XORs; every nibble function is a 16-entry table
+ * looked up for all 16 bytes at once with PSHUFB. The tables live in registers and are never indexed from memory with
+ * secret data, so, like the bitsliced engine, this one is constant-time, but it does one block at a time with low
+ * latency instead of needing a batch.
+*/
+
+#include "aesVperm.h"
+#include "aes.h"
+#include "aesBitslice.h"
+#include "cpu.h"
+#include "field.h"
+#include <pthread.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+
+/** Instruction set extensions the functions in this file are compiled for. */
+#define VPERM_TARGET __attribute__(( target( "ssse3" ) ))
+
+/** Number of values in a nibble, and entries in each shuffle table. */
+#define NIBBLE_VALUES 16
+
+/** Number of bits in a nibble. */
+#define NIBBLE_BITS 4
+
+/** Mask for the low nibble of a byte. */
+#define NIBBLE_MASK 0x0F
+
+/** Table entry standing for the reciprocal of zero. PSHUFB gives zero for any index with the top bit set, so it
+    behaves like infinity: whatever it's added to stays infinite, and its reciprocal is zero. */
+#define INFINITE 0x80
+
+/** Generator of the field's multiplicative group. */
+#define GENERATOR 0x03
+
+/** Power of GENERATOR that generates the multiplicative group of the GF(16) subfield, ( 256 - 1 ) / ( 16 - 1 ). */
+#define SUBFIELD_POWER 17
+
+/** Constant added by substBox after the affine map. */
+#define SBOX_CONSTANT 0x63
+
+/** The inverse affine map's constant, the linear part of its inverse applied to SBOX_CONSTANT. */
+#define INV_SBOX_CONSTANT 0x05
+
+/** Shuffle tables for substBox and invSubstBox. */
+typedef struct {
+  /** Maps the low and high nibbles of a byte to the tower field coordinates i and k, summed. */
+  byte inLo[ NIBBLE_VALUES ], inHi[ NIBBLE_VALUES ];
+
+  /** Maps the two nibbles the inversion ends with back to the result byte, summed. */
+  byte outI[ NIBBLE_VALUES ], outJ[ NIBBLE_VALUES ];
+} SboxTables;
+
+/** Tables for substBox: into the tower field, and back out through the affine map. */
+static SboxTables forward;
+
+/** Tables for invSubstBox: through the inverse affine map into the tower field, and back out. */
+static SboxTables inverse;
+
+/** Reciprocals in GF(16), with INFINITE for zero. */
+static byte recip[ NIBBLE_VALUES ];
+
+/** a / k in GF(16) for each k, with INFINITE for zero. */
+static byte aOver[ NIBBLE_VALUES ];
+
+/** Makes sure the tables are only built once. */
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+/**
+   Rotate a byte left.
+   @param v the byte.
+   @param n the number of bits, between 1 and 7.
+   @return the rotated byte.
+*/
+static byte rotateByte( byte v, int n )
+{
+  return ( v << n ) | ( v >> ( BBITS - n ) );
+}
+
+/**
+   Apply the linear part of the sBox's affine map.
+   @param v the byte.
+   @return the mapped byte.
+*/
+static byte affine( byte v )
+{
+  return v ^ rotateByte( v, 1 ) ^ rotateByte( v, INDEX2 ) ^ rotateByte( v, INDEX3 ) ^ rotateByte( v, INDEX4 );
+}
+
+/**
+   Apply the inverse of the linear part of the sBox's affine map.
+   @param v the byte.
+   @return the mapped byte.
+*/
+static byte invAffine( byte v )
+{
+  return rotateByte( v, 1 ) ^ rotateByte( v, INDEX3 ) ^ rotateByte( v, INDEX6 );
+}
+
+/**
+   Build the shuffle tables. Nibbles stand for elements of the GF(16) subfield of the AES field, through the basis
+   1, w, w^2, w^3 with w a generator of the subfield. a is the first of those that makes t^2 + a t + a irreducible,
+   and t is one of its roots in the AES field. Every byte x is then i t + k for nibbles i and k, and with N the norm
+   a i^2 + a i k + k^2 and j = i + k, the inversion computes io = j + 1 / ( 1 / i + a / k ) = N / ( k + a i ) and
+   jo = i + 1 / ( 1 / j + a / k ) = N / ( k + a i + a k ). 1 / x = ( i t + k + a i ) / N, which is linear in 1 / io and
+   1 / jo, so the output tables take the reciprocals and that linear map together.
+*/
+static void buildTables( void )
+{
+  byte w = 1;
+  for ( int e = 0; e < SUBFIELD_POWER; e++ )
+    w = fieldMul( w, GENERATOR );
+
+  // The subfield element for each nibble, and the nibble for each subfield element.
+  byte element[ NIBBLE_VALUES ];
+  byte nibble[ FIELD_SIZE ];
+  for ( int n = 0; n < NIBBLE_VALUES; n++ ) {
+    element[ n ] = 0;
+    byte power = 1;
+    for ( int b = 0; b < NIBBLE_BITS; b++ ) {
+      if ( n & ( 1 << b ) )
+        element[ n ] ^= power;
+      power = fieldMul( power, w );
+    }
+    nibble[ element[ n ] ] = n;
+  }
+
+  // Find a, and a root t.
+  byte a = 0;
+  for ( int n = 1; !a && n < NIBBLE_VALUES; n++ ) {
+    bool root = false;
+    for ( int s = 0; s < NIBBLE_VALUES; s++ )
+      root |= ( fieldMul( element[ s ], element[ s ] ) ^ fieldMul( element[ n ], element[ s ] ) ^ element[ n ] ) == 0;
+    if ( !root )
+      a = element[ n ];
+  }
+  byte t = 0;
+  while ( ( fieldMul( t, t ) ^ fieldMul( a, t ) ^ a ) != 0 )
+    t++;
+
+  // Tower coordinates of every byte.
+  byte tower[ FIELD_SIZE ];
+  for ( int i = 0; i < NIBBLE_VALUES; i++ ) {
+    for ( int k = 0; k < NIBBLE_VALUES; k++ )
+      tower[ fieldMul( element[ i ], t ) ^ element[ k ] ] = ( i << NIBBLE_BITS ) | k;
+  }
+
+  byte ia = fieldInv( a );
+  recip[ 0 ] = aOver[ 0 ] = INFINITE;
+  forward.outI[ 0 ] = forward.outJ[ 0 ] = inverse.outI[ 0 ] = inverse.outJ[ 0 ] = 0;
+  for ( int n = 0; n < NIBBLE_VALUES; n++ ) {
+    forward.inLo[ n ] = tower[ n ];
+    forward.inHi[ n ] = tower[ n << NIBBLE_BITS ];
+    inverse.inLo[ n ] = tower[ invAffine( n ) ^ INV_SBOX_CONSTANT ];
+    inverse.inHi[ n ] = tower[ invAffine( n << NIBBLE_BITS ) ];
+    if ( n == 0 )
+      continue;
+
+    byte r = fieldInv( element[ n ] );
+    recip[ n ] = nibble[ r ];
+    aOver[ n ] = nibble[ fieldMul( a, r ) ];
+
+    // What 1 / x gets from 1 / io = r with 1 / jo = 0, and from 1 / jo = r with 1 / io = 0.
+    byte fromI = fieldMul( fieldMul( r ^ fieldMul( r, ia ), ia ), t ) ^ r;
+    byte fromJ = fieldMul( fieldMul( r, fieldMul( ia, ia ) ), t );
+    inverse.outI[ n ] = fromI;
+    inverse.outJ[ n ] = fromJ;
+    forward.outI[ n ] = affine( fromI );
+    forward.outJ[ n ] = affine( fromJ );
+  }
+}
+
+/**
+   Load a 16-byte table into a register.
+   @param table the table.
+   @return the register.
+*/
+VPERM_TARGET static inline __m128i loadTable( byte const table[ NIBBLE_VALUES ] )
+{
+  return _mm_loadu_si128( (__m128i const *) table );
+}
+
+/** Shuffle tables for one direction, held in registers. */
+typedef struct {
+  /** Into the tower field. */
+  __m128i inLo, inHi;
+
+  /** Reciprocals, and a divided by each value. */
+  __m128i recip, aOver;
+
+  /** Back out of the tower field. */
+  __m128i outI, outJ;
+
+  /** A nibble mask in every byte. */
+  __m128i mask;
+} Shuffles;
+
+/**
+   Load the tables for substBox or invSubstBox into registers.
+   @param sh the registers to fill in.
+   @param tables the tables for the direction.
+*/
+VPERM_TARGET static inline void loadShuffles( Shuffles *sh, SboxTables const *tables )
+{
+  sh->inLo = loadTable( tables->inLo );
+  sh->inHi = loadTable( tables->inHi );
+  sh->recip = loadTable( recip );
+  sh->aOver = loadTable( aOver );
+  sh->outI = loadTable( tables->outI );
+  sh->outJ = loadTable( tables->outJ );
+  sh->mask = _mm_set1_epi8( NIBBLE_MASK );
+}
+
+/**
+   Substitute all 16 bytes of a block, with the nibble lookups in the tower field described with buildTables().
+   @param sh the tables for the direction.
+   @param x the block.
+   @return the block with every byte substituted, apart from the constant of the affine map.
+*/
+VPERM_TARGET static inline __m128i substitute( Shuffles const *sh, __m128i x )
+{
+  __m128i b = _mm_xor_si128( _mm_shuffle_epi8( sh->inLo, _mm_and_si128( x, sh->mask ) ),
+                             _mm_shuffle_epi8( sh->inHi, _mm_and_si128( _mm_srli_epi32( x, NIBBLE_BITS ), sh->mask ) ) );
+  __m128i i = _mm_and_si128( _mm_srli_epi32( b, NIBBLE_BITS ), sh->mask );
+  __m128i k = _mm_and_si128( b, sh->mask );
+  __m128i j = _mm_xor_si128( i, k );
+
+  __m128i ak = _mm_shuffle_epi8( sh->aOver, k );
+  __m128i iak = _mm_xor_si128( _mm_shuffle_epi8( sh->recip, i ), ak );
+  __m128i jak = _mm_xor_si128( _mm_shuffle_epi8( sh->recip, j ), ak );
+  __m128i io = _mm_xor_si128( _mm_shuffle_epi8( sh->recip, iak ), j );
+  __m128i jo = _mm_xor_si128( _mm_shuffle_epi8( sh->recip, jak ), i );
+  return _mm_xor_si128( _mm_shuffle_epi8( sh->outI, io ), _mm_shuffle_epi8( sh->outJ, jo ) );
+}
+
+/**
+   Multiply every byte by 02 in the field.
+   @param x the bytes.
+   @return the products.
+*/
+VPERM_TARGET static inline __m128i xtime( __m128i x )
+{
+  __m128i high = _mm_cmpgt_epi8( _mm_setzero_si128(), x );
+  return _mm_xor_si128( _mm_add_epi8( x, x ), _mm_and_si128( high, _mm_set1_epi8( REDUCER ) ) );
+}
+
+/**
+   Do mixColumns on a block. With t = a_r + a_r+1 for every row, each output byte is 02 t + a_r+1 + t two rows along.
+   @param x the block.
+   @return the mixed block.
+*/
+VPERM_TARGET static inline __m128i mixColumns128( __m128i x )
+{
+  __m128i rot1 = _mm_setr_epi8( 1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12 );
+  __m128i rot2 = _mm_setr_epi8( 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13 );
+  __m128i r1 = _mm_shuffle_epi8( x, rot1 );
+  __m128i t = _mm_xor_si128( x, r1 );
+  return _mm_xor_si128( _mm_xor_si128( xtime( t ), r1 ), _mm_shuffle_epi8( t, rot2 ) );
+}
+
+/**
+   Do unMixColumns on a block: the unMixColumns matrix is the mixColumns matrix times the one with 05 on the diagonal
+   and 04 two rows along.
+   @param x the block.
+   @return the unmixed block.
+*/
+VPERM_TARGET static inline __m128i unMixColumns128( __m128i x )
+{
+  __m128i rot2 = _mm_setr_epi8( 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13 );
+  __m128i u = xtime( xtime( _mm_xor_si128( x, _mm_shuffle_epi8( x, rot2 ) ) ) );
+  return mixColumns128( _mm_xor_si128( x, u ) );
+}
+
+/**
+   Expand the key. The subkeys are the same as for the bitsliced engine, whose key schedule is also constant-time.
+   @param ctx the context to fill in.
+   @param key the key to expand.
+*/
+static void vpermExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] )
+{
+  pthread_once( &tablesOnce, buildTables );
+  bitsliceExpandKey( ctx, key );
+}
+
+/**
+   Encrypt a sequence of blocks, one block per register.
+   @param ctx the context holding the expanded key.
+   @param in the blocks to encrypt.
+   @param out where the encrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+VPERM_TARGET static void vpermEncrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  Shuffles sh;
+  loadShuffles( &sh, &forward );
+  __m128i shift = _mm_setr_epi8( 0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 1, 6, 11 );
+  __m128i constant = _mm_set1_epi8( SBOX_CONSTANT );
+  __m128i rk[ ROUNDS + 1 ];
+  for ( int i = 0; i <= ROUNDS; i++ )
+    rk[ i ] = _mm_loadu_si128( (__m128i const *) ctx->subkey[ i ] );
+
+  for ( size_t n = 0; n < nblocks; n++ ) {
+    __m128i s = _mm_xor_si128( _mm_loadu_si128( (__m128i const *) ( in + n * BLOCK_SIZE ) ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ ) {
+      s = _mm_shuffle_epi8( _mm_xor_si128( substitute( &sh, s ), constant ), shift );
+      s = _mm_xor_si128( mixColumns128( s ), rk[ i ] );
+    }
+    s = _mm_shuffle_epi8( _mm_xor_si128( substitute( &sh, s ), constant ), shift );
+    _mm_storeu_si128( (__m128i *) ( out + n * BLOCK_SIZE ), _mm_xor_si128( s, rk[ ROUNDS ] ) );
+  }
+}
+
+/**
+   Decrypt a sequence of blocks with the equivalent inverse cipher, one block per register.
+   @param ctx the context holding the expanded key.
+   @param in the blocks to decrypt.
+   @param out where the decrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+VPERM_TARGET static void vpermDecrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  Shuffles sh;
+  loadShuffles( &sh, &inverse );
+  __m128i unshift = _mm_setr_epi8( 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3 );
+  __m128i rk[ ROUNDS + 1 ];
+  for ( int i = 0; i <= ROUNDS; i++ )
+    rk[ i ] = _mm_loadu_si128( (__m128i const *) ctx->invSubkey[ i ] );
+
+  for ( size_t n = 0; n < nblocks; n++ ) {
+    __m128i s = _mm_xor_si128( _mm_loadu_si128( (__m128i const *) ( in + n * BLOCK_SIZE ) ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ ) {
+      s = _mm_shuffle_epi8( substitute( &sh, s ), unshift );
+      s = _mm_xor_si128( unMixColumns128( s ), rk[ i ] );
+    }
+    s = _mm_shuffle_epi8( substitute( &sh, s ), unshift );
+    _mm_storeu_si128( (__m128i *) ( out + n * BLOCK_SIZE ), _mm_xor_si128( s, rk[ ROUNDS ] ) );
+  }
+}
+
+/**
+   The engine needs PSHUFB, from SSSE3.
+   @return true if this host has it.
+*/
+static bool vpermSupported( void )
+{
+  return cpuHas( CPU_SSSE3 );
+}
+
+#else
+
+/**
+   There's no PSHUFB off x86.
+   @return false.
+*/
+static bool vpermSupported( void )
+{
+  return false;
+}
+
+/** Never called, since the engine is never supported here. */
+#define vpermExpandKey NULL
+
+/** Never called, since the engine is never supported here. */
+#define vpermEncrypt NULL
+
+/** Never called, since the engine is never supported here. */
+#define vpermDecrypt NULL
+
+#endif
+
+AesEngine const vpermEngine = { "vperm", vpermSupported, vpermExpandKey, vpermEncrypt, vpermDecrypt };
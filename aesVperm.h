@@ -0,0 +1,17 @@
+/**
+ * @file aesVperm.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for aesVperm.c, the constant-time engine that does substBox with PSHUFB byte shuffles.
+*/
+
+/** Macro used for unit testing */
+#ifndef _AES_VPERM_H_
+/** Macro used for unit testing */
+#define _AES_VPERM_H_
+
+#include "aes.h"
+
+/** The vector permute engine, for the dispatch table in aes.c. It's only supported on x86 processors with SSSE3. */
+extern AesEngine const vpermEngine;
+
+#endif
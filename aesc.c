@@ -0,0 +1,26 @@
+/**
+ * @file aesc.c
+ * @author Jimin Yu, jyu34
+ * This file contains the program execution for aesc, which encrypts or decrypts a file by asking aesd to do it.
+*/
+
+#include "client.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+/**
+ * This is the main method for aesc. It carries program execution.
+ * @param argc the number of command line arguments given
+ * @param argv an array of all the command line arguments
+ * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    ClientOptions opts;
+    if ( !parseClientOptions( &opts, argc, argv ) ) {
+        fprintf( stderr, "usage: aesc [--socket <path>] [--mode M] [--iv <iv-file>] encrypt|decrypt <key-number> "
+                 "<input-file> <output-file>\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    exit( runClient( &opts ) );
+}
@@ -0,0 +1,25 @@
+/**
+ * @file aesd.c
+ * @author Jimin Yu, jyu34
+ * This file contains the program execution for aesd, the encryption server.
+*/
+
+#include "daemon.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+/**
+ * This is the main method for aesd. It carries program execution.
+ * @param argc the number of command line arguments given
+ * @param argv an array of all the command line arguments
+ * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    DaemonOptions opts;
+    if ( !parseDaemonOptions( &opts, argc, argv ) ) {
+        fprintf( stderr, "usage: aesd [-j N|auto] [--socket <path>] <key-file>...\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    exit( runDaemon( &opts ) );
+}
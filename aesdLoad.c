@@ -0,0 +1,333 @@
+/**
+  @file aesdLoad.c
+  @author Jimin Yu, jyu34
+  Load generator for aesd. Each connection runs in its own thread, keeping a fixed number of encryption requests in
+  flight and timing each one from just before it's sent to just after its reply arrives. At the end it reports the
+  request rate, throughput and latency percentiles across every connection, as a table, JSON or CSV.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "aes.h"
+#include "cli.h"
+#include "modes.h"
+#include "proto.h"
+
+/** Nanoseconds in a second. */
+#define NANOS 1000000000ULL
+
+/** Nanoseconds in a microsecond, the unit latencies are reported in. */
+#define MICRO 1000.0
+
+/** Bytes in a megabyte, for MB/s. */
+#define MEGABYTE 1e6
+
+/** Bytes in a kilobyte, for size suffixes. */
+#define KILO 1024
+
+/** Requests each connection sends before timing starts, to get aesd's buffers and the caches warm. */
+#define WARMUP 1000
+
+/** Most requests a connection keeps in flight. */
+#define MAX_DEPTH 1024
+
+/** Ways of writing the results. */
+typedef enum { FORMAT_TEXT, FORMAT_JSON, FORMAT_CSV } Format;
+
+/** Everything asked for on the command line. */
+typedef struct {
+  /** aesd's socket. */
+  char const *socketPath;
+
+  /** Number of the key to use. */
+  int key;
+
+  /** Block cipher mode. */
+  CipherMode mode;
+
+  /** Bytes of payload in each request. */
+  size_t size;
+
+  /** Number of connections, each with its own thread. */
+  int connections;
+
+  /** Timed requests on each connection. */
+  int requests;
+
+  /** Requests each connection keeps in flight. */
+  int depth;
+
+  /** How to write the results. */
+  Format format;
+} LoadOptions;
+
+/** One connection's share of the run. */
+typedef struct {
+  /** The options. */
+  LoadOptions const *opts;
+
+  /** Number of the connection, which makes its IVs different from every other's. */
+  int index;
+
+  /** Latency of each timed request, in nanoseconds. */
+  uint64_t *latencies;
+
+  /** False if the connection failed or aesd refused a request. */
+  bool ok;
+
+  /** The thread running the connection. */
+  pthread_t thread;
+} Client;
+
+/**
+   Read a clock that only goes forward.
+   @return the time in nanoseconds.
+*/
+static uint64_t now( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec * NANOS + ts.tv_nsec;
+}
+
+/**
+   Print the usage message and exit.
+*/
+static void usage( void )
+{
+  fprintf( stderr, "usage: aesdLoad [--socket <path>] [--key N] [--mode M] [--size N] [-c N] [--requests N]\n"
+                   "                [--depth N] [--json|--csv]\n" );
+  exit( EXIT_FAILURE );
+}
+
+/**
+   Parse a positive count, or exit with the usage message.
+   @param text the argument.
+   @return the count.
+*/
+static int positive( char const *text )
+{
+  int n;
+  if ( !parseCount( text, &n ) || n == 0 )
+    usage();
+  return n;
+}
+
+/**
+   Parse a size with an optional K or M suffix, or exit with the usage message.
+   @param text the size.
+   @return the number of bytes.
+*/
+static size_t parseSize( char const *text )
+{
+  char *end;
+  unsigned long long n = strtoull( text, &end, 10 );
+  if ( end == text || *text == '-' )
+    usage();
+  if ( *end == 'K' )
+    n *= KILO, end++;
+  else if ( *end == 'M' )
+    n *= KILO * KILO, end++;
+  if ( *end != '\0' || n > MAX_PAYLOAD )
+    usage();
+  return n;
+}
+
+/**
+   Parse the command line, or exit with the usage message.
+   @param opts the options to fill in.
+   @param argc the number of arguments.
+   @param argv the arguments.
+*/
+static void parseLoadOptions( LoadOptions *opts, int argc, char *argv[] )
+{
+  *opts = ( LoadOptions ) { defaultSocket(), 0, MODE_CTR, 64, 1, 10000, 1, FORMAT_TEXT };
+  for ( int i = 1; i < argc; i++ ) {
+    char const *arg = argv[ i ];
+    if ( strcmp( arg, "--json" ) == 0 )
+      opts->format = FORMAT_JSON;
+    else if ( strcmp( arg, "--csv" ) == 0 )
+      opts->format = FORMAT_CSV;
+    else if ( i + 1 == argc )
+      usage();
+    else if ( strcmp( arg, "--socket" ) == 0 )
+      opts->socketPath = argv[ ++i ];
+    else if ( strcmp( arg, "--key" ) == 0 ) {
+      if ( !parseCount( argv[ ++i ], &opts->key ) )
+        usage();
+    } else if ( strcmp( arg, "--mode" ) == 0 ) {
+      if ( !parseMode( argv[ ++i ], &opts->mode ) || opts->mode == MODE_XTS )
+        usage();
+    } else if ( strcmp( arg, "--size" ) == 0 )
+      opts->size = parseSize( argv[ ++i ] );
+    else if ( strcmp( arg, "-c" ) == 0 )
+      opts->connections = positive( argv[ ++i ] );
+    else if ( strcmp( arg, "--requests" ) == 0 )
+      opts->requests = positive( argv[ ++i ] );
+    else if ( strcmp( arg, "--depth" ) == 0 )
+      opts->depth = positive( argv[ ++i ] );
+    else
+      usage();
+  }
+
+  // ecb and cbc have no padding.
+  if ( opts->depth > MAX_DEPTH || ( ( opts->mode == MODE_ECB || opts->mode == MODE_CBC ) && opts->size % BLOCK_SIZE ) )
+    usage();
+}
+
+/**
+   Fill in a request. Every request gets its own IV, made from the connection and request numbers, so gcm never
+   sees one twice under the same key.
+   @param req the request.
+   @param opts the options.
+   @param conn the connection's number.
+   @param id the request's number on the connection.
+*/
+static void makeRequest( Request *req, LoadOptions const *opts, int conn, uint32_t id )
+{
+  *req = ( Request ) { opts->mode, ENCRYPT, opts->key, id, opts->size, 0 };
+  req->ivLen = opts->mode == MODE_ECB ? 0 : opts->mode == MODE_GCM ? GCM_IV_SIZE : BLOCK_SIZE;
+  memcpy( req->iv, &id, sizeof( id ) );
+  memcpy( req->iv + sizeof( id ), &conn, sizeof( conn ) );
+}
+
+/**
+   Start routine for a connection: send the warm-up requests and then the timed ones, keeping opts->depth in flight.
+   @param arg the Client.
+   @return NULL.
+*/
+static void *runConnection( void *arg )
+{
+  Client *conn = arg;
+  LoadOptions const *opts = conn->opts;
+  int fd = connectDaemon( opts->socketPath );
+  if ( fd < 0 ) {
+    fprintf( stderr, "Can't connect to aesd: %s: %s\n", opts->socketPath, strerror( errno ) );
+    return NULL;
+  }
+
+  byte *payload = calloc( opts->size ? opts->size : 1, 1 );
+  byte *result = NULL;
+  size_t capacity = 0;
+  uint64_t sentAt[ MAX_DEPTH ];
+  int total = WARMUP + opts->requests;
+  int sent = 0;
+  conn->ok = true;
+
+  for ( int done = 0; conn->ok && done < total; done++ ) {
+    // Top up the requests in flight, then wait for the oldest.
+    while ( sent < total && sent - done < opts->depth ) {
+      Request req;
+      makeRequest( &req, opts, conn->index, sent );
+      sentAt[ sent % MAX_DEPTH ] = now();
+      if ( !sendRequest( fd, &req, payload ) ) {
+        conn->ok = false;
+        break;
+      }
+      sent++;
+    }
+
+    Reply reply;
+    if ( !conn->ok || !receiveReply( fd, &reply, &result, &capacity ) || reply.id != done ) {
+      fprintf( stderr, "Lost connection to aesd: %s\n", opts->socketPath );
+      conn->ok = false;
+    } else if ( reply.status != REPLY_OK ) {
+      fprintf( stderr, "aesd: %s\n", replyString( reply.status ) );
+      conn->ok = false;
+    } else if ( done >= WARMUP )
+      conn->latencies[ done - WARMUP ] = now() - sentAt[ done % MAX_DEPTH ];
+  }
+
+  close( fd );
+  free( payload );
+  free( result );
+  return NULL;
+}
+
+/**
+   Compare two latencies, for qsort().
+   @param a the first.
+   @param b the second.
+   @return negative, zero or positive as a is less than, equal to or greater than b.
+*/
+static int compareLatency( void const *a, void const *b )
+{
+  uint64_t x = *( uint64_t const * ) a, y = *( uint64_t const * ) b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+   Look up a percentile of sorted latencies, in microseconds.
+   @param sorted the latencies, in order.
+   @param count how many there are.
+   @param percent the percentile.
+   @return the latency.
+*/
+static double percentile( uint64_t const *sorted, size_t count, double percent )
+{
+  size_t i = percent / 100 * ( count - 1 ) + 0.5;
+  return sorted[ i ] / MICRO;
+}
+
+int main( int argc, char *argv[] )
+{
+  LoadOptions opts;
+  parseLoadOptions( &opts, argc, argv );
+
+  Client *conns = calloc( opts.connections, sizeof( Client ) );
+  uint64_t *latencies = malloc( ( size_t ) opts.connections * opts.requests * sizeof( uint64_t ) );
+  uint64_t start = now();
+  for ( int i = 0; i < opts.connections; i++ ) {
+    conns[ i ] = ( Client ) { &opts, i, latencies + ( size_t ) i * opts.requests };
+    pthread_create( &conns[ i ].thread, NULL, runConnection, &conns[ i ] );
+  }
+  bool ok = true;
+  for ( int i = 0; i < opts.connections; i++ ) {
+    pthread_join( conns[ i ].thread, NULL );
+    ok = ok && conns[ i ].ok;
+  }
+  double seconds = ( double ) ( now() - start ) / NANOS;
+  if ( !ok ) {
+    fprintf( stderr, "Load test failed\n" );
+    exit( EXIT_FAILURE );
+  }
+
+  // The warm-up requests are in the wall time, so count them in the rates too.
+  size_t count = ( size_t ) opts.connections * opts.requests;
+  qsort( latencies, count, sizeof( uint64_t ), compareLatency );
+  double rate = ( double ) opts.connections * ( WARMUP + opts.requests ) / seconds;
+  double mbps = rate * opts.size / MEGABYTE;
+  double p50 = percentile( latencies, count, 50 ), p90 = percentile( latencies, count, 90 );
+  double p99 = percentile( latencies, count, 99 ), p999 = percentile( latencies, count, 99.9 );
+  double low = latencies[ 0 ] / MICRO, high = latencies[ count - 1 ] / MICRO;
+  static char const *const modeNames[] = { "ecb", "cbc", "ctr", "gcm" };
+  char const *mode = modeNames[ opts.mode ];
+
+  if ( opts.format == FORMAT_JSON )
+    printf( "{\"mode\": \"%s\", \"size\": %zu, \"connections\": %d, \"depth\": %d, \"requests\": %zu, "
+            "\"requestsPerSec\": %.0f, \"mbPerSec\": %.1f, \"minUs\": %.1f, \"p50Us\": %.1f, \"p90Us\": %.1f, "
+            "\"p99Us\": %.1f, \"p999Us\": %.1f, \"maxUs\": %.1f}\n", mode, opts.size, opts.connections, opts.depth,
+            count, rate, mbps, low, p50, p90, p99, p999, high );
+  else if ( opts.format == FORMAT_CSV )
+    printf( "mode,size,connections,depth,requests,requests_per_sec,mb_per_sec,min_us,p50_us,p90_us,p99_us,p999_us,"
+            "max_us\n%s,%zu,%d,%d,%zu,%.0f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", mode, opts.size, opts.connections,
+            opts.depth, count, rate, mbps, low, p50, p90, p99, p999, high );
+  else {
+    printf( "%-5s %8s %5s %5s %9s %10s %9s %8s %8s %8s %8s %8s %8s\n", "mode", "size", "conns", "depth", "requests",
+            "req/s", "MB/s", "min us", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us" );
+    printf( "%-5s %8zu %5d %5d %9zu %10.0f %9.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", mode, opts.size,
+            opts.connections, opts.depth, count, rate, mbps, low, p50, p90, p99, p999, high );
+  }
+
+  free( conns );
+  free( latencies );
+  return EXIT_SUCCESS;
+}
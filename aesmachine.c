@@ -0,0 +1,321 @@
+/**
+ * @file aesmachine.c
+ * @author Jimin Yu, jyu34
+ * This file implements the libaesmachine API on top of the AES engines and the block cipher modes. It does no file
+ * I/O; the caller hands in buffers and gets buffers back.
+*/
+
+#include "aesmachine.h"
+#include "aes.h"
+#include "modes.h"
+#include "parallel.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct AmCipher {
+  /** The block cipher mode. */
+  AmMode mode;
+
+  /** Whether the cipher encrypts or decrypts. */
+  AmDirection dir;
+
+  /** The expanded key. */
+  AesContext ctx;
+
+  /** Threads to split large buffers across, or NULL for just the caller. */
+  WorkerPool *pool;
+
+  /** The CBC chaining value, or the CTR initial counter block. */
+  byte iv[ BLOCK_SIZE ];
+
+  /** The GCM operation in progress. */
+  GcmContext gcm;
+
+  /** True once the message has an IV (always, for ECB). */
+  bool ivSet;
+
+  /** True once data or additional data has been added to the message. */
+  bool started;
+
+  /** Position in the CTR keystream. */
+  uint64_t offset;
+
+  /** The start of a block that hasn't been processed yet, in ECB, CBC and GCM. */
+  byte partial[ BLOCK_SIZE ];
+
+  /** Number of bytes in partial. */
+  size_t partialLen;
+};
+
+/** Descriptions of the status codes, in AmStatus order. */
+static char const *const statusStrings[] = {
+  "success",
+  "bad argument",
+  "bad key size",
+  "bad or missing IV",
+  "bad data length",
+  "authentication failed",
+  "out of memory",
+  "call out of order"
+};
+
+/**
+   Overwrite memory in a way the compiler can't skip, even though it's about to be freed.
+   @param data the memory.
+   @param len the number of bytes.
+*/
+static void wipe( void *data, size_t len )
+{
+  volatile byte *p = data;
+  while ( len-- )
+    *p++ = 0;
+}
+
+/**
+   Process a whole number of blocks in ECB, CBC or GCM mode.
+   @param cipher the cipher.
+   @param in the input.
+   @param out where the output goes, which may be the same as in.
+   @param len the number of bytes, a multiple of BLOCK_SIZE.
+*/
+static void cryptBlocks( AmCipher *cipher, byte const *in, byte *out, size_t len )
+{
+  bool encrypt = cipher->dir == AM_ENCRYPT;
+  if ( len == 0 )
+    return;
+
+  if ( cipher->mode == AM_ECB && encrypt )
+    parallelEncryptBlocks( cipher->pool, &cipher->ctx, in, out, len / BLOCK_SIZE );
+  else if ( cipher->mode == AM_ECB )
+    parallelDecryptBlocks( cipher->pool, &cipher->ctx, in, out, len / BLOCK_SIZE );
+  else if ( cipher->mode == AM_CBC && encrypt ) {
+    CbcStream stream = { in, out, len / BLOCK_SIZE };
+    memcpy( stream.iv, cipher->iv, BLOCK_SIZE );
+    cbcEncryptStreams( &cipher->ctx, &stream, 1 );
+    memcpy( cipher->iv, stream.iv, BLOCK_SIZE );
+  } else if ( cipher->mode == AM_CBC )
+    parallelCbcDecrypt( cipher->pool, &cipher->ctx, cipher->iv, in, out, len / BLOCK_SIZE );
+  else if ( encrypt )
+    gcmEncrypt( &cipher->gcm, cipher->pool, in, out, len );
+  else
+    gcmDecrypt( &cipher->gcm, cipher->pool, in, out, len );
+}
+
+int amVersion( void )
+{
+  return AM_VERSION_MAJOR * 100 + AM_VERSION_MINOR;
+}
+
+char const *amStatusString( AmStatus status )
+{
+  if ( status < AM_OK || status > AM_ERR_STATE )
+    return "unknown status";
+  return statusStrings[ status ];
+}
+
+char const *amEngineName( void )
+{
+  return aesGetEngine()->name;
+}
+
+AmStatus amCreate( AmCipher **cipher, AmMode mode, AmDirection dir, uint8_t const *key, size_t keyLen )
+{
+  if ( !cipher || !key || mode < AM_ECB || mode > AM_GCM || ( dir != AM_ENCRYPT && dir != AM_DECRYPT ) )
+    return AM_ERR_ARGUMENT;
+  if ( keyLen != AM_KEY_SIZE )
+    return AM_ERR_KEY;
+
+  AmCipher *c = calloc( 1, sizeof( AmCipher ) );
+  if ( !c )
+    return AM_ERR_MEMORY;
+  c->mode = mode;
+  c->dir = dir;
+  c->ivSet = mode == AM_ECB;
+  aesInitCtx( &c->ctx, key );
+
+  // Work out the GCM hash key now, so each message only has to set its IV.
+  if ( mode == AM_GCM ) {
+    byte zero[ GCM_IV_SIZE ] = { 0 };
+    gcmInit( &c->gcm, &c->ctx, zero );
+  }
+  *cipher = c;
+  return AM_OK;
+}
+
+void amDestroy( AmCipher *cipher )
+{
+  if ( !cipher )
+    return;
+  poolDestroy( cipher->pool );
+  wipe( cipher, sizeof( AmCipher ) );
+  free( cipher );
+}
+
+AmStatus amSetThreads( AmCipher *cipher, int threads )
+{
+  if ( !cipher || threads < 0 )
+    return AM_ERR_ARGUMENT;
+  poolDestroy( cipher->pool );
+  cipher->pool = poolCreate( threads == 0 ? parallelCpuCount() : threads );
+  return AM_OK;
+}
+
+AmStatus amSetIv( AmCipher *cipher, uint8_t const *iv, size_t ivLen )
+{
+  if ( !cipher )
+    return AM_ERR_ARGUMENT;
+
+  size_t want = cipher->mode == AM_ECB ? 0 : cipher->mode == AM_GCM ? AM_GCM_IV_SIZE : AM_IV_SIZE;
+  if ( ivLen != want || ( want && !iv ) )
+    return AM_ERR_IV;
+
+  if ( cipher->mode == AM_GCM )
+    gcmRestart( &cipher->gcm, iv );
+  else if ( want )
+    memcpy( cipher->iv, iv, want );
+  cipher->ivSet = true;
+  cipher->started = false;
+  cipher->offset = 0;
+  cipher->partialLen = 0;
+  return AM_OK;
+}
+
+AmStatus amAad( AmCipher *cipher, uint8_t const *aad, size_t len )
+{
+  if ( !cipher || cipher->mode != AM_GCM || ( len && !aad ) )
+    return AM_ERR_ARGUMENT;
+  if ( !cipher->ivSet || cipher->started )
+    return AM_ERR_STATE;
+
+  gcmAad( &cipher->gcm, aad, len );
+  cipher->started = true;
+  return AM_OK;
+}
+
+AmStatus amUpdate( AmCipher *cipher, uint8_t const *in, size_t inLen, uint8_t *out, size_t *outLen )
+{
+  if ( !cipher || !outLen || ( inLen && ( !in || !out ) ) )
+    return AM_ERR_ARGUMENT;
+  if ( !cipher->ivSet )
+    return AM_ERR_IV;
+  if ( cipher->mode == AM_GCM && inLen > GCM_MAX_BYTES - cipher->gcm.dataLen - cipher->partialLen )
+    return AM_ERR_LENGTH;
+  cipher->started = true;
+  *outLen = 0;
+
+  if ( cipher->mode == AM_CTR ) {
+    parallelCtrCrypt( cipher->pool, &cipher->ctx, cipher->iv, cipher->offset, in, out, inLen );
+    cipher->offset += inLen;
+    *outLen = inLen;
+    return AM_OK;
+  }
+
+  // With a partial block held, the output runs ahead of the input, so input in the same buffer is copied first.
+  byte *copy = NULL;
+  if ( cipher->partialLen && inLen && out < in + inLen && in < out + inLen + BLOCK_SIZE ) {
+    copy = malloc( inLen );
+    if ( !copy )
+      return AM_ERR_MEMORY;
+    memcpy( copy, in, inLen );
+    in = copy;
+  }
+
+  // Finish the held block first.
+  if ( cipher->partialLen ) {
+    size_t take = BLOCK_SIZE - cipher->partialLen;
+    take = take < inLen ? take : inLen;
+    memcpy( cipher->partial + cipher->partialLen, in, take );
+    cipher->partialLen += take;
+    in += take;
+    inLen -= take;
+    if ( cipher->partialLen == BLOCK_SIZE ) {
+      cryptBlocks( cipher, cipher->partial, out, BLOCK_SIZE );
+      cipher->partialLen = 0;
+      *outLen = BLOCK_SIZE;
+    }
+  }
+
+  // Then all the whole blocks, and hold on to whatever's left.
+  size_t whole = inLen - inLen % BLOCK_SIZE;
+  cryptBlocks( cipher, in, out + *outLen, whole );
+  *outLen += whole;
+  memcpy( cipher->partial + cipher->partialLen, in + whole, inLen - whole );
+  cipher->partialLen += inLen - whole;
+
+  free( copy );
+  return AM_OK;
+}
+
+AmStatus amFinal( AmCipher *cipher, uint8_t *out, size_t *outLen, uint8_t *tag )
+{
+  if ( !cipher || !outLen || ( cipher->mode == AM_GCM && !tag ) || ( cipher->partialLen && !out ) )
+    return AM_ERR_ARGUMENT;
+  if ( !cipher->ivSet )
+    return AM_ERR_IV;
+  *outLen = 0;
+
+  AmStatus status = AM_OK;
+  if ( cipher->mode == AM_GCM ) {
+    // GCM can finish on a partial block.
+    if ( cipher->dir == AM_ENCRYPT ) {
+      gcmEncrypt( &cipher->gcm, cipher->pool, cipher->partial, out, cipher->partialLen );
+      gcmFinal( &cipher->gcm, tag );
+    } else {
+      gcmDecrypt( &cipher->gcm, cipher->pool, cipher->partial, out, cipher->partialLen );
+      if ( !gcmCheckTag( &cipher->gcm, tag ) )
+        status = AM_ERR_AUTH;
+    }
+    *outLen = cipher->partialLen;
+  } else if ( cipher->partialLen )
+    status = AM_ERR_LENGTH;
+
+  // The next message needs an IV of its own, so one is never used twice by accident.
+  cipher->ivSet = cipher->mode == AM_ECB;
+  cipher->started = false;
+  cipher->offset = 0;
+  wipe( cipher->partial, BLOCK_SIZE );
+  cipher->partialLen = 0;
+  return status;
+}
+
+AmStatus amCrypt( AmMode mode, AmDirection dir, uint8_t const *key, size_t keyLen, uint8_t const *iv,
+                  size_t ivLen, uint8_t const *in, size_t inLen, uint8_t *out, size_t *outLen )
+{
+  if ( !outLen || ( inLen && ( !in || !out ) ) )
+    return AM_ERR_ARGUMENT;
+
+  // GCM ciphertext ends with the tag, which isn't part of the data.
+  bool tagged = mode == AM_GCM;
+  if ( tagged && dir == AM_DECRYPT && inLen < AM_TAG_SIZE )
+    return AM_ERR_LENGTH;
+  size_t dataLen = tagged && dir == AM_DECRYPT ? inLen - AM_TAG_SIZE : inLen;
+  if ( ( mode == AM_ECB || mode == AM_CBC ) && dataLen % AM_BLOCK_SIZE != 0 )
+    return AM_ERR_LENGTH;
+
+  AmCipher *cipher;
+  AmStatus status = amCreate( &cipher, mode, dir, key, keyLen );
+  if ( status != AM_OK )
+    return status;
+  status = amSetIv( cipher, iv, ivLen );
+
+  size_t done = 0, last = 0;
+  byte tag[ AM_TAG_SIZE ];
+  if ( tagged && dir == AM_DECRYPT )
+    memcpy( tag, in + dataLen, AM_TAG_SIZE );
+  if ( status == AM_OK )
+    status = amUpdate( cipher, in, dataLen, out, &done );
+  if ( status == AM_OK )
+    status = amFinal( cipher, out + done, &last, tagged ? tag : NULL );
+  amDestroy( cipher );
+
+  *outLen = done + last;
+  if ( status == AM_OK && tagged && dir == AM_ENCRYPT ) {
+    memcpy( out + *outLen, tag, AM_TAG_SIZE );
+    *outLen += AM_TAG_SIZE;
+  } else if ( status == AM_ERR_AUTH ) {
+    wipe( out, *outLen );
+    *outLen = 0;
+  }
+  return status;
+}
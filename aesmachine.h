@@ -0,0 +1,212 @@
+/**
+ * @file aesmachine.h
+ * @author Jimin Yu, jyu34
+ * This is the public header for libaesmachine, the AES engines and block cipher modes of the encrypt and decrypt
+ * programs as a library, for encrypting buffers in memory without running a program or touching a file. Everything
+ * the library exports is declared here. A cipher is an opaque handle; the layout behind it can change from one
+ * version to the next without breaking programs built against an earlier one.
+*/
+
+/** Macro used for unit testing */
+#ifndef _AESMACHINE_H_
+/** Macro used for unit testing */
+#define _AESMACHINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Marks the functions the shared library exports; everything else in it is hidden. */
+#if defined( __GNUC__ )
+#define AM_EXPORT __attribute__( ( visibility( "default" ) ) )
+#else
+#define AM_EXPORT
+#endif
+
+/** Version of this API. The major number only changes when a program built against an older version would break. */
+#define AM_VERSION_MAJOR 1
+/** Version of this API. The minor number changes when something is added. */
+#define AM_VERSION_MINOR 0
+
+/** Bytes in a key. */
+#define AM_KEY_SIZE 16
+
+/** Bytes in a block; ECB and CBC data must be a multiple of this. */
+#define AM_BLOCK_SIZE 16
+
+/** Bytes in the IV for CBC, and the initial counter block for CTR. */
+#define AM_IV_SIZE 16
+
+/** Bytes in the IV for GCM. */
+#define AM_GCM_IV_SIZE 12
+
+/** Bytes in a GCM authentication tag. */
+#define AM_TAG_SIZE 16
+
+/** A cipher: an expanded key, a mode and a direction, and the state of the message being processed. */
+typedef struct AmCipher AmCipher;
+
+/** Block cipher modes. */
+typedef enum {
+  AM_ECB,
+  AM_CBC,
+  AM_CTR,
+  AM_GCM
+} AmMode;
+
+/** Which way a cipher runs. */
+typedef enum {
+  AM_ENCRYPT,
+  AM_DECRYPT
+} AmDirection;
+
+/** Results of the library's functions. */
+typedef enum {
+  /** Success. */
+  AM_OK = 0,
+
+  /** A pointer was NULL, or a mode, direction or thread count was out of range. */
+  AM_ERR_ARGUMENT,
+
+  /** The key wasn't AM_KEY_SIZE bytes. */
+  AM_ERR_KEY,
+
+  /** The IV was the wrong size for the mode, or the mode needs one and none was set. */
+  AM_ERR_IV,
+
+  /** ECB or CBC data wasn't a whole number of blocks, or GCM input was too short to hold a tag or too long for one
+      IV. */
+  AM_ERR_LENGTH,
+
+  /** The GCM tag didn't match, so the data can't be trusted. */
+  AM_ERR_AUTH,
+
+  /** Memory couldn't be allocated. */
+  AM_ERR_MEMORY,
+
+  /** The call came at the wrong point in a message, like amAad() after amUpdate(). */
+  AM_ERR_STATE
+} AmStatus;
+
+/**
+ * This function returns the version of the library that's actually loaded, which may be newer than the header a
+ * program was built with.
+ * @return the version, as AM_VERSION_MAJOR * 100 + AM_VERSION_MINOR
+*/
+AM_EXPORT int amVersion( void );
+
+/**
+ * This function returns a short description of a status, for error messages.
+ * @param status the status
+ * @return the description, which is never NULL
+*/
+AM_EXPORT char const *amStatusString( AmStatus status );
+
+/**
+ * This function returns the name of the AES engine ciphers use: the fastest one the processor supports, or the one
+ * named in the AES_ENGINE environment variable.
+ * @return the engine's name
+*/
+AM_EXPORT char const *amEngineName( void );
+
+/**
+ * This function creates a cipher and expands its key. ECB is ready to use straight away; the other modes need
+ * amSetIv() before each message.
+ * @param cipher filled in with the new cipher
+ * @param mode the block cipher mode
+ * @param dir whether the cipher encrypts or decrypts
+ * @param key the key
+ * @param keyLen bytes in the key, which must be AM_KEY_SIZE
+ * @return AM_OK, or the reason the cipher couldn't be created
+*/
+AM_EXPORT AmStatus amCreate( AmCipher **cipher, AmMode mode, AmDirection dir, uint8_t const *key, size_t keyLen );
+
+/**
+ * This function frees a cipher, wiping its key schedule first.
+ * @param cipher the cipher, which may be NULL
+*/
+AM_EXPORT void amDestroy( AmCipher *cipher );
+
+/**
+ * This function sets how many threads the cipher splits large buffers across. The default is 1. CBC encryption is a
+ * chain that can't be split, so it always runs in the calling thread.
+ * @param cipher the cipher
+ * @param threads the number of threads, or 0 for one per processor
+ * @return AM_OK, or AM_ERR_ARGUMENT for a negative count
+*/
+AM_EXPORT AmStatus amSetThreads( AmCipher *cipher, int threads );
+
+/**
+ * This function starts a new message with the given IV, discarding anything left of the one before. For ECB, which
+ * has no IV, pass NULL and 0 to start a new message.
+ * @param cipher the cipher
+ * @param iv the IV: AM_IV_SIZE bytes for CBC and CTR, AM_GCM_IV_SIZE bytes for GCM
+ * @param ivLen bytes in the IV
+ * @return AM_OK, or AM_ERR_IV if the IV is the wrong size for the mode
+*/
+AM_EXPORT AmStatus amSetIv( AmCipher *cipher, uint8_t const *iv, size_t ivLen );
+
+/**
+ * This function adds data that GCM authenticates but doesn't encrypt. It can be called at most once per message,
+ * before amUpdate().
+ * @param cipher the cipher, in GCM mode
+ * @param aad the additional data
+ * @param len bytes of additional data
+ * @return AM_OK, AM_ERR_ARGUMENT outside GCM mode, or AM_ERR_STATE if it's too late in the message
+*/
+AM_EXPORT AmStatus amAad( AmCipher *cipher, uint8_t const *aad, size_t len );
+
+/**
+ * This function encrypts or decrypts the next part of a message. The parts can be any size. In ECB, CBC and GCM a
+ * partial block at the end is held back until more data or amFinal() completes it, so the output may be up to
+ * AM_BLOCK_SIZE - 1 bytes shorter or longer than the input; out needs room for inLen + AM_BLOCK_SIZE - 1 bytes. GCM
+ * plaintext from a decryption mustn't be used until amFinal() has checked the tag.
+ * @param cipher the cipher
+ * @param in the input
+ * @param inLen bytes of input
+ * @param out where the output goes; it may be the same as in, but mustn't otherwise overlap it
+ * @param outLen filled in with the bytes of output written
+ * @return AM_OK, AM_ERR_IV if the mode needs an IV and none was set, or AM_ERR_LENGTH (with nothing done) if a GCM
+ * message would go past 2^32 - 2 blocks
+*/
+AM_EXPORT AmStatus amUpdate( AmCipher *cipher, uint8_t const *in, size_t inLen, uint8_t *out, size_t *outLen );
+
+/**
+ * This function finishes a message. Any partial block held back is processed (GCM and CTR) or reported (ECB and
+ * CBC, which have no padding). When encrypting with GCM the tag is written to tag; when decrypting it's checked
+ * against tag. Afterwards the cipher needs amSetIv() before another message, except in ECB mode.
+ * @param cipher the cipher
+ * @param out where the rest of the output goes, with room for AM_BLOCK_SIZE - 1 bytes
+ * @param outLen filled in with the bytes of output written
+ * @param tag the GCM tag, AM_TAG_SIZE bytes, written or checked; NULL in other modes
+ * @return AM_OK, AM_ERR_LENGTH for a partial block in ECB or CBC, or AM_ERR_AUTH if the tag doesn't match
+*/
+AM_EXPORT AmStatus amFinal( AmCipher *cipher, uint8_t *out, size_t *outLen, uint8_t *tag );
+
+/**
+ * This function encrypts or decrypts a whole message in one call. GCM output from encryption has the tag appended,
+ * and GCM input to decryption must end with the tag, the same as the files the encrypt and decrypt programs write;
+ * if the tag doesn't match, the output is wiped.
+ * @param mode the block cipher mode
+ * @param dir whether to encrypt or decrypt
+ * @param key the key, AM_KEY_SIZE bytes
+ * @param keyLen bytes in the key
+ * @param iv the IV, or NULL for ECB
+ * @param ivLen bytes in the IV
+ * @param in the input
+ * @param inLen bytes of input
+ * @param out where the output goes, with room for inLen + AM_TAG_SIZE bytes; it may be the same as in
+ * @param outLen filled in with the bytes of output written
+ * @return AM_OK, or the reason the message couldn't be processed
+*/
+AM_EXPORT AmStatus amCrypt( AmMode mode, AmDirection dir, uint8_t const *key, size_t keyLen, uint8_t const *iv,
+                            size_t ivLen, uint8_t const *in, size_t inLen, uint8_t *out, size_t *outLen );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
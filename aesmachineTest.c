@@ -0,0 +1,332 @@
+/**
+  @file aesmachineTest.c
+  @author Jimin Yu, jyu34
+  Unit test program for libaesmachine. It only uses what aesmachine.h exports, the same as any other program linked
+  against the library.
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aesmachine.h"
+
+/** Number of tests we should have, if they're all turned on. */
+#define EXPECTED_TOTAL 27
+
+/** Total number or tests we tried. */
+static int totalTests = 0;
+
+/** Number of test cases passed. */
+static int passedTests = 0;
+
+/** Macro to check the condition on a test case, keep counts of
+    passed/failed tests and report a message if the test fails. */
+#define TestCase( conditional ) {\
+  totalTests += 1; \
+  if ( conditional ) { \
+    passedTests += 1; \
+  } else { \
+    printf( "**** Failed unit test on line %d of %s\n", __LINE__, __FILE__ );    \
+  } \
+}
+
+/** Key from the NIST SP 800-38A examples. */
+static uint8_t const nistKey[ AM_KEY_SIZE ] = {
+  0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+  0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+
+/** Plaintext from the NIST SP 800-38A examples. */
+static uint8_t const nistPlain[ 64 ] = {
+  0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+  0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+  0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+  0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+  0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11,
+  0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+  0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17,
+  0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10 };
+
+/** ECB ciphertext, from NIST SP 800-38A F.1.1. */
+static uint8_t const ecbCipher[ 64 ] = {
+  0x3A, 0xD7, 0x7B, 0xB4, 0x0D, 0x7A, 0x36, 0x60,
+  0xA8, 0x9E, 0xCA, 0xF3, 0x24, 0x66, 0xEF, 0x97,
+  0xF5, 0xD3, 0xD5, 0x85, 0x03, 0xB9, 0x69, 0x9D,
+  0xE7, 0x85, 0x89, 0x5A, 0x96, 0xFD, 0xBA, 0xAF,
+  0x43, 0xB1, 0xCD, 0x7F, 0x59, 0x8E, 0xCE, 0x23,
+  0x88, 0x1B, 0x00, 0xE3, 0xED, 0x03, 0x06, 0x88,
+  0x7B, 0x0C, 0x78, 0x5E, 0x27, 0xE8, 0xAD, 0x3F,
+  0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5D, 0xD4 };
+
+/** CBC IV, from NIST SP 800-38A F.2.1. */
+static uint8_t const cbcIv[ AM_IV_SIZE ] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+  0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+
+/** CBC ciphertext, from NIST SP 800-38A F.2.1. */
+static uint8_t const cbcCipher[ 64 ] = {
+  0x76, 0x49, 0xAB, 0xAC, 0x81, 0x19, 0xB2, 0x46,
+  0xCE, 0xE9, 0x8E, 0x9B, 0x12, 0xE9, 0x19, 0x7D,
+  0x50, 0x86, 0xCB, 0x9B, 0x50, 0x72, 0x19, 0xEE,
+  0x95, 0xDB, 0x11, 0x3A, 0x91, 0x76, 0x78, 0xB2,
+  0x73, 0xBE, 0xD6, 0xB8, 0xE3, 0xC1, 0x74, 0x3B,
+  0x71, 0x16, 0xE6, 0x9E, 0x22, 0x22, 0x95, 0x16,
+  0x3F, 0xF1, 0xCA, 0xA1, 0x68, 0x1F, 0xAC, 0x09,
+  0x12, 0x0E, 0xCA, 0x30, 0x75, 0x86, 0xE1, 0xA7 };
+
+/** CTR initial counter block, from NIST SP 800-38A F.5.1. */
+static uint8_t const ctrIv[ AM_IV_SIZE ] = {
+  0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7,
+  0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF };
+
+/** CTR ciphertext, from NIST SP 800-38A F.5.1. */
+static uint8_t const ctrCipher[ 64 ] = {
+  0x87, 0x4D, 0x61, 0x91, 0xB6, 0x20, 0xE3, 0x26,
+  0x1B, 0xEF, 0x68, 0x64, 0x99, 0x0D, 0xB6, 0xCE,
+  0x98, 0x06, 0xF6, 0x6B, 0x79, 0x70, 0xFD, 0xFF,
+  0x86, 0x17, 0x18, 0x7B, 0xB9, 0xFF, 0xFD, 0xFF,
+  0x5A, 0xE4, 0xDF, 0x3E, 0xDB, 0xD5, 0xD3, 0x5E,
+  0x5B, 0x4F, 0x09, 0x02, 0x0D, 0xB0, 0x3E, 0xAB,
+  0x1E, 0x03, 0x1D, 0xDA, 0x2F, 0xBE, 0x03, 0xD1,
+  0x79, 0x21, 0x70, 0xA0, 0xF3, 0x00, 0x9C, 0xEE };
+
+/** GCM key, from test case 4 of the GCM specification. */
+static uint8_t const gcmKey[ AM_KEY_SIZE ] = {
+  0xFE, 0xFF, 0xE9, 0x92, 0x86, 0x65, 0x73, 0x1C,
+  0x6D, 0x6A, 0x8F, 0x94, 0x67, 0x30, 0x83, 0x08 };
+
+/** GCM IV, from test case 4. */
+static uint8_t const gcmIv[ AM_GCM_IV_SIZE ] = {
+  0xCA, 0xFE, 0xBA, 0xBE, 0xFA, 0xCE, 0xDB, 0xAD,
+  0xDE, 0xCA, 0xF8, 0x88 };
+
+/** GCM plaintext, from test case 4. */
+static uint8_t const gcmPlain[ 60 ] = {
+  0xD9, 0x31, 0x32, 0x25, 0xF8, 0x84, 0x06, 0xE5,
+  0xA5, 0x59, 0x09, 0xC5, 0xAF, 0xF5, 0x26, 0x9A,
+  0x86, 0xA7, 0xA9, 0x53, 0x15, 0x34, 0xF7, 0xDA,
+  0x2E, 0x4C, 0x30, 0x3D, 0x8A, 0x31, 0x8A, 0x72,
+  0x1C, 0x3C, 0x0C, 0x95, 0x95, 0x68, 0x09, 0x53,
+  0x2F, 0xCF, 0x0E, 0x24, 0x49, 0xA6, 0xB5, 0x25,
+  0xB1, 0x6A, 0xED, 0xF5, 0xAA, 0x0D, 0xE6, 0x57,
+  0xBA, 0x63, 0x7B, 0x39 };
+
+/** GCM additional data, from test case 4. */
+static uint8_t const gcmAadData[ 20 ] = {
+  0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+  0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+  0xAB, 0xAD, 0xDA, 0xD2 };
+
+/** GCM ciphertext, from test case 4. */
+static uint8_t const gcmCipher[ 60 ] = {
+  0x42, 0x83, 0x1E, 0xC2, 0x21, 0x77, 0x74, 0x24,
+  0x4B, 0x72, 0x21, 0xB7, 0x84, 0xD0, 0xD4, 0x9C,
+  0xE3, 0xAA, 0x21, 0x2F, 0x2C, 0x02, 0xA4, 0xE0,
+  0x35, 0xC1, 0x7E, 0x23, 0x29, 0xAC, 0xA1, 0x2E,
+  0x21, 0xD5, 0x14, 0xB2, 0x54, 0x66, 0x93, 0x1C,
+  0x7D, 0x8F, 0x6A, 0x5A, 0xAC, 0x84, 0xAA, 0x05,
+  0x1B, 0xA3, 0x0B, 0x39, 0x6A, 0x0A, 0xAC, 0x97,
+  0x3D, 0x58, 0xE0, 0x91 };
+
+/** GCM tag, from test case 4. */
+static uint8_t const gcmTag[ AM_TAG_SIZE ] = {
+  0x5B, 0xC9, 0x4F, 0xBC, 0x32, 0x21, 0xA5, 0xDB,
+  0x94, 0xFA, 0xE9, 0x5A, 0xE7, 0x12, 0x1A, 0x47 };
+
+/** Odd-sized pieces to feed a message through amUpdate() in, ending with whatever's left. */
+static size_t const pieces[] = { 1, 7, 20, 3 };
+
+/**
+   Run a message through a cipher in the odd-sized pieces above, then finish it.
+   @param cipher the cipher, with its IV set.
+   @param in the input.
+   @param len bytes of input.
+   @param out where the output goes, with room for len + AM_BLOCK_SIZE bytes.
+   @param tag the GCM tag to write or check, or NULL.
+   @return the bytes of output, or 0 if a call failed.
+*/
+static size_t cryptPieces( AmCipher *cipher, uint8_t const *in, size_t len, uint8_t *out, uint8_t *tag )
+{
+  size_t done = 0, pos = 0, n;
+  for ( int i = 0; pos < len; i++ ) {
+    size_t piece = i < sizeof( pieces ) / sizeof( pieces[ 0 ] ) ? pieces[ i ] : len - pos;
+    piece = piece < len - pos ? piece : len - pos;
+    if ( amUpdate( cipher, in + pos, piece, out + done, &n ) != AM_OK )
+      return 0;
+    pos += piece;
+    done += n;
+  }
+  if ( amFinal( cipher, out + done, &n, tag ) != AM_OK )
+    return 0;
+  return done + n;
+}
+
+/**
+   Check that a mode gives the same output in pieces, in one piece, and across threads.
+   @param mode the mode.
+   @param iv the IV.
+   @param ivLen bytes in the IV.
+   @param len bytes of data, large enough to be split across threads.
+   @return true if all three match.
+*/
+static bool sameEveryWay( AmMode mode, uint8_t const *iv, size_t ivLen, size_t len )
+{
+  uint8_t *data = malloc( len );
+  uint8_t *whole = malloc( len + AM_TAG_SIZE );
+  uint8_t *split = malloc( len + AM_TAG_SIZE );
+  for ( size_t i = 0; i < len; i++ )
+    data[ i ] = i * 31 + 7;
+
+  size_t wholeLen;
+  bool same = amCrypt( mode, AM_ENCRYPT, nistKey, AM_KEY_SIZE, iv, ivLen, data, len, whole, &wholeLen ) == AM_OK;
+
+  AmCipher *cipher;
+  amCreate( &cipher, mode, AM_ENCRYPT, nistKey, AM_KEY_SIZE );
+  amSetThreads( cipher, 3 );
+  amSetIv( cipher, iv, ivLen );
+  uint8_t tag[ AM_TAG_SIZE ];
+  size_t splitLen = cryptPieces( cipher, data, len, split, mode == AM_GCM ? tag : NULL );
+  amDestroy( cipher );
+  if ( mode == AM_GCM ) {
+    memcpy( split + splitLen, tag, AM_TAG_SIZE );
+    splitLen += AM_TAG_SIZE;
+  }
+  same = same && splitLen == wholeLen && memcmp( whole, split, wholeLen ) == 0;
+
+  free( data );
+  free( whole );
+  free( split );
+  return same;
+}
+
+int main()
+{
+  TestCase( amVersion() == AM_VERSION_MAJOR * 100 + AM_VERSION_MINOR );
+  TestCase( amEngineName() != NULL );
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test amCrypt() against the NIST vectors
+
+  {
+    uint8_t out[ 64 + AM_TAG_SIZE ];
+    size_t len;
+    amCrypt( AM_ECB, AM_ENCRYPT, nistKey, AM_KEY_SIZE, NULL, 0, nistPlain, 64, out, &len );
+    TestCase( len == 64 && memcmp( out, ecbCipher, 64 ) == 0 );
+
+    amCrypt( AM_CBC, AM_ENCRYPT, nistKey, AM_KEY_SIZE, cbcIv, AM_IV_SIZE, nistPlain, 64, out, &len );
+    TestCase( len == 64 && memcmp( out, cbcCipher, 64 ) == 0 );
+
+    // Decrypting works in place.
+    amCrypt( AM_CBC, AM_DECRYPT, nistKey, AM_KEY_SIZE, cbcIv, AM_IV_SIZE, out, 64, out, &len );
+    TestCase( len == 64 && memcmp( out, nistPlain, 64 ) == 0 );
+
+    amCrypt( AM_CTR, AM_ENCRYPT, nistKey, AM_KEY_SIZE, ctrIv, AM_IV_SIZE, nistPlain, 53, out, &len );
+    TestCase( len == 53 && memcmp( out, ctrCipher, 53 ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test amUpdate() and amFinal() with pieces that don't line up with blocks
+
+  {
+    uint8_t out[ 64 + AM_BLOCK_SIZE ];
+    AmCipher *cipher;
+    amCreate( &cipher, AM_ECB, AM_DECRYPT, nistKey, AM_KEY_SIZE );
+    TestCase( cryptPieces( cipher, ecbCipher, 64, out, NULL ) == 64 && memcmp( out, nistPlain, 64 ) == 0 );
+    amDestroy( cipher );
+
+    amCreate( &cipher, AM_CBC, AM_ENCRYPT, nistKey, AM_KEY_SIZE );
+    amSetIv( cipher, cbcIv, AM_IV_SIZE );
+    TestCase( cryptPieces( cipher, nistPlain, 64, out, NULL ) == 64 && memcmp( out, cbcCipher, 64 ) == 0 );
+
+    // The same cipher does the next message once it has an IV, and can work in place while holding a partial block.
+    size_t n, m;
+    TestCase( amUpdate( cipher, nistPlain, 64, out, &n ) == AM_ERR_IV );
+    amSetIv( cipher, cbcIv, AM_IV_SIZE );
+    memcpy( out, nistPlain, 64 );
+    amUpdate( cipher, out, 5, out, &n );
+    amUpdate( cipher, out + 5, 59, out, &m );
+    TestCase( n == 0 && m == 64 && memcmp( out, cbcCipher, 64 ) == 0 );
+    amDestroy( cipher );
+
+    amCreate( &cipher, AM_CTR, AM_DECRYPT, nistKey, AM_KEY_SIZE );
+    amSetIv( cipher, ctrIv, AM_IV_SIZE );
+    TestCase( cryptPieces( cipher, ctrCipher, 64, out, NULL ) == 64 && memcmp( out, nistPlain, 64 ) == 0 );
+    amDestroy( cipher );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test GCM, with test case 4 of the GCM specification
+
+  {
+    uint8_t out[ 60 + AM_TAG_SIZE ];
+    uint8_t tag[ AM_TAG_SIZE ];
+    AmCipher *cipher;
+    amCreate( &cipher, AM_GCM, AM_ENCRYPT, gcmKey, AM_KEY_SIZE );
+    amSetIv( cipher, gcmIv, AM_GCM_IV_SIZE );
+    TestCase( amAad( cipher, gcmAadData, sizeof( gcmAadData ) ) == AM_OK );
+    TestCase( cryptPieces( cipher, gcmPlain, 60, out, tag ) == 60 && memcmp( out, gcmCipher, 60 ) == 0 );
+    TestCase( memcmp( tag, gcmTag, AM_TAG_SIZE ) == 0 );
+
+    // Additional data has to come first.
+    size_t n;
+    amSetIv( cipher, gcmIv, AM_GCM_IV_SIZE );
+    amUpdate( cipher, gcmPlain, 16, out, &n );
+    TestCase( amAad( cipher, gcmAadData, sizeof( gcmAadData ) ) == AM_ERR_STATE );
+    amDestroy( cipher );
+
+    // With no additional data, one-shot decryption takes the ciphertext with the tag on the end.
+    uint8_t sealed[ 60 + AM_TAG_SIZE ];
+    size_t len;
+    amCrypt( AM_GCM, AM_ENCRYPT, gcmKey, AM_KEY_SIZE, gcmIv, AM_GCM_IV_SIZE, gcmPlain, 60, sealed, &len );
+    TestCase( len == 60 + AM_TAG_SIZE );
+    TestCase( amCrypt( AM_GCM, AM_DECRYPT, gcmKey, AM_KEY_SIZE, gcmIv, AM_GCM_IV_SIZE, sealed, len, out, &len )
+              == AM_OK && len == 60 && memcmp( out, gcmPlain, 60 ) == 0 );
+
+    // A changed bit fails, and nothing is left in the output.
+    sealed[ 3 ] ^= 0x10;
+    uint8_t zero[ 60 ] = { 0 };
+    TestCase( amCrypt( AM_GCM, AM_DECRYPT, gcmKey, AM_KEY_SIZE, gcmIv, AM_GCM_IV_SIZE, sealed, 60 + AM_TAG_SIZE, out,
+                       &len ) == AM_ERR_AUTH && len == 0 && memcmp( out, zero, 60 ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test pieces and threads against one call, on enough data to split
+
+  TestCase( sameEveryWay( AM_ECB, NULL, 0, 40000 * AM_BLOCK_SIZE ) );
+  TestCase( sameEveryWay( AM_CTR, ctrIv, AM_IV_SIZE, 40000 * AM_BLOCK_SIZE + 9 ) );
+  TestCase( sameEveryWay( AM_GCM, gcmIv, AM_GCM_IV_SIZE, 40000 * AM_BLOCK_SIZE + 9 ) );
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test the errors
+
+  {
+    AmCipher *cipher = NULL;
+    uint8_t out[ 32 ];
+    size_t len;
+    TestCase( amCreate( &cipher, AM_CBC, AM_ENCRYPT, nistKey, 24 ) == AM_ERR_KEY && cipher == NULL );
+    TestCase( amCrypt( AM_CBC, AM_ENCRYPT, nistKey, AM_KEY_SIZE, cbcIv, AM_IV_SIZE, nistPlain, 20, out, &len )
+              == AM_ERR_LENGTH );
+    TestCase( amCrypt( AM_GCM, AM_ENCRYPT, gcmKey, AM_KEY_SIZE, cbcIv, AM_IV_SIZE, nistPlain, 16, out, &len )
+              == AM_ERR_IV );
+
+    amCreate( &cipher, AM_ECB, AM_ENCRYPT, nistKey, AM_KEY_SIZE );
+    TestCase( amAad( cipher, gcmAadData, 4 ) == AM_ERR_ARGUMENT && amSetThreads( cipher, -1 ) == AM_ERR_ARGUMENT );
+    amUpdate( cipher, nistPlain, 20, out, &len );
+    TestCase( len == 16 && amFinal( cipher, out, &len, NULL ) == AM_ERR_LENGTH );
+    amDestroy( cipher );
+
+    TestCase( strcmp( amStatusString( AM_ERR_AUTH ), "authentication failed" ) == 0 );
+  }
+
+  // Report a message if some tests are still disabled.
+  if ( totalTests < EXPECTED_TOTAL )
+    printf( "** %d of %d tests currently enabled.\n", totalTests,
+            EXPECTED_TOTAL );
+
+  // Exit successfully if all tests are enabled and they all pass.
+  if ( passedTests != EXPECTED_TOTAL )
+    return EXIT_FAILURE;
+  else
+    return EXIT_SUCCESS;
+}
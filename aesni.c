@@ -0,0 +1,321 @@
+/**
+ * @file aesni.c
+ * @author Jimin Yu, jyu34
+ * This file implements the AES engine that uses the AESENC, AESDEC and AESKEYGENASSIST instructions. The functions are
+ * compiled for those instructions individually, so the rest of the program still runs on processors without them; the
+ * dispatch code in aes.c only picks this engine after cpuHas() says it's safe. The wide engine shares the key
+ * schedule and uses the 512-bit VAES instructions to do a round on four blocks at once.
+*/
+
+#include "aesni.h"
+#include "aes.h"
+#include "cpu.h"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+
+/** Number of independent blocks kept in flight at once. */
+#define LANES 8
+
+/** Instruction set extensions the functions in this file are compiled for. */
+#define AESNI_TARGET __attribute__(( target( "aes,sse4.1" ) ))
+
+/**
+   Finish one step of the key schedule from the previous subkey and the AESKEYGENASSIST result for it.
+   @param key the previous subkey.
+   @param assist the output of AESKEYGENASSIST on the previous subkey.
+   @return the next subkey.
+*/
+AESNI_TARGET static __m128i expandStep( __m128i key, __m128i assist )
+{
+  // Only the g function result for the last word is needed, in every word.
+  assist = _mm_shuffle_epi32( assist, 0xFF );
+
+  // Each word is the sum of the previous subkey's words up to that point.
+  key = _mm_xor_si128( key, _mm_slli_si128( key, WORD_SIZE ) );
+  key = _mm_xor_si128( key, _mm_slli_si128( key, WORD_SIZE ) );
+  key = _mm_xor_si128( key, _mm_slli_si128( key, WORD_SIZE ) );
+  return _mm_xor_si128( key, assist );
+}
+
+/** One step of the key schedule, with the round constant as an immediate operand as AESKEYGENASSIST requires. */
+#define EXPAND( rk, i, rcon ) \
+  rk[ i ] = expandStep( rk[ ( i ) - 1 ], _mm_aeskeygenassist_si128( rk[ ( i ) - 1 ], rcon ) )
+
+/**
+   Expand the key with AESKEYGENASSIST, and compute the inverse cipher subkeys with AESIMC.
+   @param ctx the context to fill in.
+   @param key the key to expand.
+*/
+AESNI_TARGET static void aesniExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] )
+{
+  __m128i rk[ ROUNDS + 1 ];
+  rk[ 0 ] = _mm_loadu_si128( (__m128i const *) key );
+  EXPAND( rk, 1, 0x01 );
+  EXPAND( rk, INDEX2, 0x02 );
+  EXPAND( rk, INDEX3, 0x04 );
+  EXPAND( rk, INDEX4, 0x08 );
+  EXPAND( rk, INDEX5, 0x10 );
+  EXPAND( rk, INDEX6, 0x20 );
+  EXPAND( rk, INDEX7, 0x40 );
+  EXPAND( rk, INDEX8, 0x80 );
+  EXPAND( rk, INDEX9, 0x1B );
+  EXPAND( rk, INDEX10, 0x36 );
+
+  for ( int i = 0; i <= ROUNDS; i++ ) {
+    _mm_storeu_si128( (__m128i *) ctx->subkey[ i ], rk[ i ] );
+
+    // AESIMC is unMixColumns, for the middle subkeys of the equivalent inverse cipher.
+    __m128i inv = rk[ ROUNDS - i ];
+    if ( i != 0 && i != ROUNDS )
+      inv = _mm_aesimc_si128( inv );
+    _mm_storeu_si128( (__m128i *) ctx->invSubkey[ i ], inv );
+  }
+}
+
+/**
+   Encrypt a sequence of blocks with AESENC and AESENCLAST. The subkeys stay in registers, and LANES blocks at a time
+   go through each round together, so the multi-cycle latency of AESENC is hidden behind the other blocks.
+   @param ctx the context holding the expanded key.
+   @param in the blocks to encrypt.
+   @param out where the encrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+AESNI_TARGET static void aesniEncrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  __m128i rk[ ROUNDS + 1 ];
+  for ( int i = 0; i <= ROUNDS; i++ )
+    rk[ i ] = _mm_loadu_si128( (__m128i const *) ctx->subkey[ i ] );
+
+  size_t n = 0;
+  for ( ; n + LANES <= nblocks; n += LANES ) {
+    __m128i s[ LANES ];
+    for ( int b = 0; b < LANES; b++ )
+      s[ b ] = _mm_xor_si128( _mm_loadu_si128( (__m128i const *) ( in + ( n + b ) * BLOCK_SIZE ) ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ ) {
+      for ( int b = 0; b < LANES; b++ )
+        s[ b ] = _mm_aesenc_si128( s[ b ], rk[ i ] );
+    }
+    for ( int b = 0; b < LANES; b++ )
+      _mm_storeu_si128( (__m128i *) ( out + ( n + b ) * BLOCK_SIZE ), _mm_aesenclast_si128( s[ b ], rk[ ROUNDS ] ) );
+  }
+
+  for ( ; n < nblocks; n++ ) {
+    __m128i s = _mm_xor_si128( _mm_loadu_si128( (__m128i const *) ( in + n * BLOCK_SIZE ) ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ )
+      s = _mm_aesenc_si128( s, rk[ i ] );
+    _mm_storeu_si128( (__m128i *) ( out + n * BLOCK_SIZE ), _mm_aesenclast_si128( s, rk[ ROUNDS ] ) );
+  }
+}
+
+/**
+   Decrypt a sequence of blocks with AESDEC and AESDECLAST, using the inverse cipher subkeys.
+   @param ctx the context holding the expanded key.
+   @param in the blocks to decrypt.
+   @param out where the decrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+AESNI_TARGET static void aesniDecrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  __m128i rk[ ROUNDS + 1 ];
+  for ( int i = 0; i <= ROUNDS; i++ )
+    rk[ i ] = _mm_loadu_si128( (__m128i const *) ctx->invSubkey[ i ] );
+
+  size_t n = 0;
+  for ( ; n + LANES <= nblocks; n += LANES ) {
+    __m128i s[ LANES ];
+    for ( int b = 0; b < LANES; b++ )
+      s[ b ] = _mm_xor_si128( _mm_loadu_si128( (__m128i const *) ( in + ( n + b ) * BLOCK_SIZE ) ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ ) {
+      for ( int b = 0; b < LANES; b++ )
+        s[ b ] = _mm_aesdec_si128( s[ b ], rk[ i ] );
+    }
+    for ( int b = 0; b < LANES; b++ )
+      _mm_storeu_si128( (__m128i *) ( out + ( n + b ) * BLOCK_SIZE ), _mm_aesdeclast_si128( s[ b ], rk[ ROUNDS ] ) );
+  }
+
+  for ( ; n < nblocks; n++ ) {
+    __m128i s = _mm_xor_si128( _mm_loadu_si128( (__m128i const *) ( in + n * BLOCK_SIZE ) ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ )
+      s = _mm_aesdec_si128( s, rk[ i ] );
+    _mm_storeu_si128( (__m128i *) ( out + n * BLOCK_SIZE ), _mm_aesdeclast_si128( s, rk[ ROUNDS ] ) );
+  }
+}
+
+/** Instruction set extensions the wide functions are compiled for. */
+#define VAES_TARGET __attribute__(( target( "aes,sse4.1,avx512f,vaes" ) ))
+
+/** Number of blocks in a 512-bit register. */
+#define WIDE_BLOCKS 4
+
+/** Number of 512-bit registers kept in flight at once. */
+#define WIDE_LANES 4
+
+/** Fewest blocks worth broadcasting the subkeys into 512-bit registers for; below about 1 KB AES-NI is as fast. */
+#define WIDE_MIN_BLOCKS 64
+
+/**
+   Encrypt a sequence of blocks with the 512-bit VAESENC, which does a round on four blocks at once. WIDE_LANES
+   registers go through each round together, and whatever is left over is finished by aesniEncrypt().
+   @param ctx the context holding the expanded key.
+   @param in the blocks to encrypt.
+   @param out where the encrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+VAES_TARGET static void vaesEncryptWide( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  __m512i rk[ ROUNDS + 1 ];
+  for ( int i = 0; i <= ROUNDS; i++ )
+    rk[ i ] = _mm512_broadcast_i32x4( _mm_loadu_si128( (__m128i const *) ctx->subkey[ i ] ) );
+
+  size_t n = 0;
+  for ( ; n + WIDE_LANES * WIDE_BLOCKS <= nblocks; n += WIDE_LANES * WIDE_BLOCKS ) {
+    __m512i s[ WIDE_LANES ];
+    for ( int b = 0; b < WIDE_LANES; b++ )
+      s[ b ] = _mm512_xor_si512( _mm512_loadu_si512( in + ( n + b * WIDE_BLOCKS ) * BLOCK_SIZE ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ ) {
+      for ( int b = 0; b < WIDE_LANES; b++ )
+        s[ b ] = _mm512_aesenc_epi128( s[ b ], rk[ i ] );
+    }
+    for ( int b = 0; b < WIDE_LANES; b++ )
+      _mm512_storeu_si512( out + ( n + b * WIDE_BLOCKS ) * BLOCK_SIZE, _mm512_aesenclast_epi128( s[ b ], rk[ ROUNDS ] ) );
+  }
+
+  for ( ; n + WIDE_BLOCKS <= nblocks; n += WIDE_BLOCKS ) {
+    __m512i s = _mm512_xor_si512( _mm512_loadu_si512( in + n * BLOCK_SIZE ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ )
+      s = _mm512_aesenc_epi128( s, rk[ i ] );
+    _mm512_storeu_si512( out + n * BLOCK_SIZE, _mm512_aesenclast_epi128( s, rk[ ROUNDS ] ) );
+  }
+
+  aesniEncrypt( ctx, in + n * BLOCK_SIZE, out + n * BLOCK_SIZE, nblocks - n );
+}
+
+/**
+   Decrypt a sequence of blocks with the 512-bit VAESDEC, four blocks per instruction, the same way as
+   vaesEncryptWide().
+   @param ctx the context holding the expanded key.
+   @param in the blocks to decrypt.
+   @param out where the decrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+VAES_TARGET static void vaesDecryptWide( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  __m512i rk[ ROUNDS + 1 ];
+  for ( int i = 0; i <= ROUNDS; i++ )
+    rk[ i ] = _mm512_broadcast_i32x4( _mm_loadu_si128( (__m128i const *) ctx->invSubkey[ i ] ) );
+
+  size_t n = 0;
+  for ( ; n + WIDE_LANES * WIDE_BLOCKS <= nblocks; n += WIDE_LANES * WIDE_BLOCKS ) {
+    __m512i s[ WIDE_LANES ];
+    for ( int b = 0; b < WIDE_LANES; b++ )
+      s[ b ] = _mm512_xor_si512( _mm512_loadu_si512( in + ( n + b * WIDE_BLOCKS ) * BLOCK_SIZE ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ ) {
+      for ( int b = 0; b < WIDE_LANES; b++ )
+        s[ b ] = _mm512_aesdec_epi128( s[ b ], rk[ i ] );
+    }
+    for ( int b = 0; b < WIDE_LANES; b++ )
+      _mm512_storeu_si512( out + ( n + b * WIDE_BLOCKS ) * BLOCK_SIZE, _mm512_aesdeclast_epi128( s[ b ], rk[ ROUNDS ] ) );
+  }
+
+  for ( ; n + WIDE_BLOCKS <= nblocks; n += WIDE_BLOCKS ) {
+    __m512i s = _mm512_xor_si512( _mm512_loadu_si512( in + n * BLOCK_SIZE ), rk[ 0 ] );
+    for ( int i = 1; i < ROUNDS; i++ )
+      s = _mm512_aesdec_epi128( s, rk[ i ] );
+    _mm512_storeu_si512( out + n * BLOCK_SIZE, _mm512_aesdeclast_epi128( s, rk[ ROUNDS ] ) );
+  }
+
+  aesniDecrypt( ctx, in + n * BLOCK_SIZE, out + n * BLOCK_SIZE, nblocks - n );
+}
+
+/**
+   Encrypt a sequence of blocks with the wide engine. Setting up the 512-bit subkeys costs more than a few blocks take
+   with AES-NI, and callers like CBC encryption pass one block at a time, so short runs go to aesniEncrypt() before
+   any 512-bit register is touched. This function isn't compiled for VAES, so none of that code can be hoisted into it.
+   @param ctx the context holding the expanded key.
+   @param in the blocks to encrypt.
+   @param out where the encrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+static void vaesEncrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  if ( nblocks < WIDE_MIN_BLOCKS )
+    aesniEncrypt( ctx, in, out, nblocks );
+  else
+    vaesEncryptWide( ctx, in, out, nblocks );
+}
+
+/**
+   Decrypt a sequence of blocks with the wide engine, sending short runs to aesniDecrypt() as vaesEncrypt() does.
+   @param ctx the context holding the expanded key.
+   @param in the blocks to decrypt.
+   @param out where the decrypted blocks go.
+   @param nblocks the number of blocks.
+*/
+static void vaesDecrypt( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  if ( nblocks < WIDE_MIN_BLOCKS )
+    aesniDecrypt( ctx, in, out, nblocks );
+  else
+    vaesDecryptWide( ctx, in, out, nblocks );
+}
+
+/**
+   The engine needs the AES instructions, plus SSE4.1 for the way the key schedule is compiled.
+   @return true if this host has them.
+*/
+static bool aesniSupported( void )
+{
+  return cpuHas( CPU_AESNI ) && cpuHas( CPU_SSE41 );
+}
+
+/**
+   The wide engine needs the AES-NI engine for its key schedule and leftover blocks, plus VAES and the 512-bit
+   registers.
+   @return true if this host has them.
+*/
+static bool vaesSupported( void )
+{
+  return aesniSupported() && cpuHas( CPU_VAES ) && cpuHas( CPU_AVX512F );
+}
+
+#else
+
+/**
+   There are no AES instructions off x86.
+   @return false.
+*/
+static bool aesniSupported( void )
+{
+  return false;
+}
+
+/** Never called, since the engine is never supported here. */
+#define aesniExpandKey NULL
+
+/** Never called, since the engine is never supported here. */
+#define aesniEncrypt NULL
+
+/** Never called, since the engine is never supported here. */
+#define aesniDecrypt NULL
+
+/**
+   There are no vector AES instructions off x86 either.
+   @return false.
+*/
+static bool vaesSupported( void )
+{
+  return false;
+}
+
+/** Never called, since the engine is never supported here. */
+#define vaesEncrypt NULL
+
+/** Never called, since the engine is never supported here. */
+#define vaesDecrypt NULL
+
+#endif
+
+AesEngine const aesniEngine = { "aesni", aesniSupported, aesniExpandKey, aesniEncrypt, aesniDecrypt };
+
+AesEngine const vaesEngine = { "vaes", vaesSupported, aesniExpandKey, vaesEncrypt, vaesDecrypt };
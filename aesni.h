@@ -0,0 +1,20 @@
+/**
+ * @file aesni.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for aesni.c, the engine that uses the processor's AES instructions.
+*/
+
+/** Macro used for unit testing */
+#ifndef _AESNI_H_
+/** Macro used for unit testing */
+#define _AESNI_H_
+
+#include "aes.h"
+
+/** The AES-NI engine, for the dispatch table in aes.c. It's only supported on x86 processors with AES instructions. */
+extern AesEngine const aesniEngine;
+
+/** The wide engine, for processors that also have VAES and AVX-512. It uses the same subkeys as the AES-NI engine. */
+extern AesEngine const vaesEngine;
+
+#endif
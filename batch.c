@@ -0,0 +1,448 @@
+/**
+ * @file batch.c
+ * @author Jimin Yu, jyu34
+ * This file runs a manifest of encrypt or decrypt jobs in one process. Starting a process, reading the key file and
+ * expanding the key cost far more than encrypting a small file, so the keys are read and expanded once each and
+ * cached by their contents, and the files are read whole into buffers each thread reuses.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+#include "aes.h"
+#include "io.h"
+#include "modes.h"
+#include "parallel.h"
+#include "stats.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Most names on one line of the manifest: the key, the input, the output and the IV. */
+#define MANIFEST_FIELDS 4
+
+/** Starting size of the hash tables; they double whenever they're half full. */
+#define TABLE_START 64
+
+/** FNV-1a offset basis, the starting value of the hash. */
+#define FNV_OFFSET 2166136261u
+
+/** FNV-1a prime, multiplied in after each byte. */
+#define FNV_PRIME 16777619u
+
+/** One job from the manifest. */
+typedef struct {
+  /** Name of the file to read. */
+  char const *inputFile;
+
+  /** Name of the file to write. */
+  char const *outputFile;
+
+  /** Name of the IV file, or NULL in ecb mode. */
+  char const *ivFile;
+
+  /** Index of the job's expanded key in the key cache. */
+  int key;
+} BatchJob;
+
+/** One entry in a hash table, mapping a name or a key to a number. */
+typedef struct {
+  /** The file name, for the table of key file names. */
+  char const *name;
+
+  /** The key's contents, for the table of keys. */
+  byte key[ BLOCK_SIZE ];
+
+  /** The number stored for this entry; -1 for an empty slot. */
+  int value;
+} TableEntry;
+
+/** A hash table with open addressing. */
+typedef struct {
+  /** The slots, a power of two of them. */
+  TableEntry *slots;
+
+  /** Number of slots. */
+  size_t size;
+
+  /** Number of slots in use. */
+  size_t used;
+} Table;
+
+/** Buffers one thread reuses from job to job. */
+typedef struct {
+  /** The file being processed. */
+  byte *data;
+
+  /** Size of data. */
+  size_t capacity;
+
+  /** The IV file. */
+  byte *iv;
+
+  /** Size of iv. */
+  size_t ivCapacity;
+} WorkerBuffers;
+
+/** Everything the threads share. */
+typedef struct {
+  /** The parsed command line. */
+  Options const *opts;
+
+  /** Whether to encrypt or decrypt. */
+  Direction dir;
+
+  /** The jobs. */
+  BatchJob *jobs;
+
+  /** The distinct expanded keys, indexed by BatchJob.key. */
+  AesContext *keys;
+
+  /** One set of buffers for each thread. */
+  WorkerBuffers *buffers;
+
+  /** Set by any job that fails. */
+  bool failed;
+} Batch;
+
+/**
+   Hash some bytes with FNV-1a.
+   @param data the bytes.
+   @param len the number of bytes.
+   @return the hash.
+*/
+static size_t hashBytes( void const *data, size_t len )
+{
+  byte const *p = data;
+  uint32_t h = FNV_OFFSET;
+  for ( size_t i = 0; i < len; i++ )
+    h = ( h ^ p[ i ] ) * FNV_PRIME;
+  return h;
+}
+
+/**
+   Set up an empty table.
+   @param table the table.
+   @param size the number of slots, a power of two.
+*/
+static void tableInit( Table *table, size_t size )
+{
+  table->slots = malloc( size * sizeof( TableEntry ) );
+  table->size = size;
+  table->used = 0;
+  for ( size_t i = 0; i < size; i++ )
+    table->slots[ i ].value = -1;
+}
+
+/**
+   Find the slot for a name or a key: the one holding it, or the empty one where it belongs.
+   @param table the table.
+   @param name the name to look for, or NULL to look for key.
+   @param key the key to look for, when name is NULL.
+   @return the slot.
+*/
+static TableEntry *tableFind( Table const *table, char const *name, byte const *key )
+{
+  size_t h = name ? hashBytes( name, strlen( name ) ) : hashBytes( key, BLOCK_SIZE );
+  for ( size_t i = h & ( table->size - 1 ); ; i = ( i + 1 ) & ( table->size - 1 ) ) {
+    TableEntry *slot = &table->slots[ i ];
+    if ( slot->value < 0 )
+      return slot;
+    if ( name ? strcmp( slot->name, name ) == 0 : memcmp( slot->key, key, BLOCK_SIZE ) == 0 )
+      return slot;
+  }
+}
+
+/**
+   Fill in an empty slot, doubling the table first if it's half full.
+   @param table the table.
+   @param slot the empty slot returned by tableFind().
+   @param name the name, or NULL when storing a key.
+   @param key the key, when name is NULL.
+   @param value the number to store.
+*/
+static void tableAdd( Table *table, TableEntry *slot, char const *name, byte const *key, int value )
+{
+  if ( ( table->used + 1 ) * 2 > table->size ) {
+    Table bigger;
+    tableInit( &bigger, table->size * 2 );
+    for ( size_t i = 0; i < table->size; i++ ) {
+      TableEntry *old = &table->slots[ i ];
+      if ( old->value >= 0 ) {
+        *tableFind( &bigger, old->name, old->key ) = *old;
+        bigger.used++;
+      }
+    }
+    free( table->slots );
+    *table = bigger;
+    slot = tableFind( table, name, key );
+  }
+
+  slot->name = name;
+  if ( key )
+    memcpy( slot->key, key, BLOCK_SIZE );
+  slot->value = value;
+  table->used++;
+}
+
+/**
+   Report a bad line in the manifest and exit.
+   @param manifest name of the manifest.
+   @param line the line number.
+*/
+static void badManifest( char const *manifest, int line )
+{
+  fprintf( stderr, "Bad manifest line %d: %s\n", line, manifest );
+  exit( EXIT_FAILURE );
+}
+
+/**
+   Split the manifest into jobs. The names point into text, which has the separators replaced with NUL bytes.
+   @param text the contents of the manifest, NUL-terminated.
+   @param opts the parsed command line.
+   @param keyFiles filled in with the key file name of each job.
+   @param count filled in with the number of jobs.
+   @return the jobs, with their keys not filled in yet.
+*/
+static BatchJob *parseManifest( char *text, Options const *opts, char const ***keyFiles, size_t *count )
+{
+  size_t capacity = TABLE_START;
+  BatchJob *jobs = malloc( capacity * sizeof( BatchJob ) );
+  *keyFiles = malloc( capacity * sizeof( char const * ) );
+  *count = 0;
+
+  int want = opts->mode == MODE_ECB ? MANIFEST_FIELDS - 1 : MANIFEST_FIELDS;
+  int lineNo = 0;
+  for ( char *line = text; line; ) {
+    char *next = strchr( line, '\n' );
+    if ( next )
+      *next++ = '\0';
+    lineNo++;
+
+    char *fields[ MANIFEST_FIELDS ];
+    int nfields = 0;
+    for ( char *p = line; *p; ) {
+      while ( isspace( (unsigned char) *p ) )
+        *p++ = '\0';
+      if ( !*p || *p == '#' )
+        break;
+      if ( nfields == MANIFEST_FIELDS )
+        badManifest( opts->batchFile, lineNo );
+      fields[ nfields++ ] = p;
+      while ( *p && !isspace( (unsigned char) *p ) )
+        p++;
+    }
+    line = next;
+    if ( nfields == 0 )
+      continue;
+    if ( nfields != want )
+      badManifest( opts->batchFile, lineNo );
+
+    if ( *count == capacity ) {
+      capacity *= 2;
+      jobs = realloc( jobs, capacity * sizeof( BatchJob ) );
+      *keyFiles = realloc( *keyFiles, capacity * sizeof( char const * ) );
+    }
+    BatchJob *job = &jobs[ *count ];
+    ( *keyFiles )[ *count ] = fields[ 0 ];
+    job->inputFile = fields[ 1 ];
+    job->outputFile = fields[ 2 ];
+    job->ivFile = nfields == MANIFEST_FIELDS ? fields[ MANIFEST_FIELDS - 1 ] : NULL;
+    ( *count )++;
+  }
+  return jobs;
+}
+
+/**
+   Read and expand the key for every job, once for each key file name and once for each distinct key.
+   @param jobs the jobs, whose key fields are filled in.
+   @param keyFiles the key file name of each job.
+   @param count the number of jobs.
+   @param keyCount filled in with the number of distinct keys.
+   @return the expanded keys.
+*/
+static AesContext *loadKeys( BatchJob *jobs, char const **keyFiles, size_t count, int *keyCount )
+{
+  Table names, keys;
+  tableInit( &names, TABLE_START );
+  tableInit( &keys, TABLE_START );
+  size_t capacity = TABLE_START;
+  AesContext *contexts = malloc( capacity * sizeof( AesContext ) );
+  *keyCount = 0;
+
+  for ( size_t i = 0; i < count; i++ ) {
+    TableEntry *named = tableFind( &names, keyFiles[ i ], NULL );
+    if ( named->value < 0 ) {
+      size_t size = 0;
+      byte *key = readBinaryFile( keyFiles[ i ], &size );
+      if ( size != BLOCK_SIZE ) {
+        fprintf( stderr, "Bad key file: %s\n", keyFiles[ i ] );
+        exit( EXIT_FAILURE );
+      }
+
+      // Different files can hold the same key; it's only expanded the first time.
+      TableEntry *known = tableFind( &keys, NULL, key );
+      int index = known->value;
+      if ( index < 0 ) {
+        if ( (size_t) *keyCount == capacity ) {
+          capacity *= 2;
+          contexts = realloc( contexts, capacity * sizeof( AesContext ) );
+        }
+        index = ( *keyCount )++;
+        aesInitCtx( &contexts[ index ], key );
+        tableAdd( &keys, known, NULL, key, index );
+      }
+      free( key );
+      tableAdd( &names, named, keyFiles[ i ], NULL, index );
+      named = tableFind( &names, keyFiles[ i ], NULL );
+    }
+    jobs[ i ].key = named->value;
+  }
+
+  free( names.slots );
+  free( keys.slots );
+  return contexts;
+}
+
+/**
+   Report a failed job, without stopping the others.
+   @param batch the batch.
+   @param message what went wrong.
+   @param filename the file it went wrong with.
+*/
+static void jobFailed( Batch *batch, char const *message, char const *filename )
+{
+  fprintf( stderr, "%s: %s\n", message, filename );
+  __atomic_store_n( &batch->failed, true, __ATOMIC_RELAXED );
+}
+
+/**
+   Encrypt or decrypt a file held in memory, in place, in whichever mode the options ask for.
+   @param batch the batch.
+   @param ctx the job's expanded key.
+   @param iv the IV, or NULL in ecb mode.
+   @param data the file, with room for a tag past it.
+   @param size the size of the file, updated to the size of the output.
+   @return a message saying what went wrong, or NULL on success.
+*/
+static char const *cryptFile( Batch *batch, AesContext const *ctx, byte *iv, byte *data, size_t *size )
+{
+  CipherMode mode = batch->opts->mode;
+  bool encrypt = batch->dir == ENCRYPT;
+  if ( ( mode == MODE_ECB || mode == MODE_CBC ) && *size % BLOCK_SIZE != 0 )
+    return encrypt ? "Bad plaintext file length" : "Bad ciphertext file length";
+
+  if ( mode == MODE_ECB && encrypt )
+    encryptBlocks( ctx, data, data, *size / BLOCK_SIZE );
+  else if ( mode == MODE_ECB )
+    decryptBlocks( ctx, data, data, *size / BLOCK_SIZE );
+  else if ( mode == MODE_CBC && encrypt ) {
+    CbcStream stream = { data, data, *size / BLOCK_SIZE };
+    memcpy( stream.iv, iv, BLOCK_SIZE );
+    cbcEncryptStreams( ctx, &stream, 1 );
+  } else if ( mode == MODE_CBC )
+    parallelCbcDecrypt( NULL, ctx, iv, data, data, *size / BLOCK_SIZE );
+  else if ( mode == MODE_CTR )
+    parallelCtrCrypt( NULL, ctx, iv, 0, data, data, *size );
+  else {
+    GcmContext gcm;
+    gcmInit( &gcm, ctx, iv );
+    if ( encrypt ) {
+      if ( !gcmEncrypt( &gcm, NULL, data, data, *size ) )
+        return "Bad plaintext file length";
+      gcmFinal( &gcm, data + *size );
+      *size += GCM_TAG_SIZE;
+    } else {
+      if ( *size < GCM_TAG_SIZE )
+        return "Bad ciphertext file length";
+      *size -= GCM_TAG_SIZE;
+      if ( !gcmDecrypt( &gcm, NULL, data, data, *size ) )
+        return "Bad ciphertext file length";
+      if ( !gcmCheckTag( &gcm, data + *size ) )
+        return "Authentication failed";
+    }
+  }
+  return NULL;
+}
+
+/**
+   Run one job: read the input and IV, run the cipher and write the output.
+   @param arg the Batch.
+   @param index which job.
+   @param worker which thread is running it, to pick its buffers.
+*/
+static void runJob( void *arg, size_t index, int worker )
+{
+  Batch *batch = arg;
+  BatchJob const *job = &batch->jobs[ index ];
+  WorkerBuffers *buffers = &batch->buffers[ worker ];
+
+  byte *iv = NULL;
+  if ( job->ivFile ) {
+    size_t ivSize = 0;
+    size_t want = batch->opts->mode == MODE_GCM ? GCM_IV_SIZE : BLOCK_SIZE;
+    char const *error = loadFile( job->ivFile, &buffers->iv, &buffers->ivCapacity, &ivSize );
+    if ( error || ivSize != want ) {
+      jobFailed( batch, error ? error : "Bad IV file", job->ivFile );
+      return;
+    }
+    iv = buffers->iv;
+  }
+
+  size_t size = 0;
+  char const *error = loadFile( job->inputFile, &buffers->data, &buffers->capacity, &size );
+  if ( error ) {
+    jobFailed( batch, error, job->inputFile );
+    return;
+  }
+
+  STATS_START( start );
+  size_t outSize = size;
+  error = cryptFile( batch, &batch->keys[ job->key ], iv, buffers->data, &outSize );
+  if ( error ) {
+    // Nothing has been written yet, so a job that fails here leaves whatever was at the output alone.
+    jobFailed( batch, error, job->inputFile );
+    return;
+  }
+  STATS_STOP( STAT_COMPUTE, start, size );
+
+  error = saveFile( job->outputFile, buffers->data, outSize );
+  if ( error )
+    jobFailed( batch, error, job->outputFile );
+}
+
+int runBatch( Options const *opts, Direction dir )
+{
+  size_t manifestSize = 0;
+  byte *contents = readBinaryFile( opts->batchFile, &manifestSize );
+  char *text = malloc( manifestSize + 1 );
+  memcpy( text, contents, manifestSize );
+  text[ manifestSize ] = '\0';
+  free( contents );
+
+  char const **keyFiles;
+  size_t count;
+  BatchJob *jobs = parseManifest( text, opts, &keyFiles, &count );
+  int keyCount;
+  AesContext *keys = loadKeys( jobs, keyFiles, count, &keyCount );
+  free( keyFiles );
+
+  // Every job is small, so one thread per job is the most that can help.
+  int threads = parallelThreadsFor( optionThreads( opts ), count, 1 );
+  WorkerPool *pool = poolCreate( threads );
+  STATS_THREADS( threads );
+  Batch batch = { opts, dir, jobs, keys, calloc( threads, sizeof( WorkerBuffers ) ), false };
+  parallelForEach( pool, count, runJob, &batch );
+  poolDestroy( pool );
+
+  for ( int i = 0; i < threads; i++ ) {
+    free( batch.buffers[ i ].data );
+    free( batch.buffers[ i ].iv );
+  }
+  free( batch.buffers );
+  free( keys );
+  free( jobs );
+  free( text );
+  return batch.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file batch.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for batch.c, which runs the encrypt and decrypt programs over a manifest of many small
+ * jobs in one process.
+*/
+
+/** Macro used for unit testing */
+#ifndef _BATCH_H_
+/** Macro used for unit testing */
+#define _BATCH_H_
+
+#include "cli.h"
+#include "tool.h"
+
+/**
+ * This function runs every job in the manifest named by opts->batchFile. Each line of the manifest names a key file,
+ * an input file and an output file, and for modes other than ecb an IV file after them, separated by spaces or tabs;
+ * blank lines and lines starting with # are skipped. Key files are read and expanded once for each distinct key, up
+ * front, and the jobs are then shared out across a work-stealing pool. A job that fails is reported on standard
+ * error and the rest still run.
+ * @param opts the parsed command line
+ * @param dir whether to encrypt or decrypt
+ * @return EXIT_SUCCESS if every job succeeded, EXIT_FAILURE otherwise
+*/
+int runBatch( Options const *opts, Direction dir );
+
+#endif
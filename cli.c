@@ -0,0 +1,215 @@
+/**
+ * @file cli.c
+ * @author Jimin Yu, jyu34
+ * This file contains the command-line parsing shared by the encrypt and decrypt programs.
+*/
+
+#include "cli.h"
+#include "container.h"
+#include "modes.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of file names expected after the options for one input and output pair. */
+#define FILE_ARGS 3
+
+/** Most file names that can be given: the key, then the pairs. */
+#define MAX_FILE_ARGS ( 1 + 2 * MAX_FILE_PAIRS )
+
+/** Largest XTS sector accepted; it has to fit in one chunk of a stream. */
+#define MAX_SECTOR ( 1024 * 1024 )
+
+/** Room for the offset part of a --range argument: 20 digits for any 64-bit number, and the null. */
+#define RANGE_DIGITS 21
+
+bool parseCount( char const *text, int *value )
+{
+  char *end;
+  long n = strtol( text, &end, 10 );
+  if ( end == text || *end != '\0' || n < 0 || n > 1 << 16 )
+    return false;
+  *value = n;
+  return true;
+}
+
+/**
+   Parse a byte count or position from an option argument.
+   @param text the argument.
+   @param value where to put the number.
+   @return true if text was a valid number.
+*/
+static bool parseSize( char const *text, uint64_t *value )
+{
+  char *end;
+  if ( *text == '-' )
+    return false;
+  unsigned long long n = strtoull( text, &end, 10 );
+  if ( end == text || *end != '\0' )
+    return false;
+  *value = n;
+  return true;
+}
+
+/**
+   Parse a byte range given as offset:length.
+   @param text the argument.
+   @param offset where to put the offset.
+   @param length where to put the length.
+   @return true if text was a valid range.
+*/
+static bool parseRange( char const *text, uint64_t *offset, uint64_t *length )
+{
+  char const *colon = strchr( text, ':' );
+  if ( !colon || colon - text >= RANGE_DIGITS )
+    return false;
+  char first[ RANGE_DIGITS ];
+  memcpy( first, text, colon - text );
+  first[ colon - text ] = '\0';
+  return parseSize( first, offset ) && parseSize( colon + 1, length );
+}
+
+bool parseMode( char const *text, CipherMode *mode )
+{
+  static char const *const names[] = { "ecb", "cbc", "ctr", "gcm", "xts" };
+  for ( int i = 0; i < sizeof( names ) / sizeof( names[ 0 ] ); i++ ) {
+    if ( strcmp( text, names[ i ] ) == 0 ) {
+      *mode = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool parseOptions( Options *opts, int argc, char *argv[] )
+{
+  memset( opts, 0, sizeof( Options ) );
+  opts->mode = MODE_ECB;
+  opts->length = UINT64_MAX;
+
+  char const *files[ MAX_FILE_ARGS ];
+  int nfiles = 0;
+  for ( int i = 1; i < argc; i++ ) {
+    char const *arg = argv[ i ];
+    if ( strcmp( arg, "-j" ) == 0 ) {
+      if ( ++i == argc )
+        return false;
+      if ( strcmp( argv[ i ], "auto" ) == 0 )
+        opts->threads = 0;
+      else if ( !parseCount( argv[ i ], &opts->threads ) )
+        return false;
+    } else if ( strcmp( arg, "--mode" ) == 0 ) {
+      if ( ++i == argc || !parseMode( argv[ i ], &opts->mode ) )
+        return false;
+    } else if ( strcmp( arg, "--iv" ) == 0 ) {
+      if ( ++i == argc )
+        return false;
+      opts->ivFile = argv[ i ];
+    } else if ( strcmp( arg, "--offset" ) == 0 ) {
+      if ( ++i == argc || !parseSize( argv[ i ], &opts->offset ) )
+        return false;
+    } else if ( strcmp( arg, "--length" ) == 0 ) {
+      if ( ++i == argc || !parseSize( argv[ i ], &opts->length ) )
+        return false;
+    } else if ( strcmp( arg, "--sector" ) == 0 ) {
+      uint64_t size;
+      if ( ++i == argc || !parseSize( argv[ i ], &size ) || size < BLOCK_SIZE || size > MAX_SECTOR )
+        return false;
+      opts->sectorSize = size;
+    } else if ( strcmp( arg, "--range" ) == 0 ) {
+      if ( ++i == argc || !parseRange( argv[ i ], &opts->offset, &opts->length ) )
+        return false;
+    } else if ( strcmp( arg, "--container" ) == 0 ) {
+      opts->container = true;
+    } else if ( strcmp( arg, "--compress" ) == 0 ) {
+      opts->compress = true;
+    } else if ( strcmp( arg, "--chunk" ) == 0 ) {
+      uint64_t size;
+      if ( ++i == argc || !parseSize( argv[ i ], &size ) || size < CONTAINER_MIN_CHUNK || size > CONTAINER_MAX_CHUNK )
+        return false;
+      opts->chunkSize = size;
+    } else if ( strcmp( arg, "--mmap" ) == 0 ) {
+      opts->mapFiles = true;
+    } else if ( strcmp( arg, "--batch" ) == 0 ) {
+      if ( ++i == argc )
+        return false;
+      opts->batchFile = argv[ i ];
+    } else if ( strcmp( arg, "--io" ) == 0 ) {
+      if ( ++i == argc || ( strcmp( argv[ i ], "stdio" ) != 0 && strcmp( argv[ i ], "uring" ) != 0 ) )
+        return false;
+      opts->uring = strcmp( argv[ i ], "uring" ) == 0;
+    } else if ( strcmp( arg, "--stats" ) == 0 ) {
+      opts->stats = true;
+    } else if ( strcmp( arg, "--in-place" ) == 0 ) {
+      opts->inPlace = true;
+      opts->mapFiles = true;
+    } else if ( strncmp( arg, "-j", 2 ) == 0 ) {
+      if ( !parseCount( arg + 2, &opts->threads ) )
+        return false;
+    } else {
+      if ( nfiles == MAX_FILE_ARGS )
+        return false;
+      files[ nfiles++ ] = arg;
+    }
+  }
+
+  // Only XTS has sectors.
+  if ( opts->sectorSize && opts->mode != MODE_XTS )
+    return false;
+  if ( !opts->sectorSize )
+    opts->sectorSize = XTS_SECTOR;
+
+  // Only a container has chunks. It has its own nonces and tags, so it takes no mode or IV, and it's streamed.
+  if ( ( opts->chunkSize || opts->compress ) && !opts->container )
+    return false;
+  if ( !opts->chunkSize )
+    opts->chunkSize = CONTAINER_CHUNK;
+  if ( opts->container && ( opts->mode != MODE_ECB || opts->ivFile || opts->mapFiles ) )
+    return false;
+
+  // A manifest names all the files, including the IVs, and has no room for XTS's double-length keys.
+  if ( opts->batchFile )
+    return nfiles == 0 && !opts->ivFile && !opts->mapFiles && !opts->offset && opts->length == UINT64_MAX &&
+           opts->mode != MODE_XTS && !opts->container;
+
+  // In place, the one file is both the input and the output.
+  if ( opts->inPlace && nfiles == FILE_ARGS - 1 )
+    files[ nfiles++ ] = files[ 1 ];
+  if ( nfiles < FILE_ARGS || nfiles % 2 != 1 )
+    return false;
+
+  // Extra pairs can't share one file or one range of the input.
+  opts->filePairs = nfiles / 2;
+  if ( opts->filePairs > 1 && ( opts->inPlace || opts->offset || opts->length != UINT64_MAX ) )
+    return false;
+
+  // Chained and counter-based modes need an IV; XTS tweaks each sector by its number instead. Only counter mode, XTS
+  // and containers can start partway into the input, and XTS only on a sector boundary.
+  bool needsIv = opts->mode != MODE_ECB && opts->mode != MODE_XTS;
+  if ( needsIv != ( opts->ivFile != NULL ) )
+    return false;
+  bool ranged = opts->offset || opts->length != UINT64_MAX;
+  if ( ranged && opts->mode != MODE_CTR && opts->mode != MODE_XTS && !opts->container )
+    return false;
+  if ( opts->mode == MODE_XTS && ( opts->offset % opts->sectorSize ||
+                                   ( opts->length != UINT64_MAX && opts->length % opts->sectorSize ) ) )
+    return false;
+
+  // GCM adds a tag to the end of the ciphertext, so the output can't overwrite the input.
+  if ( opts->mode == MODE_GCM && opts->inPlace )
+    return false;
+
+  opts->keyFile = files[ 0 ];
+  for ( int i = 0; i < opts->filePairs; i++ ) {
+    opts->inputFiles[ i ] = files[ 1 + 2 * i ];
+    opts->outputFiles[ i ] = files[ 2 + 2 * i ];
+  }
+  opts->inputFile = opts->inputFiles[ 0 ];
+  opts->outputFile = opts->outputFiles[ 0 ];
+  return true;
+}
+
+int optionThreads( Options const *opts )
+{
+  return opts->threads > 0 ? opts->threads : parallelCpuCount();
+}
@@ -0,0 +1,140 @@
+/**
+ * @file cli.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for cli.c. It contains the options shared by the encrypt and decrypt programs and the function
+ * that parses them.
+*/
+
+/** Macro used for unit testing */
+#ifndef _CLI_H_
+/** Macro used for unit testing */
+#define _CLI_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Most input and output file pairs that can be given on one command line. */
+#define MAX_FILE_PAIRS 16
+
+/** Block cipher modes the tools support. */
+typedef enum {
+  MODE_ECB,
+  MODE_CBC,
+  MODE_CTR,
+  MODE_GCM,
+  MODE_XTS
+} CipherMode;
+
+/** Options and file names given on the command line. */
+typedef struct {
+  /** Block cipher mode, from --mode; ECB unless given. */
+  CipherMode mode;
+
+  /** Name of the file holding the IV or initial counter block, from --iv; NULL if none was given. */
+  char const *ivFile;
+
+  /** Position in the input to start at, from --offset or --range (CTR, XTS and containers only). */
+  uint64_t offset;
+
+  /** Most bytes of input to process, from --length or --range (CTR, XTS and containers only); UINT64_MAX for all. */
+  uint64_t length;
+
+  /** Bytes in an XTS sector, from --sector (XTS only); XTS_SECTOR unless given. */
+  size_t sectorSize;
+
+  /** True to write or read the chunked container format instead of a bare mode, from --container. */
+  bool container;
+
+  /** Bytes of plaintext in each chunk of a container written, from --chunk; CONTAINER_CHUNK unless given. */
+  size_t chunkSize;
+
+  /** True to compress each chunk of a container before encrypting it, from --compress. */
+  bool compress;
+
+  /** Number of threads to use, from -j; 0 means one per processor. */
+  int threads;
+
+  /** True to memory-map the input and output files instead of streaming them, from --mmap. */
+  bool mapFiles;
+
+  /** True to encrypt or decrypt the input file in place, from --in-place; implies mapFiles. */
+  bool inPlace;
+
+  /** True to stream through io_uring instead of the reader and writer threads, from --io uring. */
+  bool uring;
+
+  /** True to report where the time went on standard error at the end, from --stats. */
+  bool stats;
+
+  /** Name of the manifest of jobs to run, from --batch; NULL if none was given. */
+  char const *batchFile;
+
+  /** Name of the file holding the key. */
+  char const *keyFile;
+
+  /** Name of the file to read. */
+  char const *inputFile;
+
+  /** Name of the file to write; the same as inputFile for --in-place. */
+  char const *outputFile;
+
+  /** Number of input and output file pairs given, at least 1. */
+  int filePairs;
+
+  /** Names of all the files to read; the first is inputFile. */
+  char const *inputFiles[ MAX_FILE_PAIRS ];
+
+  /** Names of all the files to write, one for each input; the first is outputFile. */
+  char const *outputFiles[ MAX_FILE_PAIRS ];
+} Options;
+
+/**
+ * This function parses the command line for the encrypt and decrypt programs:
+ *   [options] <key-file> <input-file> <output-file> [<input-file> <output-file>]...
+ *   [options] --in-place <key-file> <file>
+ *   [options] --batch <manifest>
+ * -j N|auto gives the number of threads to use; the default, auto, uses one per processor. --mmap maps the input and
+ * output files into memory instead of streaming them, and --in-place maps a single file and overwrites it. --mode
+ * picks ecb (the default), cbc, ctr, gcm or xts, and --iv names the file with the IV or initial counter block cbc, ctr
+ * and gcm need, one after another for each file pair. In ctr and xts modes, --offset and --length select a byte range
+ * of the input to process on its own; for xts they have to be whole sectors, whose size --sector gives. gcm output
+ * is longer than its input, so it can't be used with --in-place. Up to MAX_FILE_PAIRS input and output files can be
+ * given, except with --in-place, --offset or --length. --stats asks for a report of the time spent reading, expanding
+ * keys, computing and writing. --io picks how streamed files are read and written: stdio (the default) or uring, which
+ * falls back to stdio where io_uring can't be used. --batch takes the key, input, output and IV files for each job
+ * from a manifest instead, so it can't be used with file names, --iv, --mmap, a byte range, xts or --container.
+ * --container writes or reads the chunked container format, in chunks of --chunk bytes, compressing each one first
+ * with --compress; it takes no --mode, --iv or --mmap, and on decrypt a byte range selects part of the plaintext.
+ * --range offset:length is short for --offset and --length together.
+ * @param opts the options to fill in
+ * @param argc the number of command line arguments
+ * @param argv the command line arguments
+ * @return true if the command line was valid, false if the caller should print a usage message
+*/
+bool parseOptions( Options *opts, int argc, char *argv[] );
+
+/**
+ * This function parses a non-negative count from an option argument, like the number given to -j.
+ * @param text the argument
+ * @param value where to put the count
+ * @return true if text was a valid count
+*/
+bool parseCount( char const *text, int *value );
+
+/**
+ * This function parses the name of a block cipher mode: ecb, cbc, ctr, gcm or xts.
+ * @param text the argument
+ * @param mode where to put the mode
+ * @return true if text named a mode
+*/
+bool parseMode( char const *text, CipherMode *mode );
+
+/**
+ * This function returns the number of threads the options ask for, with auto resolved to the number of processors.
+ * @param opts the parsed options
+ * @return the number of threads, at least 1
+*/
+int optionThreads( Options const *opts );
+
+#endif
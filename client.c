@@ -0,0 +1,116 @@
+/**
+ * @file client.c
+ * @author Jimin Yu, jyu34
+ * This file is the aesc program. It sends a whole file to aesd as one request and writes out the reply.
+*/
+
+#include "client.h"
+#include "aes.h"
+#include "io.h"
+#include "modes.h"
+#include "proto.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Number of names expected after the options: the direction, the key, the input and the output. */
+#define CLIENT_ARGS 4
+
+bool parseClientOptions( ClientOptions *opts, int argc, char *argv[] )
+{
+  opts->socketPath = defaultSocket();
+  opts->mode = MODE_ECB;
+  opts->ivFile = NULL;
+
+  int i = 1;
+  for ( ; i < argc && argv[ i ][ 0 ] == '-'; i++ ) {
+    if ( i + 1 == argc )
+      return false;
+    if ( strcmp( argv[ i ], "--socket" ) == 0 )
+      opts->socketPath = argv[ ++i ];
+    else if ( strcmp( argv[ i ], "--mode" ) == 0 ) {
+      // aesd's keys are single AES keys, so it has no xts.
+      if ( !parseMode( argv[ ++i ], &opts->mode ) || opts->mode == MODE_XTS )
+        return false;
+    } else if ( strcmp( argv[ i ], "--iv" ) == 0 )
+      opts->ivFile = argv[ ++i ];
+    else
+      return false;
+  }
+  if ( argc - i != CLIENT_ARGS )
+    return false;
+
+  if ( strcmp( argv[ i ], "encrypt" ) == 0 )
+    opts->dir = ENCRYPT;
+  else if ( strcmp( argv[ i ], "decrypt" ) == 0 )
+    opts->dir = DECRYPT;
+  else
+    return false;
+
+  int key;
+  if ( !parseCount( argv[ i + 1 ], &key ) )
+    return false;
+  opts->key = key;
+  opts->inputFile = argv[ i + 2 ];
+  opts->outputFile = argv[ i + 3 ];
+
+  // Every mode but ecb needs an IV, and ecb can't use one.
+  return ( opts->mode == MODE_ECB ) == ( opts->ivFile == NULL );
+}
+
+int runClient( ClientOptions const *opts )
+{
+  Request req = { opts->mode, opts->dir, opts->key, 0, 0, 0 };
+  if ( opts->ivFile ) {
+    size_t size;
+    byte *iv = readBinaryFile( opts->ivFile, &size );
+    req.ivLen = opts->mode == MODE_GCM ? GCM_IV_SIZE : BLOCK_SIZE;
+    if ( size != req.ivLen ) {
+      fprintf( stderr, "Bad IV file: %s\n", opts->ivFile );
+      exit( EXIT_FAILURE );
+    }
+    memcpy( req.iv, iv, size );
+    free( iv );
+  }
+
+  byte *data = NULL;
+  size_t capacity = 0, size;
+  char const *error = loadFile( opts->inputFile, &data, &capacity, &size );
+  if ( error ) {
+    fprintf( stderr, "%s: %s\n", error, opts->inputFile );
+    exit( EXIT_FAILURE );
+  }
+  if ( size > MAX_PAYLOAD ) {
+    fprintf( stderr, "Input too large for aesd: %s\n", opts->inputFile );
+    exit( EXIT_FAILURE );
+  }
+  req.length = size;
+
+  int fd = connectDaemon( opts->socketPath );
+  if ( fd < 0 ) {
+    fprintf( stderr, "Can't connect to aesd: %s: %s\n", opts->socketPath, strerror( errno ) );
+    exit( EXIT_FAILURE );
+  }
+
+  // The reply is read into the same buffer the request came from.
+  Reply reply;
+  if ( !sendRequest( fd, &req, data ) || !receiveReply( fd, &reply, &data, &capacity ) ) {
+    fprintf( stderr, "Lost connection to aesd: %s\n", opts->socketPath );
+    exit( EXIT_FAILURE );
+  }
+  close( fd );
+
+  if ( reply.status != REPLY_OK ) {
+    fprintf( stderr, "%s: %s\n", replyString( reply.status ), opts->inputFile );
+    exit( EXIT_FAILURE );
+  }
+  error = saveFile( opts->outputFile, data, reply.length );
+  if ( error ) {
+    fprintf( stderr, "%s: %s\n", error, opts->outputFile );
+    exit( EXIT_FAILURE );
+  }
+  free( data );
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file client.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for client.c, the aesc program, which sends a file to aesd to be encrypted or decrypted
+ * with one of the keys it already has.
+*/
+
+/** Macro used for unit testing */
+#ifndef _CLIENT_H_
+/** Macro used for unit testing */
+#define _CLIENT_H_
+
+#include "cli.h"
+#include "tool.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Options and file names given on aesc's command line. */
+typedef struct {
+  /** Name of aesd's socket, from --socket. */
+  char const *socketPath;
+
+  /** Block cipher mode, from --mode; ECB unless given. */
+  CipherMode mode;
+
+  /** Name of the file holding the IV or initial counter block, from --iv; NULL if none was given. */
+  char const *ivFile;
+
+  /** Whether to encrypt or decrypt. */
+  Direction dir;
+
+  /** Number of the key on aesd's command line, starting from 0. */
+  uint32_t key;
+
+  /** Name of the file to read. */
+  char const *inputFile;
+
+  /** Name of the file to write. */
+  char const *outputFile;
+} ClientOptions;
+
+/**
+ * This function parses aesc's command line:
+ *   [--socket <path>] [--mode M] [--iv <iv-file>] encrypt|decrypt <key-number> <input-file> <output-file>
+ * @param opts the options to fill in
+ * @param argc the number of command line arguments
+ * @param argv the command line arguments
+ * @return true if the command line was valid, false if the caller should print a usage message
+*/
+bool parseClientOptions( ClientOptions *opts, int argc, char *argv[] );
+
+/**
+ * This function reads the input file, has aesd encrypt or decrypt it, and writes what comes back to the output file.
+ * Errors, including ones aesd reports, go to standard error.
+ * @param opts the parsed command line
+ * @return the exit status for the program
+*/
+int runClient( ClientOptions const *opts );
+
+#endif
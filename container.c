@@ -0,0 +1,563 @@
+/**
+ * @file container.c
+ * @author Jimin Yu, jyu34
+ * This file reads and writes the chunked container format. Every number in it is little-endian:
+ *   header   "AMCF", version, flags, 2 reserved bytes, chunk size (4 bytes), 4 reserved bytes, salt (16 bytes)
+ *   records  for each chunk: the nonce (chunk number, 8 bytes, then 4 zero bytes), the ciphertext and the GCM tag
+ *   index    for each chunk: the record's position (8 bytes), plaintext length and stored length (4 bytes each)
+ *   trailer  index position, number of chunks, plaintext length (8 bytes each), the index's tag, "AMCFEND\0"
+ * Every chunk's tag covers the header as additional data, and the index's tag covers the header, the index and the
+ * first three fields of the trailer, so chunks can't be moved between containers or to other places in one.
+ * Nothing is encrypted under the key itself: each container has its own subkey, the random salt encrypted under the
+ * key, so nonces only have to be unique within a container and the chunk number is enough.
+ * With the compressed flag set, each chunk is compressed with lzCompress() before it's encrypted, unless that doesn't
+ * make it smaller; a chunk whose stored length is less than its plaintext length is a compressed one.
+*/
+
+#define _GNU_SOURCE
+
+#include "container.h"
+#include "io.h"
+#include "lz.h"
+#include "modes.h"
+#include "parallel.h"
+#include "stats.h"
+#include "stream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+
+/** Version of the format this file writes and reads. */
+#define CONTAINER_VERSION 2
+
+/** Bytes of each record besides the ciphertext: the nonce in front and the tag behind. */
+#define RECORD_OVERHEAD ( GCM_IV_SIZE + GCM_TAG_SIZE )
+
+/** Bytes in each index entry. */
+#define ENTRY_SIZE 16
+
+/** Bytes in the trailer. */
+#define TRAILER_SIZE 48
+
+/** Bytes of the trailer the index's tag covers, the fields before the tag itself. */
+#define TRAILER_AUTH 24
+
+/** Header flag for a container whose chunks may be compressed. */
+#define FLAG_COMPRESSED 0x01
+
+/** Chunk number reserved for the index's nonce, so no chunk can have it. */
+#define INDEX_NONCE 0xFFFFFFFFu
+
+/** Bytes in the salt the container's subkey is made from. */
+#define SALT_SIZE BLOCK_SIZE
+
+/** Message for any container that isn't laid out as it should be. */
+#define BAD_CONTAINER "Bad container file"
+
+/** Message for a chunk or an index whose tag doesn't match. */
+#define AUTH_FAILED "Authentication failed"
+
+/** Where the fields are in the header. */
+enum { HDR_MAGIC = 0, HDR_VERSION = 4, HDR_FLAGS = 5, HDR_CHUNK = 8, HDR_SALT = 16 };
+
+/** Where the fields are in the trailer. */
+enum { TRL_INDEX = 0, TRL_CHUNKS = 8, TRL_TOTAL = 16, TRL_TAG = 24, TRL_MAGIC = 40 };
+
+/** Where the fields are in an index entry. */
+enum { ENT_OFFSET = 0, ENT_PLAIN = 8, ENT_STORED = 12 };
+
+/** Magic number at the start of the header. */
+static char const headerMagic[] = "AMCF";
+
+/** Magic number at the end of the trailer, with its null terminator. */
+static char const trailerMagic[] = "AMCFEND";
+
+/** State for encrypting a stream into a container. */
+typedef struct {
+  /** The container's subkey. */
+  AesContext key;
+
+  /** GCM state with the hash key already worked out; each chunk starts from a copy. */
+  GcmContext gcm;
+
+  /** The header, which every chunk's tag covers. */
+  byte header[ CONTAINER_HEADER_SIZE ];
+
+  /** Bytes of plaintext in each chunk. */
+  size_t chunkSize;
+
+  /** True to compress each chunk before encrypting it. */
+  bool compress;
+
+  /** Threads to encrypt the chunks of each group across. */
+  WorkerPool *pool;
+
+  /** The plaintext of the group being encrypted. */
+  byte const *data;
+
+  /** Room for the group's records, a whole chunk and its nonce and tag for each, before they're packed together. */
+  byte *records;
+
+  /** Bytes of plaintext in the group. */
+  size_t groupLen;
+
+  /** Number of the group's first chunk. */
+  uint64_t firstChunk;
+
+  /** Index entries so far, and how many there's room for. */
+  ContainerEntry *index;
+  uint64_t chunks;
+  uint64_t capacity;
+
+  /** Position in the container of the next record. */
+  uint64_t outOffset;
+
+  /** Set if the input has more chunks than a container can hold. */
+  bool tooLarge;
+} Packer;
+
+/** State for decrypting a group of chunks from a container. */
+typedef struct {
+  /** The container. */
+  Container const *c;
+
+  /** GCM state with the hash key already worked out; each chunk starts from a copy. */
+  GcmContext gcm;
+
+  /** The records read from the container, starting with the group's first; compressed chunks are decrypted here. */
+  byte *records;
+
+  /** Where the plaintext goes, a whole chunk for each. */
+  byte *plain;
+
+  /** Number of the group's first chunk. */
+  uint64_t firstChunk;
+
+  /** Set if any chunk in the group failed to authenticate. */
+  bool failed;
+
+  /** Set if an authentic chunk didn't decompress, which only a broken encrypter could cause. */
+  bool corrupt;
+} Unpacker;
+
+/**
+   Store a number in little-endian order.
+   @param dest where the bytes go.
+   @param value the number.
+   @param bytes how many bytes to store it in.
+*/
+static void putLittle( byte *dest, uint64_t value, int bytes )
+{
+  for ( int i = 0; i < bytes; i++ )
+    dest[ i ] = ( byte ) ( value >> ( 8 * i ) );
+}
+
+/**
+   Load a number stored in little-endian order.
+   @param src the bytes.
+   @param bytes how many bytes it's stored in.
+   @return the number.
+*/
+static uint64_t getLittle( byte const *src, int bytes )
+{
+  uint64_t value = 0;
+  for ( int i = bytes - 1; i >= 0; i-- )
+    value = value << 8 | src[ i ];
+  return value;
+}
+
+/**
+   Make the nonce for a chunk, or for the index: just the chunk number, since the subkey is the container's own.
+   @param nonce where the nonce goes.
+   @param chunk the chunk number, or INDEX_NONCE.
+*/
+static void makeNonce( byte nonce[ GCM_IV_SIZE ], uint64_t chunk )
+{
+  memset( nonce, 0, GCM_IV_SIZE );
+  putLittle( nonce, chunk, sizeof( chunk ) );
+}
+
+/**
+   Work out a container's subkey by encrypting the salt in its header under the key.
+   @param sub the context to fill in with the subkey.
+   @param ctx the context holding the expanded key.
+   @param header the container's header, which holds the salt.
+*/
+static void deriveKey( AesContext *sub, AesContext const *ctx, byte const *header )
+{
+  byte key[ BLOCK_SIZE ];
+  encryptBlocks( ctx, header + HDR_SALT, key, 1 );
+  aesInitCtx( sub, key );
+  explicit_bzero( key, sizeof( key ) );
+}
+
+/**
+   Work out how many chunks to handle at a time: enough to fill a stream chunk, and at least one for each thread.
+   @param chunkSize bytes in each chunk.
+   @param threads the number of threads.
+   @return the number of chunks in a group.
+*/
+static size_t groupChunks( size_t chunkSize, int threads )
+{
+  size_t count = STREAM_CHUNK / chunkSize;
+  if ( count < ( size_t ) threads )
+    count = threads;
+  return count ? count : 1;
+}
+
+/**
+   Compute the index's tag over the header, the index and the start of the trailer, which have to be one after another
+   in auth, and check it or store it in the trailer.
+   @param ctx the context holding the container's subkey.
+   @param auth the header, the index and the trailer.
+   @param chunks the number of index entries.
+   @param check true to check the tag that's there, false to store it.
+   @return true if storing, or if the tag matched.
+*/
+static bool indexTag( AesContext const *ctx, byte *auth, uint64_t chunks, bool check )
+{
+  byte nonce[ GCM_IV_SIZE ];
+  makeNonce( nonce, INDEX_NONCE );
+  byte *trailer = auth + CONTAINER_HEADER_SIZE + chunks * ENTRY_SIZE;
+
+  GcmContext gcm;
+  gcmInit( &gcm, ctx, nonce );
+  gcmAad( &gcm, auth, trailer + TRAILER_AUTH - auth );
+  if ( check )
+    return gcmCheckTag( &gcm, trailer + TRL_TAG );
+  gcmFinal( &gcm, trailer + TRL_TAG );
+  return true;
+}
+
+/**
+   Compress one chunk of a group if that's asked for, encrypt it into its record, and fill in its index entry's
+   lengths. A thread compresses and encrypts its chunk in one go, while it's still in the cache, and the other threads
+   work on other chunks at the same time.
+   @param arg the Packer.
+   @param index which chunk of the group.
+   @param worker the thread running it.
+*/
+static void packChunk( void *arg, size_t index, int worker )
+{
+  Packer *p = arg;
+  byte const *plain = p->data + index * p->chunkSize;
+  byte *record = p->records + index * ( p->chunkSize + RECORD_OVERHEAD );
+  size_t len = p->groupLen - index * p->chunkSize < p->chunkSize ? p->groupLen - index * p->chunkSize : p->chunkSize;
+
+  // The compressed chunk is only kept if it's smaller; otherwise the chunk is stored as it is.
+  size_t stored = p->compress ? lzCompress( plain, len, record + GCM_IV_SIZE, len - 1 ) : 0;
+  byte const *source = stored ? record + GCM_IV_SIZE : plain;
+  if ( !stored )
+    stored = len;
+
+  makeNonce( record, p->firstChunk + index );
+  GcmContext gcm = p->gcm;
+  gcmRestart( &gcm, record );
+  gcmAad( &gcm, p->header, CONTAINER_HEADER_SIZE );
+  gcmEncrypt( &gcm, NULL, source, record + GCM_IV_SIZE, stored );
+  gcmFinal( &gcm, record + GCM_IV_SIZE + stored );
+
+  ContainerEntry *entry = &p->index[ p->chunks + index ];
+  entry->plainLen = len;
+  entry->storedLen = stored;
+}
+
+/**
+   Encrypt a group of chunks from the stream into records, pack the records over the plaintext, and add them to the
+   index.
+   @param arg the Packer.
+   @param data the plaintext, with room for a nonce and a tag for each chunk past its length.
+   @param len the length of the plaintext, set to the length of the records.
+   @param offset position of the group in the input.
+   @param last true for the last group.
+   @return false if the input has too many chunks.
+*/
+static bool packGroup( void *arg, byte *data, size_t *len, uint64_t offset, bool last )
+{
+  Packer *p = arg;
+  size_t count = ( *len + p->chunkSize - 1 ) / p->chunkSize;
+  p->firstChunk = offset / p->chunkSize;
+  if ( p->firstChunk + count >= INDEX_NONCE ) {
+    p->tooLarge = true;
+    return false;
+  }
+  if ( p->chunks + count > p->capacity ) {
+    p->capacity = ( p->chunks + count ) * 2;
+    p->index = realloc( p->index, p->capacity * sizeof( ContainerEntry ) );
+  }
+
+  STATS_START( start );
+  p->data = data;
+  p->groupLen = *len;
+  parallelForEach( p->pool, count, packChunk, p );
+
+  // The records are no bigger than the plaintext and its nonces and tags, so they fit back in the buffer.
+  size_t packed = 0;
+  for ( size_t i = 0; i < count; i++ ) {
+    ContainerEntry *entry = &p->index[ p->chunks++ ];
+    size_t recordLen = entry->storedLen + RECORD_OVERHEAD;
+    memcpy( data + packed, p->records + i * ( p->chunkSize + RECORD_OVERHEAD ), recordLen );
+    entry->offset = p->outOffset;
+    p->outOffset += recordLen;
+    packed += recordLen;
+  }
+  STATS_STOP( STAT_COMPUTE, start, *len );
+
+  *len = packed;
+  return true;
+}
+
+char const *packStream( FILE *in, char const *inName, FILE *out, char const *outName, AesContext const *ctx,
+                        size_t chunkSize, bool compress, uint64_t limit, int threads, bool uring )
+{
+  Packer p;
+  memset( &p, 0, sizeof( p ) );
+  p.chunkSize = chunkSize;
+  p.compress = compress;
+  p.outOffset = CONTAINER_HEADER_SIZE;
+
+  memcpy( p.header + HDR_MAGIC, headerMagic, HDR_VERSION );
+  p.header[ HDR_VERSION ] = CONTAINER_VERSION;
+  p.header[ HDR_FLAGS ] = compress ? FLAG_COMPRESSED : 0;
+  putLittle( p.header + HDR_CHUNK, chunkSize, 4 );
+
+  // A fresh salt gives the container a subkey no other container shares, even with the same key.
+  if ( getrandom( p.header + HDR_SALT, SALT_SIZE, 0 ) != SALT_SIZE ) {
+    fprintf( stderr, "Can't get random bytes for the salt\n" );
+    exit( EXIT_FAILURE );
+  }
+  deriveKey( &p.key, ctx, p.header );
+
+  byte zero[ GCM_IV_SIZE ] = { 0 };
+  gcmInit( &p.gcm, &p.key, zero );
+
+  size_t group = groupChunks( chunkSize, threads );
+  p.pool = poolCreate( parallelThreadsFor( threads, group, 1 ) );
+  STATS_THREADS( poolThreads( p.pool ) );
+  p.records = malloc( group * ( chunkSize + RECORD_OVERHEAD ) );
+
+  writeChunk( out, p.header, CONTAINER_HEADER_SIZE, outName );
+  bool ok = streamFile( in, inName, out, outName, group * chunkSize, group * RECORD_OVERHEAD, STREAM_BUFFERS, limit,
+                        uring, packGroup, &p );
+  poolDestroy( p.pool );
+  free( p.records );
+  if ( !ok ) {
+    explicit_bzero( &p.key, sizeof( p.key ) );
+    free( p.index );
+    return p.tooLarge ? "Too much input for a container" : BAD_CONTAINER;
+  }
+
+  // Lay out the header, the index and the trailer together, since the index's tag covers all three.
+  size_t authLen = CONTAINER_HEADER_SIZE + p.chunks * ENTRY_SIZE + TRAILER_SIZE;
+  byte *auth = malloc( authLen );
+  memcpy( auth, p.header, CONTAINER_HEADER_SIZE );
+  uint64_t total = 0;
+  for ( uint64_t i = 0; i < p.chunks; i++ ) {
+    byte *entry = auth + CONTAINER_HEADER_SIZE + i * ENTRY_SIZE;
+    putLittle( entry + ENT_OFFSET, p.index[ i ].offset, 8 );
+    putLittle( entry + ENT_PLAIN, p.index[ i ].plainLen, 4 );
+    putLittle( entry + ENT_STORED, p.index[ i ].storedLen, 4 );
+    total += p.index[ i ].plainLen;
+  }
+  byte *trailer = auth + authLen - TRAILER_SIZE;
+  putLittle( trailer + TRL_INDEX, p.outOffset, 8 );
+  putLittle( trailer + TRL_CHUNKS, p.chunks, 8 );
+  putLittle( trailer + TRL_TOTAL, total, 8 );
+  memcpy( trailer + TRL_MAGIC, trailerMagic, sizeof( trailerMagic ) );
+  indexTag( &p.key, auth, p.chunks, false );
+  explicit_bzero( &p.key, sizeof( p.key ) );
+
+  writeChunk( out, auth + CONTAINER_HEADER_SIZE, authLen - CONTAINER_HEADER_SIZE, outName );
+  free( auth );
+  free( p.index );
+  return NULL;
+}
+
+/**
+   Check that the authenticated index describes a container this file could have written: records one after another
+   from the end of the header to the start of the index, every chunk whole but the last, only compressed chunks
+   stored shorter than they are, and the lengths adding up.
+   @param c the container, with its index read.
+   @param indexOffset where the index starts.
+   @return true if the layout is sound.
+*/
+static bool checkLayout( Container const *c, uint64_t indexOffset )
+{
+  uint64_t offset = CONTAINER_HEADER_SIZE;
+  uint64_t total = 0;
+  bool compressed = c->header[ HDR_FLAGS ] & FLAG_COMPRESSED;
+  for ( uint64_t i = 0; i < c->chunks; i++ ) {
+    ContainerEntry const *e = &c->index[ i ];
+    bool lastChunk = i + 1 == c->chunks;
+    if ( e->offset != offset || e->storedLen > e->plainLen || e->storedLen == 0 || e->plainLen > c->chunkSize ||
+         ( !compressed && e->storedLen != e->plainLen ) || ( !lastChunk && e->plainLen != c->chunkSize ) )
+      return false;
+    offset += e->storedLen + RECORD_OVERHEAD;
+    total += e->plainLen;
+  }
+  return offset == indexOffset && total == c->total;
+}
+
+char const *openContainer( Container *c, FILE *in, char const *name, AesContext const *ctx )
+{
+  memset( c, 0, sizeof( Container ) );
+  c->in = in;
+  c->name = name;
+
+  // The index is at the end, so the container has to be a file we can seek around in.
+  uint64_t size;
+  if ( !inputFileSize( in, &size ) )
+    return "Container must be a regular file";
+  byte trailer[ TRAILER_SIZE ];
+  if ( size < CONTAINER_HEADER_SIZE + TRAILER_SIZE ||
+       readChunk( in, c->header, CONTAINER_HEADER_SIZE, name ) != CONTAINER_HEADER_SIZE ||
+       fseeko( in, size - TRAILER_SIZE, SEEK_SET ) != 0 ||
+       readChunk( in, trailer, TRAILER_SIZE, name ) != TRAILER_SIZE )
+    return BAD_CONTAINER;
+
+  c->chunkSize = getLittle( c->header + HDR_CHUNK, 4 );
+  if ( memcmp( c->header + HDR_MAGIC, headerMagic, HDR_VERSION ) != 0 ||
+       c->header[ HDR_VERSION ] != CONTAINER_VERSION || ( c->header[ HDR_FLAGS ] & ~FLAG_COMPRESSED ) != 0 ||
+       c->chunkSize < CONTAINER_MIN_CHUNK || c->chunkSize > CONTAINER_MAX_CHUNK ||
+       memcmp( trailer + TRL_MAGIC, trailerMagic, sizeof( trailerMagic ) ) != 0 )
+    return BAD_CONTAINER;
+
+  // The index has to fill exactly the space between where the trailer says it starts and the trailer itself.
+  uint64_t indexOffset = getLittle( trailer + TRL_INDEX, 8 );
+  c->chunks = getLittle( trailer + TRL_CHUNKS, 8 );
+  c->total = getLittle( trailer + TRL_TOTAL, 8 );
+  uint64_t room = size - CONTAINER_HEADER_SIZE - TRAILER_SIZE;
+  if ( c->chunks >= INDEX_NONCE || c->chunks > room / ENTRY_SIZE || indexOffset < CONTAINER_HEADER_SIZE ||
+       indexOffset + c->chunks * ENTRY_SIZE + TRAILER_SIZE != size )
+    return BAD_CONTAINER;
+
+  size_t authLen = CONTAINER_HEADER_SIZE + c->chunks * ENTRY_SIZE + TRAILER_SIZE;
+  byte *auth = malloc( authLen );
+  memcpy( auth, c->header, CONTAINER_HEADER_SIZE );
+  memcpy( auth + authLen - TRAILER_SIZE, trailer, TRAILER_SIZE );
+  size_t indexLen = c->chunks * ENTRY_SIZE;
+  if ( fseeko( in, indexOffset, SEEK_SET ) != 0 || readChunk( in, auth + CONTAINER_HEADER_SIZE, indexLen, name ) !=
+       indexLen ) {
+    free( auth );
+    return BAD_CONTAINER;
+  }
+  deriveKey( &c->key, ctx, c->header );
+  if ( !indexTag( &c->key, auth, c->chunks, true ) ) {
+    explicit_bzero( &c->key, sizeof( c->key ) );
+    free( auth );
+    return AUTH_FAILED;
+  }
+
+  c->index = malloc( ( c->chunks ? c->chunks : 1 ) * sizeof( ContainerEntry ) );
+  for ( uint64_t i = 0; i < c->chunks; i++ ) {
+    byte const *entry = auth + CONTAINER_HEADER_SIZE + i * ENTRY_SIZE;
+    c->index[ i ].offset = getLittle( entry + ENT_OFFSET, 8 );
+    c->index[ i ].plainLen = getLittle( entry + ENT_PLAIN, 4 );
+    c->index[ i ].storedLen = getLittle( entry + ENT_STORED, 4 );
+  }
+  free( auth );
+
+  if ( !checkLayout( c, indexOffset ) ) {
+    closeContainer( c );
+    return BAD_CONTAINER;
+  }
+  return NULL;
+}
+
+/**
+   Decrypt one chunk of a group, check its tag, and decompress it if it was compressed.
+   @param arg the Unpacker.
+   @param index which chunk of the group.
+   @param worker the thread running it.
+*/
+static void unpackChunk( void *arg, size_t index, int worker )
+{
+  Unpacker *u = arg;
+  ContainerEntry const *first = &u->c->index[ u->firstChunk ];
+  ContainerEntry const *e = first + index;
+  byte *record = u->records + ( e->offset - first->offset );
+
+  // A record copied from elsewhere in the container would carry the wrong chunk number.
+  byte nonce[ GCM_IV_SIZE ];
+  makeNonce( nonce, u->firstChunk + index );
+  if ( memcmp( nonce, record, GCM_IV_SIZE ) != 0 ) {
+    __atomic_store_n( &u->failed, true, __ATOMIC_RELAXED );
+    return;
+  }
+
+  // A compressed chunk is decrypted where it is, and only decompressed once it's known to be authentic.
+  byte *plain = u->plain + index * u->c->chunkSize;
+  byte *stored = e->storedLen < e->plainLen ? record + GCM_IV_SIZE : plain;
+  GcmContext gcm = u->gcm;
+  gcmRestart( &gcm, nonce );
+  gcmAad( &gcm, u->c->header, CONTAINER_HEADER_SIZE );
+  gcmDecrypt( &gcm, NULL, record + GCM_IV_SIZE, stored, e->storedLen );
+  if ( !gcmCheckTag( &gcm, record + GCM_IV_SIZE + e->storedLen ) )
+    __atomic_store_n( &u->failed, true, __ATOMIC_RELAXED );
+  else if ( stored != plain && !lzDecompress( stored, e->storedLen, plain, e->plainLen ) )
+    __atomic_store_n( &u->corrupt, true, __ATOMIC_RELAXED );
+}
+
+char const *readContainer( Container *c, uint64_t offset, uint64_t length, int threads, FILE *out,
+                           char const *outName )
+{
+  uint64_t start = offset < c->total ? offset : c->total;
+  uint64_t end = length < c->total - start ? start + length : c->total;
+  if ( start == end )
+    return NULL;
+
+  uint64_t firstChunk = start / c->chunkSize;
+  uint64_t lastChunk = ( end - 1 ) / c->chunkSize;
+  size_t group = groupChunks( c->chunkSize, threads );
+  WorkerPool *pool = poolCreate( parallelThreadsFor( threads, lastChunk - firstChunk + 1, 1 ) );
+  STATS_THREADS( poolThreads( pool ) );
+
+  Unpacker u;
+  u.c = c;
+  byte zero[ GCM_IV_SIZE ] = { 0 };
+  gcmInit( &u.gcm, &c->key, zero );
+  byte *records = malloc( group * ( c->chunkSize + RECORD_OVERHEAD ) );
+  u.plain = malloc( group * c->chunkSize );
+  u.records = records;
+
+  char const *error = NULL;
+  for ( uint64_t a = firstChunk; a <= lastChunk && !error; a += group ) {
+    uint64_t b = lastChunk - a + 1 < group ? lastChunk + 1 : a + group;
+
+    // The group's records are one after another, so they come in with a single read.
+    uint64_t from = c->index[ a ].offset;
+    size_t len = c->index[ b - 1 ].offset + c->index[ b - 1 ].storedLen + RECORD_OVERHEAD - from;
+    if ( fseeko( c->in, from, SEEK_SET ) != 0 || readChunk( c->in, records, len, c->name ) != len ) {
+      error = BAD_CONTAINER;
+      break;
+    }
+
+    STATS_START( computeStart );
+    u.firstChunk = a;
+    u.failed = false;
+    u.corrupt = false;
+    parallelForEach( pool, b - a, unpackChunk, &u );
+    uint64_t groupStart = a * c->chunkSize;
+    uint64_t groupEnd = b - 1 == lastChunk ? end : b * c->chunkSize;
+    STATS_STOP( STAT_COMPUTE, computeStart, groupEnd - groupStart );
+    if ( u.failed || u.corrupt ) {
+      error = u.failed ? AUTH_FAILED : BAD_CONTAINER;
+      break;
+    }
+
+    size_t skip = a == firstChunk ? start - groupStart : 0;
+    writeChunk( out, u.plain + skip, groupEnd - groupStart - skip, outName );
+  }
+
+  poolDestroy( pool );
+  free( records );
+  free( u.plain );
+  return error;
+}
+
+void closeContainer( Container *c )
+{
+  free( c->index );
+  c->index = NULL;
+  explicit_bzero( &c->key, sizeof( c->key ) );
+}
@@ -0,0 +1,124 @@
+/**
+ * @file container.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for container.c, the chunked container format. A container is a header, then the plaintext
+ * in fixed-size chunks, each encrypted on its own in GCM with its own nonce and tag, then an index of where every
+ * chunk is, authenticated with a tag of its own. Since no chunk depends on any other, they can be encrypted and
+ * decrypted in parallel, and any byte range can be read back by decrypting just the chunks it overlaps. Chunks can be
+ * compressed before they're encrypted, since ciphertext doesn't compress.
+*/
+
+/** Macro used for unit testing */
+#ifndef _CONTAINER_H_
+/** Macro used for unit testing */
+#define _CONTAINER_H_
+
+#include "aes.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Default number of bytes of plaintext in each chunk. */
+#define CONTAINER_CHUNK ( 1024 * 1024 )
+
+/** Smallest chunk size allowed. */
+#define CONTAINER_MIN_CHUNK 4096
+
+/** Largest chunk size allowed. */
+#define CONTAINER_MAX_CHUNK ( 64 * 1024 * 1024 )
+
+/** Number of bytes in a container's header. */
+#define CONTAINER_HEADER_SIZE 32
+
+/** Where one chunk is in a container. */
+typedef struct {
+  /** Position of the chunk's record (nonce, ciphertext and tag) in the container. */
+  uint64_t offset;
+
+  /** Bytes of plaintext in the chunk. */
+  uint32_t plainLen;
+
+  /** Bytes of ciphertext stored for the chunk; fewer than plainLen if the chunk was compressed. */
+  uint32_t storedLen;
+} ContainerEntry;
+
+/** An open container, with its index read and checked. */
+typedef struct {
+  /** The container file. */
+  FILE *in;
+
+  /** Name of the container file, for error messages. */
+  char const *name;
+
+  /** The header, which every chunk's tag covers too. */
+  byte header[ CONTAINER_HEADER_SIZE ];
+
+  /** The container's own subkey, made from the key and the salt in the header. */
+  AesContext key;
+
+  /** Bytes of plaintext in every chunk but the last. */
+  size_t chunkSize;
+
+  /** Number of chunks. */
+  uint64_t chunks;
+
+  /** Bytes of plaintext in all the chunks together. */
+  uint64_t total;
+
+  /** Where each chunk is. */
+  ContainerEntry *index;
+} Container;
+
+/**
+ * This function encrypts a stream into a container. The chunks are read, encrypted across the threads and written
+ * through the streaming pipeline, and the index goes at the end once the input runs out, so the output can be a pipe.
+ * @param in the input file
+ * @param inName name of the input file, for error messages
+ * @param out the output file
+ * @param outName name of the output file, for error messages
+ * @param ctx the context holding the expanded key
+ * @param chunkSize bytes of plaintext in each chunk, from CONTAINER_MIN_CHUNK to CONTAINER_MAX_CHUNK
+ * @param compress true to compress each chunk before encrypting it, wherever that makes it smaller
+ * @param limit the most bytes to read from the input, or UINT64_MAX for all of it
+ * @param threads the number of threads to encrypt with
+ * @param uring true to try io_uring for the pipeline
+ * @return NULL on success, or a message saying what went wrong
+*/
+char const *packStream( FILE *in, char const *inName, FILE *out, char const *outName, AesContext const *ctx,
+                        size_t chunkSize, bool compress, uint64_t limit, int threads, bool uring );
+
+/**
+ * This function opens a container for reading: it reads the header and the index, and checks the index's tag, so
+ * nothing about the layout is trusted until it's authenticated. The file has to be seekable. The container's subkey is
+ * kept in it for readContainer().
+ * @param c the container to fill in
+ * @param in the container file
+ * @param name name of the container file
+ * @param ctx the context holding the expanded key
+ * @return NULL on success, or a message saying what went wrong
+*/
+char const *openContainer( Container *c, FILE *in, char const *name, AesContext const *ctx );
+
+/**
+ * This function decrypts a byte range of a container's plaintext and writes it out. Only the chunks that overlap the
+ * range are read, and they're decrypted across the threads a batch at a time. Each batch is written only once all of
+ * its tags have been checked.
+ * @param c the open container
+ * @param offset position in the plaintext to start at
+ * @param length the most bytes to decrypt, or UINT64_MAX for the rest
+ * @param threads the number of threads to decrypt with
+ * @param out where the plaintext goes
+ * @param outName name of the output file, for error messages
+ * @return NULL on success, or a message saying what went wrong
+*/
+char const *readContainer( Container *c, uint64_t offset, uint64_t length, int threads, FILE *out,
+                           char const *outName );
+
+/**
+ * This function frees what openContainer() allocated and wipes the subkey. It doesn't close the file.
+ * @param c the container
+*/
+void closeContainer( Container *c );
+
+#endif
@@ -0,0 +1,119 @@
+/**
+ * @file cpu.c
+ * @author Jimin Yu, jyu34
+ * This file detects the processor features the optional AES and field code paths depend on, so one build can pick
+ * the fastest code that works on whatever host it runs on.
+*/
+
+#include "cpu.h"
+#include <pthread.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <cpuid.h>
+
+/** Leaf 1 ECX bit for SSSE3. */
+#define ECX1_SSSE3 ( 1u << 9 )
+
+/** Leaf 1 ECX bit for SSE4.1. */
+#define ECX1_SSE41 ( 1u << 19 )
+
+/** Leaf 1 ECX bit for the AES instructions. */
+#define ECX1_AESNI ( 1u << 25 )
+
+/** Leaf 1 ECX bit for the carry-less multiply instruction. */
+#define ECX1_PCLMUL ( 1u << 1 )
+
+/** Leaf 1 ECX bit saying the OS has enabled XGETBV. */
+#define ECX1_OSXSAVE ( 1u << 27 )
+
+/** Leaf 1 ECX bit for AVX. */
+#define ECX1_AVX ( 1u << 28 )
+
+/** Leaf 7 EBX bit for AVX2. */
+#define EBX7_AVX2 ( 1u << 5 )
+
+/** Leaf 7 EBX bit for AVX-512 Foundation. */
+#define EBX7_AVX512F ( 1u << 16 )
+
+/** Leaf 7 EBX bit for AVX-512 byte and word instructions. */
+#define EBX7_AVX512BW ( 1u << 30 )
+
+/** Leaf 7 ECX bit for the vector AES instructions. */
+#define ECX7_VAES ( 1u << 9 )
+
+/** Leaf 7 ECX bit for the vector carry-less multiply instruction. */
+#define ECX7_VPCLMUL ( 1u << 10 )
+
+/** XCR0 bits for the SSE and AVX register state. */
+#define XCR0_AVX 0x6
+
+/** XCR0 bits for the SSE, AVX and AVX-512 register state. */
+#define XCR0_AVX512 0xE6
+
+/** CPUID leaf with the extended feature flags. */
+#define LEAF_EXTENDED 7
+#endif
+
+/** Number of features in the CpuFeature enumeration. */
+#define FEATURE_COUNT ( CPU_VPCLMUL + 1 )
+
+/** Cached answers for each feature. */
+static bool features[ FEATURE_COUNT ];
+
+/** Makes sure the processor is only queried once. */
+static pthread_once_t detectOnce = PTHREAD_ONCE_INIT;
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+/**
+   Read the extended control register that says which register state the OS saves on a context switch.
+   @return the value of XCR0.
+*/
+static unsigned long long readXcr0( void )
+{
+  unsigned int lo, hi;
+  __asm__ volatile ( "xgetbv" : "=a" ( lo ), "=d" ( hi ) : "c" ( 0 ) );
+  return ( (unsigned long long) hi << 32 ) | lo;
+}
+#endif
+
+/**
+   Query the processor and fill in the features array.
+*/
+static void detect( void )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+  unsigned int eax, ebx, ecx, edx;
+  if ( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) )
+    return;
+
+  features[ CPU_SSSE3 ] = ecx & ECX1_SSSE3;
+  features[ CPU_SSE41 ] = ecx & ECX1_SSE41;
+  features[ CPU_AESNI ] = ecx & ECX1_AESNI;
+  features[ CPU_PCLMUL ] = ecx & ECX1_PCLMUL;
+
+  // The 256 and 512-bit registers are only usable if the OS saves them.
+  bool avx = false;
+  bool avx512 = false;
+  if ( ( ecx & ECX1_OSXSAVE ) && ( ecx & ECX1_AVX ) ) {
+    unsigned long long xcr0 = readXcr0();
+    avx = ( xcr0 & XCR0_AVX ) == XCR0_AVX;
+    avx512 = ( xcr0 & XCR0_AVX512 ) == XCR0_AVX512;
+  }
+
+  if ( __get_cpuid_max( 0, 0 ) < LEAF_EXTENDED )
+    return;
+  __cpuid_count( LEAF_EXTENDED, 0, eax, ebx, ecx, edx );
+
+  features[ CPU_AVX2 ] = avx && ( ebx & EBX7_AVX2 );
+  features[ CPU_AVX512F ] = avx512 && ( ebx & EBX7_AVX512F );
+  features[ CPU_AVX512BW ] = avx512 && ( ebx & EBX7_AVX512BW );
+  features[ CPU_VAES ] = avx && ( ecx & ECX7_VAES );
+  features[ CPU_VPCLMUL ] = avx && ( ecx & ECX7_VPCLMUL );
+#endif
+}
+
+bool cpuHas( CpuFeature feature )
+{
+  pthread_once( &detectOnce, detect );
+  return features[ feature ];
+}
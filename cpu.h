@@ -0,0 +1,37 @@
+/**
+ * @file cpu.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for cpu.c. It contains the list of processor features the program can take advantage of, and
+ * the function that checks for them at run time.
+*/
+
+/** Macro used for unit testing */
+#ifndef _CPU_H_
+/** Macro used for unit testing */
+#define _CPU_H_
+
+#include <stdbool.h>
+
+/** Processor features that an optional, faster code path may depend on. */
+typedef enum {
+  CPU_SSSE3,
+  CPU_SSE41,
+  CPU_AESNI,
+  CPU_PCLMUL,
+  CPU_AVX2,
+  CPU_AVX512F,
+  CPU_AVX512BW,
+  CPU_VAES,
+  CPU_VPCLMUL
+} CpuFeature;
+
+/**
+ * This function reports whether the processor (and operating system, for the wider registers) support the given
+ * feature. The answer comes from the CPUID instruction the first time it's needed and is cached after that. On
+ * processors other than x86, it always returns false.
+ * @param feature the feature to check for
+ * @return true if code that depends on the feature can run on this host
+*/
+bool cpuHas( CpuFeature feature );
+
+#endif
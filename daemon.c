@@ -0,0 +1,548 @@
+/**
+ * @file daemon.c
+ * @author Jimin Yu, jyu34
+ * This file is the aesd server. Keys are read and expanded once, along with their GCM hash keys, and shared read-only
+ * by every thread. Each thread has its own epoll set; they all wait on the listening socket, and a connection belongs
+ * to the thread that accepted it from then on, so nothing about a connection is ever locked or handed between
+ * threads.
+*/
+
+#define _GNU_SOURCE
+
+#include "daemon.h"
+#include "aes.h"
+#include "cli.h"
+#include "io.h"
+#include "modes.h"
+#include "parallel.h"
+#include "proto.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/** Most events one call to epoll_wait() returns. */
+#define MAX_EVENTS 64
+
+/** Permissions masked off when the socket is created, leaving it 0600 so only the user can connect. */
+#define SOCKET_UMASK 0177
+
+/** Starting size of a connection's input and output buffers; they double as needed to fit a request and its reply. */
+#define BUFFER_START ( 64 * 1024 )
+
+/** A key, ready to use. */
+typedef struct {
+  /** The expanded key. */
+  AesContext ctx;
+
+  /** GCM state with the hash key already worked out; each gcm request starts from a copy. */
+  GcmContext gcm;
+} DaemonKey;
+
+/** A client's connection. */
+typedef struct Connection {
+  /** The connected socket. */
+  int fd;
+
+  /** The events epoll is watching for: EPOLLIN, or EPOLLOUT while a reply is waiting to be sent. */
+  uint32_t events;
+
+  /** Bytes read but not yet served, starting with the header of the next request. */
+  byte *in;
+
+  /** Number of bytes in in. */
+  size_t inLen;
+
+  /** Bytes in can hold. */
+  size_t inCap;
+
+  /** Replies waiting to be sent. */
+  byte *out;
+
+  /** Number of bytes in out. */
+  size_t outLen;
+
+  /** Number of bytes of out already sent. */
+  size_t outSent;
+
+  /** Bytes out can hold. */
+  size_t outCap;
+
+  /** Set once nothing more will be read; the connection closes when its replies are sent. */
+  bool closing;
+
+  /** Neighbours in the thread's list of connections. */
+  struct Connection *prev, *next;
+} Connection;
+
+/** One serving thread. */
+typedef struct {
+  /** The thread's epoll set. */
+  int epfd;
+
+  /** The listening socket, shared by every thread. */
+  int listenFd;
+
+  /** The keys, shared by every thread. */
+  DaemonKey const *keys;
+
+  /** Number of keys. */
+  int keyCount;
+
+  /** The connections this thread has accepted. */
+  Connection *conns;
+
+  /** The thread itself. */
+  pthread_t thread;
+} Server;
+
+/** Marks the listening socket's events, in place of a connection. */
+static char listenTag;
+
+/** Marks the event that tells the threads to stop, in place of a connection. */
+static char stopTag;
+
+bool parseDaemonOptions( DaemonOptions *opts, int argc, char *argv[] )
+{
+  opts->threads = 0;
+  opts->socketPath = defaultSocket();
+  opts->keyCount = 0;
+
+  for ( int i = 1; i < argc; i++ ) {
+    char const *arg = argv[ i ];
+    if ( strcmp( arg, "-j" ) == 0 ) {
+      if ( ++i == argc )
+        return false;
+      if ( strcmp( argv[ i ], "auto" ) == 0 )
+        opts->threads = 0;
+      else if ( !parseCount( argv[ i ], &opts->threads ) )
+        return false;
+    } else if ( strcmp( arg, "--socket" ) == 0 ) {
+      if ( ++i == argc )
+        return false;
+      opts->socketPath = argv[ i ];
+    } else if ( arg[ 0 ] == '-' || opts->keyCount == MAX_KEYS )
+      return false;
+    else
+      opts->keyFiles[ opts->keyCount++ ] = arg;
+  }
+  return opts->keyCount > 0;
+}
+
+/**
+   Read and expand every key.
+   @param opts the parsed command line.
+   @return the keys, in the order they were given.
+*/
+static DaemonKey *loadKeys( DaemonOptions const *opts )
+{
+  DaemonKey *keys = malloc( opts->keyCount * sizeof( DaemonKey ) );
+  byte zero[ GCM_IV_SIZE ] = { 0 };
+  for ( int i = 0; i < opts->keyCount; i++ ) {
+    size_t size;
+    byte *key = readBinaryFile( opts->keyFiles[ i ], &size );
+    if ( size != BLOCK_SIZE ) {
+      fprintf( stderr, "Bad key file: %s\n", opts->keyFiles[ i ] );
+      exit( EXIT_FAILURE );
+    }
+    aesInitCtx( &keys[ i ].ctx, key );
+    gcmInit( &keys[ i ].gcm, &keys[ i ].ctx, zero );
+    memset( key, 0, size );
+    free( key );
+  }
+  return keys;
+}
+
+/**
+   Check that a name is free for a socket, or taken by a socket that can be replaced, so starting the server never
+   removes some other kind of file.
+   @param name the file name.
+   @return true if nothing has the name or a socket does.
+*/
+static bool socketOrMissing( char const *name )
+{
+  struct stat info;
+  if ( lstat( name, &info ) != 0 )
+    return errno == ENOENT;
+  return S_ISSOCK( info.st_mode );
+}
+
+/**
+   Create the listening socket. It's bound to a temporary name and renamed into place once it's listening, so a
+   client never finds a socket that refuses connections, and a stale one left by a server that died is replaced. Only
+   a socket is ever replaced, and the new one is created with only the user allowed to connect.
+   @param path the name of the socket.
+   @return the listening socket, which doesn't block.
+*/
+static int listenOn( char const *path )
+{
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  int len = snprintf( addr.sun_path, sizeof( addr.sun_path ), "%s.%d", path, ( int ) getpid() );
+  if ( len < 0 || len >= sizeof( addr.sun_path ) ) {
+    fprintf( stderr, "Socket name too long: %s\n", path );
+    exit( EXIT_FAILURE );
+  }
+
+  // Don't take the name from a server that's still running.
+  int probe = connectDaemon( path );
+  if ( probe >= 0 ) {
+    close( probe );
+    fprintf( stderr, "Already running: %s\n", path );
+    exit( EXIT_FAILURE );
+  }
+
+  char const *taken = !socketOrMissing( path ) ? path : !socketOrMissing( addr.sun_path ) ? addr.sun_path : NULL;
+  if ( taken ) {
+    fprintf( stderr, "Not a socket: %s\n", taken );
+    exit( EXIT_FAILURE );
+  }
+
+  // The threads haven't started yet, so changing the umask for the bind doesn't affect anything else.
+  int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+  unlink( addr.sun_path );
+  mode_t mask = umask( SOCKET_UMASK );
+  bool bound = fd >= 0 && bind( fd, ( struct sockaddr * ) &addr, sizeof( addr ) ) == 0;
+  umask( mask );
+  if ( !bound || listen( fd, SOMAXCONN ) != 0 || rename( addr.sun_path, path ) != 0 ) {
+    perror( path );
+    unlink( addr.sun_path );
+    exit( EXIT_FAILURE );
+  }
+  return fd;
+}
+
+/**
+   Make sure a buffer can hold at least the given number of bytes, doubling it until it can.
+   @param buffer the buffer, which may move.
+   @param capacity bytes the buffer can hold, updated if it grows.
+   @param need bytes it has to hold.
+   @return false if there wasn't enough memory.
+*/
+static bool reserve( byte **buffer, size_t *capacity, size_t need )
+{
+  if ( need <= *capacity )
+    return true;
+  size_t grown = *capacity ? *capacity : BUFFER_START;
+  while ( grown < need )
+    grown *= 2;
+  byte *bigger = realloc( *buffer, grown );
+  if ( !bigger )
+    return false;
+  *buffer = bigger;
+  *capacity = grown;
+  return true;
+}
+
+/**
+   Encrypt or decrypt a request's payload. The request has been checked already.
+   @param key the key the request names.
+   @param req the request.
+   @param in the payload.
+   @param out where the result goes.
+   @return false if a gcm tag didn't match.
+*/
+static bool cryptPayload( DaemonKey const *key, Request const *req, byte const *in, byte *out )
+{
+  AesContext const *ctx = &key->ctx;
+  size_t len = req->length;
+  if ( req->mode == MODE_ECB && req->dir == ENCRYPT )
+    encryptBlocks( ctx, in, out, len / BLOCK_SIZE );
+  else if ( req->mode == MODE_ECB )
+    decryptBlocks( ctx, in, out, len / BLOCK_SIZE );
+  else if ( req->mode == MODE_CBC && req->dir == ENCRYPT ) {
+    CbcStream stream = { in, out, len / BLOCK_SIZE };
+    memcpy( stream.iv, req->iv, BLOCK_SIZE );
+    cbcEncryptStreams( ctx, &stream, 1 );
+  } else if ( req->mode == MODE_CBC ) {
+    byte iv[ BLOCK_SIZE ];
+    memcpy( iv, req->iv, BLOCK_SIZE );
+    parallelCbcDecrypt( NULL, ctx, iv, in, out, len / BLOCK_SIZE );
+  } else if ( req->mode == MODE_CTR )
+    ctrCrypt( ctx, req->iv, 0, in, out, len );
+  else {
+    GcmContext gcm = key->gcm;
+    gcmRestart( &gcm, req->iv );
+    if ( req->dir == ENCRYPT ) {
+      gcmEncrypt( &gcm, NULL, in, out, len );
+      gcmFinal( &gcm, out + len );
+    } else {
+      len -= GCM_TAG_SIZE;
+      gcmDecrypt( &gcm, NULL, in, out, len );
+      return gcmCheckTag( &gcm, in + len );
+    }
+  }
+  return true;
+}
+
+/**
+   Serve one request, adding its reply to the connection's output.
+   @param server the thread serving the connection.
+   @param conn the connection.
+   @param req the request.
+   @param payload the payload, all of it.
+   @return false if there wasn't memory for the reply.
+*/
+static bool serveRequest( Server *server, Connection *conn, Request const *req, byte const *payload )
+{
+  Reply reply = { REPLY_OK, req->id, 0 };
+  int ivLen = req->mode == MODE_ECB ? 0 : req->mode == MODE_GCM ? GCM_IV_SIZE : BLOCK_SIZE;
+  bool whole = req->mode == MODE_ECB || req->mode == MODE_CBC;
+  bool tagged = req->mode == MODE_GCM;
+
+  if ( req->mode > MODE_GCM || ( req->dir != ENCRYPT && req->dir != DECRYPT ) )
+    reply.status = REPLY_BAD_REQUEST;
+  else if ( req->key >= server->keyCount )
+    reply.status = REPLY_BAD_KEY;
+  else if ( req->ivLen != ivLen )
+    reply.status = REPLY_BAD_IV;
+  else if ( ( whole && req->length % BLOCK_SIZE != 0 ) || ( tagged && req->dir == DECRYPT && req->length < GCM_TAG_SIZE ) )
+    reply.status = REPLY_BAD_LENGTH;
+  else if ( tagged )
+    reply.length = req->dir == ENCRYPT ? req->length + GCM_TAG_SIZE : req->length - GCM_TAG_SIZE;
+  else
+    reply.length = req->length;
+
+  // The result goes straight into the output buffer, after room for the header.
+  if ( !reserve( &conn->out, &conn->outCap, conn->outLen + REPLY_HEADER_SIZE + reply.length ) )
+    return false;
+  byte *result = conn->out + conn->outLen + REPLY_HEADER_SIZE;
+  if ( reply.status == REPLY_OK && !cryptPayload( &server->keys[ req->key ], req, payload, result ) ) {
+    memset( result, 0, reply.length );
+    reply.status = REPLY_AUTH_FAILED;
+    reply.length = 0;
+  }
+  encodeReply( conn->out + conn->outLen, &reply );
+  conn->outLen += REPLY_HEADER_SIZE + reply.length;
+  return true;
+}
+
+/**
+   Read what's waiting on a connection and serve every request that's now complete. A request that can't be parsed
+   gets an error reply, and then the connection is closed, since there's no telling where the next one starts.
+   @param server the thread serving the connection.
+   @param conn the connection.
+   @return false if the connection failed.
+*/
+static bool readRequests( Server *server, Connection *conn )
+{
+  if ( !reserve( &conn->in, &conn->inCap, conn->inLen + REQUEST_HEADER_SIZE ) )
+    return false;
+  ssize_t got = recv( conn->fd, conn->in + conn->inLen, conn->inCap - conn->inLen, 0 );
+  if ( got < 0 )
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  conn->inLen += got;
+
+  // The client has finished sending; whatever's complete is still served.
+  if ( got == 0 )
+    conn->closing = true;
+
+  size_t pos = 0;
+  while ( conn->inLen - pos >= REQUEST_HEADER_SIZE ) {
+    Request req;
+    bool valid = decodeRequest( &req, conn->in + pos );
+    if ( !valid || req.length > MAX_PAYLOAD ) {
+      Reply reply = { valid ? REPLY_TOO_LARGE : REPLY_BAD_REQUEST, valid ? req.id : 0, 0 };
+      if ( !reserve( &conn->out, &conn->outCap, conn->outLen + REPLY_HEADER_SIZE ) )
+        return false;
+      encodeReply( conn->out + conn->outLen, &reply );
+      conn->outLen += REPLY_HEADER_SIZE;
+      conn->closing = true;
+      conn->inLen = 0;
+      return true;
+    }
+
+    // Wait for the rest of the payload, with room for it all.
+    size_t size = REQUEST_HEADER_SIZE + req.length;
+    if ( conn->inLen - pos < size ) {
+      memmove( conn->in, conn->in + pos, conn->inLen - pos );
+      conn->inLen -= pos;
+      return reserve( &conn->in, &conn->inCap, size );
+    }
+
+    if ( !serveRequest( server, conn, &req, conn->in + pos + REQUEST_HEADER_SIZE ) )
+      return false;
+    pos += size;
+  }
+
+  memmove( conn->in, conn->in + pos, conn->inLen - pos );
+  conn->inLen -= pos;
+  return true;
+}
+
+/**
+   Send as much of a connection's waiting replies as the socket will take.
+   @param conn the connection.
+   @return false if the connection failed.
+*/
+static bool sendReplies( Connection *conn )
+{
+  while ( conn->outSent < conn->outLen ) {
+    ssize_t sent = send( conn->fd, conn->out + conn->outSent, conn->outLen - conn->outSent, MSG_NOSIGNAL );
+    if ( sent < 0 && errno == EINTR )
+      continue;
+    if ( sent < 0 )
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    conn->outSent += sent;
+  }
+  conn->outLen = conn->outSent = 0;
+  return true;
+}
+
+/**
+   Close a connection and free it.
+   @param server the thread serving the connection.
+   @param conn the connection.
+*/
+static void closeConnection( Server *server, Connection *conn )
+{
+  close( conn->fd );
+  if ( conn->prev )
+    conn->prev->next = conn->next;
+  else
+    server->conns = conn->next;
+  if ( conn->next )
+    conn->next->prev = conn->prev;
+  free( conn->in );
+  free( conn->out );
+  free( conn );
+}
+
+/**
+   Accept a connection and add it to this thread's epoll set. Only one is taken at a time, so a burst of new clients
+   is spread over the threads that wake up for it rather than all landing on the first.
+   @param server the thread.
+*/
+static void acceptConnection( Server *server )
+{
+  int fd = accept4( server->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+  if ( fd < 0 )
+    return;
+
+  Connection *conn = calloc( 1, sizeof( Connection ) );
+  struct epoll_event event = { EPOLLIN, { .ptr = conn } };
+  if ( !conn || epoll_ctl( server->epfd, EPOLL_CTL_ADD, fd, &event ) != 0 ) {
+    close( fd );
+    free( conn );
+    return;
+  }
+  conn->fd = fd;
+  conn->events = EPOLLIN;
+  conn->next = server->conns;
+  if ( conn->next )
+    conn->next->prev = conn;
+  server->conns = conn;
+}
+
+/**
+   Handle an event on a connection. While replies are waiting to be sent nothing more is read, so a client that
+   sends faster than it reads is held back by its own socket rather than by the server's memory.
+   @param server the thread serving the connection.
+   @param conn the connection.
+*/
+static void serveConnection( Server *server, Connection *conn )
+{
+  bool ok = conn->outSent < conn->outLen ? sendReplies( conn ) : readRequests( server, conn ) && sendReplies( conn );
+  bool waiting = conn->outSent < conn->outLen;
+  if ( !ok || ( conn->closing && !waiting ) ) {
+    closeConnection( server, conn );
+    return;
+  }
+
+  uint32_t events = waiting ? EPOLLOUT : EPOLLIN;
+  if ( events != conn->events ) {
+    struct epoll_event event = { events, { .ptr = conn } };
+    epoll_ctl( server->epfd, EPOLL_CTL_MOD, conn->fd, &event );
+    conn->events = events;
+  }
+}
+
+/**
+   Start routine for a serving thread: handle events until told to stop, then close every connection.
+   @param arg the Server.
+   @return NULL.
+*/
+static void *serveThread( void *arg )
+{
+  Server *server = arg;
+  struct epoll_event events[ MAX_EVENTS ];
+  bool stop = false;
+  while ( !stop ) {
+    int count = epoll_wait( server->epfd, events, MAX_EVENTS, -1 );
+    if ( count < 0 && errno != EINTR )
+      break;
+    for ( int i = 0; i < count; i++ ) {
+      void *ptr = events[ i ].data.ptr;
+      if ( ptr == &stopTag )
+        stop = true;
+      else if ( ptr == &listenTag )
+        acceptConnection( server );
+      else
+        serveConnection( server, ptr );
+    }
+  }
+
+  while ( server->conns )
+    closeConnection( server, server->conns );
+  return NULL;
+}
+
+int runDaemon( DaemonOptions const *opts )
+{
+  DaemonKey *keys = loadKeys( opts );
+  int listenFd = listenOn( opts->socketPath );
+  int stopFd = eventfd( 0, EFD_CLOEXEC );
+
+  // Only this thread takes SIGINT and SIGTERM; the serving threads inherit the mask and leave them alone.
+  sigset_t signals;
+  sigemptyset( &signals );
+  sigaddset( &signals, SIGINT );
+  sigaddset( &signals, SIGTERM );
+  pthread_sigmask( SIG_BLOCK, &signals, NULL );
+
+  // Every thread waits on the listening socket; EPOLLEXCLUSIVE wakes just one of them for a new connection.
+  int threads = opts->threads > 0 ? opts->threads : parallelCpuCount();
+  Server *servers = calloc( threads, sizeof( Server ) );
+  for ( int i = 0; i < threads; i++ ) {
+    Server *server = &servers[ i ];
+    server->listenFd = listenFd;
+    server->keys = keys;
+    server->keyCount = opts->keyCount;
+    server->epfd = epoll_create1( EPOLL_CLOEXEC );
+    struct epoll_event listenEvent = { EPOLLIN | EPOLLEXCLUSIVE, { .ptr = &listenTag } };
+    struct epoll_event stopEvent = { EPOLLIN, { .ptr = &stopTag } };
+    if ( stopFd < 0 || server->epfd < 0 || epoll_ctl( server->epfd, EPOLL_CTL_ADD, listenFd, &listenEvent ) != 0 ||
+         epoll_ctl( server->epfd, EPOLL_CTL_ADD, stopFd, &stopEvent ) != 0 ||
+         pthread_create( &server->thread, NULL, serveThread, server ) != 0 ) {
+      perror( "aesd" );
+      unlink( opts->socketPath );
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  // Wait to be told to stop. The event fd stays readable, so it wakes every thread.
+  int sig;
+  sigwait( &signals, &sig );
+  uint64_t one = 1;
+  if ( write( stopFd, &one, sizeof( one ) ) != sizeof( one ) )
+    perror( "aesd" );
+  for ( int i = 0; i < threads; i++ ) {
+    pthread_join( servers[ i ].thread, NULL );
+    close( servers[ i ].epfd );
+  }
+
+  unlink( opts->socketPath );
+  close( listenFd );
+  close( stopFd );
+  memset( keys, 0, opts->keyCount * sizeof( DaemonKey ) );
+  free( keys );
+  free( servers );
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file daemon.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for daemon.c, the aesd server. It reads and expands its keys once, at start-up, and then
+ * encrypts and decrypts whatever its clients send it over a Unix domain socket, so a request costs a round trip
+ * through the socket instead of a new process.
+*/
+
+/** Macro used for unit testing */
+#ifndef _DAEMON_H_
+/** Macro used for unit testing */
+#define _DAEMON_H_
+
+#include <stdbool.h>
+
+/** Most key files aesd can be given. */
+#define MAX_KEYS 256
+
+/** Options and file names given on aesd's command line. */
+typedef struct {
+  /** Number of threads serving connections, from -j; 0 means one per processor. */
+  int threads;
+
+  /** Name of the socket to listen on, from --socket. */
+  char const *socketPath;
+
+  /** Number of key files given. */
+  int keyCount;
+
+  /** Names of the key files; a request names its key by its position here, starting from 0. */
+  char const *keyFiles[ MAX_KEYS ];
+} DaemonOptions;
+
+/**
+ * This function parses aesd's command line: [-j N|auto] [--socket <path>] <key-file>...
+ * @param opts the options to fill in
+ * @param argc the number of command line arguments
+ * @param argv the command line arguments
+ * @return true if the command line was valid, false if the caller should print a usage message
+*/
+bool parseDaemonOptions( DaemonOptions *opts, int argc, char *argv[] );
+
+/**
+ * This function runs the server until it gets SIGINT or SIGTERM, then removes the socket. Each thread runs its own
+ * epoll loop over the connections it accepted, with non-blocking sockets, and does the work for a request itself, so
+ * a request never waits for a hand-off between threads. Problems with the keys or the socket at start-up are
+ * reported on standard error and exit the program.
+ * @param opts the parsed command line
+ * @return the exit status for the program
+*/
+int runDaemon( DaemonOptions const *opts );
+
+#endif
@@ -0,0 +1,474 @@
+/**
+ * @file ec.c
+ * @author Jimin Yu, jyu34
+ * This file contains the program execution shared by the ecencode and ecdecode programs: parsing the command line,
+ * and moving stripes of data between the original file, the shard files and the Reed-Solomon code.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include "ec.h"
+#include "field.h"
+#include "ghash.h"
+#include "io.h"
+#include "parallel.h"
+#include "rs.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Bytes of each shard processed per stripe. */
+#define EC_PIECE ( 256 * 1024 )
+
+/** Identifies a shard file. */
+#define SHARD_MAGIC "AMRS"
+
+/** Bytes in the magic number. */
+#define MAGIC_SIZE 4
+
+/** Bytes in a shard file header: the magic number, k, m, the shard number and the format version as 16-bit values and
+    the original length as a 64-bit value, all big-endian. */
+#define SHARD_HEADER 20
+
+/** Version of the shard file format, the one with a checksum after each piece. */
+#define SHARD_VERSION 1
+
+/** Offset of k in the header. */
+#define HEADER_K 4
+
+/** Offset of m in the header. */
+#define HEADER_M 6
+
+/** Offset of the shard number in the header. */
+#define HEADER_INDEX 8
+
+/** Offset of the format version in the header. */
+#define HEADER_VERSION 10
+
+/** Offset of the original length in the header. */
+#define HEADER_LENGTH 12
+
+/** Number of file names expected after the options. */
+#define EC_FILE_ARGS 2
+
+/** Most digits in a shard number. */
+#define INDEX_DIGITS 3
+
+/** Bytes in the checksum that follows each shard's piece of a stripe: the piece's GHASH under a fixed key. */
+#define CHECK_SIZE BLOCK_SIZE
+
+/** The fixed GHASH key for checksums. It needn't be secret, since the checksums catch damage, not tampering. */
+#define CHECK_KEY "AMRS shard check"
+
+/** Everything known about one shard file. */
+typedef struct {
+  /** The file's name. */
+  char *name;
+
+  /** The open file, or NULL if it's missing or damaged. */
+  FILE *fp;
+
+  /** Buffer for the shard's piece of the current stripe. */
+  byte *piece;
+
+  /** Checksum computed for the current piece. */
+  byte sum[ CHECK_SIZE ];
+
+  /** Checksum the file has for the current piece, when decoding. */
+  byte stored[ CHECK_SIZE ];
+} Shard;
+
+/** Work shared by the threads checksumming the pieces of a stripe. */
+typedef struct {
+  /** All the shards; the ones without an open file are skipped. */
+  Shard *shards;
+
+  /** The checksum key. */
+  GhashKey const *key;
+
+  /** Bytes in each piece. */
+  size_t piece;
+} StripeCheck;
+
+/**
+   Parse a count from an option argument.
+   @param text the argument.
+   @param value where to put the count.
+   @param limit the largest allowed value.
+   @return true if text was a valid count.
+*/
+static bool parseEcCount( char const *text, int *value, int limit )
+{
+  char *end;
+  long n = strtol( text, &end, 10 );
+  if ( end == text || *end != '\0' || n < 0 || n > limit )
+    return false;
+  *value = n;
+  return true;
+}
+
+bool parseEcOptions( EcOptions *opts, int argc, char *argv[], bool encode )
+{
+  memset( opts, 0, sizeof( EcOptions ) );
+  opts->k = -1;
+  opts->m = -1;
+
+  char const *files[ EC_FILE_ARGS ];
+  int nfiles = 0;
+  for ( int i = 1; i < argc; i++ ) {
+    char const *arg = argv[ i ];
+    if ( strcmp( arg, "-j" ) == 0 ) {
+      if ( ++i == argc )
+        return false;
+      if ( strcmp( argv[ i ], "auto" ) != 0 && !parseEcCount( argv[ i ], &opts->threads, 1 << 16 ) )
+        return false;
+    } else if ( encode && strcmp( arg, "-k" ) == 0 ) {
+      if ( ++i == argc || !parseEcCount( argv[ i ], &opts->k, RS_MAX_SHARDS ) )
+        return false;
+    } else if ( encode && strcmp( arg, "-m" ) == 0 ) {
+      if ( ++i == argc || !parseEcCount( argv[ i ], &opts->m, RS_MAX_SHARDS ) )
+        return false;
+    } else if ( strncmp( arg, "-j", 2 ) == 0 ) {
+      if ( !parseEcCount( arg + 2, &opts->threads, 1 << 16 ) )
+        return false;
+    } else {
+      if ( nfiles == EC_FILE_ARGS )
+        return false;
+      files[ nfiles++ ] = arg;
+    }
+  }
+
+  if ( nfiles != EC_FILE_ARGS )
+    return false;
+  if ( encode ) {
+    if ( opts->k < 1 || opts->m < 0 || opts->k + opts->m > RS_MAX_SHARDS )
+      return false;
+    opts->inputFile = files[ 0 ];
+    opts->prefix = files[ 1 ];
+  } else {
+    opts->prefix = files[ 0 ];
+    opts->outputFile = files[ 1 ];
+  }
+  return true;
+}
+
+/**
+   Make the name of a shard file.
+   @param prefix the prefix shard files are named with.
+   @param index the shard number.
+   @return the name, which the caller frees.
+*/
+static char *shardName( char const *prefix, int index )
+{
+  size_t size = strlen( prefix ) + INDEX_DIGITS + 2;
+  char *name = malloc( size );
+  snprintf( name, size, "%s.%d", prefix, index );
+  return name;
+}
+
+/**
+   Store a big-endian value in a header.
+   @param p where the bytes go.
+   @param v the value.
+   @param n the number of bytes.
+*/
+static void storeBig( byte *p, uint64_t v, int n )
+{
+  for ( int i = n - 1; i >= 0; i-- ) {
+    p[ i ] = v;
+    v >>= BBITS;
+  }
+}
+
+/**
+   Load a big-endian value from a header.
+   @param p the bytes.
+   @param n the number of bytes.
+   @return the value.
+*/
+static uint64_t loadBig( byte const *p, int n )
+{
+  uint64_t v = 0;
+  for ( int i = 0; i < n; i++ )
+    v = ( v << BBITS ) | p[ i ];
+  return v;
+}
+
+/**
+   Work out how many bytes of each shard a stripe holds. Every stripe but the last takes EC_PIECE bytes from each data
+   shard; the last one splits what's left of the original evenly, rounding up.
+   @param k the number of data shards.
+   @param remaining bytes of the original file not yet in a stripe.
+   @return the piece size.
+*/
+static size_t pieceSize( int k, uint64_t remaining )
+{
+  if ( remaining >= (uint64_t) k * EC_PIECE )
+    return EC_PIECE;
+  return ( remaining + k - 1 ) / k;
+}
+
+/**
+   Work out how big a shard file should be, from its header and the way runEcEncode() lays out stripes.
+   @param k the number of data shards.
+   @param length the length of the original file.
+   @return the size of each shard file in bytes.
+*/
+static uint64_t shardSize( int k, uint64_t length )
+{
+  uint64_t stripe = (uint64_t) k * EC_PIECE;
+  uint64_t size = SHARD_HEADER + length / stripe * ( EC_PIECE + CHECK_SIZE );
+  if ( length % stripe )
+    size += pieceSize( k, length % stripe ) + CHECK_SIZE;
+  return size;
+}
+
+/**
+   Checksum one shard's piece of a stripe, a parallelForEach() item function.
+   @param arg the StripeCheck.
+   @param index the shard number.
+   @param worker unused.
+*/
+static void checkShard( void *arg, size_t index, int worker )
+{
+  StripeCheck const *work = arg;
+  Shard *shard = work->shards + index;
+  if ( !shard->fp )
+    return;
+
+  memset( shard->sum, 0, CHECK_SIZE );
+  size_t whole = work->piece / BLOCK_SIZE * BLOCK_SIZE;
+  ghashBlocks( work->key, shard->sum, shard->piece, whole / BLOCK_SIZE );
+  if ( whole < work->piece ) {
+    byte last[ BLOCK_SIZE ] = { 0 };
+    memcpy( last, shard->piece + whole, work->piece - whole );
+    ghashBlocks( work->key, shard->sum, last, 1 );
+  }
+}
+
+/**
+   Start a pool with as many threads as the options ask for, but no more than are worth using on one stripe.
+   @param opts the parsed command line.
+   @return the pool, or NULL for a single thread.
+*/
+static WorkerPool *startEcPool( EcOptions const *opts )
+{
+  int threads = opts->threads > 0 ? opts->threads : parallelCpuCount();
+  return poolCreate( parallelThreadsFor( threads, EC_PIECE, RS_GRAIN ) );
+}
+
+int runEcEncode( EcOptions const *opts )
+{
+  int k = opts->k, m = opts->m;
+  RsCode code;
+  rsInit( &code, k, m );
+
+  FILE *in = openInputFile( opts->inputFile );
+  Shard shards[ RS_MAX_SHARDS ];
+  byte *data = malloc( (size_t) k * EC_PIECE );
+  for ( int i = 0; i < k + m; i++ ) {
+    shards[ i ].name = shardName( opts->prefix, i );
+    shards[ i ].fp = openOutputFile( shards[ i ].name );
+    shards[ i ].piece = i < k ? data + (size_t) i * EC_PIECE : malloc( EC_PIECE );
+  }
+
+  // The length isn't known until the input has all been read, so the headers are written again at the end.
+  byte header[ SHARD_HEADER ] = { 0 };
+  for ( int i = 0; i < k + m; i++ )
+    writeChunk( shards[ i ].fp, header, SHARD_HEADER, shards[ i ].name );
+
+  GhashKey key;
+  ghashInit( &key, (byte const *) CHECK_KEY );
+  WorkerPool *pool = startEcPool( opts );
+  uint64_t length = 0;
+  for ( bool more = true; more; ) {
+    size_t len = readChunk( in, data, (size_t) k * EC_PIECE, opts->inputFile );
+    more = len == (size_t) k * EC_PIECE;
+    length += len;
+    if ( len == 0 )
+      break;
+
+    // The data shards' pieces are consecutive in the buffer, with the last one padded with zeros.
+    size_t piece = pieceSize( k, len );
+    byte const *dataPieces[ RS_MAX_SHARDS ];
+    byte *parityPieces[ RS_MAX_SHARDS ];
+    for ( int i = 0; i < k; i++ ) {
+      shards[ i ].piece = data + i * piece;
+      dataPieces[ i ] = shards[ i ].piece;
+    }
+    memset( data + len, 0, k * piece - len );
+    for ( int i = 0; i < m; i++ )
+      parityPieces[ i ] = shards[ k + i ].piece;
+    rsEncode( &code, pool, dataPieces, parityPieces, piece );
+
+    StripeCheck work = { shards, &key, piece };
+    parallelForEach( pool, k + m, checkShard, &work );
+    for ( int i = 0; i < k + m; i++ ) {
+      writeChunk( shards[ i ].fp, shards[ i ].piece, piece, shards[ i ].name );
+      writeChunk( shards[ i ].fp, shards[ i ].sum, CHECK_SIZE, shards[ i ].name );
+    }
+  }
+  poolDestroy( pool );
+
+  memcpy( header, SHARD_MAGIC, MAGIC_SIZE );
+  storeBig( header + HEADER_K, k, HEADER_M - HEADER_K );
+  storeBig( header + HEADER_M, m, HEADER_INDEX - HEADER_M );
+  storeBig( header + HEADER_VERSION, SHARD_VERSION, HEADER_LENGTH - HEADER_VERSION );
+  storeBig( header + HEADER_LENGTH, length, SHARD_HEADER - HEADER_LENGTH );
+  for ( int i = 0; i < k + m; i++ ) {
+    storeBig( header + HEADER_INDEX, i, HEADER_VERSION - HEADER_INDEX );
+    if ( fseeko( shards[ i ].fp, 0, SEEK_SET ) != 0 ) {
+      fprintf( stderr, "Can't write file: %s\n", shards[ i ].name );
+      exit( EXIT_FAILURE );
+    }
+    writeChunk( shards[ i ].fp, header, SHARD_HEADER, shards[ i ].name );
+    closeFile( shards[ i ].fp, shards[ i ].name );
+    if ( i >= k )
+      free( shards[ i ].piece );
+    free( shards[ i ].name );
+  }
+
+  closeFile( in, opts->inputFile );
+  free( data );
+  rsFree( &code );
+  return EXIT_SUCCESS;
+}
+
+/**
+   Open a shard file and check its header against what's expected. The first shard found decides what's expected. A
+   file that isn't the size its header calls for has been cut short or added to, so it doesn't count either.
+   @param name the file's name.
+   @param index the shard number the file should have.
+   @param header the header the other shards had, updated from this one if known is false.
+   @param known true once some shard has been found.
+   @return the open file, positioned after the header, or NULL if it's missing or doesn't belong.
+*/
+static FILE *openShard( char const *name, int index, byte header[ SHARD_HEADER ], bool known )
+{
+  FILE *fp = fopen( name, "rb" );
+  if ( !fp )
+    return NULL;
+
+  byte mine[ SHARD_HEADER ];
+  bool read = fread( mine, 1, SHARD_HEADER, fp ) == SHARD_HEADER;
+  uint64_t k = loadBig( mine + HEADER_K, HEADER_M - HEADER_K );
+  uint64_t m = loadBig( mine + HEADER_M, HEADER_INDEX - HEADER_M );
+  uint64_t length = loadBig( mine + HEADER_LENGTH, SHARD_HEADER - HEADER_LENGTH );
+  uint64_t size;
+  if ( !read || memcmp( mine, SHARD_MAGIC, MAGIC_SIZE ) != 0 || k < 1 || k + m > RS_MAX_SHARDS ||
+       (uint64_t) index >= k + m || loadBig( mine + HEADER_INDEX, HEADER_VERSION - HEADER_INDEX ) != (uint64_t) index ||
+       loadBig( mine + HEADER_VERSION, HEADER_LENGTH - HEADER_VERSION ) != SHARD_VERSION ||
+       ( known && ( memcmp( mine, header, HEADER_INDEX ) != 0 ||
+                    memcmp( mine + HEADER_LENGTH, header + HEADER_LENGTH, SHARD_HEADER - HEADER_LENGTH ) != 0 ) ) ||
+       !inputFileSize( fp, &size ) || size != shardSize( k, length ) ) {
+    fclose( fp );
+    return NULL;
+  }
+
+  if ( !known )
+    memcpy( header, mine, SHARD_HEADER );
+  return fp;
+}
+
+/**
+   Stop using a shard that turned out to be damaged partway through, treating it as missing from then on.
+   @param shard the shard.
+*/
+static void dropShard( Shard *shard )
+{
+  fclose( shard->fp );
+  shard->fp = NULL;
+}
+
+int runEcDecode( EcOptions const *opts )
+{
+  // Look for shards until one says how many there should be.
+  Shard shards[ RS_MAX_SHARDS ];
+  byte header[ SHARD_HEADER ];
+  bool known = false;
+  int total = RS_MAX_SHARDS;
+  for ( int i = 0; i < total; i++ ) {
+    shards[ i ].name = shardName( opts->prefix, i );
+    shards[ i ].fp = openShard( shards[ i ].name, i, header, known );
+    if ( shards[ i ].fp && !known ) {
+      known = true;
+      total = loadBig( header + HEADER_K, HEADER_M - HEADER_K ) + loadBig( header + HEADER_M, HEADER_INDEX - HEADER_M );
+    }
+  }
+
+  int k = known ? loadBig( header + HEADER_K, HEADER_M - HEADER_K ) : 0;
+  int m = total - k;
+  RsCode code;
+  if ( !known || !rsInit( &code, k, m ) ) {
+    fprintf( stderr, "No shard files found: %s\n", opts->prefix );
+    exit( EXIT_FAILURE );
+  }
+
+  // Only the data is needed, so missing parity shards are left alone.
+  byte *data = malloc( (size_t) k * EC_PIECE );
+  bool present[ RS_MAX_SHARDS ];
+  byte *pieces[ RS_MAX_SHARDS ];
+  int found = 0;
+  for ( int i = 0; i < k + m; i++ ) {
+    found += shards[ i ].fp != NULL;
+    shards[ i ].piece = i < k ? data : shards[ i ].fp ? malloc( EC_PIECE ) : NULL;
+  }
+  if ( found < k ) {
+    fprintf( stderr, "Not enough shard files: %s (%d of %d)\n", opts->prefix, found, k );
+    exit( EXIT_FAILURE );
+  }
+
+  GhashKey key;
+  ghashInit( &key, (byte const *) CHECK_KEY );
+  FILE *out = openOutputFile( opts->outputFile );
+  WorkerPool *pool = startEcPool( opts );
+  uint64_t remaining = loadBig( header + HEADER_LENGTH, SHARD_HEADER - HEADER_LENGTH );
+  while ( remaining > 0 ) {
+    size_t piece = pieceSize( k, remaining );
+    for ( int i = 0; i < k + m; i++ ) {
+      Shard *shard = shards + i;
+      if ( i < k )
+        shard->piece = data + i * piece;
+      if ( shard->fp && ( readChunk( shard->fp, shard->piece, piece, shard->name ) != piece ||
+                          readChunk( shard->fp, shard->stored, CHECK_SIZE, shard->name ) != CHECK_SIZE ) )
+        dropShard( shard );
+    }
+
+    // A piece that doesn't match its checksum is as good as missing, and so is the rest of its shard.
+    StripeCheck work = { shards, &key, piece };
+    parallelForEach( pool, k + m, checkShard, &work );
+    found = 0;
+    for ( int i = 0; i < k + m; i++ ) {
+      if ( shards[ i ].fp && memcmp( shards[ i ].sum, shards[ i ].stored, CHECK_SIZE ) != 0 )
+        dropShard( &shards[ i ] );
+      present[ i ] = shards[ i ].fp != NULL;
+      pieces[ i ] = shards[ i ].piece;
+      found += present[ i ];
+    }
+    if ( found < k ) {
+      fprintf( stderr, "Not enough undamaged shard files: %s (%d of %d)\n", opts->prefix, found, k );
+      exit( EXIT_FAILURE );
+    }
+
+    rsDecode( &code, pool, pieces, present, piece );
+
+    size_t len = remaining < (uint64_t) k * piece ? remaining : (uint64_t) k * piece;
+    writeChunk( out, data, len, opts->outputFile );
+    remaining -= len;
+  }
+  poolDestroy( pool );
+  closeFile( out, opts->outputFile );
+
+  for ( int i = 0; i < k + m; i++ ) {
+    if ( shards[ i ].fp )
+      fclose( shards[ i ].fp );
+    if ( i >= k )
+      free( shards[ i ].piece );
+    free( shards[ i ].name );
+  }
+  free( data );
+  rsFree( &code );
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file ec.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for ec.c, which holds the work shared by the ecencode and ecdecode programs.
+*/
+
+/** Macro used for unit testing */
+#ifndef _EC_H_
+/** Macro used for unit testing */
+#define _EC_H_
+
+#include <stdbool.h>
+
+/** Options and file names given on the ecencode or ecdecode command line. */
+typedef struct {
+  /** Number of threads to use, from -j; 0 means one per processor. */
+  int threads;
+
+  /** Number of data shards, from -k (ecencode only). */
+  int k;
+
+  /** Number of parity shards, from -m (ecencode only). */
+  int m;
+
+  /** Name of the file to read: the original for ecencode, ignored for ecdecode. */
+  char const *inputFile;
+
+  /** Shard files are named this, a dot and the shard number. */
+  char const *prefix;
+
+  /** Name of the file to write, for ecdecode. */
+  char const *outputFile;
+} EcOptions;
+
+/**
+ * This function parses the command line for ecencode or ecdecode:
+ *   ecencode [-j N|auto] -k <data-shards> -m <parity-shards> <input-file> <shard-prefix>
+ *   ecdecode [-j N|auto] <shard-prefix> <output-file>
+ * @param opts the options to fill in
+ * @param argc the number of command line arguments
+ * @param argv the command line arguments
+ * @param encode true for ecencode, false for ecdecode
+ * @return true if the command line was valid, false if the caller should print a usage message
+*/
+bool parseEcOptions( EcOptions *opts, int argc, char *argv[], bool encode );
+
+/**
+ * This function splits the input file into k data shards and computes m parity shards, writing each to its own file.
+ * Each shard file starts with a header giving k, m, its shard number and the length of the original file, and each of
+ * its pieces is followed by a checksum. The input is processed a stripe at a time, so memory use doesn't depend on its size. Errors are reported on standard error and
+ * exit the program.
+ * @param opts the parsed command line
+ * @return the exit status for the program
+*/
+int runEcEncode( EcOptions const *opts );
+
+/**
+ * This function rebuilds the original file from whichever of its shard files are there, as long as at least k of
+ * them are. Shard files that are missing, have a bad header or are the wrong size are skipped, and a shard whose piece
+ * of a stripe fails its checksum or comes up short is treated as missing from there on. Errors are reported on standard error and exit the program.
+ * @param opts the parsed command line
+ * @return the exit status for the program
+*/
+int runEcDecode( EcOptions const *opts );
+
+#endif
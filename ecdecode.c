@@ -0,0 +1,25 @@
+/**
+ * @file ecdecode.c
+ * @author Jimin Yu, jyu34
+ * This file contains the program execution for the ecdecode functionality, which rebuilds a file from its shards.
+*/
+
+#include "ec.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+/**
+ * This is the main method for the ecdecode functionality. It carries program execution.
+ * @param argc the number of command line arguments given
+ * @param argv an array of all the command line arguments
+ * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    EcOptions opts;
+    if ( !parseEcOptions( &opts, argc, argv, false ) ) {
+        fprintf( stderr, "usage: ecdecode [-j N|auto] <shard-prefix> <output-file>\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    exit( runEcDecode( &opts ) );
+}
@@ -0,0 +1,25 @@
+/**
+ * @file ecencode.c
+ * @author Jimin Yu, jyu34
+ * This file contains the program execution for the ecencode functionality, which splits a file into data and parity shards.
+*/
+
+#include "ec.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+/**
+ * This is the main method for the ecencode functionality. It carries program execution.
+ * @param argc the number of command line arguments given
+ * @param argv an array of all the command line arguments
+ * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    EcOptions opts;
+    if ( !parseEcOptions( &opts, argc, argv, true ) ) {
+        fprintf( stderr, "usage: ecencode [-j N|auto] -k <data-shards> -m <parity-shards> <input-file> <shard-prefix>\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    exit( runEcEncode( &opts ) );
+}
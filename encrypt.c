@@ -4,10 +4,8 @@
  * This file contains the program execution for the encrypt functionality.
 */
 
-#include "aes.h"
-#include "field.h"
-#include "io.h"
-#include <stdbool.h>
+#include "cli.h"
+#include "tool.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -18,48 +16,11 @@
  * @return program exit status
 */
 int main( int argc, char *argv[] ) {
-    if ( argc !=  NUMARGS ) {
+    Options opts;
+    if ( !parseOptions( &opts, argc, argv ) ) {
         fprintf( stderr, "usage: encrypt <key-file> <input-file> <output-file>\n" );
         exit( EXIT_FAILURE );
     }
 
-    byte* key = NULL;
-    int sizeKey = 0;
-    key = readBinaryFile( argv[1], &sizeKey );
-
-    byte* plainText = NULL;
-    int sizePlainText = 0;
-    plainText = readBinaryFile( argv[INDEX2], &sizePlainText );
-
-    if ( sizeKey != BLOCK_SIZE ) {
-        free( key );
-        free( plainText );
-        fprintf( stderr, "Bad key file: %s\n", argv[1] );
-        exit( EXIT_FAILURE );
-    }
-
-    if ( sizePlainText % BLOCK_SIZE != 0 ) {
-        free( plainText );
-        free( key );
-        fprintf( stderr, "Bad plaintext file length: %s\n", argv[INDEX2] );
-        exit( EXIT_FAILURE );
-    }
-
-    byte allData[sizePlainText];
-    for ( int i = 0; i < sizePlainText; i += BLOCK_SIZE ) {
-        byte temp[BLOCK_SIZE];
-        for ( int j = 0; j < BLOCK_SIZE; j++ ) {
-            temp[j] = plainText[i + j];
-        }
-        encryptBlock( temp, key );
-        
-        for ( int j = 0; j < BLOCK_SIZE; j++ ) {
-            allData[i + j] = temp[j];
-        }
-    }
-    writeBinaryFile( argv[INDEX3], allData, sizePlainText );
-
-    free( key );
-    free( plainText );
-    exit( EXIT_SUCCESS );
+    exit( runTool( &opts, ENCRYPT ) );
 }
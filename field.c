@@ -3,11 +3,49 @@
  * @author Jimin Yu, jyu34
  * This file contains implementation supporting basic arithmetic operations in an 8-bit (1 byte) Galois field.
  * These operations are used internally by AES for many steps in the encryption and decryption process.
+ * Multiplication comes in several versions with different speed and timing trade-offs, plus functions that multiply
+ * whole buffers at once, which use the PSHUFB byte shuffle on processors that have it.
 */
 
 #include "field.h"
+#include "cpu.h"
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
+/** Generator of the field's multiplicative group, whose powers give every nonzero value. */
+#define GENERATOR 0x03
+
+/** Number of nonzero values in the field, the order of the multiplicative group. */
+#define GROUP_ORDER 255
+
+/** Number of values in a nibble, and entries in each of the shuffle tables. */
+#define NIBBLE_VALUES 16
+
+/** Number of bits in a nibble. */
+#define NIBBLE_BITS 4
+
+/** Mask for the low nibble of a byte. */
+#define NIBBLE_MASK 0x0F
+
+/** Logarithms to the base GENERATOR of each nonzero value. */
+static byte logTable[ FIELD_SIZE ];
+
+/** Powers of GENERATOR, repeated so the sum of two logarithms can be looked up without reducing it. */
+static byte expTable[ 2 * GROUP_ORDER ];
+
+/** Every product in the field, productTable[ a ][ b ] = a * b. */
+static byte productTable[ FIELD_SIZE ][ FIELD_SIZE ];
+
+/** Makes sure the log tables are only built once, even if several threads need them at the same time. */
+static pthread_once_t logOnce = PTHREAD_ONCE_INIT;
+
+/** Makes sure the product table is only built once. */
+static pthread_once_t productOnce = PTHREAD_ONCE_INIT;
+
+/** The implementation fieldMul() uses. */
+static byte ( *selectedMul )( byte a, byte b ) = fieldMulCt;
+
 byte fieldAdd( byte a, byte b ) {
     return a ^ b;
 }
@@ -17,6 +55,10 @@ byte fieldSub( byte a, byte b ) {
 }
 
 byte fieldMul( byte a, byte b ) {
+    return selectedMul( a, b );
+}
+
+byte fieldMulLoop( byte a, byte b ) {
     byte p = 0; // product
     byte bitcount;
     byte most_sig_bit;
@@ -32,5 +74,256 @@ byte fieldMul( byte a, byte b ) {
         }
         b >>= 1;
     }
-    return p;   
+    return p;
+}
+
+byte fieldMulCt( byte a, byte b ) {
+    byte p = 0;
+    for ( int bitcount = 0; bitcount < BBITS; bitcount++ ) {
+        // -( x & 1 ) is all ones when the bit is set and zero when it isn't, so it selects without branching.
+        p ^= a & -( b & 1 );
+        a = ( a << 1 ) ^ ( REDUCER & -( a >> ( BBITS - 1 ) ) );
+        b >>= 1;
+    }
+    return p;
+}
+
+/**
+   Build the log and antilog tables from the powers of the generator.
+*/
+static void buildLogTables( void ) {
+    byte power = 1;
+    for ( int i = 0; i < GROUP_ORDER; i++ ) {
+        expTable[ i ] = expTable[ i + GROUP_ORDER ] = power;
+        logTable[ power ] = i;
+        power = fieldMulLoop( power, GENERATOR );
+    }
+}
+
+/**
+   Multiply by adding logarithms, once the log tables are known to be built.
+   @param a the first byte value to multiply.
+   @param b the second byte value to multiply.
+   @return the product.
+*/
+static byte logMul( byte a, byte b ) {
+    if ( a == 0 || b == 0 ) {
+        return 0;
+    }
+    return expTable[ logTable[ a ] + logTable[ b ] ];
+}
+
+byte fieldMulLog( byte a, byte b ) {
+    pthread_once( &logOnce, buildLogTables );
+    return logMul( a, b );
+}
+
+/**
+   Build the table of every product.
+*/
+static void buildProductTable( void ) {
+    for ( int a = 0; a < FIELD_SIZE; a++ ) {
+        for ( int b = 0; b < FIELD_SIZE; b++ ) {
+            productTable[ a ][ b ] = fieldMulLog( a, b );
+        }
+    }
+}
+
+/**
+   Look up a product, once the product table is known to be built.
+   @param a the first byte value to multiply.
+   @param b the second byte value to multiply.
+   @return the product.
+*/
+static byte tableMul( byte a, byte b ) {
+    return productTable[ a ][ b ];
+}
+
+byte fieldMulTable( byte a, byte b ) {
+    pthread_once( &productOnce, buildProductTable );
+    return tableMul( a, b );
+}
+
+bool fieldSelectMul( FieldMulImpl impl ) {
+    static byte ( *const impls[ FIELD_MUL_IMPLS ] )( byte, byte ) = { fieldMulLoop, logMul, tableMul, fieldMulCt };
+    if ( ( unsigned ) impl >= FIELD_MUL_IMPLS ) {
+        return false;
+    }
+
+    // The tables are built now, so the multiplies fieldMul() passes on don't each have to check.
+    if ( impl == FIELD_MUL_LOG ) {
+        pthread_once( &logOnce, buildLogTables );
+    } else if ( impl == FIELD_MUL_TABLE ) {
+        pthread_once( &productOnce, buildProductTable );
+    }
+    selectedMul = impls[ impl ];
+    return true;
+}
+
+byte fieldInv( byte a ) {
+    pthread_once( &logOnce, buildLogTables );
+    if ( a == 0 ) {
+        return 0;
+    }
+    return expTable[ GROUP_ORDER - logTable[ a ] ];
+}
+
+/**
+   Fill in the two shuffle tables for multiplying by c: the products of c with every value of a low nibble, and with
+   every value of a high nibble. Any byte's product is the sum of the entries for its two nibbles.
+   @param c the constant.
+   @param lo the products with low nibbles.
+   @param hi the products with high nibbles.
+*/
+static void nibbleTables( byte c, byte lo[ NIBBLE_VALUES ], byte hi[ NIBBLE_VALUES ] ) {
+    for ( int i = 0; i < NIBBLE_VALUES; i++ ) {
+        lo[ i ] = fieldMulLog( c, i );
+        hi[ i ] = fieldMulLog( c, i << NIBBLE_BITS );
+    }
+}
+
+/**
+   Multiply a buffer by a constant a byte at a time with the nibble tables, either storing or adding the products.
+   @param dst where the products go.
+   @param src the values to multiply.
+   @param lo the products of the constant with low nibbles.
+   @param hi the products of the constant with high nibbles.
+   @param n the number of bytes.
+   @param add true to add the products into dst instead of storing them.
+*/
+static void mulRegionScalar( byte *dst, byte const *src, byte const lo[ NIBBLE_VALUES ], byte const hi[ NIBBLE_VALUES ],
+                             size_t n, bool add ) {
+    for ( size_t i = 0; i < n; i++ ) {
+        byte p = lo[ src[ i ] & NIBBLE_MASK ] ^ hi[ src[ i ] >> NIBBLE_BITS ];
+        dst[ i ] = add ? dst[ i ] ^ p : p;
+    }
+}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+
+/** Bytes in an SSE register. */
+#define SSE_BYTES 16
+
+/** Bytes in an AVX2 register. */
+#define AVX2_BYTES 32
+
+/**
+   Multiply a buffer by a constant sixteen bytes at a time. PSHUFB looks up all sixteen low nibbles in the low
+   nibble table at once, and the same for the high nibbles.
+   @param dst where the products go.
+   @param src the values to multiply.
+   @param lo the products of the constant with low nibbles.
+   @param hi the products of the constant with high nibbles.
+   @param n the number of bytes.
+   @param add true to add the products into dst instead of storing them.
+   @return the number of bytes done, a multiple of SSE_BYTES.
+*/
+__attribute__(( target( "ssse3" ) ))
+static size_t mulRegionSsse3( byte *dst, byte const *src, byte const lo[ NIBBLE_VALUES ],
+                              byte const hi[ NIBBLE_VALUES ], size_t n, bool add ) {
+    __m128i tlo = _mm_loadu_si128( (__m128i const *) lo );
+    __m128i thi = _mm_loadu_si128( (__m128i const *) hi );
+    __m128i mask = _mm_set1_epi8( NIBBLE_MASK );
+
+    size_t i = 0;
+    for ( ; i + SSE_BYTES <= n; i += SSE_BYTES ) {
+        __m128i x = _mm_loadu_si128( (__m128i const *) ( src + i ) );
+        __m128i p = _mm_xor_si128( _mm_shuffle_epi8( tlo, _mm_and_si128( x, mask ) ),
+                                   _mm_shuffle_epi8( thi, _mm_and_si128( _mm_srli_epi64( x, NIBBLE_BITS ), mask ) ) );
+        if ( add ) {
+            p = _mm_xor_si128( p, _mm_loadu_si128( (__m128i const *) ( dst + i ) ) );
+        }
+        _mm_storeu_si128( (__m128i *) ( dst + i ), p );
+    }
+    return i;
+}
+
+/**
+   Multiply a buffer by a constant thirty-two bytes at a time, the same way as mulRegionSsse3() but with AVX2's
+   VPSHUFB, which does the lookups in each 16-byte half with the same tables.
+   @param dst where the products go.
+   @param src the values to multiply.
+   @param lo the products of the constant with low nibbles.
+   @param hi the products of the constant with high nibbles.
+   @param n the number of bytes.
+   @param add true to add the products into dst instead of storing them.
+   @return the number of bytes done, a multiple of AVX2_BYTES.
+*/
+__attribute__(( target( "avx2" ) ))
+static size_t mulRegionAvx2( byte *dst, byte const *src, byte const lo[ NIBBLE_VALUES ],
+                             byte const hi[ NIBBLE_VALUES ], size_t n, bool add ) {
+    __m256i tlo = _mm256_broadcastsi128_si256( _mm_loadu_si128( (__m128i const *) lo ) );
+    __m256i thi = _mm256_broadcastsi128_si256( _mm_loadu_si128( (__m128i const *) hi ) );
+    __m256i mask = _mm256_set1_epi8( NIBBLE_MASK );
+
+    size_t i = 0;
+    for ( ; i + AVX2_BYTES <= n; i += AVX2_BYTES ) {
+        __m256i x = _mm256_loadu_si256( (__m256i const *) ( src + i ) );
+        __m256i p = _mm256_xor_si256( _mm256_shuffle_epi8( tlo, _mm256_and_si256( x, mask ) ),
+                                      _mm256_shuffle_epi8( thi, _mm256_and_si256( _mm256_srli_epi64( x, NIBBLE_BITS ),
+                                                                                  mask ) ) );
+        if ( add ) {
+            p = _mm256_xor_si256( p, _mm256_loadu_si256( (__m256i const *) ( dst + i ) ) );
+        }
+        _mm256_storeu_si256( (__m256i *) ( dst + i ), p );
+    }
+    return i;
+}
+
+/**
+   Multiply as much of a buffer as possible with the widest shuffle the processor has.
+   @param dst where the products go.
+   @param src the values to multiply.
+   @param lo the products of the constant with low nibbles.
+   @param hi the products of the constant with high nibbles.
+   @param n the number of bytes.
+   @param add true to add the products into dst instead of storing them.
+   @return the number of bytes done; the rest are left for the scalar code.
+*/
+static size_t mulRegionSimd( byte *dst, byte const *src, byte const lo[ NIBBLE_VALUES ], byte const hi[ NIBBLE_VALUES ],
+                             size_t n, bool add ) {
+    if ( cpuHas( CPU_AVX2 ) ) {
+        return mulRegionAvx2( dst, src, lo, hi, n, add );
+    }
+    if ( cpuHas( CPU_SSSE3 ) ) {
+        return mulRegionSsse3( dst, src, lo, hi, n, add );
+    }
+    return 0;
+}
+
+#else
+
+/**
+   There are no byte shuffles off x86, so the scalar code does everything.
+   @return 0.
+*/
+static size_t mulRegionSimd( byte *dst, byte const *src, byte const lo[ NIBBLE_VALUES ], byte const hi[ NIBBLE_VALUES ],
+                             size_t n, bool add ) {
+    return 0;
+}
+
+#endif
+
+/**
+   Multiply a buffer by a constant, either storing or adding the products.
+   @param dst where the products go.
+   @param src the values to multiply.
+   @param c the constant.
+   @param n the number of bytes.
+   @param add true to add the products into dst instead of storing them.
+*/
+static void mulRegion( byte *dst, byte const *src, byte c, size_t n, bool add ) {
+    byte lo[ NIBBLE_VALUES ], hi[ NIBBLE_VALUES ];
+    nibbleTables( c, lo, hi );
+    size_t done = mulRegionSimd( dst, src, lo, hi, n, add );
+    mulRegionScalar( dst + done, src + done, lo, hi, n - done, add );
+}
+
+void fieldMulRegion( byte *dst, byte const *src, byte c, size_t n ) {
+    mulRegion( dst, src, c, n, false );
+}
+
+void fieldMulAddRegion( byte *dst, byte const *src, byte c, size_t n ) {
+    mulRegion( dst, src, c, n, true );
 }
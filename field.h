@@ -10,9 +10,33 @@
 /** Macro defined for unit testing */
 #define _FIELD_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+
 /** Type used for our field, an unsigned byte. */
 typedef unsigned char byte;
 
+/** Number of values in the field. */
+#define FIELD_SIZE 256
+
+/** The ways fieldMul() can be computed; they all give the same answers. */
+typedef enum {
+  /** Shift and add a bit at a time, branching on each bit. */
+  FIELD_MUL_LOOP,
+
+  /** Add logarithms, with 768 bytes of log and antilog tables. */
+  FIELD_MUL_LOG,
+
+  /** Look up the answer in a 64 KB table of every product. */
+  FIELD_MUL_TABLE,
+
+  /** Shift and add a bit at a time with masks instead of branches, so the time taken doesn't depend on the values. */
+  FIELD_MUL_CT,
+
+  /** Number of implementations. */
+  FIELD_MUL_IMPLS
+} FieldMulImpl;
+
 /** Number of bits in a byte. */
 #define BBITS 8
 
@@ -40,10 +64,81 @@ byte fieldSub( byte a, byte b );
 
 /**
  * This function performs the multiplication operation in the 8-bit Galois field used by AES. It multiplies a and b and returns the result.
+ * It uses whichever implementation fieldSelectMul() chose, FIELD_MUL_CT unless it was called, since the values may be
+ * secret and the faster table versions look up memory that depends on them.
  * @param a the first byte value to multiply
  * @param b the second byte value to multiply
  * @return the product of multiplication in the 8-bit Galois field
 */
 byte fieldMul( byte a, byte b );
 
+/**
+ * This function chooses the implementation fieldMul() uses, building any tables it needs now rather than on each
+ * multiply. It should be called before any threads that use the field are started. Only pick a table version when the
+ * values multiplied aren't secret.
+ * @param impl the implementation to use
+ * @return false, leaving the choice alone, if impl isn't one of the implementations
+*/
+bool fieldSelectMul( FieldMulImpl impl );
+
+/**
+ * This function multiplies in the field a bit at a time, with a branch on every bit.
+ * @param a the first byte value to multiply
+ * @param b the second byte value to multiply
+ * @return the product
+*/
+byte fieldMulLoop( byte a, byte b );
+
+/**
+ * This function multiplies in the field by adding the logarithms of a and b and looking up the antilogarithm.
+ * @param a the first byte value to multiply
+ * @param b the second byte value to multiply
+ * @return the product
+*/
+byte fieldMulLog( byte a, byte b );
+
+/**
+ * This function multiplies in the field by looking the product up in a table of all of them.
+ * @param a the first byte value to multiply
+ * @param b the second byte value to multiply
+ * @return the product
+*/
+byte fieldMulTable( byte a, byte b );
+
+/**
+ * This function multiplies in the field with a chain of xtime steps and masks, without branches or table lookups that
+ * depend on a or b, so it can be used on secret values.
+ * @param a the first byte value to multiply
+ * @param b the second byte value to multiply
+ * @return the product
+*/
+byte fieldMulCt( byte a, byte b );
+
+/**
+ * This function finds the multiplicative inverse of a value in the field.
+ * @param a the value to invert
+ * @return the value that gives 1 when multiplied by a, or 0 if a is 0
+*/
+byte fieldInv( byte a );
+
+/**
+ * This function multiplies every byte of a buffer by a constant: dst[i] = c * src[i]. It uses SSSE3 or AVX2 byte
+ * shuffles on processors that have them.
+ * @param dst where the products go, which may be the same as src
+ * @param src the values to multiply
+ * @param c the constant to multiply by
+ * @param n the number of bytes
+*/
+void fieldMulRegion( byte *dst, byte const *src, byte c, size_t n );
+
+/**
+ * This function multiplies every byte of a buffer by a constant and adds the result into another buffer:
+ * dst[i] = dst[i] + c * src[i]. It uses SSSE3 or AVX2 byte shuffles on processors that have them.
+ * @param dst the values to add to
+ * @param src the values to multiply
+ * @param c the constant to multiply by
+ * @param n the number of bytes
+*/
+void fieldMulAddRegion( byte *dst, byte const *src, byte c, size_t n );
+
 #endif
@@ -6,11 +6,13 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "field.h"
 
 /** Number of tests we should have, if they're all turned on. */
-#define EXPECTED_TOTAL 10
+#define EXPECTED_TOTAL 19
 
 /** Total number or tests we tried. */
 static int totalTests = 0;
@@ -80,6 +82,66 @@ int main()
     TestCase( c == 0xF3 );
   }
 
+  ////////////////////////////////////////////////////////////////////////
+  // Test the other fieldMul() implementations against the loop, on every pair of values
+
+  {
+    bool logOk = true, tableOk = true, ctOk = true;
+    for ( int a = 0; a < FIELD_SIZE; a++ )
+      for ( int b = 0; b < FIELD_SIZE; b++ ) {
+        byte p = fieldMulLoop( a, b );
+        logOk = logOk && fieldMulLog( a, b ) == p;
+        tableOk = tableOk && fieldMulTable( a, b ) == p;
+        ctOk = ctOk && fieldMulCt( a, b ) == p;
+      }
+    TestCase( logOk );
+    TestCase( tableOk );
+    TestCase( ctOk );
+
+    // fieldMul() follows the selection, and a value that isn't an implementation is turned down.
+    TestCase( fieldSelectMul( FIELD_MUL_TABLE ) && fieldMul( 0x3B, 0x57 ) == 0x7E );
+    TestCase( !fieldSelectMul( FIELD_MUL_IMPLS ) && !fieldSelectMul( ( FieldMulImpl ) -1 ) &&
+              fieldMul( 0x3B, 0x57 ) == 0x7E );
+    fieldSelectMul( FIELD_MUL_CT );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test fieldInv()
+
+  {
+    bool ok = fieldInv( 0x00 ) == 0x00;
+    for ( int a = 1; a < FIELD_SIZE; a++ )
+      ok = ok && fieldMul( a, fieldInv( a ) ) == 0x01;
+    TestCase( ok );
+    TestCase( fieldInv( 0x53 ) == 0xCA );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test fieldMulRegion() and fieldMulAddRegion(), with odd lengths and offsets so the
+  // vector code and the leftover bytes both get used
+
+  {
+    byte src[ 301 ], dst[ 301 ], acc[ 301 ];
+    for ( int i = 0; i < 301; i++ ) {
+      src[ i ] = i * 37 + 11;
+      acc[ i ] = i * 101 + 5;
+    }
+
+    bool mulOk = true, addOk = true;
+    for ( int c = 0; c < FIELD_SIZE; c += 7 ) {
+      fieldMulRegion( dst, src + 3, c, 297 );
+      for ( int i = 0; i < 297; i++ )
+        mulOk = mulOk && dst[ i ] == fieldMulLoop( c, src[ i + 3 ] );
+
+      memcpy( dst, acc, sizeof( acc ) );
+      fieldMulAddRegion( dst + 1, src, c, 299 );
+      for ( int i = 0; i < 299; i++ )
+        addOk = addOk && dst[ i + 1 ] == ( acc[ i + 1 ] ^ fieldMulLoop( c, src[ i ] ) );
+    }
+    TestCase( mulOk );
+    TestCase( addOk );
+  }
+
   // Once you move the #ifdef DISABLE_TESTS to here, you've enabled
   // all the tests.
   #ifdef DISABLE_TESTS
@@ -0,0 +1,321 @@
+/**
+ * @file ghash.c
+ * @author Jimin Yu, jyu34
+ * This file implements GHASH two ways: portably, with Shoup's method of multiplying by the hash key four bits at a time
+ * from a 16-entry table, and with the PCLMULQDQ carry-less multiply instruction, which hashes GHASH_STRIDE blocks per
+ * reduction. The instruction path is compiled for PCLMULQDQ on its own and only used when cpuHas() says it's there.
+*/
+
+#include "ghash.h"
+#include "aes.h"
+#include "cpu.h"
+#include <string.h>
+
+/** Number of bytes in each half of a block. */
+#define HALF_BLOCK 8
+
+/** Number of bits in a nibble. */
+#define NIBBLE_BITS 4
+
+/** Mask for the low nibble of a byte. */
+#define NIBBLE_MASK 0x0F
+
+/** The reduction polynomial x^128 + x^7 + x^2 + x + 1, in the top byte of the high half with GCM's bit order. */
+#define GHASH_REDUCER 0xE100000000000000ULL
+
+/** Bit position of the reduction values in last4[] within the high half. */
+#define LAST4_SHIFT 48
+
+/** Number of bits in a 64-bit word, less one. */
+#define TOP_BIT 63
+
+/**
+   What has to be added back into the high bits when four bits are shifted off the low end of a product, for each
+   value of those four bits.
+*/
+static uint64_t const last4[ GHASH_NIBBLES ] = {
+  0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+  0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0 };
+
+void ghashMul( byte x[ BLOCK_SIZE ], byte const y[ BLOCK_SIZE ] )
+{
+  uint64_t zh = 0, zl = 0;
+  uint64_t vh = loadBig64( y ), vl = loadBig64( y + HALF_BLOCK );
+
+  // GCM numbers bits from the most significant end, so x^0 is the top bit of the first byte. The values can be the
+  // hash key or the hash state, so bits only ever pick things through masks, never through branches.
+  for ( int i = 0; i < BLOCK_SIZE * BBITS; i++ ) {
+    uint64_t mask = -( uint64_t ) ( ( x[ i / BBITS ] >> ( BBITS - 1 - i % BBITS ) ) & 1 );
+    zh ^= vh & mask;
+    zl ^= vl & mask;
+
+    // Multiply v by x, reducing if a term falls off the end.
+    uint64_t carry = vl & 1;
+    vl = ( vl >> 1 ) | ( vh << TOP_BIT );
+    vh >>= 1;
+    vh ^= GHASH_REDUCER & -carry;
+  }
+
+  storeBig64( x, zh );
+  storeBig64( x + HALF_BLOCK, zl );
+}
+
+void ghashPow( byte result[ BLOCK_SIZE ], byte const x[ BLOCK_SIZE ], uint64_t exponent )
+{
+  // The multiplicative identity is the value with only the x^0 bit set. Only the exponent, a public block count,
+  // decides which products are taken; ghashMul() itself doesn't branch on the values.
+  byte square[ BLOCK_SIZE ];
+  memcpy( square, x, BLOCK_SIZE );
+  memset( result, 0, BLOCK_SIZE );
+  result[ 0 ] = HIBIT;
+
+  while ( exponent ) {
+    if ( exponent & 1 )
+      ghashMul( result, square );
+    exponent >>= 1;
+    if ( exponent ) {
+      byte copy[ BLOCK_SIZE ];
+      memcpy( copy, square, BLOCK_SIZE );
+      ghashMul( square, copy );
+    }
+  }
+}
+
+/**
+   Multiply a value by the hash key with the 4-bit tables, a nibble at a time from the last byte to the first.
+   @param key the precomputed hash key.
+   @param x the value, replaced with the product.
+*/
+static void tableMul( GhashKey const *key, byte x[ BLOCK_SIZE ] )
+{
+  int lo = x[ BLOCK_SIZE - 1 ] & NIBBLE_MASK;
+  uint64_t zh = key->tableHi[ lo ];
+  uint64_t zl = key->tableLo[ lo ];
+
+  for ( int i = BLOCK_SIZE - 1; i >= 0; i-- ) {
+    lo = x[ i ] & NIBBLE_MASK;
+    int hi = x[ i ] >> NIBBLE_BITS;
+
+    if ( i != BLOCK_SIZE - 1 ) {
+      int rem = zl & NIBBLE_MASK;
+      zl = ( zh << ( TOP_BIT + 1 - NIBBLE_BITS ) ) | ( zl >> NIBBLE_BITS );
+      zh = ( zh >> NIBBLE_BITS ) ^ ( last4[ rem ] << LAST4_SHIFT );
+      zh ^= key->tableHi[ lo ];
+      zl ^= key->tableLo[ lo ];
+    }
+
+    int rem = zl & NIBBLE_MASK;
+    zl = ( zh << ( TOP_BIT + 1 - NIBBLE_BITS ) ) | ( zl >> NIBBLE_BITS );
+    zh = ( zh >> NIBBLE_BITS ) ^ ( last4[ rem ] << LAST4_SHIFT );
+    zh ^= key->tableHi[ hi ];
+    zl ^= key->tableLo[ hi ];
+  }
+
+  storeBig64( x, zh );
+  storeBig64( x + HALF_BLOCK, zl );
+}
+
+/**
+   Absorb blocks with the 4-bit tables.
+   @param key the precomputed hash key.
+   @param state the running hash value.
+   @param data the blocks to absorb.
+   @param nblocks the number of blocks.
+*/
+static void tableBlocks( GhashKey const *key, byte state[ BLOCK_SIZE ], byte const *data, size_t nblocks )
+{
+  for ( size_t b = 0; b < nblocks; b++ ) {
+    for ( int i = 0; i < BLOCK_SIZE; i++ )
+      state[ i ] ^= data[ b * BLOCK_SIZE + i ];
+    tableMul( key, state );
+  }
+}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+
+/** Instruction set extensions the functions below are compiled for. */
+#define CLMUL_TARGET __attribute__(( target( "pclmul,ssse3" ) ))
+
+/** Bits a 32-bit lane is shifted by in the first step of the reduction. */
+#define REDUCE_SHIFT1 31
+
+/** Bits for the second step of the reduction. */
+#define REDUCE_SHIFT2 30
+
+/** Bits for the third step of the reduction. */
+#define REDUCE_SHIFT3 25
+
+/** Bits for the matching right shifts in the second half of the reduction. */
+#define REDUCE_SHIFT4 7
+
+/** Bytes in a 32-bit lane. */
+#define LANE_BYTES 4
+
+/** Bytes in the top three 32-bit lanes. */
+#define THREE_LANES 12
+
+/**
+   Reverse the bytes of a block, since PCLMULQDQ wants the most significant byte last.
+   @param x the block.
+   @return x with its bytes reversed.
+*/
+CLMUL_TARGET static __m128i reverse( __m128i x )
+{
+  return _mm_shuffle_epi8( x, _mm_set_epi8( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 ) );
+}
+
+/**
+   Add the 256-bit carry-less product of a and b into lo and hi, without reducing it. Products that are going to be
+   added together can share one reduction.
+   @param a the first value, byte-reversed.
+   @param b the second value, byte-reversed.
+   @param lo the low half of the running sum.
+   @param hi the high half of the running sum.
+*/
+CLMUL_TARGET static void clmulAdd( __m128i a, __m128i b, __m128i *lo, __m128i *hi )
+{
+  __m128i low = _mm_clmulepi64_si128( a, b, 0x00 );
+  __m128i mid = _mm_xor_si128( _mm_clmulepi64_si128( a, b, 0x10 ), _mm_clmulepi64_si128( a, b, 0x01 ) );
+  __m128i high = _mm_clmulepi64_si128( a, b, 0x11 );
+  *lo = _mm_xor_si128( *lo, _mm_xor_si128( low, _mm_slli_si128( mid, HALF_BLOCK ) ) );
+  *hi = _mm_xor_si128( *hi, _mm_xor_si128( high, _mm_srli_si128( mid, HALF_BLOCK ) ) );
+}
+
+/**
+   Reduce a 256-bit carry-less product to an element of GF(2^128). GCM's bits are reflected, so the product is first
+   shifted left by one, then folded down with the reduction polynomial.
+   @param lo the low half of the product.
+   @param hi the high half of the product.
+   @return the reduced value, byte-reversed.
+*/
+CLMUL_TARGET static __m128i clmulReduce( __m128i lo, __m128i hi )
+{
+  // Shift the 256-bit value left by one bit.
+  __m128i carryLo = _mm_srli_epi32( lo, REDUCE_SHIFT1 );
+  __m128i carryHi = _mm_srli_epi32( hi, REDUCE_SHIFT1 );
+  lo = _mm_slli_epi32( lo, 1 );
+  hi = _mm_slli_epi32( hi, 1 );
+  __m128i across = _mm_srli_si128( carryLo, THREE_LANES );
+  carryHi = _mm_slli_si128( carryHi, LANE_BYTES );
+  carryLo = _mm_slli_si128( carryLo, LANE_BYTES );
+  lo = _mm_or_si128( lo, carryLo );
+  hi = _mm_or_si128( _mm_or_si128( hi, carryHi ), across );
+
+  // First phase of the reduction.
+  __m128i t = _mm_xor_si128( _mm_xor_si128( _mm_slli_epi32( lo, REDUCE_SHIFT1 ), _mm_slli_epi32( lo, REDUCE_SHIFT2 ) ),
+                             _mm_slli_epi32( lo, REDUCE_SHIFT3 ) );
+  __m128i spill = _mm_srli_si128( t, LANE_BYTES );
+  lo = _mm_xor_si128( lo, _mm_slli_si128( t, THREE_LANES ) );
+
+  // Second phase of the reduction.
+  t = _mm_xor_si128( _mm_xor_si128( _mm_srli_epi32( lo, 1 ), _mm_srli_epi32( lo, INDEX2 ) ),
+                     _mm_srli_epi32( lo, REDUCE_SHIFT4 ) );
+  t = _mm_xor_si128( t, spill );
+  return _mm_xor_si128( hi, _mm_xor_si128( lo, t ) );
+}
+
+/**
+   Absorb blocks with PCLMULQDQ. Groups of GHASH_STRIDE blocks are multiplied by H^4 down to H and summed, so each
+   group needs only one reduction.
+   @param key the precomputed hash key.
+   @param state the running hash value.
+   @param data the blocks to absorb.
+   @param nblocks the number of blocks.
+*/
+CLMUL_TARGET static void clmulBlocks( GhashKey const *key, byte state[ BLOCK_SIZE ], byte const *data, size_t nblocks )
+{
+  __m128i h[ GHASH_STRIDE ];
+  for ( int i = 0; i < GHASH_STRIDE; i++ )
+    h[ i ] = _mm_loadu_si128( (__m128i const *) key->powers[ i ] );
+  __m128i y = reverse( _mm_loadu_si128( (__m128i const *) state ) );
+
+  size_t b = 0;
+  for ( ; b + GHASH_STRIDE <= nblocks; b += GHASH_STRIDE ) {
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    byte const *p = data + b * BLOCK_SIZE;
+    __m128i x0 = _mm_xor_si128( y, reverse( _mm_loadu_si128( (__m128i const *) p ) ) );
+    clmulAdd( x0, h[ INDEX3 ], &lo, &hi );
+    clmulAdd( reverse( _mm_loadu_si128( (__m128i const *) ( p + BLOCK_SIZE ) ) ), h[ INDEX2 ], &lo, &hi );
+    clmulAdd( reverse( _mm_loadu_si128( (__m128i const *) ( p + INDEX2 * BLOCK_SIZE ) ) ), h[ 1 ], &lo, &hi );
+    clmulAdd( reverse( _mm_loadu_si128( (__m128i const *) ( p + INDEX3 * BLOCK_SIZE ) ) ), h[ 0 ], &lo, &hi );
+    y = clmulReduce( lo, hi );
+  }
+
+  for ( ; b < nblocks; b++ ) {
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    __m128i x = _mm_xor_si128( y, reverse( _mm_loadu_si128( (__m128i const *) ( data + b * BLOCK_SIZE ) ) ) );
+    clmulAdd( x, h[ 0 ], &lo, &hi );
+    y = clmulReduce( lo, hi );
+  }
+
+  _mm_storeu_si128( (__m128i *) state, reverse( y ) );
+}
+
+/**
+   The carry-less multiply path needs PCLMULQDQ, plus SSSE3 to reverse bytes.
+   @return true if this host has them.
+*/
+static bool clmulSupported( void )
+{
+  return cpuHas( CPU_PCLMUL ) && cpuHas( CPU_SSSE3 );
+}
+
+#else
+
+/**
+   There's no carry-less multiply instruction off x86.
+   @return false.
+*/
+static bool clmulSupported( void )
+{
+  return false;
+}
+
+/** Never called, since the carry-less multiply path is never used here. */
+#define clmulBlocks tableBlocks
+
+#endif
+
+void ghashInit( GhashKey *key, byte const h[ BLOCK_SIZE ] )
+{
+  memcpy( key->h, h, BLOCK_SIZE );
+
+  // Entries for single bits are H times successive powers of x; the rest are sums of those.
+  uint64_t vh = loadBig64( h ), vl = loadBig64( h + HALF_BLOCK );
+  int top = GHASH_NIBBLES / INDEX2;
+  key->tableHi[ 0 ] = key->tableLo[ 0 ] = 0;
+  key->tableHi[ top ] = vh;
+  key->tableLo[ top ] = vl;
+  for ( int i = top / INDEX2; i > 0; i /= INDEX2 ) {
+    uint64_t carry = vl & 1;
+    vl = ( vl >> 1 ) | ( vh << TOP_BIT );
+    vh >>= 1;
+    vh ^= GHASH_REDUCER & -carry;
+    key->tableHi[ i ] = vh;
+    key->tableLo[ i ] = vl;
+  }
+  for ( int i = INDEX2; i <= top; i *= INDEX2 )
+    for ( int j = 1; j < i; j++ ) {
+      key->tableHi[ i + j ] = key->tableHi[ i ] ^ key->tableHi[ j ];
+      key->tableLo[ i + j ] = key->tableLo[ i ] ^ key->tableLo[ j ];
+    }
+
+  byte power[ BLOCK_SIZE ];
+  memcpy( power, h, BLOCK_SIZE );
+  for ( int i = 0; i < GHASH_STRIDE; i++ ) {
+    for ( int j = 0; j < BLOCK_SIZE; j++ )
+      key->powers[ i ][ j ] = power[ BLOCK_SIZE - 1 - j ];
+    ghashMul( power, h );
+  }
+
+  key->clmul = clmulSupported();
+}
+
+void ghashBlocks( GhashKey const *key, byte state[ BLOCK_SIZE ], byte const *data, size_t nblocks )
+{
+  if ( key->clmul )
+    clmulBlocks( key, state, data, nblocks );
+  else
+    tableBlocks( key, state, data, nblocks );
+}
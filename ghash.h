@@ -0,0 +1,106 @@
+/**
+ * @file ghash.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for ghash.c, the GHASH universal hash that GCM uses to authenticate data. Values are 128-bit
+ * elements of GF(2^128) stored as 16 bytes, with the bit order GCM specifies.
+*/
+
+/** Macro used for unit testing */
+#ifndef _GHASH_H_
+/** Macro used for unit testing */
+#define _GHASH_H_
+
+#include "aes.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Number of 4-bit values, and so entries in each multiplication table. */
+#define GHASH_NIBBLES 16
+
+/** Number of powers of the hash key kept for the carry-less multiply path, which hashes this many blocks at once. */
+#define GHASH_STRIDE 4
+
+/** A hash key with everything precomputed for multiplying by it. */
+typedef struct {
+  /** The hash key itself. */
+  byte h[ BLOCK_SIZE ];
+
+  /** High halves of the products of the hash key with each 4-bit value. */
+  uint64_t tableHi[ GHASH_NIBBLES ];
+
+  /** Low halves of the products of the hash key with each 4-bit value. */
+  uint64_t tableLo[ GHASH_NIBBLES ];
+
+  /** H, H^2, H^3 and H^4, byte-reversed the way the carry-less multiply path wants them. */
+  byte powers[ GHASH_STRIDE ][ BLOCK_SIZE ];
+
+  /** True to use the PCLMULQDQ instruction instead of the tables. */
+  bool clmul;
+} GhashKey;
+
+/**
+ * This function loads eight bytes as a big-endian integer. It's inline, since counter and hash loops call it for every
+ * block.
+ * @param p the bytes
+ * @return the integer
+*/
+static inline uint64_t loadBig64( byte const *p )
+{
+  uint64_t v;
+  memcpy( &v, p, sizeof( v ) );
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  v = __builtin_bswap64( v );
+#endif
+  return v;
+}
+
+/**
+ * This function stores an integer as eight big-endian bytes. It's inline, since counter and hash loops call it for
+ * every block.
+ * @param p where the bytes go
+ * @param v the integer
+*/
+static inline void storeBig64( byte *p, uint64_t v )
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  v = __builtin_bswap64( v );
+#endif
+  memcpy( p, &v, sizeof( v ) );
+}
+
+/**
+ * This function multiplies two elements of GF(2^128) a bit at a time. It's slow, but works for any pair of values,
+ * so it's used for the occasional product that isn't by the hash key. It takes the same time whatever the values are.
+ * @param x the first value, replaced with the product
+ * @param y the second value
+*/
+void ghashMul( byte x[ BLOCK_SIZE ], byte const y[ BLOCK_SIZE ] );
+
+/**
+ * This function raises an element of GF(2^128) to a power, by repeated squaring.
+ * @param result where the result goes
+ * @param x the value to raise
+ * @param exponent the power to raise it to
+*/
+void ghashPow( byte result[ BLOCK_SIZE ], byte const x[ BLOCK_SIZE ], uint64_t exponent );
+
+/**
+ * This function precomputes the tables for a hash key. It uses PCLMULQDQ if the processor supports it; clearing the
+ * clmul field afterward forces the portable tables.
+ * @param key the key to fill in
+ * @param h the hash key, normally the encryption of a zero block
+*/
+void ghashInit( GhashKey *key, byte const h[ BLOCK_SIZE ] );
+
+/**
+ * This function absorbs whole blocks into a running GHASH value: for each block, the state becomes (state ^ block) * H.
+ * @param key the precomputed hash key
+ * @param state the running hash value
+ * @param data the blocks to absorb
+ * @param nblocks the number of blocks
+*/
+void ghashBlocks( GhashKey const *key, byte state[ BLOCK_SIZE ], byte const *data, size_t nblocks );
+
+#endif
@@ -1,42 +1,303 @@
 /**
  * @file io.c
  * @author Jimin Yu, jyu34
- * This file contains the functionality responsible for reading input files and writing output files when 
- * the encrypt or decrypt program is done.
+ * This file contains the functionality responsible for reading input files and writing output files, either all at
+ * once or a piece at a time for the streaming pipeline.
 */
 
+#define _DEFAULT_SOURCE
+#define _FILE_OFFSET_BITS 64
+
 #include "io.h"
+#include "stats.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+   Report an error with a file and exit.
+   @param message what went wrong.
+   @param filename the file it went wrong with.
+*/
+static void fileError( char const *message, char const *filename )
+{
+    fprintf( stderr, "%s: %s\n", message, filename );
+    exit( EXIT_FAILURE );
+}
 
-byte *readBinaryFile( char const *filename, int *size ) {
+byte *readBinaryFile( char const *filename, size_t *size ) {
     FILE *input = fopen( filename, "rb" );
     if ( !input ) {
-        fprintf( stderr, "Can't open file: %s\n", filename );
-        exit( EXIT_FAILURE );
+        fileError( "Can't open file", filename );
     }
 
-    fseek( input, 0, SEEK_END );
-    long fileSize = ftell( input );
+    fseeko( input, 0, SEEK_END );
+    off_t fileSize = ftello( input );
     rewind( input );
+    if ( fileSize < 0 ) {
+        fileError( "Can't read file", filename );
+    }
 
-    byte *filecontents = ( byte * ) malloc ( fileSize * sizeof( byte ) );
-    *size = ( int ) fileSize;
-    fread( filecontents, 1, *size, input );
+    // Allocate at least one byte, so an empty file still gets a buffer to free.
+    byte *filecontents = ( byte * ) malloc ( fileSize ? fileSize : 1 );
+    if ( !filecontents ) {
+        fileError( "Out of memory reading file", filename );
+    }
+    *size = ( size_t ) fileSize;
+    STATS_START( start );
+    if ( fread( filecontents, 1, *size, input ) != *size ) {
+        fileError( "Can't read file", filename );
+    }
+    STATS_STOP( STAT_READ, start, *size );
 
     fclose( input );
 
     return filecontents;
 }
 
-void writeBinaryFile( char const *filename, byte *data, int size ) {
+void writeBinaryFile( char const *filename, byte *data, size_t size ) {
+    FILE *output = openOutputFile( filename );
+    writeChunk( output, data, size, filename );
+    closeFile( output, filename );
+}
+
+FILE *openInputFile( char const *filename ) {
+    if ( strcmp( filename, STDIO_NAME ) == 0 ) {
+        return stdin;
+    }
+
+    FILE *input = fopen( filename, "rb" );
+    if ( !input ) {
+        fileError( "Can't open file", filename );
+    }
+    return input;
+}
+
+FILE *openOutputFile( char const *filename ) {
+    if ( strcmp( filename, STDIO_NAME ) == 0 ) {
+        return stdout;
+    }
+
     FILE *output = fopen( filename, "wb" );
     if ( !output ) {
-        fprintf( stderr, "Can't open file: %s\n", filename );
-        exit(EXIT_FAILURE);
+        fileError( "Can't open file", filename );
+    }
+    return output;
+}
+
+bool inputFileSize( FILE *fp, uint64_t *size ) {
+    struct stat info;
+    if ( fstat( fileno( fp ), &info ) != 0 || !S_ISREG( info.st_mode ) ) {
+        return false;
+    }
+
+    *size = info.st_size;
+    return true;
+}
+
+bool sameFile( char const *first, char const *second ) {
+    struct stat a, b;
+    if ( strcmp( first, STDIO_NAME ) == 0 || strcmp( second, STDIO_NAME ) == 0 ||
+         stat( first, &a ) != 0 || stat( second, &b ) != 0 || !S_ISREG( a.st_mode ) ) {
+        return false;
+    }
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+}
+
+void skipInput( FILE *fp, uint64_t count, char const *filename ) {
+    if ( count == 0 || fseeko( fp, count, SEEK_CUR ) == 0 ) {
+        return;
+    }
+
+    // Pipes can't seek, so read and throw away the bytes instead.
+    byte discard[ BUFSIZ ];
+    while ( count > 0 ) {
+        size_t n = readChunk( fp, discard, count < sizeof( discard ) ? count : sizeof( discard ), filename );
+        if ( n == 0 ) {
+            break;
+        }
+        count -= n;
+    }
+}
+
+size_t readChunk( FILE *fp, byte *data, size_t size, char const *filename ) {
+    STATS_START( start );
+    size_t total = 0;
+    while ( total < size ) {
+        size_t n = fread( data + total, 1, size - total, fp );
+        if ( n == 0 ) {
+            if ( ferror( fp ) ) {
+                fileError( "Can't read file", filename );
+            }
+            break;
+        }
+        total += n;
+    }
+    STATS_STOP( STAT_READ, start, total );
+    return total;
+}
+
+void writeChunk( FILE *fp, byte const *data, size_t size, char const *filename ) {
+    STATS_START( start );
+    if ( size > 0 && fwrite( data, 1, size, fp ) != size ) {
+        fileError( "Can't write file", filename );
+    }
+    STATS_STOP( STAT_WRITE, start, size );
+}
+
+void closeFile( FILE *fp, char const *filename ) {
+    if ( fp == stdin ) {
+        return;
     }
 
-    fwrite( data, 1, size, output );
+    // Anything still buffered is written now, so the time counts as writing.
+    STATS_START( start );
+    if ( fp == stdout ) {
+        if ( fflush( fp ) != 0 ) {
+            fileError( "Can't write file", filename );
+        }
+    } else if ( fclose( fp ) != 0 ) {
+        fileError( "Can't write file", filename );
+    }
+    STATS_STOP( STAT_WRITE, start, 0 );
+}
+
+/**
+   Map an open file into memory, and close the descriptor, which the mapping doesn't need.
+   @param fd the open file.
+   @param size the number of bytes to map.
+   @param prot the access wanted.
+   @param filename name of the file, for error messages.
+   @return the mapped contents, or NULL if size is zero.
+*/
+static byte *mapDescriptor( int fd, size_t size, int prot, char const *filename )
+{
+    if ( size == 0 ) {
+        close( fd );
+        return NULL;
+    }
+
+    void *data = mmap( NULL, size, prot, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED ) {
+        fileError( "Can't map file", filename );
+    }
+
+    // The data is processed front to back, so aggressive read-ahead pays off.
+    madvise( data, size, MADV_SEQUENTIAL );
+    return data;
+}
+
+/**
+   Open an existing file and find its size.
+   @param filename the file to open.
+   @param flags the open() flags.
+   @param size filled in with the size of the file.
+   @return the open descriptor.
+*/
+static int openSized( char const *filename, int flags, size_t *size )
+{
+    int fd = open( filename, flags );
+    if ( fd < 0 ) {
+        fileError( "Can't open file", filename );
+    }
+
+    struct stat info;
+    if ( fstat( fd, &info ) != 0 || !S_ISREG( info.st_mode ) ) {
+        fileError( "Can't map file", filename );
+    }
+    *size = info.st_size;
+    return fd;
+}
+
+byte *mapInputFile( char const *filename, size_t *size ) {
+    int fd = openSized( filename, O_RDONLY, size );
+    return mapDescriptor( fd, *size, PROT_READ, filename );
+}
+
+byte *mapOutputFile( char const *filename, size_t size ) {
+    int fd = open( filename, O_RDWR | O_CREAT | O_TRUNC, 0666 );
+    if ( fd < 0 ) {
+        fileError( "Can't open file", filename );
+    }
+    if ( ftruncate( fd, size ) != 0 ) {
+        fileError( "Can't write file", filename );
+    }
+    return mapDescriptor( fd, size, PROT_READ | PROT_WRITE, filename );
+}
+
+byte *mapFileInPlace( char const *filename, size_t *size ) {
+    int fd = openSized( filename, O_RDWR, size );
+    return mapDescriptor( fd, *size, PROT_READ | PROT_WRITE, filename );
+}
+
+void unmapFile( byte *data, size_t size ) {
+    if ( data ) {
+        munmap( data, size );
+    }
+}
+
+char const *loadFile( char const *filename, byte **data, size_t *capacity, size_t *size ) {
+    int fd = open( filename, O_RDONLY );
+    if ( fd < 0 ) {
+        return "Can't open file";
+    }
 
-    fclose( output );
+    struct stat info;
+    if ( fstat( fd, &info ) != 0 || !S_ISREG( info.st_mode ) ) {
+        close( fd );
+        return "Can't read file";
+    }
+
+    // Grow the buffer only when a file doesn't fit, with slack past the data for a tag.
+    size_t need = info.st_size + LOAD_SLACK;
+    if ( need > *capacity ) {
+        byte *bigger = realloc( *data, need );
+        if ( !bigger ) {
+            close( fd );
+            return "Out of memory reading file";
+        }
+        *data = bigger;
+        *capacity = need;
+    }
+
+    STATS_START( start );
+    size_t total = 0;
+    while ( total < ( size_t ) info.st_size ) {
+        ssize_t n = read( fd, *data + total, info.st_size - total );
+        if ( n <= 0 ) {
+            close( fd );
+            return "Can't read file";
+        }
+        total += n;
+    }
+    STATS_STOP( STAT_READ, start, total );
+    close( fd );
+    *size = total;
+    return NULL;
+}
+
+char const *saveFile( char const *filename, byte const *data, size_t size ) {
+    int fd = open( filename, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+    if ( fd < 0 ) {
+        return "Can't open file";
+    }
+
+    STATS_START( start );
+    size_t total = 0;
+    while ( total < size ) {
+        ssize_t n = write( fd, data + total, size - total );
+        if ( n <= 0 ) {
+            close( fd );
+            return "Can't write file";
+        }
+        total += n;
+    }
+    STATS_STOP( STAT_WRITE, start, total );
+    return close( fd ) == 0 ? NULL : "Can't write file";
 }
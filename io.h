@@ -4,18 +4,34 @@
  * This is the header file for io.c. It contains all function declarations.
 */
 
+/** Macro used for unit testing */
+#ifndef _IO_H_
+/** Macro used for unit testing */
+#define _IO_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
 /** Type used for our field, an unsigned byte. */
 typedef unsigned char byte;
 
+/** File name that stands for standard input or standard output. */
+#define STDIO_NAME "-"
+
+/** Extra room loadFile() leaves past the end of the data, so a little more (like a tag) can be added in place. */
+#define LOAD_SLACK 64
+
 /**
  * This function reads the contents of the binary file with the given name. It returns a pointer to a dynamically allocated
- * array of bytes containing the entire file contents. The size parameter is an integer that’s passed by reference to the
- * function. The function fills in this integer with the total size of the file (i.e., how many bytes are in the returned array).
+ * array of bytes containing the entire file contents. The size parameter is passed by reference to the function. The
+ * function fills it in with the total size of the file (i.e., how many bytes are in the returned array).
  * @param filename the file to read from
  * @param size the total size of the file, determined by the function
  * @return an array containing the entire file contents
 */
-byte *readBinaryFile( char const *filename, int *size );
+byte *readBinaryFile( char const *filename, size_t *size );
 
 /**
  * This function writes the contents of the given data array (in binary) to the file with the given name. The size parameter says
@@ -24,4 +40,128 @@ byte *readBinaryFile( char const *filename, int *size );
  * @param data an array of bytes containing the data to write
  * @param size the size of the data array, or the number of bytes to write
 */
-void writeBinaryFile( char const *filename, byte *data, int size );
+void writeBinaryFile( char const *filename, byte *data, size_t size );
+
+/**
+ * This function opens a file to be read a piece at a time. The name "-" stands for standard input.
+ * @param filename the file to open
+ * @return the open file
+*/
+FILE *openInputFile( char const *filename );
+
+/**
+ * This function opens (creating or truncating) a file to be written a piece at a time. The name "-" stands for
+ * standard output.
+ * @param filename the file to open
+ * @return the open file
+*/
+FILE *openOutputFile( char const *filename );
+
+/**
+ * This function finds out how big an open input file is, if that can be known ahead of time. It can't for pipes and
+ * terminals, only for regular files.
+ * @param fp the open file
+ * @param size filled in with the size of the file in bytes
+ * @return true if the size is known
+*/
+bool inputFileSize( FILE *fp, uint64_t *size );
+
+/**
+ * This function reports whether two names are the same regular file, by device and inode, so different paths and
+ * hard links to one file count too. Standard input and output never do.
+ * @param first one file name
+ * @param second the other file name
+ * @return true if both exist and are the same regular file
+*/
+bool sameFile( char const *first, char const *second );
+
+/**
+ * This function skips over the given number of bytes at the start of an input file, seeking if the file allows it and
+ * reading and discarding them otherwise. Skipping past the end of the file leaves it at the end.
+ * @param fp the file to skip through
+ * @param count the number of bytes to skip
+ * @param filename name of the file, for error messages
+*/
+void skipInput( FILE *fp, uint64_t count, char const *filename );
+
+/**
+ * This function reads up to size bytes from the file, stopping early only at the end of the file.
+ * @param fp the file to read
+ * @param data where to put the bytes read
+ * @param size the number of bytes wanted
+ * @param filename name of the file, for error messages
+ * @return the number of bytes read, less than size only at the end of the file
+*/
+size_t readChunk( FILE *fp, byte *data, size_t size, char const *filename );
+
+/**
+ * This function writes all of the given bytes to the file.
+ * @param fp the file to write
+ * @param data the bytes to write
+ * @param size the number of bytes to write
+ * @param filename name of the file, for error messages
+*/
+void writeChunk( FILE *fp, byte const *data, size_t size, char const *filename );
+
+/**
+ * This function closes a file opened with openInputFile() or openOutputFile(). For output files, it makes sure everything
+ * written has actually reached the file.
+ * @param fp the file to close
+ * @param filename name of the file, for error messages
+*/
+void closeFile( FILE *fp, char const *filename );
+
+/**
+ * This function maps a whole file into memory for reading, and tells the kernel it will be read sequentially.
+ * @param filename the file to map
+ * @param size filled in with the size of the file
+ * @return the mapped contents, or NULL for an empty file
+*/
+byte *mapInputFile( char const *filename, size_t *size );
+
+/**
+ * This function creates (or truncates) a file of the given size and maps it into memory for writing.
+ * @param filename the file to create
+ * @param size the size the file should have
+ * @return the mapped contents, or NULL if size is zero
+*/
+byte *mapOutputFile( char const *filename, size_t size );
+
+/**
+ * This function maps an existing file into memory for both reading and writing, so it can be changed in place.
+ * @param filename the file to map
+ * @param size filled in with the size of the file
+ * @return the mapped contents, or NULL for an empty file
+*/
+byte *mapFileInPlace( char const *filename, size_t *size );
+
+/**
+ * This function unmaps a file mapped by one of the functions above. Changes to a file mapped for writing are written
+ * back by the kernel.
+ * @param data the mapped contents, which may be NULL
+ * @param size the size of the mapping
+*/
+void unmapFile( byte *data, size_t size );
+
+/**
+ * This function reads a whole regular file into a buffer that's reused from one call to the next, growing it only
+ * when a file doesn't fit. Unlike readBinaryFile(), it reports a problem instead of exiting, for callers that go on to
+ * other files.
+ * @param filename the file to read
+ * @param data the buffer, which may be NULL to start with and is reallocated as needed
+ * @param capacity the size of the buffer, updated when it grows
+ * @param size filled in with the size of the file; the buffer has at least LOAD_SLACK bytes past it
+ * @return NULL on success, or a message saying what went wrong
+*/
+char const *loadFile( char const *filename, byte **data, size_t *capacity, size_t *size );
+
+/**
+ * This function creates (or truncates) a file and writes the given bytes to it, reporting a problem instead of exiting.
+ * @param filename the file to write
+ * @param data the bytes to write
+ * @param size the number of bytes
+ * @return NULL on success, or a message saying what went wrong
+*/
+char const *saveFile( char const *filename, byte const *data, size_t size );
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * @file lz.c
+ * @author Jimin Yu, jyu34
+ * This file contains the LZ77 compressor and decompressor. The compressor keeps, for each hash of four bytes, the last
+ * position they were seen at, and takes a match whenever the four bytes there really are the same. When nothing
+ * matches for a while it steps further and further ahead, so data that doesn't compress goes through quickly.
+*/
+
+#include "lz.h"
+#include <stdint.h>
+#include <string.h>
+
+/** Shortest match worth storing; a sequence costs at least three bytes. */
+#define LZ_MIN_MATCH 4
+
+/** Farthest back a match can be, the most two bytes can hold. */
+#define LZ_MAX_OFFSET 65535
+
+/** Number of bits in a hash, so the table is 64 KB of positions. */
+#define LZ_HASH_BITS 14
+
+/** Multiplier for the hash, from Knuth's multiplicative hashing. */
+#define LZ_HASH_PRIME 2654435761u
+
+/** Value of a length field that continues in the following bytes. */
+#define LZ_MORE 15
+
+/** Value of a continuation byte that's followed by another. */
+#define LZ_MORE_BYTE 255
+
+/** log2 of how many misses it takes to step one byte further on each try. */
+#define LZ_SKIP_SHIFT 6
+
+/**
+   Load four bytes, in whatever order the processor uses; it's only used for hashing and comparing.
+   @param p the bytes.
+   @return the bytes as a number.
+*/
+static uint32_t load32( byte const *p )
+{
+  uint32_t v;
+  memcpy( &v, p, sizeof( v ) );
+  return v;
+}
+
+/**
+   Hash four bytes to a position in the table.
+   @param v the bytes, from load32().
+   @return the hash.
+*/
+static uint32_t hash( uint32_t v )
+{
+  return ( v * LZ_HASH_PRIME ) >> ( 32 - LZ_HASH_BITS );
+}
+
+/**
+   Count how many bytes match, starting with two that are already known to match for LZ_MIN_MATCH bytes.
+   @param a the earlier position.
+   @param b the later position.
+   @param end the end of the input, which b's match can't go past.
+   @return the match length.
+*/
+static size_t matchLength( byte const *a, byte const *b, byte const *end )
+{
+  byte const *start = b;
+  a += LZ_MIN_MATCH;
+  b += LZ_MIN_MATCH;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // Compare eight bytes at a time; the lowest differing bit is in the first differing byte.
+  while ( end - b >= ( long ) sizeof( uint64_t ) ) {
+    uint64_t x, y;
+    memcpy( &x, a, sizeof( x ) );
+    memcpy( &y, b, sizeof( y ) );
+    if ( x != y )
+      return b - start + __builtin_ctzll( x ^ y ) / 8;
+    a += sizeof( uint64_t );
+    b += sizeof( uint64_t );
+  }
+#endif
+
+  while ( b < end && *a == *b ) {
+    a++;
+    b++;
+  }
+  return b - start;
+}
+
+/**
+   Write the continuation bytes of a length field.
+   @param out the output.
+   @param o position in the output, moved past the bytes.
+   @param extra the part of the length past LZ_MORE.
+*/
+static void putMore( byte *out, size_t *o, size_t extra )
+{
+  for ( ; extra >= LZ_MORE_BYTE; extra -= LZ_MORE_BYTE )
+    out[ ( *o )++ ] = LZ_MORE_BYTE;
+  out[ ( *o )++ ] = extra;
+}
+
+/**
+   Write one sequence: literals, then a match unless matchLen is 0.
+   @param out the output.
+   @param o position in the output, moved past the sequence.
+   @param capacity the size of the output.
+   @param literals the literal bytes.
+   @param litLen the number of literal bytes.
+   @param offset the match's distance back.
+   @param matchLen the match's length, or 0 for the last sequence.
+   @return false if the sequence doesn't fit.
+*/
+static bool putSequence( byte *out, size_t *o, size_t capacity, byte const *literals, size_t litLen, size_t offset,
+                         size_t matchLen )
+{
+  // The worst case for the length fields is one byte per LZ_MORE_BYTE of length, plus the token, offset and ends.
+  size_t need = 1 + litLen + litLen / LZ_MORE_BYTE + 1;
+  if ( matchLen )
+    need += 2 + matchLen / LZ_MORE_BYTE + 1;
+  if ( need > capacity - *o )
+    return false;
+
+  size_t litField = litLen < LZ_MORE ? litLen : LZ_MORE;
+  size_t matchExtra = matchLen ? matchLen - LZ_MIN_MATCH : 0;
+  size_t matchField = matchExtra < LZ_MORE ? matchExtra : LZ_MORE;
+  out[ ( *o )++ ] = litField << 4 | matchField;
+  if ( litField == LZ_MORE )
+    putMore( out, o, litLen - LZ_MORE );
+  memcpy( out + *o, literals, litLen );
+  *o += litLen;
+
+  if ( matchLen ) {
+    out[ ( *o )++ ] = offset & 0xFF;
+    out[ ( *o )++ ] = offset >> 8;
+    if ( matchField == LZ_MORE )
+      putMore( out, o, matchExtra - LZ_MORE );
+  }
+  return true;
+}
+
+size_t lzCompress( byte const *in, size_t len, byte *out, size_t capacity )
+{
+  uint32_t table[ 1 << LZ_HASH_BITS ];
+  memset( table, 0, sizeof( table ) );
+
+  size_t o = 0, anchor = 0, pos = 0;
+  while ( len >= LZ_MIN_MATCH && pos <= len - LZ_MIN_MATCH ) {
+    uint32_t v = load32( in + pos );
+    uint32_t h = hash( v );
+    size_t candidate = table[ h ];
+    table[ h ] = pos;
+
+    if ( candidate < pos && pos - candidate <= LZ_MAX_OFFSET && load32( in + candidate ) == v ) {
+      size_t matchLen = matchLength( in + candidate, in + pos, in + len );
+      if ( !putSequence( out, &o, capacity, in + anchor, pos - anchor, pos - candidate, matchLen ) )
+        return 0;
+      pos += matchLen;
+      anchor = pos;
+    } else
+      pos += 1 + ( ( pos - anchor ) >> LZ_SKIP_SHIFT );
+  }
+
+  if ( !putSequence( out, &o, capacity, in + anchor, len - anchor, 0, 0 ) )
+    return 0;
+  return o;
+}
+
+/**
+   Read the continuation bytes of a length field and add them to the length.
+   @param in the input.
+   @param len the size of the input.
+   @param i position in the input, moved past the bytes.
+   @param value the length to add to.
+   @return false if the input ran out first.
+*/
+static bool getMore( byte const *in, size_t len, size_t *i, size_t *value )
+{
+  byte b;
+  do {
+    if ( *i == len )
+      return false;
+    b = in[ ( *i )++ ];
+    *value += b;
+  } while ( b == LZ_MORE_BYTE );
+  return true;
+}
+
+bool lzDecompress( byte const *in, size_t len, byte *out, size_t outLen )
+{
+  size_t i = 0, o = 0;
+  bool ended = false;
+  while ( i < len ) {
+    byte token = in[ i++ ];
+    size_t litLen = token >> 4;
+    if ( litLen == LZ_MORE && !getMore( in, len, &i, &litLen ) )
+      return false;
+    if ( litLen > len - i || litLen > outLen - o )
+      return false;
+    memcpy( out + o, in + i, litLen );
+    i += litLen;
+    o += litLen;
+
+    // The last sequence has no match, and there always is one, so input cut off after a match is caught.
+    ended = i == len;
+    if ( ended )
+      break;
+
+    if ( len - i < 2 )
+      return false;
+    size_t offset = in[ i ] | in[ i + 1 ] << 8;
+    i += 2;
+    size_t matchLen = ( token & LZ_MORE ) + LZ_MIN_MATCH;
+    if ( ( token & LZ_MORE ) == LZ_MORE && !getMore( in, len, &i, &matchLen ) )
+      return false;
+    if ( offset == 0 || offset > o || matchLen > outLen - o )
+      return false;
+
+    // A match can overlap the bytes it's producing, which repeats a pattern, so it's copied a byte at a time then.
+    byte *dest = out + o;
+    byte const *src = dest - offset;
+    if ( offset >= matchLen )
+      memcpy( dest, src, matchLen );
+    else
+      for ( size_t k = 0; k < matchLen; k++ )
+        dest[ k ] = src[ k ];
+    o += matchLen;
+  }
+  return ended && o == outLen;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file lz.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for lz.c, a small LZ77 compressor in the style of LZ4: repeats are found with a single hash
+ * table lookup per position and stored as a distance back and a length, with no entropy coding, so it runs at
+ * hundreds of MB per second and still shrinks text like logs and CSV several times over.
+*/
+
+/** Macro used for unit testing */
+#ifndef _LZ_H_
+/** Macro used for unit testing */
+#define _LZ_H_
+
+#include "field.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * This function compresses a buffer. Each sequence in the output is a token byte with the number of literals in its
+ * high four bits and the match length less four in its low four, a field that's 15 continuing in further bytes that
+ * are added on until one isn't 255; then the literals; then, unless the input ends there, the match's distance back
+ * as two little-endian bytes and the rest of its length.
+ * @param in the bytes to compress
+ * @param len the number of bytes
+ * @param out where the compressed bytes go
+ * @param capacity the most bytes to write to out
+ * @return the number of compressed bytes, or 0 if they wouldn't fit in capacity
+*/
+size_t lzCompress( byte const *in, size_t len, byte *out, size_t capacity );
+
+/**
+ * This function decompresses what lzCompress() wrote. It checks every length and distance, so it never reads or
+ * writes outside the buffers whatever the input is.
+ * @param in the compressed bytes
+ * @param len the number of compressed bytes
+ * @param out where the decompressed bytes go
+ * @param outLen the number of bytes the input should decompress to
+ * @return true if the input was well formed and decompressed to exactly outLen bytes
+*/
+bool lzDecompress( byte const *in, size_t len, byte *out, size_t outLen );
+
+#endif
@@ -0,0 +1,151 @@
+/**
+  @file lzTest.c
+  @author Jimin Yu, jyu34
+  Unit test program for the LZ77 compressor.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lz.h"
+
+/** Number of tests we should have, if they're all turned on. */
+#define EXPECTED_TOTAL 16
+
+/** Total number or tests we tried. */
+static int totalTests = 0;
+
+/** Number of test cases passed. */
+static int passedTests = 0;
+
+/** Macro to check the condition on a test case, keep counts of
+    passed/failed tests and report a message if the test fails. */
+#define TestCase( conditional ) {\
+  totalTests += 1; \
+  if ( conditional ) { \
+    passedTests += 1; \
+  } else { \
+    printf( "**** Failed unit test on line %d of %s\n", __LINE__, __FILE__ );    \
+  } \
+}
+
+/**
+   Compress a buffer and decompress it again.
+   @param in the bytes.
+   @param len the number of bytes.
+   @param compressedLen where to put the compressed size.
+   @return true if the bytes came back unchanged.
+*/
+static bool roundTrip( byte const *in, size_t len, size_t *compressedLen )
+{
+  size_t capacity = len + len / 128 + 16;
+  byte *packed = malloc( capacity );
+  byte *unpacked = malloc( len + 1 );
+  *compressedLen = lzCompress( in, len, packed, capacity );
+  bool ok = *compressedLen > 0 && lzDecompress( packed, *compressedLen, unpacked, len ) &&
+            memcmp( in, unpacked, len ) == 0;
+  free( packed );
+  free( unpacked );
+  return ok;
+}
+
+int main()
+{
+  size_t len = 200000;
+  byte *text = malloc( len );
+  byte *noise = malloc( len );
+  byte *out = malloc( 2 * len );
+
+  // Lines of a log, which repeat a lot but not exactly.
+  size_t filled = 0;
+  for ( int line = 0; filled < len; line++ ) {
+    char buffer[ 100 ];
+    int n = snprintf( buffer, sizeof( buffer ), "2024-05-01 12:%02d:%02d INFO request %d served in %d ms\n",
+                      line / 60 % 60, line % 60, line, line * 7 % 300 );
+    size_t take = len - filled < ( size_t ) n ? len - filled : ( size_t ) n;
+    memcpy( text + filled, buffer, take );
+    filled += take;
+  }
+
+  unsigned seed = 12345;
+  for ( size_t i = 0; i < len; i++ ) {
+    seed = seed * 1103515245 + 12345;
+    noise[ i ] = seed >> 16;
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Round trips
+
+  {
+    size_t packed;
+    TestCase( roundTrip( text, 0, &packed ) );
+    TestCase( roundTrip( text, 3, &packed ) );
+    TestCase( roundTrip( text, len, &packed ) );
+    TestCase( packed < len / 4 );
+
+    // A run of one byte is a match overlapping itself.
+    memset( out, 'a', 1000 );
+    TestCase( roundTrip( out, 1000, &packed ) );
+    TestCase( packed < 20 );
+
+    // Random bytes don't compress, but still come back.
+    TestCase( roundTrip( noise, len, &packed ) );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Output that doesn't fit
+
+  {
+    // Random bytes can't be made smaller.
+    TestCase( lzCompress( noise, len, out, len - 1 ) == 0 );
+
+    // Nothing is written past the capacity.
+    memset( out, 0xA5, 2 * len );
+    TestCase( lzCompress( text, len, out, 100 ) == 0 );
+    bool untouched = true;
+    for ( size_t i = 100; i < 2 * len; i++ )
+      untouched = untouched && out[ i ] == 0xA5;
+    TestCase( untouched );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Malformed input
+
+  {
+    size_t packed = lzCompress( text, len, out, 2 * len );
+    byte *back = malloc( len + 1 );
+
+    // The wrong length, either way.
+    TestCase( !lzDecompress( out, packed, back, len - 1 ) );
+    TestCase( !lzDecompress( out, packed, back, len + 1 ) );
+    TestCase( lzDecompress( out, packed, back, len ) && memcmp( back, text, len ) == 0 );
+
+    // Cut short.
+    TestCase( !lzDecompress( out, packed - 1, back, len ) );
+
+    // A match reaching back before the start: one literal, then a distance of 2.
+    byte far[] = { 0x10, 'x', 0x02, 0x00 };
+    TestCase( !lzDecompress( far, sizeof( far ), back, 5 ) );
+
+    // A distance of 0.
+    byte zero[] = { 0x10, 'x', 0x00, 0x00 };
+    TestCase( !lzDecompress( zero, sizeof( zero ), back, 5 ) );
+    free( back );
+  }
+
+  free( text );
+  free( noise );
+  free( out );
+
+  // Report a message if some tests are still disabled.
+  if ( totalTests < EXPECTED_TOTAL )
+    printf( "** %d of %d tests currently enabled.\n", totalTests,
+            EXPECTED_TOTAL );
+
+  // Exit successfully if all tests are enabled and they all pass.
+  if ( passedTests != EXPECTED_TOTAL )
+    return EXIT_FAILURE;
+  else
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,614 @@
+/**
+  @file microBench.c
+  @author Jimin Yu, jyu34
+  Microbenchmarks for the individual AES steps and field operations. Each one is called in batches, after a few
+  warm-up batches, and the cost per call of every batch is kept so the median and percentiles can be reported, from
+  the time stamp counter and, where the kernel allows it, the processor's own cycle, instruction and branch miss
+  counters.
+*/
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "aes.h"
+#include "field.h"
+#include "stats.h"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+/** Default number of timed batches for each primitive. */
+#define DEFAULT_SAMPLES 1001
+
+/** Default number of calls in each batch. */
+#define DEFAULT_BATCH 1000
+
+/** Default number of untimed batches run first. */
+#define DEFAULT_WARMUP 100
+
+/** Most primitives that can be picked with --only. */
+#define MAX_LIST 32
+
+/** Nanoseconds in a second. */
+#define NANOS 1e9
+
+/** Number of hardware counters read, when they're available. */
+#define COUNTERS PERF_COUNTERS
+
+/** The lower percentile reported. */
+#define P10 10
+
+/** The median, as a percentile. */
+#define P50 50
+
+/** The upper percentiles reported, showing how far the slow samples stretch. */
+#define P90 90
+#define P99 99
+
+/** Ways of writing the results. */
+typedef enum { FORMAT_TEXT, FORMAT_JSON, FORMAT_CSV } Format;
+
+/** One primitive to time. */
+typedef struct {
+  /** Name used in the results and with --only. */
+  char const *name;
+
+  /**
+     Calls the primitive the given number of times, each call using the result of the one before so none of them
+     can be skipped or overlapped.
+     @param count the number of calls.
+  */
+  void ( *run )( long count );
+} Primitive;
+
+/** Cost per call of every sample, for one primitive. */
+typedef struct {
+  /** Time stamp counter ticks per call. */
+  double *ticks;
+
+  /** Nanoseconds per call. */
+  double *nanos;
+
+  /** Core cycles, instructions and branch misses per call, if the counters are open; NaN for a sample whose
+      counters couldn't be read. */
+  double *counts[ COUNTERS ];
+} Samples;
+
+/** Anything the primitives produce ends up here, so their results are used. */
+static volatile byte sink;
+
+/** The hardware counters, opened as one group so each sample's values cover the same calls. */
+static PerfCounters counters = { { -1, -1, -1 }, true };
+
+/** True if the hardware counters are open. */
+static bool counting = false;
+
+/** What the hardware counters count. */
+static CounterEvent const counterEvents[ COUNTERS ] = { COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_BRANCH_MISSES };
+
+/** Names of the hardware counters, in the order they're read. */
+static char const *const counterNames[ COUNTERS ] = { "cycles", "instructions", "branch-misses" };
+
+/**
+   Read a clock that only goes forward.
+   @return the time in seconds.
+*/
+static double now( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec / NANOS;
+}
+
+/**
+   Read the processor's time stamp counter, after everything before it has finished.
+   @return the count, or 0 if the processor doesn't have one.
+*/
+static double ticks( void )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+  _mm_lfence();
+  double t = __rdtsc();
+  _mm_lfence();
+  return t;
+#else
+  return 0;
+#endif
+}
+
+/**
+   Time fieldMul(), using whichever implementation is selected.
+   @param count the number of calls.
+*/
+static void runFieldMul( long count )
+{
+  byte a = sink | 1;
+  for ( long i = 0; i < count; i++ )
+    a = fieldMul( a, 0x57 ) ^ (byte) i;
+  sink = a;
+}
+
+/**
+   Time fieldMulLoop().
+   @param count the number of calls.
+*/
+static void runFieldMulLoop( long count )
+{
+  byte a = sink | 1;
+  for ( long i = 0; i < count; i++ )
+    a = fieldMulLoop( a, 0x57 ) ^ (byte) i;
+  sink = a;
+}
+
+/**
+   Time fieldMulLog().
+   @param count the number of calls.
+*/
+static void runFieldMulLog( long count )
+{
+  byte a = sink | 1;
+  for ( long i = 0; i < count; i++ )
+    a = fieldMulLog( a, 0x57 ) ^ (byte) i;
+  sink = a;
+}
+
+/**
+   Time fieldMulTable().
+   @param count the number of calls.
+*/
+static void runFieldMulTable( long count )
+{
+  byte a = sink | 1;
+  for ( long i = 0; i < count; i++ )
+    a = fieldMulTable( a, 0x57 ) ^ (byte) i;
+  sink = a;
+}
+
+/**
+   Time fieldMulCt().
+   @param count the number of calls.
+*/
+static void runFieldMulCt( long count )
+{
+  byte a = sink | 1;
+  for ( long i = 0; i < count; i++ )
+    a = fieldMulCt( a, 0x57 ) ^ (byte) i;
+  sink = a;
+}
+
+/**
+   Time substBox().
+   @param count the number of calls.
+*/
+static void runSubstBox( long count )
+{
+  byte v = sink;
+  for ( long i = 0; i < count; i++ )
+    v = substBox( v );
+  sink = v;
+}
+
+/**
+   Time invSubstBox().
+   @param count the number of calls.
+*/
+static void runInvSubstBox( long count )
+{
+  byte v = sink;
+  for ( long i = 0; i < count; i++ )
+    v = invSubstBox( v );
+  sink = v;
+}
+
+/**
+   Time gFunction(), going back and forth between two words.
+   @param count the number of calls.
+*/
+static void runGFunction( long count )
+{
+  byte words[ 2 ][ WORD_SIZE ] = { { sink, 1, 2, 3 } };
+  for ( long i = 0; i < count; i++ )
+    gFunction( words[ ( i + 1 ) & 1 ], words[ i & 1 ], i % ROUNDS + 1 );
+  sink = words[ count & 1 ][ 0 ];
+}
+
+/**
+   Time generateSubkeys(), with each key taken from the last subkey of the one before.
+   @param count the number of calls.
+*/
+static void runGenerateSubkeys( long count )
+{
+  byte subkey[ ROUNDS + 1 ][ BLOCK_SIZE ] = { { sink } };
+  for ( long i = 0; i < count; i++ )
+    generateSubkeys( subkey, subkey[ ROUNDS ] );
+  sink = subkey[ ROUNDS ][ 0 ];
+}
+
+/**
+   Time addSubkey().
+   @param count the number of calls.
+*/
+static void runAddSubkey( long count )
+{
+  static byte const key[ BLOCK_SIZE ] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                                          0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+  byte data[ BLOCK_SIZE ] = { sink };
+  for ( long i = 0; i < count; i++ )
+    addSubkey( data, key );
+  sink = data[ 0 ];
+}
+
+/**
+   Time shiftRows().
+   @param count the number of calls.
+*/
+static void runShiftRows( long count )
+{
+  byte square[ BLOCK_ROWS ][ BLOCK_COLS ] = { { sink } };
+  for ( long i = 0; i < count; i++ )
+    shiftRows( square );
+  sink = square[ 1 ][ 1 ];
+}
+
+/**
+   Time unShiftRows().
+   @param count the number of calls.
+*/
+static void runUnShiftRows( long count )
+{
+  byte square[ BLOCK_ROWS ][ BLOCK_COLS ] = { { sink } };
+  for ( long i = 0; i < count; i++ )
+    unShiftRows( square );
+  sink = square[ 1 ][ 1 ];
+}
+
+/**
+   Time mixColumns().
+   @param count the number of calls.
+*/
+static void runMixColumns( long count )
+{
+  byte square[ BLOCK_ROWS ][ BLOCK_COLS ] = { { sink, 1 }, { 2, 3 } };
+  for ( long i = 0; i < count; i++ )
+    mixColumns( square );
+  sink = square[ 0 ][ 0 ];
+}
+
+/**
+   Time unMixColumns().
+   @param count the number of calls.
+*/
+static void runUnMixColumns( long count )
+{
+  byte square[ BLOCK_ROWS ][ BLOCK_COLS ] = { { sink, 1 }, { 2, 3 } };
+  for ( long i = 0; i < count; i++ )
+    unMixColumns( square );
+  sink = square[ 0 ][ 0 ];
+}
+
+/**
+   Time blockToSquare(), feeding a byte of each square back into the next block.
+   @param count the number of calls.
+*/
+static void runBlockToSquare( long count )
+{
+  byte block[ BLOCK_SIZE ] = { sink };
+  byte square[ BLOCK_ROWS ][ BLOCK_COLS ];
+  for ( long i = 0; i < count; i++ ) {
+    blockToSquare( square, block );
+    block[ 0 ] ^= square[ 1 ][ 0 ];
+  }
+  sink = block[ 0 ];
+}
+
+/**
+   Time squareToBlock(), feeding a byte of each block back into the next square.
+   @param count the number of calls.
+*/
+static void runSquareToBlock( long count )
+{
+  byte square[ BLOCK_ROWS ][ BLOCK_COLS ] = { { sink } };
+  byte block[ BLOCK_SIZE ];
+  for ( long i = 0; i < count; i++ ) {
+    squareToBlock( block, square );
+    square[ 0 ][ 0 ] ^= block[ 1 ];
+  }
+  sink = square[ 0 ][ 0 ];
+}
+
+/**
+   Time encryptBlock(), the reference cipher built from all the steps above, for comparison with their sum.
+   @param count the number of calls.
+*/
+static void runEncryptBlock( long count )
+{
+  byte key[ BLOCK_SIZE ] = { 1 };
+  byte data[ BLOCK_SIZE ] = { sink };
+  for ( long i = 0; i < count; i++ )
+    encryptBlock( data, key );
+  sink = data[ 0 ];
+}
+
+/** Every primitive, in the order they're reported. */
+static Primitive const primitives[] = {
+  { "fieldMul", runFieldMul },
+  { "fieldMulLoop", runFieldMulLoop },
+  { "fieldMulLog", runFieldMulLog },
+  { "fieldMulTable", runFieldMulTable },
+  { "fieldMulCt", runFieldMulCt },
+  { "substBox", runSubstBox },
+  { "invSubstBox", runInvSubstBox },
+  { "gFunction", runGFunction },
+  { "generateSubkeys", runGenerateSubkeys },
+  { "addSubkey", runAddSubkey },
+  { "shiftRows", runShiftRows },
+  { "unShiftRows", runUnShiftRows },
+  { "mixColumns", runMixColumns },
+  { "unMixColumns", runUnMixColumns },
+  { "blockToSquare", runBlockToSquare },
+  { "squareToBlock", runSquareToBlock },
+  { "encryptBlock", runEncryptBlock },
+};
+
+/** Number of primitives. */
+#define PRIMITIVES ( (int) ( sizeof( primitives ) / sizeof( primitives[ 0 ] ) ) )
+
+/**
+   Print the usage message and exit.
+*/
+static void usage( void )
+{
+  fprintf( stderr, "usage: microBench [--only NAME,...] [--samples N] [--batch N] [--warmup N] [--json|--csv]\n" );
+  exit( EXIT_FAILURE );
+}
+
+/**
+   Compare two doubles, for qsort().
+   @param a pointer to the first.
+   @param b pointer to the second.
+   @return negative, zero or positive as the first is less than, equal to or greater than the second.
+*/
+static int compareDoubles( void const *a, void const *b )
+{
+  double x = *(double const *) a;
+  double y = *(double const *) b;
+  return ( x > y ) - ( x < y );
+}
+
+/**
+   Find a percentile of a sorted list, using the nearest rank.
+   @param sorted the values, smallest first.
+   @param n the number of values.
+   @param p the percentile, from 0 to 100.
+   @return the value.
+*/
+static double percentile( double const *sorted, int n, int p )
+{
+  return sorted[ (int) ( ( n - 1 ) * (long) p / 100 ) ];
+}
+
+/**
+   Find the median of a counter's samples, leaving out the ones whose counters couldn't be read.
+   @param values the samples, with NaN for the ones left out; the rest are moved to the front and sorted.
+   @param n the number of samples.
+   @return the median, or NaN if no sample was counted.
+*/
+static double countMedian( double *values, int n )
+{
+  int kept = 0;
+  for ( int s = 0; s < n; s++ ) {
+    if ( !isnan( values[ s ] ) )
+      values[ kept++ ] = values[ s ];
+  }
+  if ( kept == 0 )
+    return NAN;
+  qsort( values, kept, sizeof( double ), compareDoubles );
+  return percentile( values, kept, P50 );
+}
+
+/**
+   Time one primitive: run the warm-up batches, then time each of the sample batches on its own.
+   @param prim the primitive.
+   @param samples where the cost per call of each sample goes.
+   @param n the number of samples.
+   @param batch calls in each batch.
+   @param warmup the number of untimed batches.
+   @param overhead time stamp counter ticks spent reading the clocks, taken off each sample.
+*/
+static void measure( Primitive const *prim, Samples *samples, int n, long batch, int warmup, double overhead )
+{
+  for ( int w = 0; w < warmup; w++ )
+    prim->run( batch );
+
+  for ( int s = 0; s < n; s++ ) {
+    uint64_t before[ COUNTERS ], after[ COUNTERS ];
+    bool counted = perfRead( &counters, before );
+    double start = now();
+    double t0 = ticks();
+    prim->run( batch );
+    double t1 = ticks();
+    double end = now();
+    counted = perfRead( &counters, after ) && counted;
+
+    double t = t1 - t0 - overhead;
+    samples->ticks[ s ] = ( t > 0 ? t : 0 ) / batch;
+    samples->nanos[ s ] = ( end - start ) * NANOS / batch;
+    for ( int c = 0; c < COUNTERS; c++ )
+      samples->counts[ c ][ s ] = counted ? (double) ( after[ c ] - before[ c ] ) / batch : NAN;
+  }
+}
+
+/**
+   Find how many time stamp counter ticks it takes just to read the counter twice, as the median of many tries.
+   @return the ticks.
+*/
+static double timerOverhead( void )
+{
+  double tries[ DEFAULT_SAMPLES ];
+  for ( int i = 0; i < DEFAULT_SAMPLES; i++ ) {
+    double t0 = ticks();
+    tries[ i ] = ticks() - t0;
+  }
+  qsort( tries, DEFAULT_SAMPLES, sizeof( double ), compareDoubles );
+  return percentile( tries, DEFAULT_SAMPLES, P50 );
+}
+
+/**
+   Print the heading for the results.
+   @param format how the results are written.
+*/
+static void printHeader( Format format )
+{
+  if ( format == FORMAT_TEXT ) {
+    printf( "%-16s %9s %9s %9s %9s %9s %9s %9s", "primitive", "min", "p10", "median", "p90", "p99", "max", "ns" );
+    if ( counting )
+      printf( " %9s %9s %9s", "cycles", "insns", "br-miss" );
+    printf( "\n" );
+  } else if ( format == FORMAT_CSV ) {
+    printf( "primitive,min,p10,median,p90,p99,max,ns" );
+    if ( counting )
+      printf( ",cycles,instructions,branch_misses" );
+    printf( "\n" );
+  } else {
+    printf( "[\n" );
+  }
+}
+
+/**
+   Sort the samples and print the percentiles for one primitive.
+   @param format how the results are written.
+   @param first true for the first result.
+   @param prim the primitive.
+   @param samples the cost per call of each sample, which are sorted.
+   @param n the number of samples.
+*/
+static void printResult( Format format, bool first, Primitive const *prim, Samples *samples, int n )
+{
+  qsort( samples->ticks, n, sizeof( double ), compareDoubles );
+  qsort( samples->nanos, n, sizeof( double ), compareDoubles );
+  double medians[ COUNTERS ] = { 0 };
+  for ( int c = 0; c < COUNTERS && counting; c++ )
+    medians[ c ] = countMedian( samples->counts[ c ], n );
+
+  double tk[] = { samples->ticks[ 0 ], percentile( samples->ticks, n, P10 ), percentile( samples->ticks, n, P50 ),
+                  percentile( samples->ticks, n, P90 ), percentile( samples->ticks, n, P99 ), samples->ticks[ n - 1 ] };
+  double ns = percentile( samples->nanos, n, P50 );
+
+  if ( format == FORMAT_TEXT ) {
+    printf( "%-16s %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f", prim->name, tk[ 0 ], tk[ 1 ], tk[ 2 ], tk[ 3 ], tk[ 4 ],
+            tk[ 5 ], ns );
+    if ( counting )
+      printf( " %9.2f %9.2f %9.3f", medians[ 0 ], medians[ 1 ], medians[ 2 ] );
+    printf( "\n" );
+  } else if ( format == FORMAT_CSV ) {
+    printf( "%s,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f", prim->name, tk[ 0 ], tk[ 1 ], tk[ 2 ], tk[ 3 ], tk[ 4 ], tk[ 5 ],
+            ns );
+    if ( counting )
+      printf( ",%.3f,%.3f,%.4f", medians[ 0 ], medians[ 1 ], medians[ 2 ] );
+    printf( "\n" );
+  } else {
+    printf( "%s  {\"primitive\": \"%s\", \"min\": %.3f, \"p10\": %.3f, \"median\": %.3f, \"p90\": %.3f, "
+            "\"p99\": %.3f, \"max\": %.3f, \"ns\": %.3f", first ? "" : ",\n", prim->name, tk[ 0 ], tk[ 1 ], tk[ 2 ],
+            tk[ 3 ], tk[ 4 ], tk[ 5 ], ns );
+    // JSON has no NaN, so a counter with no samples is null.
+    for ( int c = 0; c < COUNTERS && counting; c++ ) {
+      if ( isnan( medians[ c ] ) )
+        printf( ", \"%s\": null", counterNames[ c ] );
+      else
+        printf( ", \"%s\": %.4f", counterNames[ c ], medians[ c ] );
+    }
+    printf( "}" );
+  }
+}
+
+/**
+   Look up a primitive by name.
+   @param name the name.
+   @return its index, or exits with the usage message if there isn't one.
+*/
+static int findPrimitive( char const *name )
+{
+  for ( int p = 0; p < PRIMITIVES; p++ ) {
+    if ( strcmp( primitives[ p ].name, name ) == 0 )
+      return p;
+  }
+  fprintf( stderr, "Unknown primitive: %s\n", name );
+  exit( EXIT_FAILURE );
+}
+
+int main( int argc, char *argv[] )
+{
+  int samplesCount = DEFAULT_SAMPLES;
+  long batch = DEFAULT_BATCH;
+  int warmup = DEFAULT_WARMUP;
+  Format format = FORMAT_TEXT;
+  int chosen[ MAX_LIST ];
+  int chosenCount = 0;
+
+  for ( int i = 1; i < argc; i++ ) {
+    char *value = i + 1 < argc ? argv[ i + 1 ] : NULL;
+    if ( strcmp( argv[ i ], "--json" ) == 0 )
+      format = FORMAT_JSON;
+    else if ( strcmp( argv[ i ], "--csv" ) == 0 )
+      format = FORMAT_CSV;
+    else if ( !value )
+      usage();
+    else if ( strcmp( argv[ i ], "--samples" ) == 0 && ( samplesCount = atoi( argv[ ++i ] ) ) > 0 )
+      continue;
+    else if ( strcmp( argv[ i ], "--batch" ) == 0 && ( batch = atol( argv[ ++i ] ) ) > 0 )
+      continue;
+    else if ( strcmp( argv[ i ], "--warmup" ) == 0 && ( warmup = atoi( argv[ ++i ] ) ) >= 0 )
+      continue;
+    else if ( strcmp( argv[ i ], "--only" ) == 0 ) {
+      for ( char *item = strtok( argv[ ++i ], "," ); item; item = strtok( NULL, "," ) ) {
+        if ( chosenCount == MAX_LIST )
+          usage();
+        chosen[ chosenCount++ ] = findPrimitive( item );
+      }
+    } else
+      usage();
+  }
+  if ( chosenCount == 0 ) {
+    for ( int p = 0; p < PRIMITIVES; p++ )
+      chosen[ chosenCount++ ] = p;
+  }
+
+  Samples samples;
+  samples.ticks = malloc( samplesCount * sizeof( double ) );
+  samples.nanos = malloc( samplesCount * sizeof( double ) );
+  bool allocated = samples.ticks && samples.nanos;
+  for ( int c = 0; c < COUNTERS; c++ )
+    allocated = ( samples.counts[ c ] = malloc( samplesCount * sizeof( double ) ) ) && allocated;
+  if ( !allocated ) {
+    fprintf( stderr, "Not enough memory for %d samples\n", samplesCount );
+    exit( EXIT_FAILURE );
+  }
+
+  counting = perfOpen( &counters, counterEvents, true );
+  if ( !counting )
+    fprintf( stderr, "Hardware counters not available; reporting the time stamp counter only\n" );
+  double overhead = timerOverhead();
+
+  printHeader( format );
+  for ( int i = 0; i < chosenCount; i++ ) {
+    Primitive const *prim = &primitives[ chosen[ i ] ];
+    measure( prim, &samples, samplesCount, batch, warmup, overhead );
+    printResult( format, i == 0, prim, &samples, samplesCount );
+    fflush( stdout );
+  }
+  if ( format == FORMAT_JSON )
+    printf( "\n]\n" );
+
+  free( samples.ticks );
+  free( samples.nanos );
+  for ( int c = 0; c < COUNTERS; c++ )
+    free( samples.counts[ c ] );
+  return EXIT_SUCCESS;
+}
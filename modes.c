@@ -0,0 +1,714 @@
+/**
+ * @file modes.c
+ * @author Jimin Yu, jyu34
+ * This file implements the block cipher modes that are built on top of the AES engines' encryptBlocks() and
+ * decryptBlocks() calls: CBC, CTR, GCM, which is CTR with a GHASH of the ciphertext computed in the same pass, and
+ * XTS, for disk sectors.
+*/
+
+#include "modes.h"
+#include "aes.h"
+#include "ghash.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of keystream blocks generated with each call to the engine. */
+#define CTR_BATCH 64
+
+/** Number of blocks decrypted with each call to the engine in CBC mode. */
+#define CBC_BATCH 64
+
+/** Number of bytes in each half of a counter block. */
+#define HALF_BLOCK 8
+
+/** Number of blocks run through the engine with each call in XTS mode, and sector tweaks computed at once. */
+#define XTS_BATCH 64
+
+/** What's added back when doubling an XTS tweak carries out of the top bit: x^128 = x^7 + x^2 + x + 1. */
+#define XTS_POLY 0x87
+
+/** Work for parallelCtrCrypt(). */
+typedef struct {
+  /** The context holding the expanded key. */
+  AesContext const *ctx;
+
+  /** The initial counter block. */
+  byte const *iv;
+
+  /** Keystream position of the first byte of in. */
+  uint64_t offset;
+
+  /** The input data. */
+  byte const *in;
+
+  /** Where the output goes. */
+  byte *out;
+} CtrJob;
+
+/** Work for parallelCbcDecrypt(). */
+typedef struct {
+  /** The context holding the expanded key. */
+  AesContext const *ctx;
+
+  /** The ciphertext. */
+  byte const *in;
+
+  /** Where the plaintext goes. */
+  byte *out;
+
+  /** The number of blocks. */
+  size_t nblocks;
+
+  /** The number of blocks given to each slice. */
+  size_t perSlice;
+
+  /** The ciphertext block before each slice, saved before any thread can overwrite it. */
+  byte ( *prev )[ BLOCK_SIZE ];
+} CbcJob;
+
+/** Work for parallelCbcEncryptStreams(). */
+typedef struct {
+  /** The context holding the expanded key. */
+  AesContext const *ctx;
+
+  /** The streams to encrypt. */
+  CbcStream *streams;
+} CbcStreamsJob;
+
+/** Work for gcmCrypt(). */
+typedef struct {
+  /** The GCM operation in progress. */
+  GcmContext const *gcm;
+
+  /** The input data. */
+  byte const *in;
+
+  /** Where the output goes. */
+  byte *out;
+
+  /** The number of bytes. */
+  size_t len;
+
+  /** The number of blocks given to each slice. */
+  size_t perSlice;
+
+  /** True to encrypt, false to decrypt. */
+  bool encrypt;
+
+  /** GHASH of each slice's ciphertext, as if the hash started at the beginning of the slice. */
+  byte ( *partial )[ BLOCK_SIZE ];
+} GcmJob;
+
+/** Work for parallelXtsCrypt(). */
+typedef struct {
+  /** The context holding the expanded data key. */
+  AesContext const *ctx;
+
+  /** The context holding the expanded tweak key. */
+  AesContext const *tweakCtx;
+
+  /** Number of the first sector. */
+  uint64_t sector;
+
+  /** Bytes in a sector. */
+  size_t sectorSize;
+
+  /** The input data. */
+  byte const *in;
+
+  /** Where the output goes. */
+  byte *out;
+
+  /** The number of bytes. */
+  size_t len;
+
+  /** True to encrypt, false to decrypt. */
+  bool encrypt;
+} XtsJob;
+
+/**
+   XOR len bytes of a and b into dest, a word at a time where possible.
+   @param dest where the result goes; it may be the same as a.
+   @param a the first input.
+   @param b the second input.
+   @param len the number of bytes.
+*/
+static void xorBytes( byte *dest, byte const *a, byte const *b, size_t len )
+{
+  size_t i = 0;
+  for ( ; i + sizeof( uint64_t ) <= len; i += sizeof( uint64_t ) ) {
+    uint64_t x, y;
+    memcpy( &x, a + i, sizeof( x ) );
+    memcpy( &y, b + i, sizeof( y ) );
+    x ^= y;
+    memcpy( dest + i, &x, sizeof( x ) );
+  }
+  for ( ; i < len; i++ )
+    dest[ i ] = a[ i ] ^ b[ i ];
+}
+
+/**
+   Fill in consecutive counter blocks, advancing the 128-bit counter. The counter is kept in locals and written back
+   once, so the loop can stay in registers.
+   @param stream where the counter blocks go.
+   @param hi the high half of the next counter, updated.
+   @param lo the low half of the next counter, updated.
+   @param nblocks the number of counter blocks.
+*/
+static void fillCounters( byte *stream, uint64_t *hi, uint64_t *lo, size_t nblocks )
+{
+  uint64_t h = *hi, l = *lo;
+  for ( size_t b = 0; b < nblocks; b++ ) {
+    storeBig64( stream + b * BLOCK_SIZE, h );
+    storeBig64( stream + b * BLOCK_SIZE + HALF_BLOCK, l );
+    if ( ++l == 0 )
+      ++h;
+  }
+  *hi = h;
+  *lo = l;
+}
+
+/**
+   Fill in consecutive GCM counter blocks. GCM's inc32 only advances the last 32 bits of a counter block, so the IV in
+   the rest of it never changes.
+   @param stream where the counter blocks go.
+   @param j0 the pre-counter block, for its IV.
+   @param counter the last 32 bits of the next counter block, updated.
+   @param nblocks the number of counter blocks.
+*/
+static void fillGcmCounters( byte *stream, byte const j0[ BLOCK_SIZE ], uint32_t *counter, size_t nblocks )
+{
+  for ( size_t b = 0; b < nblocks; b++ ) {
+    byte *block = stream + b * BLOCK_SIZE;
+    memcpy( block, j0, GCM_IV_SIZE );
+    for ( int i = BLOCK_SIZE - 1; i >= GCM_IV_SIZE; i-- )
+      block[ i ] = *counter >> ( ( BLOCK_SIZE - 1 - i ) * BBITS );
+    ++*counter;
+  }
+}
+
+void ctrCounterAt( byte counter[ BLOCK_SIZE ], byte const iv[ BLOCK_SIZE ], uint64_t blockIndex )
+{
+  uint64_t hi = loadBig64( iv );
+  uint64_t lo = loadBig64( iv + HALF_BLOCK );
+  lo += blockIndex;
+  if ( lo < blockIndex )
+    hi++;
+  storeBig64( counter, hi );
+  storeBig64( counter + HALF_BLOCK, lo );
+}
+
+void ctrCrypt( AesContext const *ctx, byte const iv[ BLOCK_SIZE ], uint64_t offset, byte const *in, byte *out,
+               size_t len )
+{
+  byte start[ BLOCK_SIZE ];
+  ctrCounterAt( start, iv, offset / BLOCK_SIZE );
+  uint64_t hi = loadBig64( start );
+  uint64_t lo = loadBig64( start + HALF_BLOCK );
+
+  // Bytes to skip at the front of the first keystream block, when offset isn't on a block boundary.
+  size_t skip = offset % BLOCK_SIZE;
+
+  byte stream[ CTR_BATCH * BLOCK_SIZE ];
+  while ( len > 0 ) {
+    size_t nblocks = ( skip + len + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+    if ( nblocks > CTR_BATCH )
+      nblocks = CTR_BATCH;
+
+    fillCounters( stream, &hi, &lo, nblocks );
+    encryptBlocks( ctx, stream, stream, nblocks );
+
+    size_t n = nblocks * BLOCK_SIZE - skip;
+    if ( n > len )
+      n = len;
+    xorBytes( out, in, stream + skip, n );
+    in += n;
+    out += n;
+    len -= n;
+    skip = 0;
+  }
+}
+
+/**
+   Run counter mode on one slice of a CtrJob.
+   @param arg the CtrJob.
+   @param start the first byte of the slice.
+   @param count the number of bytes in the slice.
+*/
+static void ctrSlice( void *arg, size_t start, size_t count )
+{
+  CtrJob *job = arg;
+  ctrCrypt( job->ctx, job->iv, job->offset + start, job->in + start, job->out + start, count );
+}
+
+void parallelCtrCrypt( WorkerPool *pool, AesContext const *ctx, byte const iv[ BLOCK_SIZE ], uint64_t offset,
+                       byte const *in, byte *out, size_t len )
+{
+  CtrJob job = { ctx, iv, offset, in, out };
+  parallelFor( pool, len, MIN_BLOCKS_PER_THREAD * BLOCK_SIZE, ctrSlice, &job );
+}
+
+void gcmInit( GcmContext *gcm, AesContext const *ctx, byte const iv[ GCM_IV_SIZE ] )
+{
+  gcm->ctx = ctx;
+
+  // The hash key is the encryption of a zero block.
+  byte h[ BLOCK_SIZE ] = { 0 };
+  encryptBlocks( ctx, h, h, 1 );
+  ghashInit( &gcm->ghash, h );
+  gcmRestart( gcm, iv );
+}
+
+void gcmRestart( GcmContext *gcm, byte const iv[ GCM_IV_SIZE ] )
+{
+  // With a 96-bit IV, the pre-counter block is the IV followed by a 32-bit one.
+  memcpy( gcm->j0, iv, GCM_IV_SIZE );
+  memset( gcm->j0 + GCM_IV_SIZE, 0, BLOCK_SIZE - GCM_IV_SIZE );
+  gcm->j0[ BLOCK_SIZE - 1 ] = 1;
+
+  memset( gcm->state, 0, BLOCK_SIZE );
+  gcm->aadLen = 0;
+  gcm->dataLen = 0;
+}
+
+/**
+   Absorb data into a GHASH value, padding a partial last block with zeros.
+   @param key the precomputed hash key.
+   @param state the running hash value.
+   @param data the data to absorb.
+   @param len the number of bytes.
+*/
+static void ghashPadded( GhashKey const *key, byte state[ BLOCK_SIZE ], byte const *data, size_t len )
+{
+  ghashBlocks( key, state, data, len / BLOCK_SIZE );
+  if ( len % BLOCK_SIZE != 0 ) {
+    byte last[ BLOCK_SIZE ] = { 0 };
+    memcpy( last, data + len / BLOCK_SIZE * BLOCK_SIZE, len % BLOCK_SIZE );
+    ghashBlocks( key, state, last, 1 );
+  }
+}
+
+void gcmAad( GcmContext *gcm, byte const *aad, size_t len )
+{
+  ghashPadded( &gcm->ghash, gcm->state, aad, len );
+  gcm->aadLen += len;
+}
+
+/**
+   Decide how many slices to split a run of blocks into, for a mode that needs to know which slice is which. That's
+   one per thread, as long as each gets at least MIN_BLOCKS_PER_THREAD blocks.
+   @param pool the pool the slices will run on.
+   @param nblocks the number of blocks.
+   @return the number of slices, at least 1.
+*/
+static size_t sliceCount( WorkerPool *pool, size_t nblocks )
+{
+  size_t slices = ( nblocks + MIN_BLOCKS_PER_THREAD - 1 ) / MIN_BLOCKS_PER_THREAD;
+  if ( slices > (size_t) poolThreads( pool ) )
+    slices = poolThreads( pool );
+  return slices == 0 ? 1 : slices;
+}
+
+/**
+   Run GCM on one or more slices of a GcmJob. Each batch of keystream is generated, applied and hashed while it's
+   still in cache, so the data is only passed over once.
+   @param arg the GcmJob.
+   @param start the first slice.
+   @param count the number of slices.
+*/
+static void gcmSlices( void *arg, size_t start, size_t count )
+{
+  GcmJob *job = arg;
+  GcmContext const *gcm = job->gcm;
+
+  for ( size_t s = start; s < start + count; s++ ) {
+    size_t first = s * job->perSlice * BLOCK_SIZE;
+    size_t end = first + job->perSlice * BLOCK_SIZE;
+    if ( end > job->len )
+      end = job->len;
+
+    // The first slice carries on from the hash so far; the others are combined with it afterward.
+    byte *state = job->partial[ s ];
+    if ( s == 0 )
+      memcpy( state, gcm->state, BLOCK_SIZE );
+    else
+      memset( state, 0, BLOCK_SIZE );
+
+    // Block 0 of the keystream (the pre-counter block) is saved for the tag, so the data starts at block 1.
+    uint32_t counter = 0;
+    for ( int i = GCM_IV_SIZE; i < BLOCK_SIZE; i++ )
+      counter = counter << BBITS | gcm->j0[ i ];
+    counter += 1 + ( gcm->dataLen + first ) / BLOCK_SIZE;
+
+    byte stream[ CTR_BATCH * BLOCK_SIZE ];
+    for ( size_t pos = first; pos < end; ) {
+      size_t n = end - pos < sizeof( stream ) ? end - pos : sizeof( stream );
+      fillGcmCounters( stream, gcm->j0, &counter, ( n + BLOCK_SIZE - 1 ) / BLOCK_SIZE );
+      encryptBlocks( gcm->ctx, stream, stream, ( n + BLOCK_SIZE - 1 ) / BLOCK_SIZE );
+
+      // GHASH always covers the ciphertext: the output when encrypting, the input when decrypting.
+      if ( !job->encrypt )
+        ghashPadded( &gcm->ghash, state, job->in + pos, n );
+      xorBytes( job->out + pos, job->in + pos, stream, n );
+      if ( job->encrypt )
+        ghashPadded( &gcm->ghash, state, job->out + pos, n );
+      pos += n;
+    }
+  }
+}
+
+/**
+   Encrypt or decrypt the next part of the data in GCM mode, split across the threads of a pool. Each thread hashes
+   its own slice from zero, and the slices are combined afterward by multiplying each by the power of H that its
+   position calls for.
+   @param gcm the GCM operation in progress.
+   @param pool the pool to run on, or NULL for just the calling thread.
+   @param in the data.
+   @param out where the result goes, which may be the same as in.
+   @param len the number of bytes.
+   @param encrypt true to encrypt, false to decrypt.
+   @return false, with nothing done, if the message would go past GCM_MAX_BYTES.
+*/
+static bool gcmCrypt( GcmContext *gcm, WorkerPool *pool, byte const *in, byte *out, size_t len, bool encrypt )
+{
+  if ( len > GCM_MAX_BYTES - gcm->dataLen )
+    return false;
+
+  size_t nblocks = ( len + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+  size_t slices = sliceCount( pool, nblocks );
+  byte single[ 1 ][ BLOCK_SIZE ];
+  GcmJob job = { gcm, in, out, len, ( nblocks + slices - 1 ) / slices, encrypt, single };
+  if ( slices > 1 )
+    job.partial = malloc( slices * BLOCK_SIZE );
+  parallelFor( pool, slices, 1, gcmSlices, &job );
+
+  // Each slice's hash still needs multiplying by H once for every block that comes after it.
+  memcpy( gcm->state, job.partial[ slices - 1 ], BLOCK_SIZE );
+  for ( size_t s = 0; s + 1 < slices; s++ ) {
+    size_t after = ( s + 1 ) * job.perSlice;
+    byte power[ BLOCK_SIZE ];
+    ghashPow( power, gcm->ghash.h, after < nblocks ? nblocks - after : 0 );
+    ghashMul( job.partial[ s ], power );
+    for ( int i = 0; i < BLOCK_SIZE; i++ )
+      gcm->state[ i ] ^= job.partial[ s ][ i ];
+  }
+
+  if ( slices > 1 )
+    free( job.partial );
+  gcm->dataLen += len;
+  return true;
+}
+
+bool gcmEncrypt( GcmContext *gcm, WorkerPool *pool, byte const *in, byte *out, size_t len )
+{
+  return gcmCrypt( gcm, pool, in, out, len, true );
+}
+
+bool gcmDecrypt( GcmContext *gcm, WorkerPool *pool, byte const *in, byte *out, size_t len )
+{
+  return gcmCrypt( gcm, pool, in, out, len, false );
+}
+
+void gcmFinal( GcmContext *gcm, byte tag[ GCM_TAG_SIZE ] )
+{
+  // The last block hashed holds the lengths of the additional data and the ciphertext, in bits.
+  byte lengths[ BLOCK_SIZE ];
+  storeBig64( lengths, gcm->aadLen * BBITS );
+  storeBig64( lengths + HALF_BLOCK, gcm->dataLen * BBITS );
+  ghashBlocks( &gcm->ghash, gcm->state, lengths, 1 );
+
+  byte mask[ BLOCK_SIZE ];
+  encryptBlocks( gcm->ctx, gcm->j0, mask, 1 );
+  xorBytes( tag, gcm->state, mask, GCM_TAG_SIZE );
+}
+
+bool gcmCheckTag( GcmContext *gcm, byte const tag[ GCM_TAG_SIZE ] )
+{
+  byte expected[ GCM_TAG_SIZE ];
+  gcmFinal( gcm, expected );
+
+  // Look at every byte whatever the others are, so the time taken doesn't say how much of a forged tag was right.
+  byte diff = 0;
+  for ( int i = 0; i < GCM_TAG_SIZE; i++ )
+    diff |= expected[ i ] ^ tag[ i ];
+  return diff == 0;
+}
+
+void cbcEncryptStreams( AesContext const *ctx, CbcStream *streams, int count )
+{
+  byte batch[ CBC_INTERLEAVE * BLOCK_SIZE ];
+  int lane[ CBC_INTERLEAVE ];
+
+  for ( int first = 0; first < count; first += CBC_INTERLEAVE ) {
+    int group = count - first < CBC_INTERLEAVE ? count - first : CBC_INTERLEAVE;
+    size_t longest = 0;
+    for ( int s = first; s < first + group; s++ )
+      if ( streams[ s ].nblocks > longest )
+        longest = streams[ s ].nblocks;
+
+    // Each stream's blocks depend on each other, but the streams don't, so block b of every stream goes through the
+    // engine together.
+    for ( size_t b = 0; b < longest; b++ ) {
+      int lanes = 0;
+      for ( int s = first; s < first + group; s++ )
+        if ( b < streams[ s ].nblocks ) {
+          xorBytes( batch + lanes * BLOCK_SIZE, streams[ s ].in + b * BLOCK_SIZE, streams[ s ].iv, BLOCK_SIZE );
+          lane[ lanes++ ] = s;
+        }
+
+      encryptBlocks( ctx, batch, batch, lanes );
+
+      for ( int l = 0; l < lanes; l++ ) {
+        CbcStream *stream = streams + lane[ l ];
+        memcpy( stream->out + b * BLOCK_SIZE, batch + l * BLOCK_SIZE, BLOCK_SIZE );
+        memcpy( stream->iv, batch + l * BLOCK_SIZE, BLOCK_SIZE );
+      }
+    }
+  }
+}
+
+/**
+   Encrypt some of the streams of a CbcStreamsJob.
+   @param arg the CbcStreamsJob.
+   @param start the first stream.
+   @param count the number of streams.
+*/
+static void cbcStreamsSlice( void *arg, size_t start, size_t count )
+{
+  CbcStreamsJob *job = arg;
+  cbcEncryptStreams( job->ctx, job->streams + start, count );
+}
+
+void parallelCbcEncryptStreams( WorkerPool *pool, AesContext const *ctx, CbcStream *streams, int count )
+{
+  CbcStreamsJob job = { ctx, streams };
+  parallelFor( pool, count, CBC_INTERLEAVE, cbcStreamsSlice, &job );
+}
+
+/**
+   Decrypt one or more slices of a CbcJob. Each slice is worked through from the end in batches, so that when the
+   output overwrites the input, the ciphertext each block needs from before it hasn't been overwritten yet.
+   @param arg the CbcJob.
+   @param start the first slice.
+   @param count the number of slices.
+*/
+static void cbcDecryptSlices( void *arg, size_t start, size_t count )
+{
+  CbcJob *job = arg;
+  byte plain[ CBC_BATCH * BLOCK_SIZE ];
+
+  for ( size_t s = start; s < start + count; s++ ) {
+    size_t begin = s * job->perSlice;
+    size_t end = begin + job->perSlice;
+    if ( end > job->nblocks )
+      end = job->nblocks;
+
+    while ( end > begin ) {
+      size_t first = end - begin > CBC_BATCH ? end - CBC_BATCH : begin;
+      size_t n = end - first;
+      byte const *in = job->in + first * BLOCK_SIZE;
+      decryptBlocks( job->ctx, in, plain, n );
+
+      // Each block is XORed with the ciphertext block before it.
+      xorBytes( plain, plain, first == begin ? job->prev[ s ] : in - BLOCK_SIZE, BLOCK_SIZE );
+      xorBytes( plain + BLOCK_SIZE, plain + BLOCK_SIZE, in, ( n - 1 ) * BLOCK_SIZE );
+      memcpy( job->out + first * BLOCK_SIZE, plain, n * BLOCK_SIZE );
+      end = first;
+    }
+  }
+}
+
+void parallelCbcDecrypt( WorkerPool *pool, AesContext const *ctx, byte iv[ BLOCK_SIZE ], byte const *in, byte *out,
+                         size_t nblocks )
+{
+  if ( nblocks == 0 )
+    return;
+
+  size_t slices = sliceCount( pool, nblocks );
+  byte single[ 1 ][ BLOCK_SIZE ];
+  CbcJob job = { ctx, in, out, nblocks, ( nblocks + slices - 1 ) / slices, single };
+  if ( slices > 1 )
+    job.prev = malloc( slices * BLOCK_SIZE );
+
+  // Save everything that could be overwritten before it's needed: the block before each slice, and the last block,
+  // which chains into whatever comes next.
+  memcpy( job.prev[ 0 ], iv, BLOCK_SIZE );
+  for ( size_t s = 1; s < slices; s++ )
+    memcpy( job.prev[ s ], in + ( s * job.perSlice - 1 ) * BLOCK_SIZE, BLOCK_SIZE );
+  memcpy( iv, in + ( nblocks - 1 ) * BLOCK_SIZE, BLOCK_SIZE );
+
+  parallelFor( pool, slices, 1, cbcDecryptSlices, &job );
+
+  if ( slices > 1 )
+    free( job.prev );
+}
+
+/**
+   Read a 64-bit number, least significant byte first, as XTS tweaks are laid out.
+   @param p the bytes.
+   @return the number.
+*/
+static uint64_t loadLittle64( byte const *p )
+{
+  uint64_t v = 0;
+  for ( int i = HALF_BLOCK - 1; i >= 0; i-- )
+    v = v << 8 | p[ i ];
+  return v;
+}
+
+/**
+   Write a 64-bit number, least significant byte first.
+   @param p where the bytes go.
+   @param v the number.
+*/
+static void storeLittle64( byte *p, uint64_t v )
+{
+  for ( int i = 0; i < HALF_BLOCK; i++ )
+    p[ i ] = v >> ( 8 * i );
+}
+
+/**
+   Multiply a tweak, held as two little-endian halves, by x in GF(2^128), which moves it on to the next block.
+   @param lo the low half, updated.
+   @param hi the high half, updated.
+*/
+static void xtsDouble( uint64_t *lo, uint64_t *hi )
+{
+  uint64_t carry = *hi >> 63;
+  *hi = *hi << 1 | *lo >> 63;
+  *lo = *lo << 1 ^ ( carry ? XTS_POLY : 0 );
+}
+
+/**
+   Run one block through the cipher between two XORs with its tweak.
+   @param ctx the context holding the expanded data key.
+   @param tweak the block's tweak.
+   @param in the input block.
+   @param out where the output block goes, which may be the same as in.
+   @param encrypt true to encrypt, false to decrypt.
+*/
+static void xtsBlock( AesContext const *ctx, byte const tweak[ BLOCK_SIZE ], byte const *in, byte *out, bool encrypt )
+{
+  byte block[ BLOCK_SIZE ];
+  xorBytes( block, in, tweak, BLOCK_SIZE );
+  if ( encrypt )
+    encryptBlocks( ctx, block, block, 1 );
+  else
+    decryptBlocks( ctx, block, block, 1 );
+  xorBytes( out, block, tweak, BLOCK_SIZE );
+}
+
+/**
+   Encrypt or decrypt one sector, given its encrypted tweak. The tweaks for a batch of blocks are worked out first, so
+   the engine gets the whole batch at once.
+   @param ctx the context holding the expanded data key.
+   @param tweak the encrypted sector number, the tweak for the sector's first block.
+   @param in the sector.
+   @param out where the output goes, which may be the same as in.
+   @param len the number of bytes in the sector, at least BLOCK_SIZE.
+   @param encrypt true to encrypt, false to decrypt.
+*/
+static void xtsSector( AesContext const *ctx, byte const tweak[ BLOCK_SIZE ], byte const *in, byte *out, size_t len,
+                       bool encrypt )
+{
+  uint64_t lo = loadLittle64( tweak );
+  uint64_t hi = loadLittle64( tweak + HALF_BLOCK );
+
+  // With a partial block at the end, the last whole block is left for ciphertext stealing.
+  size_t tail = len % BLOCK_SIZE;
+  size_t nblocks = len / BLOCK_SIZE - ( tail ? 1 : 0 );
+
+  byte tweaks[ XTS_BATCH * BLOCK_SIZE ];
+  byte work[ XTS_BATCH * BLOCK_SIZE ];
+  for ( size_t done = 0; done < nblocks; ) {
+    size_t n = nblocks - done < XTS_BATCH ? nblocks - done : XTS_BATCH;
+    for ( size_t b = 0; b < n; b++ ) {
+      storeLittle64( tweaks + b * BLOCK_SIZE, lo );
+      storeLittle64( tweaks + b * BLOCK_SIZE + HALF_BLOCK, hi );
+      xtsDouble( &lo, &hi );
+    }
+    xorBytes( work, in + done * BLOCK_SIZE, tweaks, n * BLOCK_SIZE );
+    if ( encrypt )
+      encryptBlocks( ctx, work, work, n );
+    else
+      decryptBlocks( ctx, work, work, n );
+    xorBytes( out + done * BLOCK_SIZE, work, tweaks, n * BLOCK_SIZE );
+    done += n;
+  }
+  if ( !tail )
+    return;
+
+  // Ciphertext stealing: the last whole block's output lends its tail to pad out the partial block, which is then
+  // done with the next tweak and takes its place, while its own first bytes move to the end. Decryption has to undo
+  // the second step first, so it uses the two tweaks the other way around.
+  byte first[ BLOCK_SIZE ], second[ BLOCK_SIZE ];
+  storeLittle64( first, lo );
+  storeLittle64( first + HALF_BLOCK, hi );
+  xtsDouble( &lo, &hi );
+  storeLittle64( second, lo );
+  storeLittle64( second + HALF_BLOCK, hi );
+
+  byte const *last = in + nblocks * BLOCK_SIZE;
+  byte *lastOut = out + nblocks * BLOCK_SIZE;
+  byte block[ BLOCK_SIZE ], stolen[ BLOCK_SIZE ];
+  xtsBlock( ctx, encrypt ? first : second, last, block, encrypt );
+  memcpy( stolen, last + BLOCK_SIZE, tail );
+  memcpy( stolen + tail, block + tail, BLOCK_SIZE - tail );
+  memcpy( lastOut + BLOCK_SIZE, block, tail );
+  xtsBlock( ctx, encrypt ? second : first, stolen, lastOut, encrypt );
+}
+
+void xtsCrypt( AesContext const *ctx, AesContext const *tweakCtx, uint64_t sector, size_t sectorSize,
+               byte const *in, byte *out, size_t len, bool encrypt )
+{
+  byte tweaks[ XTS_BATCH * BLOCK_SIZE ];
+  while ( len > 0 ) {
+    // Each sector's tweak is its number as a 128-bit little-endian integer, encrypted with the tweak key. A batch of
+    // them goes through the engine together.
+    size_t sectors = ( len + sectorSize - 1 ) / sectorSize;
+    if ( sectors > XTS_BATCH )
+      sectors = XTS_BATCH;
+    for ( size_t s = 0; s < sectors; s++ ) {
+      storeLittle64( tweaks + s * BLOCK_SIZE, sector + s );
+      storeLittle64( tweaks + s * BLOCK_SIZE + HALF_BLOCK, 0 );
+    }
+    encryptBlocks( tweakCtx, tweaks, tweaks, sectors );
+
+    for ( size_t s = 0; s < sectors; s++ ) {
+      size_t n = len < sectorSize ? len : sectorSize;
+      xtsSector( ctx, tweaks + s * BLOCK_SIZE, in, out, n, encrypt );
+      in += n;
+      out += n;
+      len -= n;
+    }
+    sector += sectors;
+  }
+}
+
+/**
+   Run XTS on one slice of an XtsJob.
+   @param arg the XtsJob.
+   @param start the first sector of the slice.
+   @param count the number of sectors in the slice.
+*/
+static void xtsSlice( void *arg, size_t start, size_t count )
+{
+  XtsJob *job = arg;
+  size_t first = start * job->sectorSize;
+  size_t end = ( start + count ) * job->sectorSize;
+  if ( end > job->len )
+    end = job->len;
+  xtsCrypt( job->ctx, job->tweakCtx, job->sector + start, job->sectorSize, job->in + first, job->out + first,
+            end - first, job->encrypt );
+}
+
+void parallelXtsCrypt( WorkerPool *pool, AesContext const *ctx, AesContext const *tweakCtx, uint64_t sector,
+                       size_t sectorSize, byte const *in, byte *out, size_t len, bool encrypt )
+{
+  // Sectors are independent, so each thread just takes a run of them.
+  XtsJob job = { ctx, tweakCtx, sector, sectorSize, in, out, len, encrypt };
+  size_t sectors = ( len + sectorSize - 1 ) / sectorSize;
+  size_t grain = MIN_BLOCKS_PER_THREAD * BLOCK_SIZE / sectorSize;
+  parallelFor( pool, sectors, grain ? grain : 1, xtsSlice, &job );
+}
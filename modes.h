@@ -0,0 +1,242 @@
+/**
+ * @file modes.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for modes.c, the block cipher modes built on top of the AES engines.
+*/
+
+/** Macro used for unit testing */
+#ifndef _MODES_H_
+/** Macro used for unit testing */
+#define _MODES_H_
+
+#include "aes.h"
+#include "ghash.h"
+#include "parallel.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Size of a GCM IV in bytes; the 96-bit size GCM is designed around. */
+#define GCM_IV_SIZE 12
+
+/** Size of a GCM authentication tag in bytes. */
+#define GCM_TAG_SIZE 16
+
+/** Most bytes GCM can encrypt under one IV: 2^32 - 2 blocks, so the 32-bit counter never wraps back to the
+    pre-counter block. */
+#define GCM_MAX_BYTES ( ( ( (uint64_t) 1 << 32 ) - 2 ) * BLOCK_SIZE )
+
+/** Default size of an XTS data unit: one disk sector. */
+#define XTS_SECTOR 512
+
+/** Size of an XTS key: the data key, then the tweak key. */
+#define XTS_KEY_SIZE ( 2 * BLOCK_SIZE )
+
+/** Most CBC streams one thread encrypts together; more than the widest engine keeps in flight gains nothing. */
+#define CBC_INTERLEAVE 8
+
+/** One of several independent CBC encryptions run together. */
+typedef struct {
+  /** The plaintext. */
+  byte const *in;
+
+  /** Where the ciphertext goes, which may be the same as in. */
+  byte *out;
+
+  /** The number of blocks. */
+  size_t nblocks;
+
+  /** The IV to start with, replaced with the last ciphertext block so a stream can be continued. */
+  byte iv[ BLOCK_SIZE ];
+} CbcStream;
+
+/** State for one GCM encryption or decryption. */
+typedef struct {
+  /** The context holding the expanded key. */
+  AesContext const *ctx;
+
+  /** The hash key, with its tables. */
+  GhashKey ghash;
+
+  /** The pre-counter block, whose encryption masks the tag. */
+  byte j0[ BLOCK_SIZE ];
+
+  /** GHASH of everything so far. */
+  byte state[ BLOCK_SIZE ];
+
+  /** Bytes of additional authenticated data so far. */
+  uint64_t aadLen;
+
+  /** Bytes of data encrypted or decrypted so far. */
+  uint64_t dataLen;
+} GcmContext;
+
+/**
+ * This function fills in the counter block for the given block of a CTR keystream. Counter blocks are the initial
+ * counter block plus the block number, as a 128-bit big-endian integer.
+ * @param counter the counter block to fill in
+ * @param iv the initial counter block, used for block 0
+ * @param blockIndex the number of the block in the keystream
+*/
+void ctrCounterAt( byte counter[ BLOCK_SIZE ], byte const iv[ BLOCK_SIZE ], uint64_t blockIndex );
+
+/**
+ * This function encrypts or decrypts (they're the same operation) data in counter mode. The data can be any length and
+ * can start at any byte offset in the keystream, so a slice of a large file can be processed without touching anything
+ * before it. Keystream blocks are generated in batches through encryptBlocks(), so the engine can keep several in
+ * flight.
+ * @param ctx the context holding the expanded key
+ * @param iv the initial counter block
+ * @param offset position of the first byte of data in the keystream
+ * @param in the data to encrypt or decrypt
+ * @param out where the result goes, which may be the same as in
+ * @param len the number of bytes
+*/
+void ctrCrypt( AesContext const *ctx, byte const iv[ BLOCK_SIZE ], uint64_t offset, byte const *in, byte *out,
+               size_t len );
+
+/**
+ * This function does the same thing as ctrCrypt(), but splits the data across the threads of a pool. Every keystream
+ * block is independent, so each thread just starts at its own offset.
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param ctx the context holding the expanded key
+ * @param iv the initial counter block
+ * @param offset position of the first byte of data in the keystream
+ * @param in the data to encrypt or decrypt
+ * @param out where the result goes, which may be the same as in
+ * @param len the number of bytes
+*/
+void parallelCtrCrypt( WorkerPool *pool, AesContext const *ctx, byte const iv[ BLOCK_SIZE ], uint64_t offset,
+                       byte const *in, byte *out, size_t len );
+
+/**
+ * This function encrypts several independent streams in CBC mode. Within a stream each block depends on the one
+ * before, so a single stream can't use the engine's parallel lanes, but up to CBC_INTERLEAVE streams are interleaved
+ * a block from each at a time to fill them.
+ * @param ctx the context holding the expanded key
+ * @param streams the streams to encrypt
+ * @param count the number of streams
+*/
+void cbcEncryptStreams( AesContext const *ctx, CbcStream *streams, int count );
+
+/**
+ * This function does the same thing as cbcEncryptStreams(), but with groups of streams split across the threads of a
+ * pool.
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param ctx the context holding the expanded key
+ * @param streams the streams to encrypt
+ * @param count the number of streams
+*/
+void parallelCbcEncryptStreams( WorkerPool *pool, AesContext const *ctx, CbcStream *streams, int count );
+
+/**
+ * This function decrypts data in CBC mode, split across the threads of a pool. Unlike encryption, every block can be
+ * decrypted independently, then XORed with the ciphertext block before it.
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param ctx the context holding the expanded key
+ * @param iv the IV, replaced with the last ciphertext block so decryption can be continued
+ * @param in the ciphertext
+ * @param out where the plaintext goes, which may be the same as in
+ * @param nblocks the number of blocks
+*/
+void parallelCbcDecrypt( WorkerPool *pool, AesContext const *ctx, byte iv[ BLOCK_SIZE ], byte const *in, byte *out,
+                         size_t nblocks );
+
+/**
+ * This function starts a GCM encryption or decryption.
+ * @param gcm the state to initialize
+ * @param ctx the context holding the expanded key, which must outlive gcm
+ * @param iv the IV, which must never be used twice with the same key
+*/
+void gcmInit( GcmContext *gcm, AesContext const *ctx, byte const iv[ GCM_IV_SIZE ] );
+
+/**
+ * This function starts another GCM encryption or decryption with the same key, keeping the hash key and its tables
+ * from gcmInit() instead of working them out again.
+ * @param gcm state that gcmInit() has filled in before
+ * @param iv the IV, which must never be used twice with the same key
+*/
+void gcmRestart( GcmContext *gcm, byte const iv[ GCM_IV_SIZE ] );
+
+/**
+ * This function adds data that is authenticated but not encrypted. It must be called at most once, before any data
+ * is encrypted or decrypted.
+ * @param gcm the GCM operation in progress
+ * @param aad the additional data
+ * @param len the number of bytes
+*/
+void gcmAad( GcmContext *gcm, byte const *aad, size_t len );
+
+/**
+ * This function encrypts the next part of the data and adds the ciphertext to the hash in the same pass, splitting the
+ * work across the threads of a pool. Every call but the last must be a whole number of blocks. The counter advances
+ * in its last 32 bits only, as GCM's inc32 does, which is why a message can't go past GCM_MAX_BYTES.
+ * @param gcm the GCM operation in progress
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param in the plaintext
+ * @param out where the ciphertext goes, which may be the same as in
+ * @param len the number of bytes
+ * @return false, with nothing done, if the message would go past GCM_MAX_BYTES
+*/
+bool gcmEncrypt( GcmContext *gcm, WorkerPool *pool, byte const *in, byte *out, size_t len );
+
+/**
+ * This function is the decryption counterpart of gcmEncrypt(), hashing the ciphertext as it decrypts it. The result
+ * mustn't be trusted until gcmCheckTag() accepts the tag.
+ * @param gcm the GCM operation in progress
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param in the ciphertext
+ * @param out where the plaintext goes, which may be the same as in
+ * @param len the number of bytes
+ * @return false, with nothing done, if the message would go past GCM_MAX_BYTES
+*/
+bool gcmDecrypt( GcmContext *gcm, WorkerPool *pool, byte const *in, byte *out, size_t len );
+
+/**
+ * This function finishes an encryption and computes the authentication tag.
+ * @param gcm the GCM operation in progress
+ * @param tag where the tag goes
+*/
+void gcmFinal( GcmContext *gcm, byte tag[ GCM_TAG_SIZE ] );
+
+/**
+ * This function finishes a decryption and checks the tag that came with the ciphertext, in constant time.
+ * @param gcm the GCM operation in progress
+ * @param tag the tag to check
+ * @return true if the tag is right, so the ciphertext is authentic
+*/
+bool gcmCheckTag( GcmContext *gcm, byte const tag[ GCM_TAG_SIZE ] );
+
+/**
+ * This function encrypts or decrypts a run of consecutive sectors in XTS mode (IEEE 1619). Each sector is tweaked by
+ * its number, encrypted with the tweak key, so equal sectors at different places don't look the same and any sector
+ * can be done on its own. Every sector but the last is sectorSize bytes; the last may be shorter. Whenever a sector
+ * isn't a whole number of blocks, ciphertext stealing keeps its output the same length as its input.
+ * @param ctx the context holding the expanded data key
+ * @param tweakCtx the context holding the expanded tweak key
+ * @param sector number of the first sector
+ * @param sectorSize bytes in a sector, at least BLOCK_SIZE
+ * @param in the input data
+ * @param out where the output goes, which may be the same as in
+ * @param len the number of bytes, where the last sector is at least BLOCK_SIZE bytes
+ * @param encrypt true to encrypt, false to decrypt
+*/
+void xtsCrypt( AesContext const *ctx, AesContext const *tweakCtx, uint64_t sector, size_t sectorSize,
+               byte const *in, byte *out, size_t len, bool encrypt );
+
+/**
+ * This function does the same as xtsCrypt(), but splits the sectors across a pool of threads.
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param ctx the context holding the expanded data key
+ * @param tweakCtx the context holding the expanded tweak key
+ * @param sector number of the first sector
+ * @param sectorSize bytes in a sector, at least BLOCK_SIZE
+ * @param in the input data
+ * @param out where the output goes, which may be the same as in
+ * @param len the number of bytes, where the last sector is at least BLOCK_SIZE bytes
+ * @param encrypt true to encrypt, false to decrypt
+*/
+void parallelXtsCrypt( WorkerPool *pool, AesContext const *ctx, AesContext const *tweakCtx, uint64_t sector,
+                       size_t sectorSize, byte const *in, byte *out, size_t len, bool encrypt );
+
+#endif
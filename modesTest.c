@@ -0,0 +1,604 @@
+/**
+  @file modesTest.c
+  @author Jimin Yu, jyu34
+  Unit test program for the block cipher modes.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "modes.h"
+
+/** Number of tests we should have, if they're all turned on. */
+#define EXPECTED_TOTAL 40
+
+/** Total number or tests we tried. */
+static int totalTests = 0;
+
+/** Number of test cases passed. */
+static int passedTests = 0;
+
+/** Macro to check the condition on a test case, keep counts of
+    passed/failed tests and report a message if the test fails. */
+#define TestCase( conditional ) {\
+  totalTests += 1; \
+  if ( conditional ) { \
+    passedTests += 1; \
+  } else { \
+    printf( "**** Failed unit test on line %d of %s\n", __LINE__, __FILE__ );    \
+  } \
+}
+
+/** Key from the NIST SP 800-38A examples. */
+static byte const nistKey[ BLOCK_SIZE ] = {
+  0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+  0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+
+/** Plaintext from the NIST SP 800-38A examples. */
+static byte const nistPlain[ 4 * BLOCK_SIZE ] = {
+  0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+  0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+  0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+  0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+  0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11,
+  0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+  0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17,
+  0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10 };
+
+/** Work for countItem(). */
+typedef struct {
+  /** How many times each item was run. */
+  int *runs;
+
+  /** Number of threads the items were run on. */
+  int threads;
+
+  /** Set if an item ran on a thread number that doesn't exist. */
+  bool badWorker;
+} ItemCount;
+
+/**
+   Count a run of one item, spending longer on the first few so the other threads have to steal.
+   @param arg the ItemCount.
+   @param index the item.
+   @param worker the thread running it.
+*/
+static void countItem( void *arg, size_t index, int worker )
+{
+  ItemCount *count = arg;
+  for ( volatile int spin = 0; index < 64 && spin < 20000; spin++ )
+    ;
+  __atomic_fetch_add( &count->runs[ index ], 1, __ATOMIC_RELAXED );
+  if ( worker < 0 || worker >= count->threads )
+    count->badWorker = true;
+}
+
+int main()
+{
+  ////////////////////////////////////////////////////////////////////////
+  // Test ctrCounterAt()
+
+  {
+    byte iv[ BLOCK_SIZE ] = {
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+      0x08, 0x09, 0x0A, 0x0B, 0xFF, 0xFF, 0xFF, 0xFE };
+    byte counter[ BLOCK_SIZE ];
+    ctrCounterAt( counter, iv, 3 );
+
+    // The addition carries out of the low 32 bits.
+    byte expected[ BLOCK_SIZE ] = {
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+      0x08, 0x09, 0x0A, 0x0C, 0x00, 0x00, 0x00, 0x01 };
+    TestCase( memcmp( counter, expected, BLOCK_SIZE ) == 0 );
+  }
+
+  {
+    byte iv[ BLOCK_SIZE ];
+    memset( iv, 0xFF, BLOCK_SIZE );
+    byte counter[ BLOCK_SIZE ];
+    ctrCounterAt( counter, iv, 1 );
+
+    // The whole 128-bit counter wraps around to zero.
+    byte expected[ BLOCK_SIZE ] = { 0 };
+    TestCase( memcmp( counter, expected, BLOCK_SIZE ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test ctrCrypt(), with the vector from NIST SP 800-38A F.5.1
+
+  AesContext ctx;
+  aesInitCtx( &ctx, nistKey );
+
+  byte iv[ BLOCK_SIZE ] = {
+    0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7,
+    0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF };
+
+  byte cipher[ 4 * BLOCK_SIZE ] = {
+    0x87, 0x4D, 0x61, 0x91, 0xB6, 0x20, 0xE3, 0x26,
+    0x1B, 0xEF, 0x68, 0x64, 0x99, 0x0D, 0xB6, 0xCE,
+    0x98, 0x06, 0xF6, 0x6B, 0x79, 0x70, 0xFD, 0xFF,
+    0x86, 0x17, 0x18, 0x7B, 0xB9, 0xFF, 0xFD, 0xFF,
+    0x5A, 0xE4, 0xDF, 0x3E, 0xDB, 0xD5, 0xD3, 0x5E,
+    0x5B, 0x4F, 0x09, 0x02, 0x0D, 0xB0, 0x3E, 0xAB,
+    0x1E, 0x03, 0x1D, 0xDA, 0x2F, 0xBE, 0x03, 0xD1,
+    0x79, 0x21, 0x70, 0xA0, 0xF3, 0x00, 0x9C, 0xEE };
+
+  {
+    byte out[ sizeof( cipher ) ];
+    ctrCrypt( &ctx, iv, 0, nistPlain, out, sizeof( out ) );
+    TestCase( memcmp( out, cipher, sizeof( cipher ) ) == 0 );
+
+    // Decryption is the same operation, and can work in place.
+    ctrCrypt( &ctx, iv, 0, out, out, sizeof( out ) );
+    TestCase( memcmp( out, nistPlain, sizeof( out ) ) == 0 );
+  }
+
+  {
+    // A slice that starts and ends in the middle of blocks matches the same bytes of the whole message.
+    byte out[ 37 ];
+    ctrCrypt( &ctx, iv, 7, nistPlain + 7, out, sizeof( out ) );
+    TestCase( memcmp( out, cipher + 7, sizeof( out ) ) == 0 );
+
+    // So does a slice shorter than one block.
+    ctrCrypt( &ctx, iv, 50, nistPlain + 50, out, 5 );
+    TestCase( memcmp( out, cipher + 50, 5 ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test parallelCtrCrypt() against ctrCrypt() on enough data to split
+
+  {
+    size_t len = 3 * MIN_BLOCKS_PER_THREAD * BLOCK_SIZE + 11;
+    byte *data = malloc( len );
+    byte *serial = malloc( len );
+    byte *threaded = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      data[ i ] = i * 31 + 7;
+
+    ctrCrypt( &ctx, iv, 3, data, serial, len );
+
+    WorkerPool *pool = poolCreate( 3 );
+    parallelCtrCrypt( pool, &ctx, iv, 3, data, threaded, len );
+    TestCase( memcmp( serial, threaded, len ) == 0 );
+
+    // Decrypting in place gets the data back.
+    parallelCtrCrypt( pool, &ctx, iv, 3, threaded, threaded, len );
+    TestCase( memcmp( data, threaded, len ) == 0 );
+    poolDestroy( pool );
+
+    // With no pool it runs on the calling thread.
+    parallelCtrCrypt( NULL, &ctx, iv, 3, data, threaded, len );
+    TestCase( memcmp( serial, threaded, len ) == 0 );
+
+    free( data );
+    free( serial );
+    free( threaded );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test CBC, with the vector from NIST SP 800-38A F.2.1
+
+  byte cbcIv[ BLOCK_SIZE ] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+
+  byte cbcCipher[ 4 * BLOCK_SIZE ] = {
+    0x76, 0x49, 0xAB, 0xAC, 0x81, 0x19, 0xB2, 0x46,
+    0xCE, 0xE9, 0x8E, 0x9B, 0x12, 0xE9, 0x19, 0x7D,
+    0x50, 0x86, 0xCB, 0x9B, 0x50, 0x72, 0x19, 0xEE,
+    0x95, 0xDB, 0x11, 0x3A, 0x91, 0x76, 0x78, 0xB2,
+    0x73, 0xBE, 0xD6, 0xB8, 0xE3, 0xC1, 0x74, 0x3B,
+    0x71, 0x16, 0xE6, 0x9E, 0x22, 0x22, 0x95, 0x16,
+    0x3F, 0xF1, 0xCA, 0xA1, 0x68, 0x1F, 0xAC, 0x09,
+    0x12, 0x0E, 0xCA, 0x30, 0x75, 0x86, 0xE1, 0xA7 };
+
+  {
+    // Encrypt in two pieces, the second carrying on from the IV the first leaves behind.
+    byte out[ sizeof( cbcCipher ) ];
+    CbcStream stream = { nistPlain, out, 1 };
+    memcpy( stream.iv, cbcIv, BLOCK_SIZE );
+    cbcEncryptStreams( &ctx, &stream, 1 );
+    stream.in = nistPlain + BLOCK_SIZE;
+    stream.out = out + BLOCK_SIZE;
+    stream.nblocks = 3;
+    cbcEncryptStreams( &ctx, &stream, 1 );
+    TestCase( memcmp( out, cbcCipher, sizeof( out ) ) == 0 );
+
+    // Decrypt in place, in the same two pieces.
+    byte iv[ BLOCK_SIZE ];
+    memcpy( iv, cbcIv, BLOCK_SIZE );
+    parallelCbcDecrypt( NULL, &ctx, iv, out, out, 1 );
+    parallelCbcDecrypt( NULL, &ctx, iv, out + BLOCK_SIZE, out + BLOCK_SIZE, 3 );
+    TestCase( memcmp( out, nistPlain, sizeof( out ) ) == 0 );
+  }
+
+  {
+    // Several streams of different lengths, interleaved, match each one encrypted on its own.
+    int count = CBC_INTERLEAVE + 3;
+    size_t most = 50;
+    byte *data = malloc( count * most * BLOCK_SIZE );
+    byte *alone = malloc( count * most * BLOCK_SIZE );
+    byte *together = malloc( count * most * BLOCK_SIZE );
+    for ( size_t i = 0; i < count * most * BLOCK_SIZE; i++ )
+      data[ i ] = i * 5 + 1;
+
+    CbcStream streams[ CBC_INTERLEAVE + 3 ];
+    for ( int s = 0; s < count; s++ ) {
+      CbcStream one = { data + s * most * BLOCK_SIZE, alone + s * most * BLOCK_SIZE, most - s * 3 };
+      memset( one.iv, s, BLOCK_SIZE );
+      streams[ s ] = one;
+      cbcEncryptStreams( &ctx, &one, 1 );
+      streams[ s ].out = together + s * most * BLOCK_SIZE;
+    }
+
+    WorkerPool *pool = poolCreate( 2 );
+    parallelCbcEncryptStreams( pool, &ctx, streams, count );
+    poolDestroy( pool );
+
+    bool same = true;
+    for ( int s = 0; s < count; s++ )
+      same = same && memcmp( alone + s * most * BLOCK_SIZE, together + s * most * BLOCK_SIZE,
+                             streams[ s ].nblocks * BLOCK_SIZE ) == 0;
+    TestCase( same );
+
+    free( data );
+    free( alone );
+    free( together );
+  }
+
+  {
+    // Decryption split across threads, in place, gets back what one stream encrypted.
+    size_t nblocks = 4 * MIN_BLOCKS_PER_THREAD + 5;
+    byte *data = malloc( nblocks * BLOCK_SIZE );
+    byte *work = malloc( nblocks * BLOCK_SIZE );
+    for ( size_t i = 0; i < nblocks * BLOCK_SIZE; i++ )
+      data[ i ] = i * 11 + 2;
+
+    CbcStream stream = { data, work, nblocks };
+    memcpy( stream.iv, cbcIv, BLOCK_SIZE );
+    cbcEncryptStreams( &ctx, &stream, 1 );
+
+    WorkerPool *pool = poolCreate( 3 );
+    byte iv[ BLOCK_SIZE ];
+    memcpy( iv, cbcIv, BLOCK_SIZE );
+    parallelCbcDecrypt( pool, &ctx, iv, work, work, nblocks );
+    poolDestroy( pool );
+    TestCase( memcmp( work, data, nblocks * BLOCK_SIZE ) == 0 );
+
+    // The IV left behind is the last ciphertext block, the same as encryption left.
+    TestCase( memcmp( iv, stream.iv, BLOCK_SIZE ) == 0 );
+
+    // And without a pool.
+    memcpy( stream.iv, cbcIv, BLOCK_SIZE );
+    stream.out = work;
+    cbcEncryptStreams( &ctx, &stream, 1 );
+    memcpy( iv, cbcIv, BLOCK_SIZE );
+    parallelCbcDecrypt( NULL, &ctx, iv, work, work, nblocks );
+    TestCase( memcmp( work, data, nblocks * BLOCK_SIZE ) == 0 );
+
+    free( data );
+    free( work );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test ghashInit() and ghashBlocks(), with H from GCM test case 2
+
+  {
+    byte h[ BLOCK_SIZE ] = {
+      0x66, 0xE9, 0x4B, 0xD4, 0xEF, 0x8A, 0x2C, 0x3B,
+      0x88, 0x4C, 0xFA, 0x59, 0xCA, 0x34, 0x2B, 0x2E };
+    GhashKey key;
+    ghashInit( &key, h );
+
+    size_t nblocks = 11;
+    byte data[ 11 * BLOCK_SIZE ];
+    for ( size_t i = 0; i < sizeof( data ); i++ )
+      data[ i ] = i * 131 + 17;
+
+    // Hash one block at a time with the bitwise multiply.
+    byte expected[ BLOCK_SIZE ] = { 0 };
+    for ( size_t b = 0; b < nblocks; b++ ) {
+      for ( int i = 0; i < BLOCK_SIZE; i++ )
+        expected[ i ] ^= data[ b * BLOCK_SIZE + i ];
+      ghashMul( expected, h );
+    }
+
+    // The tables and the carry-less multiply path (where there is one) must agree with it.
+    byte state[ BLOCK_SIZE ] = { 0 };
+    ghashBlocks( &key, state, data, nblocks );
+    TestCase( memcmp( state, expected, BLOCK_SIZE ) == 0 );
+
+    key.clmul = false;
+    memset( state, 0, BLOCK_SIZE );
+    ghashBlocks( &key, state, data, nblocks );
+    TestCase( memcmp( state, expected, BLOCK_SIZE ) == 0 );
+
+    // H^3 is H times H times H.
+    byte cube[ BLOCK_SIZE ];
+    ghashPow( cube, h, 3 );
+    memcpy( state, h, BLOCK_SIZE );
+    ghashMul( state, h );
+    ghashMul( state, h );
+    TestCase( memcmp( state, cube, BLOCK_SIZE ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test GCM, with test cases 2 and 4 from the GCM specification
+
+  {
+    byte zero[ BLOCK_SIZE ] = { 0 };
+    AesContext zctx;
+    aesInitCtx( &zctx, zero );
+
+    GcmContext gcm;
+    gcmInit( &gcm, &zctx, zero );
+    byte out[ BLOCK_SIZE ];
+    gcmEncrypt( &gcm, NULL, zero, out, BLOCK_SIZE );
+    byte tag[ GCM_TAG_SIZE ];
+    gcmFinal( &gcm, tag );
+
+    byte expectedOut[ BLOCK_SIZE ] = {
+      0x03, 0x88, 0xDA, 0xCE, 0x60, 0xB6, 0xA3, 0x92,
+      0xF3, 0x28, 0xC2, 0xB9, 0x71, 0xB2, 0xFE, 0x78 };
+    byte expectedTag[ GCM_TAG_SIZE ] = {
+      0xAB, 0x6E, 0x47, 0xD4, 0x2C, 0xEC, 0x13, 0xBD,
+      0xF5, 0x3A, 0x67, 0xB2, 0x12, 0x57, 0xBD, 0xDF };
+    TestCase( memcmp( out, expectedOut, BLOCK_SIZE ) == 0 );
+    TestCase( memcmp( tag, expectedTag, GCM_TAG_SIZE ) == 0 );
+  }
+
+  byte gcmKey[ BLOCK_SIZE ] = {
+    0xFE, 0xFF, 0xE9, 0x92, 0x86, 0x65, 0x73, 0x1C,
+    0x6D, 0x6A, 0x8F, 0x94, 0x67, 0x30, 0x83, 0x08 };
+  byte gcmIv[ GCM_IV_SIZE ] = {
+    0xCA, 0xFE, 0xBA, 0xBE, 0xFA, 0xCE, 0xDB, 0xAD,
+    0xDE, 0xCA, 0xF8, 0x88 };
+  AesContext gctx;
+  aesInitCtx( &gctx, gcmKey );
+
+  {
+    byte plain[ 60 ] = {
+      0xD9, 0x31, 0x32, 0x25, 0xF8, 0x84, 0x06, 0xE5,
+      0xA5, 0x59, 0x09, 0xC5, 0xAF, 0xF5, 0x26, 0x9A,
+      0x86, 0xA7, 0xA9, 0x53, 0x15, 0x34, 0xF7, 0xDA,
+      0x2E, 0x4C, 0x30, 0x3D, 0x8A, 0x31, 0x8A, 0x72,
+      0x1C, 0x3C, 0x0C, 0x95, 0x95, 0x68, 0x09, 0x53,
+      0x2F, 0xCF, 0x0E, 0x24, 0x49, 0xA6, 0xB5, 0x25,
+      0xB1, 0x6A, 0xED, 0xF5, 0xAA, 0x0D, 0xE6, 0x57,
+      0xBA, 0x63, 0x7B, 0x39 };
+    byte aad[ 20 ] = {
+      0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+      0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF,
+      0xAB, 0xAD, 0xDA, 0xD2 };
+    byte expectedOut[ 60 ] = {
+      0x42, 0x83, 0x1E, 0xC2, 0x21, 0x77, 0x74, 0x24,
+      0x4B, 0x72, 0x21, 0xB7, 0x84, 0xD0, 0xD4, 0x9C,
+      0xE3, 0xAA, 0x21, 0x2F, 0x2C, 0x02, 0xA4, 0xE0,
+      0x35, 0xC1, 0x7E, 0x23, 0x29, 0xAC, 0xA1, 0x2E,
+      0x21, 0xD5, 0x14, 0xB2, 0x54, 0x66, 0x93, 0x1C,
+      0x7D, 0x8F, 0x6A, 0x5A, 0xAC, 0x84, 0xAA, 0x05,
+      0x1B, 0xA3, 0x0B, 0x39, 0x6A, 0x0A, 0xAC, 0x97,
+      0x3D, 0x58, 0xE0, 0x91 };
+    byte expectedTag[ GCM_TAG_SIZE ] = {
+      0x5B, 0xC9, 0x4F, 0xBC, 0x32, 0x21, 0xA5, 0xDB,
+      0x94, 0xFA, 0xE9, 0x5A, 0xE7, 0x12, 0x1A, 0x47 };
+
+    // Encrypt in two calls, the first a whole number of blocks.
+    GcmContext gcm;
+    gcmInit( &gcm, &gctx, gcmIv );
+    gcmAad( &gcm, aad, sizeof( aad ) );
+    byte out[ 60 ];
+    gcmEncrypt( &gcm, NULL, plain, out, 32 );
+    gcmEncrypt( &gcm, NULL, plain + 32, out + 32, sizeof( plain ) - 32 );
+    byte tag[ GCM_TAG_SIZE ];
+    gcmFinal( &gcm, tag );
+    TestCase( memcmp( out, expectedOut, sizeof( out ) ) == 0 );
+    TestCase( memcmp( tag, expectedTag, GCM_TAG_SIZE ) == 0 );
+
+    // Decrypt in place, and check the tag.
+    gcmInit( &gcm, &gctx, gcmIv );
+    gcmAad( &gcm, aad, sizeof( aad ) );
+    gcmDecrypt( &gcm, NULL, out, out, sizeof( out ) );
+    TestCase( memcmp( out, plain, sizeof( out ) ) == 0 );
+    TestCase( gcmCheckTag( &gcm, expectedTag ) );
+
+    // A changed bit anywhere makes the tag fail.
+    memcpy( out, expectedOut, sizeof( out ) );
+    out[ 37 ] ^= 0x04;
+    gcmInit( &gcm, &gctx, gcmIv );
+    gcmAad( &gcm, aad, sizeof( aad ) );
+    gcmDecrypt( &gcm, NULL, out, out, sizeof( out ) );
+    TestCase( !gcmCheckTag( &gcm, expectedTag ) );
+
+    // Starting over on the same state keeps the hash key, and gets the same answer.
+    gcmRestart( &gcm, gcmIv );
+    gcmAad( &gcm, aad, sizeof( aad ) );
+    gcmEncrypt( &gcm, NULL, plain, out, sizeof( plain ) );
+    gcmFinal( &gcm, tag );
+    TestCase( memcmp( out, expectedOut, sizeof( out ) ) == 0 && memcmp( tag, expectedTag, GCM_TAG_SIZE ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test GCM split across threads against a single thread
+
+  {
+    size_t len = 5 * MIN_BLOCKS_PER_THREAD * BLOCK_SIZE + 9;
+    byte *data = malloc( len );
+    byte *serial = malloc( len );
+    byte *threaded = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      data[ i ] = i * 7 + 3;
+
+    GcmContext gcm;
+    gcmInit( &gcm, &gctx, gcmIv );
+    gcmEncrypt( &gcm, NULL, data, serial, len );
+    byte serialTag[ GCM_TAG_SIZE ];
+    gcmFinal( &gcm, serialTag );
+
+    // Two calls, so the second continues from a hash that's already under way.
+    WorkerPool *pool = poolCreate( 3 );
+    size_t split = 2 * MIN_BLOCKS_PER_THREAD * BLOCK_SIZE;
+    gcmInit( &gcm, &gctx, gcmIv );
+    gcmEncrypt( &gcm, pool, data, threaded, split );
+    gcmEncrypt( &gcm, pool, data + split, threaded + split, len - split );
+    byte threadedTag[ GCM_TAG_SIZE ];
+    gcmFinal( &gcm, threadedTag );
+    TestCase( memcmp( serial, threaded, len ) == 0 );
+    TestCase( memcmp( serialTag, threadedTag, GCM_TAG_SIZE ) == 0 );
+
+    gcmInit( &gcm, &gctx, gcmIv );
+    gcmDecrypt( &gcm, pool, threaded, threaded, len );
+    TestCase( memcmp( data, threaded, len ) == 0 && gcmCheckTag( &gcm, serialTag ) );
+    poolDestroy( pool );
+
+    free( data );
+    free( serial );
+    free( threaded );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test the GCM counter wrapping in its last 32 bits and the message limit
+
+  {
+    // With the pre-counter block's counter at its top, the first data block's counter wraps to zero and the IV stays.
+    GcmContext gcm;
+    gcmInit( &gcm, &gctx, gcmIv );
+    memset( gcm.j0 + GCM_IV_SIZE, 0xFF, BLOCK_SIZE - GCM_IV_SIZE );
+    byte zero[ 2 * BLOCK_SIZE ] = { 0 };
+    byte out[ 2 * BLOCK_SIZE ];
+    gcmEncrypt( &gcm, NULL, zero, out, sizeof( out ) );
+
+    byte counters[ 2 * BLOCK_SIZE ] = { 0 };
+    memcpy( counters, gcmIv, GCM_IV_SIZE );
+    memcpy( counters + BLOCK_SIZE, gcmIv, GCM_IV_SIZE );
+    counters[ 2 * BLOCK_SIZE - 1 ] = 1;
+    encryptBlocks( &gctx, counters, counters, 2 );
+    TestCase( memcmp( out, counters, sizeof( out ) ) == 0 );
+
+    // A message can reach GCM_MAX_BYTES but not go past it.
+    gcmInit( &gcm, &gctx, gcmIv );
+    gcm.dataLen = GCM_MAX_BYTES - BLOCK_SIZE;
+    TestCase( gcmEncrypt( &gcm, NULL, zero, out, BLOCK_SIZE ) && gcm.dataLen == GCM_MAX_BYTES );
+    TestCase( !gcmEncrypt( &gcm, NULL, zero, out, 1 ) && !gcmDecrypt( &gcm, NULL, zero, out, 1 ) &&
+              gcm.dataLen == GCM_MAX_BYTES );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test XTS, with vectors 2 and 15 from IEEE 1619
+
+  {
+    byte key1[ BLOCK_SIZE ], key2[ BLOCK_SIZE ];
+    memset( key1, 0x11, BLOCK_SIZE );
+    memset( key2, 0x22, BLOCK_SIZE );
+    AesContext ctx, tweakCtx;
+    aesInitCtx( &ctx, key1 );
+    aesInitCtx( &tweakCtx, key2 );
+
+    byte plain[ 2 * BLOCK_SIZE ];
+    memset( plain, 0x44, sizeof( plain ) );
+    byte expected[ 2 * BLOCK_SIZE ] = {
+      0xC4, 0x54, 0x18, 0x5E, 0x6A, 0x16, 0x93, 0x6E,
+      0x39, 0x33, 0x40, 0x38, 0xAC, 0xEF, 0x83, 0x8B,
+      0xFB, 0x18, 0x6F, 0xFF, 0x74, 0x80, 0xAD, 0xC4,
+      0x28, 0x93, 0x82, 0xEC, 0xD6, 0xD3, 0x94, 0xF0 };
+    byte out[ 2 * BLOCK_SIZE ];
+    xtsCrypt( &ctx, &tweakCtx, 0x3333333333ULL, XTS_SECTOR, plain, out, sizeof( out ), true );
+    TestCase( memcmp( out, expected, sizeof( out ) ) == 0 );
+    xtsCrypt( &ctx, &tweakCtx, 0x3333333333ULL, XTS_SECTOR, out, out, sizeof( out ), false );
+    TestCase( memcmp( out, plain, sizeof( out ) ) == 0 );
+  }
+
+  {
+    byte key1[ BLOCK_SIZE ], key2[ BLOCK_SIZE ];
+    for ( int i = 0; i < BLOCK_SIZE; i++ ) {
+      key1[ i ] = 0xFF - i;
+      key2[ i ] = 0xBF - i;
+    }
+    AesContext ctx, tweakCtx;
+    aesInitCtx( &ctx, key1 );
+    aesInitCtx( &tweakCtx, key2 );
+
+    // 17 bytes, so the last block is stolen from.
+    byte plain[ BLOCK_SIZE + 1 ];
+    for ( int i = 0; i < sizeof( plain ); i++ )
+      plain[ i ] = i;
+    byte expected[ BLOCK_SIZE + 1 ] = {
+      0x6C, 0x16, 0x25, 0xDB, 0x46, 0x71, 0x52, 0x2D,
+      0x3D, 0x75, 0x99, 0x60, 0x1D, 0xE7, 0xCA, 0x09,
+      0xED };
+    byte out[ BLOCK_SIZE + 1 ];
+    xtsCrypt( &ctx, &tweakCtx, 0x123456789AULL, XTS_SECTOR, plain, out, sizeof( out ), true );
+    TestCase( memcmp( out, expected, sizeof( out ) ) == 0 );
+    xtsCrypt( &ctx, &tweakCtx, 0x123456789AULL, XTS_SECTOR, out, out, sizeof( out ), false );
+    TestCase( memcmp( out, plain, sizeof( out ) ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test XTS split across threads against a single thread, ending with a short sector
+
+  {
+    AesContext tweakCtx;
+    aesInitCtx( &tweakCtx, gcmKey );
+    size_t sectorSize = 4096;
+    size_t len = 40 * sectorSize + 100;
+    byte *data = malloc( len );
+    byte *serial = malloc( len );
+    byte *threaded = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      data[ i ] = i * 13 + 5;
+
+    xtsCrypt( &gctx, &tweakCtx, 7, sectorSize, data, serial, len, true );
+    WorkerPool *pool = poolCreate( 3 );
+    parallelXtsCrypt( pool, &gctx, &tweakCtx, 7, sectorSize, data, threaded, len, true );
+    TestCase( memcmp( serial, threaded, len ) == 0 );
+
+    // Any one sector can be decrypted on its own.
+    parallelXtsCrypt( pool, &gctx, &tweakCtx, 7, sectorSize, threaded, threaded, len, false );
+    xtsCrypt( &gctx, &tweakCtx, 12, sectorSize, serial + 5 * sectorSize, serial + 5 * sectorSize, sectorSize, false );
+    TestCase( memcmp( data, threaded, len ) == 0 &&
+              memcmp( serial + 5 * sectorSize, data + 5 * sectorSize, sectorSize ) == 0 );
+    poolDestroy( pool );
+
+    free( data );
+    free( serial );
+    free( threaded );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test parallelForEach() runs every item exactly once
+
+  {
+    size_t items = 5000;
+    ItemCount count = { calloc( items, sizeof( int ) ), 4, false };
+    WorkerPool *pool = poolCreate( count.threads );
+    parallelForEach( pool, items, countItem, &count );
+    poolDestroy( pool );
+
+    bool once = true;
+    for ( size_t i = 0; i < items; i++ )
+      once = once && count.runs[ i ] == 1;
+    TestCase( once && !count.badWorker );
+
+    // Without a pool, the calling thread runs them all.
+    memset( count.runs, 0, items * sizeof( int ) );
+    count.threads = 1;
+    parallelForEach( NULL, items, countItem, &count );
+    once = true;
+    for ( size_t i = 0; i < items; i++ )
+      once = once && count.runs[ i ] == 1;
+    TestCase( once && !count.badWorker );
+    free( count.runs );
+  }
+
+  // Report a message if some tests are still disabled.
+  if ( totalTests < EXPECTED_TOTAL )
+    printf( "** %d of %d tests currently enabled.\n", totalTests,
+            EXPECTED_TOTAL );
+
+  // Exit successfully if all tests are enabled and they all pass.
+  if ( passedTests != EXPECTED_TOTAL )
+    return EXIT_FAILURE;
+  else
+    return EXIT_SUCCESS;
+}
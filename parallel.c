@@ -0,0 +1,389 @@
+/**
+ * @file parallel.c
+ * @author Jimin Yu, jyu34
+ * This file implements a small pool of worker threads. The threads are started once and then reused for every range
+ * of work, so splitting a buffer across cores only costs a wake-up, not a thread creation.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "parallel.h"
+#include "aes.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/** Information a worker thread needs to find its slice. */
+typedef struct {
+  /** The pool the worker belongs to. */
+  WorkerPool *pool;
+
+  /** The worker's slice number; the calling thread always takes slice 0. */
+  int index;
+} Worker;
+
+struct WorkerPool {
+  /** Total number of threads, including the one calling parallelFor(). */
+  int threads;
+
+  /** The threads started by the pool, threads - 1 of them. */
+  pthread_t *ids;
+
+  /** Per-thread information for the started threads. */
+  Worker *workers;
+
+  /** Protects all the fields below. */
+  pthread_mutex_t lock;
+
+  /** Signaled when a new range is posted or the pool is shutting down. */
+  pthread_cond_t start;
+
+  /** Signaled when a worker finishes its slice. */
+  pthread_cond_t done;
+
+  /** Incremented for each range posted, so workers can tell a new one has arrived. */
+  unsigned long generation;
+
+  /** Number of started threads that haven't finished the current range yet. */
+  int pending;
+
+  /** Set when the pool is being destroyed. */
+  bool quit;
+
+  /** Function to run on each slice of the current range. */
+  RangeFunction fn;
+
+  /** Argument for fn. */
+  void *arg;
+
+  /** Size of the current range. */
+  size_t count;
+
+  /** Number of slices the current range is split into. */
+  int slices;
+};
+
+/** Work for parallelEncryptBlocks() and parallelDecryptBlocks(). */
+typedef struct {
+  /** The context holding the expanded key. */
+  AesContext const *ctx;
+
+  /** The input blocks. */
+  byte const *in;
+
+  /** Where the output blocks go. */
+  byte *out;
+} BlockJob;
+
+/** The items a thread still has to run in parallelForEach(); others may steal from the end of it. */
+typedef struct {
+  /** Protects next and end. */
+  pthread_mutex_t lock;
+
+  /** The next item to run. */
+  size_t next;
+
+  /** One past the last item. */
+  size_t end;
+} ItemQueue;
+
+/** Work for parallelForEach(). */
+typedef struct {
+  /** One queue for each thread. */
+  ItemQueue *queues;
+
+  /** Number of threads, and queues. */
+  int threads;
+
+  /** Function to run on each item. */
+  ItemFunction fn;
+
+  /** Argument for fn. */
+  void *arg;
+} ItemJob;
+
+/**
+   Run one slice of the pool's current range.
+   @param pool the pool.
+   @param index the slice to run.
+*/
+static void runSlice( WorkerPool *pool, int index )
+{
+  if ( index >= pool->slices )
+    return;
+
+  size_t start = pool->count * index / pool->slices;
+  size_t end = pool->count * ( index + 1 ) / pool->slices;
+  pool->fn( pool->arg, start, end - start );
+}
+
+/**
+   Main function for a started thread. It waits for ranges to be posted and runs its slice of each one.
+   @param p the Worker for this thread.
+   @return NULL.
+*/
+static void *workerMain( void *p )
+{
+  Worker *worker = p;
+  WorkerPool *pool = worker->pool;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock( &pool->lock );
+  while ( true ) {
+    while ( !pool->quit && pool->generation == seen )
+      pthread_cond_wait( &pool->start, &pool->lock );
+    if ( pool->quit )
+      break;
+    seen = pool->generation;
+    pthread_mutex_unlock( &pool->lock );
+
+    runSlice( pool, worker->index );
+
+    pthread_mutex_lock( &pool->lock );
+    if ( --pool->pending == 0 )
+      pthread_cond_signal( &pool->done );
+  }
+  pthread_mutex_unlock( &pool->lock );
+  return NULL;
+}
+
+int parallelCpuCount( void )
+{
+  long n = sysconf( _SC_NPROCESSORS_ONLN );
+  return n < 1 ? 1 : n;
+}
+
+int parallelThreadsFor( int threads, size_t count, size_t grain )
+{
+  size_t useful = grain ? count / grain : count;
+  if ( useful < (size_t) threads )
+    threads = useful;
+  return threads < 1 ? 1 : threads;
+}
+
+WorkerPool *poolCreate( int threads )
+{
+  if ( threads <= 1 )
+    return NULL;
+
+  WorkerPool *pool = calloc( 1, sizeof( WorkerPool ) );
+  pool->threads = threads;
+  pool->ids = malloc( ( threads - 1 ) * sizeof( pthread_t ) );
+  pool->workers = malloc( ( threads - 1 ) * sizeof( Worker ) );
+  pthread_mutex_init( &pool->lock, NULL );
+  pthread_cond_init( &pool->start, NULL );
+  pthread_cond_init( &pool->done, NULL );
+
+  for ( int i = 0; i < threads - 1; i++ ) {
+    pool->workers[ i ].pool = pool;
+    pool->workers[ i ].index = i + 1;
+    if ( pthread_create( &pool->ids[ i ], NULL, workerMain, &pool->workers[ i ] ) != 0 ) {
+      fprintf( stderr, "Can't start worker thread\n" );
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  return pool;
+}
+
+void poolDestroy( WorkerPool *pool )
+{
+  if ( !pool )
+    return;
+
+  pthread_mutex_lock( &pool->lock );
+  pool->quit = true;
+  pthread_cond_broadcast( &pool->start );
+  pthread_mutex_unlock( &pool->lock );
+
+  for ( int i = 0; i < pool->threads - 1; i++ )
+    pthread_join( pool->ids[ i ], NULL );
+
+  pthread_mutex_destroy( &pool->lock );
+  pthread_cond_destroy( &pool->start );
+  pthread_cond_destroy( &pool->done );
+  free( pool->ids );
+  free( pool->workers );
+  free( pool );
+}
+
+int poolThreads( WorkerPool const *pool )
+{
+  return pool ? pool->threads : 1;
+}
+
+void parallelFor( WorkerPool *pool, size_t count, size_t grain, RangeFunction fn, void *arg )
+{
+  if ( grain == 0 )
+    grain = 1;
+
+  // Use as many threads as there are grain-sized pieces of work, up to the size of the pool.
+  size_t slices = ( count + grain - 1 ) / grain;
+  if ( slices > (size_t) poolThreads( pool ) )
+    slices = poolThreads( pool );
+
+  if ( slices <= 1 ) {
+    if ( count > 0 )
+      fn( arg, 0, count );
+    return;
+  }
+
+  pthread_mutex_lock( &pool->lock );
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->count = count;
+  pool->slices = slices;
+  pool->pending = pool->threads - 1;
+  pool->generation++;
+  pthread_cond_broadcast( &pool->start );
+  pthread_mutex_unlock( &pool->lock );
+
+  // The calling thread does the first slice itself.
+  runSlice( pool, 0 );
+
+  pthread_mutex_lock( &pool->lock );
+  while ( pool->pending > 0 )
+    pthread_cond_wait( &pool->done, &pool->lock );
+  pthread_mutex_unlock( &pool->lock );
+}
+
+/**
+   Take the next item from a queue.
+   @param queue the queue.
+   @param index filled in with the item.
+   @return false if the queue is empty.
+*/
+static bool takeItem( ItemQueue *queue, size_t *index )
+{
+  pthread_mutex_lock( &queue->lock );
+  bool found = queue->next < queue->end;
+  if ( found )
+    *index = queue->next++;
+  pthread_mutex_unlock( &queue->lock );
+  return found;
+}
+
+/**
+   Refill an empty queue with the back half of the longest other queue.
+   @param job the ItemJob.
+   @param self the thread doing the stealing.
+   @return false if every queue was empty, so there's nothing left to steal.
+*/
+static bool stealItems( ItemJob *job, int self )
+{
+  while ( true ) {
+    // Find the longest queue. It can change before it's locked again below, so this is only a guess.
+    int victim = -1;
+    size_t most = 0;
+    for ( int i = 0; i < job->threads; i++ ) {
+      ItemQueue *queue = &job->queues[ i ];
+      pthread_mutex_lock( &queue->lock );
+      size_t left = queue->end - queue->next;
+      pthread_mutex_unlock( &queue->lock );
+      if ( i != self && left > most ) {
+        victim = i;
+        most = left;
+      }
+    }
+    if ( victim < 0 )
+      return false;
+
+    ItemQueue *from = &job->queues[ victim ];
+    pthread_mutex_lock( &from->lock );
+    size_t left = from->end - from->next;
+    size_t start = from->end - ( left + 1 ) / 2;
+    size_t end = from->end;
+    from->end = start;
+    pthread_mutex_unlock( &from->lock );
+
+    // Someone else may have emptied the queue first; if so, look again.
+    if ( start < end ) {
+      ItemQueue *to = &job->queues[ self ];
+      pthread_mutex_lock( &to->lock );
+      to->next = start;
+      to->end = end;
+      pthread_mutex_unlock( &to->lock );
+      return true;
+    }
+  }
+}
+
+/**
+   Run items for one thread of an ItemJob, first from its own queue and then from whatever it can steal.
+   @param arg the ItemJob.
+   @param start the thread's number.
+   @param count always 1.
+*/
+static void itemSlice( void *arg, size_t start, size_t count )
+{
+  ItemJob *job = arg;
+  int self = start;
+  do {
+    size_t index;
+    while ( takeItem( &job->queues[ self ], &index ) )
+      job->fn( job->arg, index, self );
+  } while ( stealItems( job, self ) );
+}
+
+void parallelForEach( WorkerPool *pool, size_t count, ItemFunction fn, void *arg )
+{
+  int threads = poolThreads( pool );
+  if ( (size_t) threads > count )
+    threads = count;
+  if ( threads <= 1 ) {
+    for ( size_t i = 0; i < count; i++ )
+      fn( arg, i, 0 );
+    return;
+  }
+
+  ItemJob job = { malloc( threads * sizeof( ItemQueue ) ), threads, fn, arg };
+  for ( int i = 0; i < threads; i++ ) {
+    pthread_mutex_init( &job.queues[ i ].lock, NULL );
+    job.queues[ i ].next = count * i / threads;
+    job.queues[ i ].end = count * ( i + 1 ) / threads;
+  }
+
+  parallelFor( pool, threads, 1, itemSlice, &job );
+
+  for ( int i = 0; i < threads; i++ )
+    pthread_mutex_destroy( &job.queues[ i ].lock );
+  free( job.queues );
+}
+
+/**
+   Encrypt one slice of a BlockJob.
+   @param arg the BlockJob.
+   @param start the first block of the slice.
+   @param count the number of blocks in the slice.
+*/
+static void encryptSlice( void *arg, size_t start, size_t count )
+{
+  BlockJob *job = arg;
+  encryptBlocks( job->ctx, job->in + start * BLOCK_SIZE, job->out + start * BLOCK_SIZE, count );
+}
+
+/**
+   Decrypt one slice of a BlockJob.
+   @param arg the BlockJob.
+   @param start the first block of the slice.
+   @param count the number of blocks in the slice.
+*/
+static void decryptSlice( void *arg, size_t start, size_t count )
+{
+  BlockJob *job = arg;
+  decryptBlocks( job->ctx, job->in + start * BLOCK_SIZE, job->out + start * BLOCK_SIZE, count );
+}
+
+void parallelEncryptBlocks( WorkerPool *pool, AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  BlockJob job = { ctx, in, out };
+  parallelFor( pool, nblocks, MIN_BLOCKS_PER_THREAD, encryptSlice, &job );
+}
+
+void parallelDecryptBlocks( WorkerPool *pool, AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  BlockJob job = { ctx, in, out };
+  parallelFor( pool, nblocks, MIN_BLOCKS_PER_THREAD, decryptSlice, &job );
+}
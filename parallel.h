@@ -0,0 +1,117 @@
+/**
+ * @file parallel.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for parallel.c. It contains the worker pool type and the functions that split work across it.
+*/
+
+/** Macro used for unit testing */
+#ifndef _PARALLEL_H_
+/** Macro used for unit testing */
+#define _PARALLEL_H_
+
+#include "aes.h"
+#include <stddef.h>
+
+/** Smallest number of blocks worth handing to a thread of its own; below this, thread start-up costs more than it saves. */
+#define MIN_BLOCKS_PER_THREAD 4096
+
+/** A fixed set of worker threads that run slices of a range together with the calling thread. */
+typedef struct WorkerPool WorkerPool;
+
+/**
+ * Function run on one slice of a range.
+ * @param arg the argument passed to parallelFor()
+ * @param start index of the first item in the slice
+ * @param count number of items in the slice
+*/
+typedef void ( *RangeFunction )( void *arg, size_t start, size_t count );
+
+/**
+ * Function run on one item of a list by parallelForEach().
+ * @param arg the argument passed to parallelForEach()
+ * @param index the item to run
+ * @param worker which thread is running it, from 0 to one less than the pool's thread count
+*/
+typedef void ( *ItemFunction )( void *arg, size_t index, int worker );
+
+/**
+ * This function returns the number of processors online, used when the user asks for an automatic thread count.
+ * @return the number of processors, at least 1
+*/
+int parallelCpuCount( void );
+
+/**
+ * This function limits a requested thread count to what's worth using for the given amount of work, so small inputs
+ * don't pay for starting threads that would have nothing to do.
+ * @param threads the number of threads requested
+ * @param count the number of items to split up
+ * @param grain the smallest number of items worth giving a thread
+ * @return the number of threads to start a pool with, at least 1
+*/
+int parallelThreadsFor( int threads, size_t count, size_t grain );
+
+/**
+ * This function starts a pool with the given total number of threads, counting the thread that calls parallelFor().
+ * @param threads the number of threads, at least 1
+ * @return the new pool, or NULL if threads is 1, since there's nothing to start
+*/
+WorkerPool *poolCreate( int threads );
+
+/**
+ * This function stops the pool's threads and frees it.
+ * @param pool the pool to free, which may be NULL
+*/
+void poolDestroy( WorkerPool *pool );
+
+/**
+ * This function returns the total number of threads in a pool, including the caller.
+ * @param pool the pool, which may be NULL
+ * @return the number of threads, 1 for a NULL pool
+*/
+int poolThreads( WorkerPool const *pool );
+
+/**
+ * This function splits the range [0, count) into contiguous slices, one per thread, and runs fn on each of them in
+ * parallel. It returns once every slice is done. Each slice has at least grain items (except when the whole range is
+ * smaller than that), so small ranges use fewer threads, or just the caller.
+ * @param pool the pool to run on, or NULL to run everything in the calling thread
+ * @param count the number of items in the range
+ * @param grain the smallest number of items worth giving a thread
+ * @param fn the function to run on each slice
+ * @param arg argument passed to every call of fn
+*/
+void parallelFor( WorkerPool *pool, size_t count, size_t grain, RangeFunction fn, void *arg );
+
+/**
+ * This function runs fn on every item in [0, count), for lists of items that may take very different amounts of time.
+ * Each thread starts with an equal share of the items, and a thread that runs out steals half of what's left from the
+ * thread with the most, so no thread sits idle while another still has a queue. It returns once every item is done.
+ * @param pool the pool to run on, or NULL to run everything in the calling thread
+ * @param count the number of items
+ * @param fn the function to run on each item
+ * @param arg argument passed to every call of fn
+*/
+void parallelForEach( WorkerPool *pool, size_t count, ItemFunction fn, void *arg );
+
+/**
+ * This function encrypts a sequence of independent blocks with encryptBlocks(), with each thread in the pool working
+ * straight on its own slice of the input and output.
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param ctx the context holding the expanded key
+ * @param in the blocks to encrypt
+ * @param out where the encrypted blocks go, which may be the same as in
+ * @param nblocks the number of blocks
+*/
+void parallelEncryptBlocks( WorkerPool *pool, AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * This function decrypts a sequence of independent blocks with decryptBlocks(), split across the pool.
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param ctx the context holding the expanded key
+ * @param in the blocks to decrypt
+ * @param out where the decrypted blocks go, which may be the same as in
+ * @param nblocks the number of blocks
+*/
+void parallelDecryptBlocks( WorkerPool *pool, AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+#endif
@@ -0,0 +1,206 @@
+/**
+ * @file proto.c
+ * @author Jimin Yu, jyu34
+ * This file converts aesd's request and reply headers to and from the bytes on the wire, and has the blocking calls
+ * clients use to talk to it.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "proto.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+/** Offsets of the fields in a request header. */
+enum { REQ_VERSION = 0, REQ_MODE = 1, REQ_DIR = 2, REQ_IV_LEN = 3, REQ_KEY = 4, REQ_ID = 8, REQ_LENGTH = 12,
+       REQ_IV = 16 };
+
+/** Offsets of the fields in a reply header. */
+enum { REP_VERSION = 0, REP_STATUS = 1, REP_ID = 4, REP_LENGTH = 8 };
+
+/**
+   Write a 32-bit number, least significant byte first.
+   @param dest where to write it.
+   @param value the number.
+*/
+static void putWord( byte *dest, uint32_t value )
+{
+  for ( int i = 0; i < sizeof( uint32_t ); i++ )
+    dest[ i ] = value >> ( 8 * i );
+}
+
+/**
+   Read a 32-bit number, least significant byte first.
+   @param src where to read it.
+   @return the number.
+*/
+static uint32_t getWord( byte const *src )
+{
+  uint32_t value = 0;
+  for ( int i = sizeof( uint32_t ) - 1; i >= 0; i-- )
+    value = value << 8 | src[ i ];
+  return value;
+}
+
+void encodeRequest( byte header[ REQUEST_HEADER_SIZE ], Request const *req )
+{
+  memset( header, 0, REQUEST_HEADER_SIZE );
+  header[ REQ_VERSION ] = PROTO_VERSION;
+  header[ REQ_MODE ] = req->mode;
+  header[ REQ_DIR ] = req->dir;
+  header[ REQ_IV_LEN ] = req->ivLen;
+  putWord( header + REQ_KEY, req->key );
+  putWord( header + REQ_ID, req->id );
+  putWord( header + REQ_LENGTH, req->length );
+  memcpy( header + REQ_IV, req->iv, req->ivLen );
+}
+
+bool decodeRequest( Request *req, byte const header[ REQUEST_HEADER_SIZE ] )
+{
+  if ( header[ REQ_VERSION ] != PROTO_VERSION || header[ REQ_IV_LEN ] > BLOCK_SIZE )
+    return false;
+  req->mode = header[ REQ_MODE ];
+  req->dir = header[ REQ_DIR ];
+  req->ivLen = header[ REQ_IV_LEN ];
+  req->key = getWord( header + REQ_KEY );
+  req->id = getWord( header + REQ_ID );
+  req->length = getWord( header + REQ_LENGTH );
+  memcpy( req->iv, header + REQ_IV, BLOCK_SIZE );
+  return true;
+}
+
+void encodeReply( byte header[ REPLY_HEADER_SIZE ], Reply const *reply )
+{
+  memset( header, 0, REPLY_HEADER_SIZE );
+  header[ REP_VERSION ] = PROTO_VERSION;
+  header[ REP_STATUS ] = reply->status;
+  putWord( header + REP_ID, reply->id );
+  putWord( header + REP_LENGTH, reply->length );
+}
+
+bool decodeReply( Reply *reply, byte const header[ REPLY_HEADER_SIZE ] )
+{
+  if ( header[ REP_VERSION ] != PROTO_VERSION )
+    return false;
+  reply->status = header[ REP_STATUS ];
+  reply->id = getWord( header + REP_ID );
+  reply->length = getWord( header + REP_LENGTH );
+  return true;
+}
+
+char const *replyString( ReplyStatus status )
+{
+  static char const *const strings[] = {
+    "OK",
+    "Bad request",
+    "Unknown key",
+    "Bad IV",
+    "Bad length",
+    "Request too large",
+    "Authentication failed"
+  };
+  if ( status < REPLY_OK || status > REPLY_AUTH_FAILED )
+    return "Unknown reply";
+  return strings[ status ];
+}
+
+char const *defaultSocket( void )
+{
+  static char path[ PATH_MAX ];
+  char const *dir = getenv( "XDG_RUNTIME_DIR" );
+  if ( dir && dir[ 0 ] != '\0' )
+    snprintf( path, sizeof( path ), "%s/%s", dir, SOCKET_NAME );
+  else
+    snprintf( path, sizeof( path ), FALLBACK_SOCKET, ( unsigned ) getuid() );
+  return path;
+}
+
+int connectDaemon( char const *path )
+{
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  if ( strlen( path ) >= sizeof( addr.sun_path ) ) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy( addr.sun_path, path );
+
+  int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+  if ( fd < 0 )
+    return -1;
+  if ( connect( fd, ( struct sockaddr * ) &addr, sizeof( addr ) ) != 0 ) {
+    int err = errno;
+    close( fd );
+    errno = err;
+    return -1;
+  }
+  return fd;
+}
+
+bool sendRequest( int fd, Request const *req, byte const *payload )
+{
+  byte header[ REQUEST_HEADER_SIZE ];
+  encodeRequest( header, req );
+
+  // The header and payload go in one call, so a small request is one trip into the kernel.
+  struct iovec parts[ 2 ] = { { header, REQUEST_HEADER_SIZE }, { ( void * ) payload, req->length } };
+  struct msghdr msg = { .msg_iov = parts, .msg_iovlen = 2 };
+  while ( parts[ 0 ].iov_len + parts[ 1 ].iov_len > 0 ) {
+    ssize_t sent = sendmsg( fd, &msg, MSG_NOSIGNAL );
+    if ( sent < 0 && errno == EINTR )
+      continue;
+    if ( sent <= 0 )
+      return false;
+
+    // Skip past what went, which may have been part of either piece.
+    for ( int i = 0; i < 2; i++ ) {
+      size_t used = ( size_t ) sent < parts[ i ].iov_len ? ( size_t ) sent : parts[ i ].iov_len;
+      parts[ i ].iov_base = ( byte * ) parts[ i ].iov_base + used;
+      parts[ i ].iov_len -= used;
+      sent -= used;
+    }
+  }
+  return true;
+}
+
+/**
+   Read exactly the given number of bytes from a socket.
+   @param fd the socket.
+   @param data where to put them.
+   @param len the number of bytes.
+   @return false if the connection failed or closed first.
+*/
+static bool receiveAll( int fd, byte *data, size_t len )
+{
+  while ( len > 0 ) {
+    ssize_t got = recv( fd, data, len, 0 );
+    if ( got < 0 && errno == EINTR )
+      continue;
+    if ( got <= 0 )
+      return false;
+    data += got;
+    len -= got;
+  }
+  return true;
+}
+
+bool receiveReply( int fd, Reply *reply, byte **data, size_t *capacity )
+{
+  byte header[ REPLY_HEADER_SIZE ];
+  if ( !receiveAll( fd, header, REPLY_HEADER_SIZE ) || !decodeReply( reply, header ) )
+    return false;
+  if ( reply->length > *capacity ) {
+    byte *bigger = realloc( *data, reply->length );
+    if ( !bigger )
+      return false;
+    *data = bigger;
+    *capacity = reply->length;
+  }
+  return receiveAll( fd, *data, reply->length );
+}
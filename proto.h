@@ -0,0 +1,168 @@
+/**
+ * @file proto.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for proto.c, the wire format aesd speaks over its Unix domain socket, and the blocking
+ * calls clients use to send it requests. Each request is a REQUEST_HEADER_SIZE header followed by the payload, and
+ * each reply a REPLY_HEADER_SIZE header followed by the result. Numbers in the headers are little-endian. A client
+ * can send several requests before reading the replies; they come back in the same order.
+*/
+
+/** Macro used for unit testing */
+#ifndef _PROTO_H_
+/** Macro used for unit testing */
+#define _PROTO_H_
+
+#include "aes.h"
+#include "tool.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Version of the wire format, the first byte of every header. */
+#define PROTO_VERSION 1
+
+/** Bytes in a request header. */
+#define REQUEST_HEADER_SIZE 32
+
+/** Bytes in a reply header. */
+#define REPLY_HEADER_SIZE 12
+
+/** Largest payload aesd accepts in one request. */
+#define MAX_PAYLOAD ( 16 * 1024 * 1024 )
+
+/** Name of aesd's socket in the user's runtime directory. */
+#define SOCKET_NAME "aesd.sock"
+
+/** Where aesd's socket goes when there's no runtime directory, with the user ID filled in. */
+#define FALLBACK_SOCKET "/tmp/aesd-%u.sock"
+
+/** Results aesd sends back. */
+typedef enum {
+  /** The result follows. */
+  REPLY_OK,
+
+  /** The header was from another version, or named a mode or direction that doesn't exist. */
+  REPLY_BAD_REQUEST,
+
+  /** No key was loaded with the given number. */
+  REPLY_BAD_KEY,
+
+  /** The IV was the wrong size for the mode. */
+  REPLY_BAD_IV,
+
+  /** ecb or cbc data wasn't a whole number of blocks, or gcm ciphertext was too short to hold a tag. */
+  REPLY_BAD_LENGTH,
+
+  /** The payload was bigger than MAX_PAYLOAD; aesd closes the connection after this one. */
+  REPLY_TOO_LARGE,
+
+  /** The gcm tag didn't match. */
+  REPLY_AUTH_FAILED
+} ReplyStatus;
+
+/** A request header. */
+typedef struct {
+  /** Block cipher mode. */
+  CipherMode mode;
+
+  /** Whether to encrypt or decrypt. */
+  Direction dir;
+
+  /** Number of the key to use, from the order aesd was given its key files. */
+  uint32_t key;
+
+  /** A number the client picks, sent back in the reply. */
+  uint32_t id;
+
+  /** Bytes of payload after the header. */
+  uint32_t length;
+
+  /** Bytes of the IV that are used: 0 for ecb, GCM_IV_SIZE for gcm and BLOCK_SIZE otherwise. */
+  int ivLen;
+
+  /** The IV, or initial counter block for ctr. */
+  byte iv[ BLOCK_SIZE ];
+} Request;
+
+/** A reply header. */
+typedef struct {
+  /** How the request went. */
+  ReplyStatus status;
+
+  /** The id from the request. */
+  uint32_t id;
+
+  /** Bytes of result after the header; 0 unless status is REPLY_OK. */
+  uint32_t length;
+} Reply;
+
+/**
+ * This function writes a request header in the wire format.
+ * @param header where to write it
+ * @param req the request
+*/
+void encodeRequest( byte header[ REQUEST_HEADER_SIZE ], Request const *req );
+
+/**
+ * This function reads a request header from the wire format.
+ * @param req the request to fill in
+ * @param header the header
+ * @return false if the header is from another version of the protocol or its IV length is out of range
+*/
+bool decodeRequest( Request *req, byte const header[ REQUEST_HEADER_SIZE ] );
+
+/**
+ * This function writes a reply header in the wire format.
+ * @param header where to write it
+ * @param reply the reply
+*/
+void encodeReply( byte header[ REPLY_HEADER_SIZE ], Reply const *reply );
+
+/**
+ * This function reads a reply header from the wire format.
+ * @param reply the reply to fill in
+ * @param header the header
+ * @return false if the header is from another version of the protocol
+*/
+bool decodeReply( Reply *reply, byte const header[ REPLY_HEADER_SIZE ] );
+
+/**
+ * This function returns a short description of a reply status, for error messages.
+ * @param status the status
+ * @return the description
+*/
+char const *replyString( ReplyStatus status );
+
+/**
+ * This function finds the socket aesd listens on and clients connect to unless --socket says otherwise: SOCKET_NAME in
+ * $XDG_RUNTIME_DIR, a directory only the user can get into, or FALLBACK_SOCKET if that isn't set.
+ * @return the socket's file name, in a buffer that's reused by every call
+*/
+char const *defaultSocket( void );
+
+/**
+ * This function connects to aesd.
+ * @param path the socket's file name
+ * @return the connected socket, or -1 with errno set
+*/
+int connectDaemon( char const *path );
+
+/**
+ * This function sends a request and its payload, blocking until it's all sent.
+ * @param fd the connected socket
+ * @param req the request
+ * @param payload the payload, req->length bytes
+ * @return false if the connection failed
+*/
+bool sendRequest( int fd, Request const *req, byte const *payload );
+
+/**
+ * This function waits for the next reply and reads its result into a buffer that grows as needed.
+ * @param fd the connected socket
+ * @param reply the reply header to fill in
+ * @param data the buffer for the result, which may be NULL to start with
+ * @param capacity bytes the buffer can hold, updated if it grows
+ * @return false if the connection failed or the reply was malformed
+*/
+bool receiveReply( int fd, Reply *reply, byte **data, size_t *capacity );
+
+#endif
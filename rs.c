@@ -0,0 +1,206 @@
+/**
+ * @file rs.c
+ * @author Jimin Yu, jyu34
+ * This file implements Reed-Solomon erasure coding with a systematic Cauchy matrix. Both encoding and rebuilding come
+ * down to multiplying a small matrix by a set of shards, which is done with fieldMulRegion() and fieldMulAddRegion()
+ * a cache-sized block at a time, with the bytes of the shards split across a thread pool.
+*/
+
+#include "rs.h"
+#include "field.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Bytes of each shard combined at a time, small enough that the source blocks stay in cache for every output row. */
+#define RS_BLOCK 16384
+
+/** A matrix multiplication of shards: dst[ r ] = sum over c of matrix[ r ][ c ] * src[ c ]. */
+typedef struct {
+  /** The matrix, rows x cols, one row after another. */
+  byte const *matrix;
+
+  /** Number of output shards. */
+  int rows;
+
+  /** Number of input shards. */
+  int cols;
+
+  /** The input shards. */
+  byte const *const *src;
+
+  /** The output shards. */
+  byte *const *dst;
+} RsJob;
+
+bool rsInit( RsCode *code, int k, int m )
+{
+  if ( k < 1 || m < 0 || k + m > RS_MAX_SHARDS )
+    return false;
+
+  code->k = k;
+  code->m = m;
+  code->parityRows = malloc( m * k + 1 );
+  for ( int i = 0; i < m; i++ )
+    for ( int j = 0; j < k; j++ )
+      code->parityRows[ i * k + j ] = fieldInv( ( k + i ) ^ j );
+  return true;
+}
+
+void rsFree( RsCode *code )
+{
+  free( code->parityRows );
+  code->parityRows = NULL;
+}
+
+/**
+   Multiply the matrix of an RsJob by one slice of its shards, a block at a time so every output row reuses the
+   source blocks while they're still in cache.
+   @param arg the RsJob.
+   @param start the first byte of the slice.
+   @param count the number of bytes in the slice.
+*/
+static void combineSlice( void *arg, size_t start, size_t count )
+{
+  RsJob *job = arg;
+  for ( size_t off = start; off < start + count; off += RS_BLOCK ) {
+    size_t n = start + count - off < RS_BLOCK ? start + count - off : RS_BLOCK;
+    for ( int r = 0; r < job->rows; r++ ) {
+      byte const *row = job->matrix + r * job->cols;
+      fieldMulRegion( job->dst[ r ] + off, job->src[ 0 ] + off, row[ 0 ], n );
+      for ( int c = 1; c < job->cols; c++ )
+        fieldMulAddRegion( job->dst[ r ] + off, job->src[ c ] + off, row[ c ], n );
+    }
+  }
+}
+
+/**
+   Multiply a matrix by a set of shards, split across the threads of a pool.
+   @param pool the pool to run on, or NULL for just the calling thread.
+   @param matrix the matrix, rows x cols.
+   @param rows the number of output shards.
+   @param cols the number of input shards.
+   @param src the input shards.
+   @param dst the output shards.
+   @param len the number of bytes in each shard.
+*/
+static void combine( WorkerPool *pool, byte const *matrix, int rows, int cols, byte const *const src[],
+                     byte *const dst[], size_t len )
+{
+  if ( rows == 0 )
+    return;
+  RsJob job = { matrix, rows, cols, src, dst };
+  parallelFor( pool, len, RS_GRAIN, combineSlice, &job );
+}
+
+void rsEncode( RsCode const *code, WorkerPool *pool, byte const *const data[], byte *const parity[], size_t len )
+{
+  combine( pool, code->parityRows, code->m, code->k, data, parity, len );
+}
+
+/**
+   Invert an n x n matrix by Gauss-Jordan elimination.
+   @param a the matrix, destroyed in the process.
+   @param inv where the inverse goes.
+   @param n the size of the matrix.
+   @return false if the matrix is singular.
+*/
+static bool invertMatrix( byte *a, byte *inv, int n )
+{
+  memset( inv, 0, n * n );
+  for ( int i = 0; i < n; i++ )
+    inv[ i * n + i ] = 1;
+
+  for ( int col = 0; col < n; col++ ) {
+    int pivot = col;
+    while ( pivot < n && a[ pivot * n + col ] == 0 )
+      pivot++;
+    if ( pivot == n )
+      return false;
+
+    // Swap the pivot row into place.
+    for ( int j = 0; j < n && pivot != col; j++ ) {
+      byte t = a[ col * n + j ];
+      a[ col * n + j ] = a[ pivot * n + j ];
+      a[ pivot * n + j ] = t;
+      t = inv[ col * n + j ];
+      inv[ col * n + j ] = inv[ pivot * n + j ];
+      inv[ pivot * n + j ] = t;
+    }
+
+    // Scale it so the pivot is 1, then clear the column in every other row.
+    byte scale = fieldInv( a[ col * n + col ] );
+    for ( int j = 0; j < n; j++ ) {
+      a[ col * n + j ] = fieldMul( a[ col * n + j ], scale );
+      inv[ col * n + j ] = fieldMul( inv[ col * n + j ], scale );
+    }
+    for ( int i = 0; i < n; i++ ) {
+      byte f = a[ i * n + col ];
+      if ( i == col || f == 0 )
+        continue;
+      for ( int j = 0; j < n; j++ ) {
+        a[ i * n + j ] ^= fieldMul( f, a[ col * n + j ] );
+        inv[ i * n + j ] ^= fieldMul( f, inv[ col * n + j ] );
+      }
+    }
+  }
+  return true;
+}
+
+bool rsDecode( RsCode const *code, WorkerPool *pool, byte *const shards[], bool const present[], size_t len )
+{
+  int k = code->k, m = code->m;
+
+  // Use the first k shards that are there.
+  int used[ RS_MAX_SHARDS ];
+  int nused = 0;
+  for ( int i = 0; i < k + m && nused < k; i++ )
+    if ( present[ i ] )
+      used[ nused++ ] = i;
+  if ( nused < k )
+    return false;
+
+  // Each of those shards is a row of the generator matrix (the identity over the Cauchy matrix) times the data.
+  // Inverting those rows gives the data back from them.
+  byte *sub = malloc( k * k );
+  byte *inv = malloc( k * k );
+  for ( int r = 0; r < k; r++ ) {
+    if ( used[ r ] < k ) {
+      memset( sub + r * k, 0, k );
+      sub[ r * k + used[ r ] ] = 1;
+    } else
+      memcpy( sub + r * k, code->parityRows + ( used[ r ] - k ) * k, k );
+  }
+  bool ok = invertMatrix( sub, inv, k );
+
+  byte const *src[ RS_MAX_SHARDS ];
+  byte *dst[ RS_MAX_SHARDS ];
+  byte *rows = malloc( ( k + m ) * k );
+  int missing = 0;
+  if ( ok ) {
+    for ( int r = 0; r < k; r++ )
+      src[ r ] = shards[ used[ r ] ];
+    for ( int d = 0; d < k; d++ )
+      if ( !present[ d ] ) {
+        memcpy( rows + missing * k, inv + d * k, k );
+        dst[ missing++ ] = shards[ d ];
+      }
+    combine( pool, rows, missing, k, src, dst, len );
+
+    // With all the data back, missing parity is just encoded again.
+    missing = 0;
+    for ( int p = 0; p < m; p++ )
+      if ( !present[ k + p ] && shards[ k + p ] ) {
+        memcpy( rows + missing * k, code->parityRows + p * k, k );
+        dst[ missing++ ] = shards[ k + p ];
+      }
+    for ( int d = 0; d < k; d++ )
+      src[ d ] = shards[ d ];
+    combine( pool, rows, missing, k, src, dst, len );
+  }
+
+  free( rows );
+  free( sub );
+  free( inv );
+  return ok;
+}
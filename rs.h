@@ -0,0 +1,75 @@
+/**
+ * @file rs.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for rs.c, a Reed-Solomon erasure code over the AES field. Data is split into k shards and m
+ * parity shards are computed from them, so that any k of the k + m shards are enough to rebuild the rest.
+*/
+
+/** Macro used for unit testing */
+#ifndef _RS_H_
+/** Macro used for unit testing */
+#define _RS_H_
+
+#include "field.h"
+#include "parallel.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Most shards a code can have in total; the Cauchy matrix needs a distinct field value for each one. */
+#define RS_MAX_SHARDS FIELD_SIZE
+
+/** Smallest number of bytes per shard worth handing to a thread of its own. */
+#define RS_GRAIN 65536
+
+/** A Reed-Solomon code with a particular number of data and parity shards. */
+typedef struct {
+  /** Number of data shards. */
+  int k;
+
+  /** Number of parity shards. */
+  int m;
+
+  /** The m x k Cauchy matrix that gives each parity shard as a sum of multiples of the data shards. */
+  byte *parityRows;
+} RsCode;
+
+/**
+ * This function sets up a code. Parity shard i is the sum over data shards j of data[ j ] / ( x_i + y_j ) with
+ * x_i = k + i and y_j = j, the Cauchy matrix construction, which makes every k x k submatrix of the whole generator
+ * matrix invertible.
+ * @param code the code to fill in
+ * @param k the number of data shards, at least 1
+ * @param m the number of parity shards
+ * @return false if k and m are out of range
+*/
+bool rsInit( RsCode *code, int k, int m );
+
+/**
+ * This function frees the memory used by a code.
+ * @param code the code to free
+*/
+void rsFree( RsCode *code );
+
+/**
+ * This function computes the parity shards from the data shards, split across the threads of a pool.
+ * @param code the code
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param data the k data shards
+ * @param parity the m parity shards to fill in
+ * @param len the number of bytes in each shard
+*/
+void rsEncode( RsCode const *code, WorkerPool *pool, byte const *const data[], byte *const parity[], size_t len );
+
+/**
+ * This function rebuilds missing shards from the ones that are left, split across the threads of a pool.
+ * @param code the code
+ * @param pool the pool to run on, or NULL for just the calling thread
+ * @param shards all k + m shards, data first, each with room for len bytes; the missing ones are filled in, except
+ *               for missing parity shards left NULL, which aren't needed
+ * @param present which of the shards are there
+ * @param len the number of bytes in each shard
+ * @return false if fewer than k shards are present, so nothing could be rebuilt
+*/
+bool rsDecode( RsCode const *code, WorkerPool *pool, byte *const shards[], bool const present[], size_t len );
+
+#endif
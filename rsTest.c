@@ -0,0 +1,156 @@
+/**
+  @file rsTest.c
+  @author Jimin Yu, jyu34
+  Unit test program for the Reed-Solomon erasure code.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rs.h"
+
+/** Number of tests we should have, if they're all turned on. */
+#define EXPECTED_TOTAL 10
+
+/** Total number or tests we tried. */
+static int totalTests = 0;
+
+/** Number of test cases passed. */
+static int passedTests = 0;
+
+/** Macro to check the condition on a test case, keep counts of
+    passed/failed tests and report a message if the test fails. */
+#define TestCase( conditional ) {\
+  totalTests += 1; \
+  if ( conditional ) { \
+    passedTests += 1; \
+  } else { \
+    printf( "**** Failed unit test on line %d of %s\n", __LINE__, __FILE__ );    \
+  } \
+}
+
+/**
+   Make a set of shards filled with a pattern, all in one allocation.
+   @param shards pointers to fill in.
+   @param count the number of shards.
+   @param len the bytes in each shard.
+   @param seed changes the pattern.
+   @return the allocation, for freeing.
+*/
+static byte *makeShards( byte *shards[], int count, size_t len, int seed )
+{
+  byte *all = malloc( count * len );
+  for ( size_t i = 0; i < count * len; i++ )
+    all[ i ] = ( i * 167 + seed ) ^ ( i >> 9 );
+  for ( int i = 0; i < count; i++ )
+    shards[ i ] = all + i * len;
+  return all;
+}
+
+int main()
+{
+  ////////////////////////////////////////////////////////////////////////
+  // Test rsInit()
+
+  {
+    RsCode code;
+    TestCase( !rsInit( &code, 0, 2 ) );
+    TestCase( !rsInit( &code, 200, 57 ) );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test a small code, losing data and parity shards
+
+  {
+    int k = 4, m = 2;
+    size_t len = 1000;
+    RsCode code;
+    TestCase( rsInit( &code, k, m ) );
+
+    byte *shards[ 6 ];
+    byte *all = makeShards( shards, k + m, len, 1 );
+    rsEncode( &code, NULL, (byte const *const *) shards, shards + k, len );
+
+    byte *copy = malloc( ( k + m ) * len );
+    memcpy( copy, all, ( k + m ) * len );
+
+    // Lose a data shard and a parity shard.
+    bool present[ 6 ] = { true, false, true, true, false, true };
+    memset( shards[ 1 ], 0, len );
+    memset( shards[ 4 ], 0, len );
+    TestCase( rsDecode( &code, NULL, shards, present, len ) && memcmp( all, copy, ( k + m ) * len ) == 0 );
+
+    // Lose two data shards.
+    bool twoData[ 6 ] = { false, true, true, false, true, true };
+    memset( shards[ 0 ], 0, len );
+    memset( shards[ 3 ], 0, len );
+    TestCase( rsDecode( &code, NULL, shards, twoData, len ) && memcmp( all, copy, ( k + m ) * len ) == 0 );
+
+    // A missing parity shard left NULL isn't rebuilt.
+    bool noParity[ 6 ] = { true, true, false, true, false, true };
+    memset( shards[ 2 ], 0, len );
+    byte *parity = shards[ 4 ];
+    shards[ 4 ] = NULL;
+    TestCase( rsDecode( &code, NULL, shards, noParity, len ) && memcmp( all, copy, k * len ) == 0 );
+    shards[ 4 ] = parity;
+
+    // Three shards gone is one more than the code can stand.
+    bool three[ 6 ] = { false, true, true, false, false, true };
+    three[ 2 ] = false;
+    TestCase( !rsDecode( &code, NULL, shards, three, len ) );
+
+    free( copy );
+    free( all );
+    rsFree( &code );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test a wide code split across a pool, against the calling thread alone
+
+  {
+    int k = 20, m = 6;
+    size_t len = 5 * RS_GRAIN + 13;
+    RsCode code;
+    TestCase( rsInit( &code, k, m ) );
+
+    byte *shards[ 26 ];
+    byte *all = makeShards( shards, k + m, len, 7 );
+    rsEncode( &code, NULL, (byte const *const *) shards, shards + k, len );
+
+    byte *serial = malloc( ( k + m ) * len );
+    memcpy( serial, all, ( k + m ) * len );
+
+    WorkerPool *pool = poolCreate( 4 );
+    memset( all + k * len, 0, m * len );
+    rsEncode( &code, pool, (byte const *const *) shards, shards + k, len );
+    TestCase( memcmp( all, serial, ( k + m ) * len ) == 0 );
+
+    // Lose m shards scattered across data and parity.
+    bool present[ 26 ];
+    for ( int i = 0; i < k + m; i++ )
+      present[ i ] = true;
+    int lost[] = { 0, 5, 11, 19, 21, 25 };
+    for ( int i = 0; i < m; i++ ) {
+      present[ lost[ i ] ] = false;
+      memset( shards[ lost[ i ] ], 0xA5, len );
+    }
+    TestCase( rsDecode( &code, pool, shards, present, len ) && memcmp( all, serial, ( k + m ) * len ) == 0 );
+    poolDestroy( pool );
+
+    free( serial );
+    free( all );
+    rsFree( &code );
+  }
+
+  // Report a message if some tests are still disabled.
+  if ( totalTests < EXPECTED_TOTAL )
+    printf( "** %d of %d tests currently enabled.\n", totalTests,
+            EXPECTED_TOTAL );
+
+  // Exit successfully if all tests are enabled and they all pass.
+  if ( passedTests != EXPECTED_TOTAL )
+    return EXIT_FAILURE;
+  else
+    return EXIT_SUCCESS;
+}
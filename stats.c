@@ -0,0 +1,205 @@
+/**
+ * @file stats.c
+ * @author Jimin Yu, jyu34
+ * This file keeps the counts behind the --stats report of the encrypt and decrypt programs, and reads the processor's
+ * hardware counters for it where the kernel allows that.
+*/
+
+#define _GNU_SOURCE
+
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/** Nanoseconds in a second. */
+#define NANOS 1e9
+
+/** Bytes in a megabyte, for the throughput. */
+#define MEGABYTE 1e6
+
+#ifndef NO_STATS
+
+bool statsEnabled = false;
+
+/** Nanoseconds spent in each phase. */
+static uint64_t phaseNanos[ STAT_PHASES ];
+
+/** Work done in each phase. */
+static uint64_t phaseAmount[ STAT_PHASES ];
+
+/** Name of the engine used, or NULL if no key was expanded. */
+static char const *engineName = NULL;
+
+/** Largest pool started. */
+static int mostThreads = 1;
+
+#endif
+
+/** When statsBegin() was called. */
+static uint64_t startNanos;
+
+/** The hardware counters for the report. */
+static PerfCounters counters = { { -1, -1, -1 }, false };
+
+/** What the report's hardware counters count. */
+static CounterEvent const counterEvents[ PERF_COUNTERS ] = { COUNTER_CYCLES, COUNTER_INSTRUCTIONS,
+                                                             COUNTER_CACHE_MISSES };
+
+/** Names of the hardware counters, in the order they're opened. */
+static char const *const counterNames[ PERF_COUNTERS ] = { "cycles", "instructions", "cache-misses" };
+
+uint64_t statsClock( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (uint64_t) ts.tv_sec * (uint64_t) NANOS + ts.tv_nsec;
+}
+
+#ifndef NO_STATS
+
+void statsAdd( StatPhase phase, uint64_t nanos, uint64_t amount )
+{
+  __atomic_fetch_add( &phaseNanos[ phase ], nanos, __ATOMIC_RELAXED );
+  __atomic_fetch_add( &phaseAmount[ phase ], amount, __ATOMIC_RELAXED );
+}
+
+void statsEngine( char const *name )
+{
+  __atomic_store_n( &engineName, name, __ATOMIC_RELAXED );
+}
+
+void statsThreads( int threads )
+{
+  int seen = __atomic_load_n( &mostThreads, __ATOMIC_RELAXED );
+  while ( threads > seen && !__atomic_compare_exchange_n( &mostThreads, &seen, threads, false, __ATOMIC_RELAXED,
+                                                          __ATOMIC_RELAXED ) )
+    ;
+}
+
+#endif
+
+bool perfOpen( PerfCounters *counters, CounterEvent const events[ PERF_COUNTERS ], bool grouped )
+{
+  counters->grouped = grouped;
+  for ( int i = 0; i < PERF_COUNTERS; i++ )
+    counters->fds[ i ] = -1;
+
+#ifdef __linux__
+  static uint64_t const configs[] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+  bool all = true;
+  for ( int i = 0; i < PERF_COUNTERS; i++ ) {
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.size = sizeof( attr );
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[ events[ i ] ];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // The group stays off until all of it is open, so its counters start together.
+    if ( grouped ) {
+      attr.read_format = PERF_FORMAT_GROUP;
+      attr.disabled = i == 0;
+    } else {
+      attr.inherit = 1;
+    }
+    int leader = grouped && i > 0 ? counters->fds[ 0 ] : -1;
+    counters->fds[ i ] = syscall( SYS_perf_event_open, &attr, 0, -1, leader, 0 );
+    all = all && counters->fds[ i ] >= 0;
+
+    if ( grouped && !all ) {
+      for ( int j = 0; j <= i; j++ ) {
+        if ( counters->fds[ j ] >= 0 )
+          close( counters->fds[ j ] );
+        counters->fds[ j ] = -1;
+      }
+      return false;
+    }
+  }
+  if ( grouped )
+    ioctl( counters->fds[ 0 ], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+  return all;
+#else
+  return false;
+#endif
+}
+
+bool perfRead( PerfCounters const *counters, uint64_t values[ PERF_COUNTERS ] )
+{
+  for ( int i = 0; i < PERF_COUNTERS; i++ )
+    values[ i ] = PERF_UNAVAILABLE;
+
+#ifdef __linux__
+  if ( counters->grouped ) {
+    // With PERF_FORMAT_GROUP, the kernel gives the number of counters and then their values.
+    uint64_t buffer[ PERF_COUNTERS + 1 ];
+    if ( counters->fds[ 0 ] < 0 || read( counters->fds[ 0 ], buffer, sizeof( buffer ) ) != sizeof( buffer ) )
+      return false;
+    memcpy( values, buffer + 1, sizeof( uint64_t ) * PERF_COUNTERS );
+    return true;
+  }
+
+  bool all = true;
+  for ( int i = 0; i < PERF_COUNTERS; i++ ) {
+    if ( counters->fds[ i ] < 0 ||
+         read( counters->fds[ i ], &values[ i ], sizeof( uint64_t ) ) != sizeof( uint64_t ) ) {
+      values[ i ] = PERF_UNAVAILABLE;
+      all = false;
+    }
+  }
+  return all;
+#else
+  return false;
+#endif
+}
+
+void statsBegin( void )
+{
+#ifndef NO_STATS
+  statsEnabled = true;
+#endif
+  // Opened one at a time rather than as a group, since a group can't follow the threads started later.
+  perfOpen( &counters, counterEvents, false );
+  startNanos = statsClock();
+}
+
+void statsReport( FILE *fp )
+{
+  double wall = ( statsClock() - startNanos ) / NANOS;
+#ifdef NO_STATS
+  fprintf( fp, "stats: wall %.6f s (built with NO_STATS, so there's nothing else to report)\n", wall );
+#else
+  static char const *const names[ STAT_BLOCKS ] = { "read", "key", "compute", "write" };
+  static char const *const units[ STAT_BLOCKS ] = { "bytes", "schedules", "bytes", "bytes" };
+
+  fprintf( fp, "stats: engine %s, %d thread%s\n", engineName ? engineName : "none", mostThreads,
+           mostThreads == 1 ? "" : "s" );
+  fprintf( fp, "  %-8s %12.6f s\n", "wall", wall );
+  for ( int p = 0; p < STAT_BLOCKS; p++ )
+    fprintf( fp, "  %-8s %12.6f s %14llu %s\n", names[ p ], phaseNanos[ p ] / NANOS,
+             (unsigned long long) phaseAmount[ p ], units[ p ] );
+  fprintf( fp, "  %-8s %14llu\n", "blocks", (unsigned long long) phaseAmount[ STAT_BLOCKS ] );
+  if ( wall > 0 )
+    fprintf( fp, "  %-8s %12.1f MB/s\n", "rate", phaseAmount[ STAT_COMPUTE ] / wall / MEGABYTE );
+#endif
+
+#ifdef __linux__
+  uint64_t values[ PERF_COUNTERS ];
+  perfRead( &counters, values );
+  for ( int i = 0; i < PERF_COUNTERS; i++ ) {
+    if ( values[ i ] == PERF_UNAVAILABLE )
+      fprintf( fp, "  %-12s not available\n", counterNames[ i ] );
+    else
+      fprintf( fp, "  %-12s %14llu\n", counterNames[ i ], (unsigned long long) values[ i ] );
+  }
+#endif
+}
@@ -0,0 +1,151 @@
+/**
+ * @file stats.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for stats.c, the instrumentation behind the --stats report. The hot paths in io.c, aes.c
+ * and tool.c mark where time goes with the macros below. Building with -DNO_STATS turns the macros into nothing, so
+ * the instrumentation costs nothing at all; otherwise each one is a single check of statsEnabled until --stats turns
+ * it on.
+*/
+
+/** Macro used for unit testing */
+#ifndef _STATS_H_
+/** Macro used for unit testing */
+#define _STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** The phases time and work are counted under. */
+typedef enum {
+  /** Reading input, key and IV files; the amount is bytes. */
+  STAT_READ,
+
+  /** Expanding keys; the amount is key schedules. */
+  STAT_KEY,
+
+  /** Running the cipher mode over the data; the amount is bytes. */
+  STAT_COMPUTE,
+
+  /** Writing and flushing output; the amount is bytes. */
+  STAT_WRITE,
+
+  /** Blocks handed to an engine, from any thread; there's no time for this one. */
+  STAT_BLOCKS,
+
+  /** Number of phases. */
+  STAT_PHASES
+} StatPhase;
+
+/** Number of hardware counters in a PerfCounters set. */
+#define PERF_COUNTERS 3
+
+/** What perfRead() gives for a counter that couldn't be opened or read. */
+#define PERF_UNAVAILABLE UINT64_MAX
+
+/** Hardware events a counter can count. */
+typedef enum { COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_CACHE_MISSES, COUNTER_BRANCH_MISSES } CounterEvent;
+
+/** A set of the processor's hardware counters, counting in user mode. */
+typedef struct {
+  /** File descriptors of the counters, or -1 for ones that couldn't be opened. */
+  int fds[ PERF_COUNTERS ];
+
+  /** True if the counters were opened as one group, with the first as its leader. */
+  bool grouped;
+} PerfCounters;
+
+/**
+ * This function reads the clock the phases are timed with.
+ * @return nanoseconds since some fixed point
+*/
+uint64_t statsClock( void );
+
+/**
+ * This function opens a set of hardware counters for this thread. As a group, they're started and read together, so
+ * their values always cover the same stretch, but a group can't follow new threads; opened one at a time, each one
+ * counts in this thread and every thread it starts after this. Many systems don't let ordinary users open them.
+ * @param counters the set to fill in
+ * @param events what each counter counts
+ * @param grouped true to open them as one group, which is all or nothing
+ * @return true if every counter is open
+*/
+bool perfOpen( PerfCounters *counters, CounterEvent const events[ PERF_COUNTERS ], bool grouped );
+
+/**
+ * This function reads the current values of a set of hardware counters.
+ * @param counters the set, opened with perfOpen()
+ * @param values where the values go; any counter that couldn't be opened or read gets PERF_UNAVAILABLE
+ * @return true if every counter was read
+*/
+bool perfRead( PerfCounters const *counters, uint64_t values[ PERF_COUNTERS ] );
+
+#ifdef NO_STATS
+
+#define STATS_START( name )
+#define STATS_STOP( phase, name, amount )
+#define STATS_COUNT( phase, amount )
+#define STATS_ENGINE( engineName )
+#define STATS_THREADS( n )
+
+#else
+
+/** Set by statsBegin(); while it's false, the macros do nothing but check it. */
+extern bool statsEnabled;
+
+/** Start timing a phase, keeping the start time in a local variable with the given name. */
+#define STATS_START( name ) uint64_t name = statsEnabled ? statsClock() : 0
+
+/** Finish timing a phase started with STATS_START, and add the amount of work it did. */
+#define STATS_STOP( phase, name, amount ) \
+  do { if ( statsEnabled ) statsAdd( ( phase ), statsClock() - ( name ), ( amount ) ); } while ( 0 )
+
+/** Add to the amount of work done in a phase, without any time. */
+#define STATS_COUNT( phase, amount ) \
+  do { if ( statsEnabled ) statsAdd( ( phase ), 0, ( amount ) ); } while ( 0 )
+
+/** Record the name of the engine used. */
+#define STATS_ENGINE( engineName ) \
+  do { if ( statsEnabled ) statsEngine( engineName ); } while ( 0 )
+
+/** Record the number of threads a pool was started with; the report shows the most. */
+#define STATS_THREADS( n ) \
+  do { if ( statsEnabled ) statsThreads( n ); } while ( 0 )
+
+/**
+ * This function adds time and work to a phase. It's safe to call from any thread.
+ * @param phase the phase
+ * @param nanos the nanoseconds spent
+ * @param amount the work done, in the phase's unit
+*/
+void statsAdd( StatPhase phase, uint64_t nanos, uint64_t amount );
+
+/**
+ * This function records the name of the engine used.
+ * @param name the engine's name, which must last for the rest of the program
+*/
+void statsEngine( char const *name );
+
+/**
+ * This function records the size of a pool, keeping the largest seen.
+ * @param threads the number of threads in the pool
+*/
+void statsThreads( int threads );
+
+#endif
+
+/**
+ * This function turns the instrumentation on, notes the starting time and, where the kernel allows it, starts the
+ * processor's cycle, instruction and cache miss counters for this thread and every thread it starts after this.
+*/
+void statsBegin( void );
+
+/**
+ * This function writes the report: wall time, the time and work for each phase, throughput, the engine and threads
+ * used, and the hardware counters if they could be started. Reading and writing run in threads of their own while
+ * streaming, so the phase times overlap and can add up to more than the wall time.
+ * @param fp where to write the report
+*/
+void statsReport( FILE *fp );
+
+#endif
@@ -0,0 +1,461 @@
+/**
+ * @file stream.c
+ * @author Jimin Yu, jyu34
+ * This file implements the streaming pipeline: a reader thread, the compute step in the calling thread and a writer
+ * thread, passing a fixed ring of buffers around in order. With io_uring, one thread does it all instead, keeping the
+ * reads and writes queued in the kernel while it computes.
+*/
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "stream.h"
+#include "io.h"
+#include "stats.h"
+#include "uring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/** Alignment direct I/O needs for buffers, file positions and lengths; a multiple of every common block size. */
+#define DIRECT_ALIGN 4096
+
+/** Where a buffer in the ring is in the pipeline. */
+typedef enum {
+  SLOT_EMPTY,
+  SLOT_READ,
+  SLOT_COMPUTED,
+
+  /** A read is queued in the kernel (io_uring only). */
+  SLOT_READING,
+
+  /** A write is queued in the kernel (io_uring only). */
+  SLOT_WRITING
+} SlotState;
+
+/** One buffer in the ring. */
+typedef struct {
+  /** The data, chunkSize bytes plus the slack. */
+  byte *data;
+
+  /** Number of bytes of data in use. */
+  size_t len;
+
+  /** Position of the chunk's first byte in the input. */
+  uint64_t offset;
+
+  /** True if this is the last chunk of the input. */
+  bool last;
+
+  /** Which stage owns the buffer next. */
+  SlotState state;
+} Slot;
+
+/** State shared by the three stages of the pipeline. */
+typedef struct {
+  /** The input file. */
+  FILE *in;
+
+  /** Name of the input file. */
+  char const *inName;
+
+  /** The output file. */
+  FILE *out;
+
+  /** Name of the output file. */
+  char const *outName;
+
+  /** Bytes per chunk. */
+  size_t chunkSize;
+
+  /** Bytes of input left to read. */
+  uint64_t remaining;
+
+  /** The ring of buffers. */
+  Slot *slots;
+
+  /** Number of buffers in the ring. */
+  int count;
+
+  /** Set if the compute step fails, so the other stages stop early. */
+  bool failed;
+
+  /** Protects the slot states and failed. */
+  pthread_mutex_t lock;
+
+  /** Signaled whenever a slot changes state. */
+  pthread_cond_t changed;
+} Pipeline;
+
+/**
+   Wait until a slot reaches the given state, or the pipeline fails.
+   @param p the pipeline.
+   @param slot the slot to wait for.
+   @param state the state to wait for.
+   @return true if the slot is ready, false if the pipeline failed.
+*/
+static bool waitFor( Pipeline *p, Slot *slot, SlotState state )
+{
+  pthread_mutex_lock( &p->lock );
+  while ( slot->state != state && !p->failed )
+    pthread_cond_wait( &p->changed, &p->lock );
+  bool ready = !p->failed;
+  pthread_mutex_unlock( &p->lock );
+  return ready;
+}
+
+/**
+   Hand a slot on to the next stage.
+   @param p the pipeline.
+   @param slot the slot.
+   @param state the slot's new state.
+*/
+static void advance( Pipeline *p, Slot *slot, SlotState state )
+{
+  pthread_mutex_lock( &p->lock );
+  slot->state = state;
+  pthread_cond_broadcast( &p->changed );
+  pthread_mutex_unlock( &p->lock );
+}
+
+/**
+   Reader stage: fill empty buffers from the input, in order.
+   @param arg the pipeline.
+   @return NULL.
+*/
+static void *readerMain( void *arg )
+{
+  Pipeline *p = arg;
+  uint64_t offset = 0;
+  for ( int i = 0; ; i = ( i + 1 ) % p->count ) {
+    Slot *slot = &p->slots[ i ];
+    if ( !waitFor( p, slot, SLOT_EMPTY ) )
+      break;
+
+    size_t want = p->remaining < p->chunkSize ? p->remaining : p->chunkSize;
+    slot->len = readChunk( p->in, slot->data, want, p->inName );
+    slot->offset = offset;
+    slot->last = slot->len < p->chunkSize || slot->len == p->remaining;
+    offset += slot->len;
+    p->remaining -= slot->len;
+    advance( p, slot, SLOT_READ );
+    if ( slot->last )
+      break;
+  }
+  return NULL;
+}
+
+/**
+   Writer stage: write computed buffers to the output, in order.
+   @param arg the pipeline.
+   @return NULL.
+*/
+static void *writerMain( void *arg )
+{
+  Pipeline *p = arg;
+  for ( int i = 0; ; i = ( i + 1 ) % p->count ) {
+    Slot *slot = &p->slots[ i ];
+    if ( !waitFor( p, slot, SLOT_COMPUTED ) )
+      break;
+
+    writeChunk( p->out, slot->data, slot->len, p->outName );
+    bool last = slot->last;
+    advance( p, slot, SLOT_EMPTY );
+    if ( last )
+      break;
+  }
+  return NULL;
+}
+
+/** State for streaming through io_uring. */
+typedef struct {
+  /** The ring the reads and writes are queued on. */
+  Uring ring;
+
+  /** The input file, and a second descriptor for it with direct I/O, or -1. */
+  int inFd;
+  int directIn;
+
+  /** The output file, and a second descriptor for it with direct I/O, or -1. */
+  int outFd;
+  int directOut;
+
+  /** Names of the files, for error messages. */
+  char const *inName;
+  char const *outName;
+
+  /** Position in the input file of the first byte to read. */
+  uint64_t start;
+
+  /** Number of bytes of input to read. */
+  uint64_t total;
+
+  /** Position in the output file for the next write. */
+  uint64_t outOffset;
+
+  /** Bytes per chunk. */
+  size_t chunkSize;
+
+  /** Number of chunks in the input, and the number of the next one to read. */
+  uint64_t chunks;
+  uint64_t nextRead;
+
+  /** The ring of buffers. */
+  Slot *slots;
+
+  /** Number of buffers in the ring. */
+  int count;
+} UringStream;
+
+/**
+   Round a length up to the direct I/O alignment.
+   @param len the length.
+   @return the rounded length.
+*/
+static size_t alignUp( size_t len )
+{
+  return ( len + DIRECT_ALIGN - 1 ) / DIRECT_ALIGN * DIRECT_ALIGN;
+}
+
+/**
+   Open a second descriptor for a file with direct I/O, which moves data straight between our buffers and the device
+   instead of copying it through the page cache. The name has to lead back to the same file that's already open.
+   @param name the name of the file.
+   @param flags O_RDONLY or O_WRONLY.
+   @param info what fstat() says about the file that's already open.
+   @return the descriptor, or -1 if the file is standard input or output, or its file system won't do direct I/O.
+*/
+static int openDirect( char const *name, int flags, struct stat const *info )
+{
+  if ( strcmp( name, STDIO_NAME ) == 0 )
+    return -1;
+  int fd = open( name, flags | O_DIRECT | O_CLOEXEC );
+  struct stat same;
+  if ( fd >= 0 && ( fstat( fd, &same ) != 0 || same.st_dev != info->st_dev || same.st_ino != info->st_ino ) ) {
+    close( fd );
+    return -1;
+  }
+  return fd;
+}
+
+/**
+   Queue reads for the next chunks, into as many buffers as are free.
+   @param s the stream.
+*/
+static void queueReads( UringStream *s )
+{
+  while ( s->nextRead < s->chunks ) {
+    int index = s->nextRead % s->count;
+    Slot *slot = &s->slots[ index ];
+    if ( slot->state != SLOT_EMPTY )
+      break;
+
+    slot->offset = s->nextRead * s->chunkSize;
+    slot->len = s->total - slot->offset < s->chunkSize ? s->total - slot->offset : s->chunkSize;
+    slot->last = ++s->nextRead == s->chunks;
+    if ( slot->len == 0 ) {
+      slot->state = SLOT_READ;
+      continue;
+    }
+
+    // Direct reads are whole aligned blocks; the last one may run past the end of the input, which does no harm.
+    if ( s->directIn >= 0 )
+      uringRead( &s->ring, s->directIn, slot->data, alignUp( slot->len ), s->start + slot->offset, index );
+    else
+      uringRead( &s->ring, s->inFd, slot->data, slot->len, s->start + slot->offset, index );
+    slot->state = SLOT_READING;
+  }
+}
+
+/**
+   Wait for a read or write to finish and move its buffer on, exiting if it failed.
+   @param s the stream.
+*/
+static void completeOne( UringStream *s )
+{
+  uint64_t tag;
+  int result;
+  if ( !uringWait( &s->ring, &tag, &result ) ) {
+    fprintf( stderr, "Can't wait for I/O: %s\n", strerror( errno ) );
+    exit( EXIT_FAILURE );
+  }
+
+  Slot *slot = &s->slots[ tag ];
+  if ( slot->state == SLOT_READING ) {
+    // The input's size was taken at the start, so reading less than that means something went wrong.
+    if ( result < 0 || ( size_t ) result < slot->len ) {
+      fprintf( stderr, "Can't read file: %s\n", s->inName );
+      exit( EXIT_FAILURE );
+    }
+    STATS_COUNT( STAT_READ, slot->len );
+    slot->state = SLOT_READ;
+  } else {
+    if ( result < 0 || ( size_t ) result != slot->len ) {
+      fprintf( stderr, "Can't write file: %s\n", s->outName );
+      exit( EXIT_FAILURE );
+    }
+    STATS_COUNT( STAT_WRITE, slot->len );
+    slot->state = SLOT_EMPTY;
+  }
+  queueReads( s );
+}
+
+/**
+   Stream a file through a chunk function with io_uring, all in the calling thread. Reads for the chunks ahead are
+   kept queued in every free buffer, and each computed chunk's write is queued without waiting for it, so the device
+   stays busy while the chunk function runs. Where the file system allows it, reads and writes of whole aligned blocks
+   use direct I/O; anything else, like a short last chunk, goes through the page cache.
+   @param in the input file.
+   @param inName name of the input file.
+   @param out the output file.
+   @param outName name of the output file.
+   @param chunkSize the number of bytes in each chunk.
+   @param slack the number of bytes of extra room at the end of every buffer.
+   @param buffers the number of buffers in the ring.
+   @param limit the most bytes to read from the input.
+   @param fn the function to run on each chunk.
+   @param arg argument passed to fn.
+   @param ok set to true if the whole input was processed, false if fn asked to stop.
+   @return false if io_uring can't be used for these files, before anything has been read or written.
+*/
+static bool streamUring( FILE *in, char const *inName, FILE *out, char const *outName, size_t chunkSize, size_t slack,
+                         int buffers, uint64_t limit, ChunkFunction fn, void *arg, bool *ok )
+{
+  // Reads and writes go at explicit positions, so both files have to be regular files, and the output can't be in
+  // append mode, where the kernel ignores the position.
+  UringStream s = { .inFd = fileno( in ), .outFd = fileno( out ), .inName = inName, .outName = outName,
+                    .chunkSize = chunkSize, .count = buffers };
+  struct stat inInfo, outInfo;
+  off_t start = ftello( in ), outStart = ftello( out );
+  if ( start < 0 || outStart < 0 || fstat( s.inFd, &inInfo ) != 0 || !S_ISREG( inInfo.st_mode ) ||
+       fstat( s.outFd, &outInfo ) != 0 || !S_ISREG( outInfo.st_mode ) || ( fcntl( s.outFd, F_GETFL ) & O_APPEND ) )
+    return false;
+  if ( !uringInit( &s.ring, buffers ) )
+    return false;
+
+  // Anything the caller already wrote through the stdio buffer, like a header, has to land before our writes.
+  fflush( out );
+
+  s.start = start;
+  s.outOffset = outStart;
+  s.total = ( uint64_t ) inInfo.st_size > s.start ? inInfo.st_size - s.start : 0;
+  if ( s.total > limit )
+    s.total = limit;
+  s.chunks = s.total == 0 ? 1 : ( s.total + chunkSize - 1 ) / chunkSize;
+
+  // Every read starts on a chunk boundary, so they can all be direct if the first one can.
+  s.directIn = start % DIRECT_ALIGN == 0 && chunkSize % DIRECT_ALIGN == 0 ? openDirect( inName, O_RDONLY, &inInfo )
+                                                                          : -1;
+  s.directOut = openDirect( outName, O_WRONLY, &outInfo );
+
+  s.slots = calloc( buffers, sizeof( Slot ) );
+  for ( int i = 0; i < buffers; i++ ) {
+    if ( posix_memalign( ( void ** ) &s.slots[ i ].data, DIRECT_ALIGN, alignUp( chunkSize + slack ) ) != 0 ) {
+      fprintf( stderr, "Out of memory for stream buffers\n" );
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  *ok = true;
+  queueReads( &s );
+  for ( uint64_t i = 0; i < s.chunks; i++ ) {
+    int index = i % buffers;
+    Slot *slot = &s.slots[ index ];
+    STATS_START( waited );
+    while ( slot->state != SLOT_READ )
+      completeOne( &s );
+    STATS_STOP( STAT_READ, waited, 0 );
+
+    if ( !fn( arg, slot->data, &slot->len, slot->offset, slot->last ) ) {
+      *ok = false;
+      s.nextRead = s.chunks;
+      break;
+    }
+    if ( slot->len == 0 ) {
+      slot->state = SLOT_EMPTY;
+      queueReads( &s );
+      continue;
+    }
+
+    // A chunk function that changes lengths can knock the writes out of alignment, and then they go through the cache.
+    bool direct = s.directOut >= 0 && s.outOffset % DIRECT_ALIGN == 0 && slot->len % DIRECT_ALIGN == 0;
+    uringWrite( &s.ring, direct ? s.directOut : s.outFd, slot->data, slot->len, s.outOffset, index );
+    slot->state = SLOT_WRITING;
+    s.outOffset += slot->len;
+  }
+
+  // The kernel may still be using the buffers, even after a failure.
+  STATS_START( drain );
+  while ( s.ring.inFlight > 0 )
+    completeOne( &s );
+  STATS_STOP( STAT_WRITE, drain, 0 );
+
+  // Leave the output positioned after what was written, as the stdio path would.
+  fseeko( out, s.outOffset, SEEK_SET );
+  for ( int i = 0; i < buffers; i++ )
+    free( s.slots[ i ].data );
+  free( s.slots );
+  if ( s.directIn >= 0 )
+    close( s.directIn );
+  if ( s.directOut >= 0 )
+    close( s.directOut );
+  uringFree( &s.ring );
+  return true;
+}
+
+bool streamFile( FILE *in, char const *inName, FILE *out, char const *outName, size_t chunkSize, size_t slack,
+                 int buffers, uint64_t limit, bool uring, ChunkFunction fn, void *arg )
+{
+  bool ok;
+  if ( uring && streamUring( in, inName, out, outName, chunkSize, slack, buffers, limit, fn, arg, &ok ) )
+    return ok;
+
+  Pipeline p = { in, inName, out, outName, chunkSize, limit, NULL, buffers, false };
+  pthread_mutex_init( &p.lock, NULL );
+  pthread_cond_init( &p.changed, NULL );
+  p.slots = calloc( buffers, sizeof( Slot ) );
+  for ( int i = 0; i < buffers; i++ ) {
+    p.slots[ i ].data = malloc( chunkSize + slack );
+    if ( !p.slots[ i ].data ) {
+      fprintf( stderr, "Out of memory for stream buffers\n" );
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  pthread_t reader, writer;
+  pthread_create( &reader, NULL, readerMain, &p );
+  pthread_create( &writer, NULL, writerMain, &p );
+
+  // Compute stage, in this thread.
+  ok = true;
+  for ( int i = 0; ; i = ( i + 1 ) % buffers ) {
+    Slot *slot = &p.slots[ i ];
+    waitFor( &p, slot, SLOT_READ );
+    if ( !fn( arg, slot->data, &slot->len, slot->offset, slot->last ) ) {
+      pthread_mutex_lock( &p.lock );
+      p.failed = true;
+      pthread_cond_broadcast( &p.changed );
+      pthread_mutex_unlock( &p.lock );
+      ok = false;
+      break;
+    }
+    bool last = slot->last;
+    advance( &p, slot, SLOT_COMPUTED );
+    if ( last )
+      break;
+  }
+
+  pthread_join( reader, NULL );
+  pthread_join( writer, NULL );
+
+  for ( int i = 0; i < buffers; i++ )
+    free( p.slots[ i ].data );
+  free( p.slots );
+  pthread_mutex_destroy( &p.lock );
+  pthread_cond_destroy( &p.changed );
+  return ok;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file stream.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for stream.c, the bounded-memory pipeline that reads, processes and writes a file a chunk at
+ * a time.
+*/
+
+/** Macro used for unit testing */
+#ifndef _STREAM_H_
+/** Macro used for unit testing */
+#define _STREAM_H_
+
+#include "io.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Default number of bytes read into each buffer; a multiple of the block size. */
+#define STREAM_CHUNK ( 4 * 1024 * 1024 )
+
+/** Default number of buffers in the ring, enough for the reader, the compute step and the writer to each have one. */
+#define STREAM_BUFFERS 4
+
+/** Default extra room at the end of every buffer, so a chunk function can add a little data (like a tag) to a chunk. */
+#define STREAM_SLACK 64
+
+/**
+ * Function that processes one chunk of the stream in place, between reading it and writing it.
+ * @param arg the argument passed to streamFile()
+ * @param data the chunk, with room for the slack given to streamFile() past its length
+ * @param len the length of the chunk; the function may change it to shorten or lengthen what's written
+ * @param offset position of the chunk's first byte in the input
+ * @param last true for the final chunk of the input, which may be short or even empty
+ * @return true to keep going, false to stop the pipeline with an error
+*/
+typedef bool ( *ChunkFunction )( void *arg, byte *data, size_t *len, uint64_t offset, bool last );
+
+/**
+ * This function streams a file through a chunk function. A reader thread fills a fixed ring of buffers from the input,
+ * the calling thread runs fn on each one, and a writer thread writes them out, so reading, computing and writing all
+ * overlap and memory use stays the same no matter how big the input is. Every chunk except the last is exactly
+ * chunkSize bytes. With uring set, and both files regular files, the calling thread does everything instead, keeping
+ * reads and writes queued with io_uring and using direct I/O for whole aligned blocks where the file system allows
+ * it; if the kernel doesn't allow io_uring, or a file is a pipe or terminal, the threads are used after all.
+ * @param in the input file
+ * @param inName name of the input file, for error messages
+ * @param out the output file
+ * @param outName name of the output file, for error messages
+ * @param chunkSize the number of bytes in each chunk
+ * @param slack the number of bytes of extra room at the end of every buffer, for the chunk function to grow chunks into
+ * @param buffers the number of buffers in the ring, at least 2
+ * @param limit the most bytes to read from the input, or UINT64_MAX for all of it
+ * @param uring true to try io_uring first
+ * @param fn the function to run on each chunk
+ * @param arg argument passed to fn
+ * @return true if the whole input was processed, false if fn asked to stop
+*/
+bool streamFile( FILE *in, char const *inName, FILE *out, char const *outName, size_t chunkSize, size_t slack,
+                 int buffers, uint64_t limit, bool uring, ChunkFunction fn, void *arg );
+
+#endif
@@ -177,6 +177,74 @@ else
     FAIL=1
 fi
 
+# Run unit tests for the cipher modes.
+echo
+echo "Running modesTest unit tests"
+make modesTest
+
+if [ -x modesTest ]; then
+    ./modesTest
+    
+    if [ $? -ne 0 ]; then
+	echo "**** Your program didn't pass all the modesTest unit tests."
+	FAIL=1
+    fi
+else
+    echo "**** We couldn't build the modesTest program with your implementation, so we couldn't run these unit tests."
+    FAIL=1
+fi
+
+# Run unit tests for the library.
+echo
+echo "Running aesmachineTest unit tests"
+make aesmachineTest
+
+if [ -x aesmachineTest ]; then
+    ./aesmachineTest
+    
+    if [ $? -ne 0 ]; then
+	echo "**** Your program didn't pass all the aesmachineTest unit tests."
+	FAIL=1
+    fi
+else
+    echo "**** We couldn't build the aesmachineTest program with your implementation, so we couldn't run these unit tests."
+    FAIL=1
+fi
+
+# Run unit tests for the erasure code.
+echo
+echo "Running rsTest unit tests"
+make rsTest
+
+if [ -x rsTest ]; then
+    ./rsTest
+    
+    if [ $? -ne 0 ]; then
+	echo "**** Your program didn't pass all the rsTest unit tests."
+	FAIL=1
+    fi
+else
+    echo "**** We couldn't build the rsTest program with your implementation, so we couldn't run these unit tests."
+    FAIL=1
+fi
+
+# Run unit tests for the compressor.
+echo
+echo "Running lzTest unit tests"
+make lzTest
+
+if [ -x lzTest ]; then
+    ./lzTest
+    
+    if [ $? -ne 0 ]; then
+	echo "**** Your program didn't pass all the lzTest unit tests."
+	FAIL=1
+    fi
+else
+    echo "**** We couldn't build the lzTest program with your implementation, so we couldn't run these unit tests."
+    FAIL=1
+fi
+
 # Tests for the encrypt program.
 echo
 echo "Running encrypt tests"
@@ -203,6 +271,48 @@ if [ -x encrypt ]; then
     args=(key-06.dat plain-06.dat)
     testEncrypt 06 0
     
+    args=(-j 4 key-06.dat plain-06.dat)
+    testEncrypt 06 0
+    
+    args=(--mmap key-05.dat plain-05.dat)
+    testEncrypt 05 0
+    
+    args=(--mode ctr --iv iv-10.dat key-10.dat plain-10.dat)
+    testEncrypt 10 0
+    
+    args=(--mode ctr --iv iv-10.dat --offset 20 --length 30 key-10.dat plain-10.dat)
+    testEncrypt 11 0
+    
+    args=(--mmap --mode ctr --iv iv-10.dat --offset 20 --length 30 key-10.dat plain-10.dat)
+    testEncrypt 11 0
+    
+    args=(--io uring key-06.dat plain-06.dat)
+    testEncrypt 06 0
+    
+    args=(--io uring --mode ctr --iv iv-10.dat --offset 20 --length 30 key-10.dat plain-10.dat)
+    testEncrypt 11 0
+    
+    args=(--mode gcm --iv iv-12.dat key-12.dat plain-12.dat)
+    testEncrypt 12 0
+    
+    args=(--mmap --mode gcm --iv iv-12.dat key-12.dat plain-12.dat)
+    testEncrypt 12 0
+    
+    args=(--mode cbc --iv iv-14.dat key-14.dat plain-14.dat)
+    testEncrypt 14 0
+    
+    args=(--mode cbc --iv iv-15.dat key-14.dat plain-06.dat /dev/null plain-15.dat)
+    testEncrypt 15 0
+    
+    args=(--mode xts key-16.dat plain-16.dat)
+    testEncrypt 16 0
+    
+    args=(--mmap --mode xts key-16.dat plain-16.dat)
+    testEncrypt 16 0
+    
+    args=(--mode xts --offset 512 --length 1024 key-16.dat plain-16.dat)
+    testEncrypt 17 0
+    
     args=(key-07.dat plain-07.dat)
     testEncrypt 07 1
     
@@ -235,12 +345,384 @@ if [ -x decrypt ]; then
     args=(key-06.dat cipher-06.dat)
     testDecrypt 06 0
     
+    args=(-j 4 key-06.dat cipher-06.dat)
+    testDecrypt 06 0
+    
+    args=(--mmap key-05.dat cipher-05.dat)
+    testDecrypt 05 0
+    
+    args=(--mode ctr --iv iv-10.dat key-10.dat cipher-10.dat)
+    testDecrypt 10 0
+    
+    args=(--mode ctr --iv iv-10.dat --offset 20 --length 30 key-10.dat cipher-10.dat)
+    testDecrypt 11 0
+    
+    args=(--mode gcm --iv iv-12.dat key-12.dat cipher-12.dat)
+    testDecrypt 12 0
+    
+    args=(--mmap --mode gcm --iv iv-12.dat key-12.dat cipher-12.dat)
+    testDecrypt 12 0
+    
+    args=(--mode gcm --iv iv-12.dat key-12.dat cipher-13.dat)
+    testDecrypt 13 1
+    
+    args=(--mmap --mode gcm --iv iv-12.dat key-12.dat cipher-13.dat)
+    testDecrypt 13 1
+    
+    args=(--io uring --mode gcm --iv iv-12.dat key-12.dat cipher-12.dat)
+    testDecrypt 12 0
+    
+    args=(--io uring --mode gcm --iv iv-12.dat key-12.dat cipher-13.dat)
+    testDecrypt 13 1
+    
+    args=(--mode cbc --iv iv-14.dat key-14.dat cipher-14.dat)
+    testDecrypt 14 0
+    
+    args=(-j 4 --mmap --mode cbc --iv iv-14.dat key-14.dat cipher-14.dat)
+    testDecrypt 14 0
+    
+    args=(--mode cbc --iv iv-15.dat key-14.dat cipher-06.dat /dev/null cipher-15.dat)
+    testDecrypt 15 0
+    
+    args=(--mode xts key-16.dat cipher-16.dat)
+    testDecrypt 16 0
+    
+    args=(-j 4 --mmap --mode xts --offset 512 --length 1024 key-16.dat cipher-16.dat)
+    testDecrypt 17 0
+    
+    args=(--container key-12.dat cipher-18.dat)
+    testDecrypt 18 0
+    
+    args=(-j 2 --container --range 4000:5000 key-12.dat cipher-18.dat)
+    testDecrypt 19 0
+    
+    args=(--container key-12.dat cipher-20.dat)
+    testDecrypt 20 1
+    
+    args=(-j 3 --container key-12.dat cipher-21.dat)
+    testDecrypt 21 0
+    
     args=(key-09.dat cipher-09.dat)
     testDecrypt 09 1
 else
     fail "Since your decrypt program didn't compile, it couldn't be tested"
 fi
 
+# Encrypt with --stats, which should leave the output alone and report on standard error.
+echo
+echo "Running stats tests"
+
+if [ -x encrypt ]; then
+    echo "Stats Test 01"
+    rm -f output.dat stderr.txt
+    echo "   ./encrypt --stats key-06.dat plain-06.dat output.dat 2> stderr.txt"
+    ./encrypt --stats key-06.dat plain-06.dat output.dat 2> stderr.txt
+    if checkStatus 0 $? && checkFile "Ciphertext output" "cipher-06.dat" "output.dat"; then
+	if grep -q "^stats:" stderr.txt; then
+	    echo "Stats Test 01 PASS"
+	else
+	    fail "FAILED - no stats report in stderr.txt"
+	fi
+    else
+	FAIL=1
+    fi
+else
+    fail "Since your encrypt program didn't compile, it couldn't be tested"
+fi
+
+# Run several jobs from one manifest, sharing a key between two of them.
+echo
+echo "Running batch tests"
+
+if [ -x encrypt ] && [ -x decrypt ]; then
+    echo "Batch Test 01"
+    rm -f batch.txt batch-*.dat
+    printf '%s\n' "key-01.dat plain-01.dat batch-01.dat" "key-05.dat plain-05.dat batch-05.dat" \
+	"# a comment" "" "key-06.dat plain-06.dat batch-06.dat" "key-01.dat plain-01.dat batch-11.dat" > batch.txt
+    echo "   ./encrypt -j 2 --batch batch.txt"
+    ./encrypt -j 2 --batch batch.txt
+    if checkStatus 0 $? &&
+       checkFile "Batch output" "cipher-01.dat" "batch-01.dat" &&
+       checkFile "Batch output" "cipher-05.dat" "batch-05.dat" &&
+       checkFile "Batch output" "cipher-06.dat" "batch-06.dat" &&
+       checkFile "Batch output" "cipher-01.dat" "batch-11.dat"; then
+	echo "Batch Test 01 PASS"
+    else
+	FAIL=1
+    fi
+
+    echo "Batch Test 02"
+    printf '%s\n' "key-05.dat batch-05.dat batch-05.dat" "key-06.dat batch-06.dat batch-06.dat" > batch.txt
+    echo "   ./decrypt --batch batch.txt"
+    ./decrypt --batch batch.txt
+    if checkStatus 0 $? &&
+       checkFile "Batch output" "plain-05.dat" "batch-05.dat" &&
+       checkFile "Batch output" "plain-06.dat" "batch-06.dat"; then
+	echo "Batch Test 02 PASS"
+    else
+	FAIL=1
+    fi
+
+    echo "Batch Test 03"
+    echo "existing" > batch-13.dat
+    echo "existing" > expected.dat
+    printf '%s\n' "key-12.dat cipher-13.dat batch-13.dat iv-12.dat" > batch.txt
+    echo "   ./decrypt --mode gcm --batch batch.txt"
+    ./decrypt --mode gcm --batch batch.txt 2> stderr.txt
+    if checkStatus 1 $? && checkFile "Untouched output" "expected.dat" "batch-13.dat"; then
+	echo "Batch Test 03 PASS"
+    else
+	FAIL=1
+    fi
+    rm -f expected.dat
+    rm -f batch.txt batch-*.dat
+else
+    fail "Since your encrypt and decrypt programs didn't compile, they couldn't be tested"
+fi
+
+# Decrypt two sectors of an xts image in place, leaving the sectors around them alone.
+echo
+echo "Running sector tests"
+
+if [ -x decrypt ]; then
+    echo "Sector Test 01"
+    rm -f image.dat expected.dat
+    cp cipher-16.dat image.dat
+    { head -c 512 cipher-16.dat; cat plain-17.dat; tail -c +1537 cipher-16.dat; } > expected.dat
+    echo "   ./decrypt --in-place --mode xts --offset 512 --length 1024 key-16.dat image.dat"
+    ./decrypt --in-place --mode xts --offset 512 --length 1024 key-16.dat image.dat
+    if checkStatus 0 $? && checkFile "Image" "expected.dat" "image.dat"; then
+	echo "Sector Test 01 PASS"
+    else
+	FAIL=1
+    fi
+    rm -f image.dat expected.dat
+else
+    fail "Since your decrypt program didn't compile, it couldn't be tested"
+fi
+
+# gcm plaintext can't be trusted until the tag at the end has been checked, so decrypt won't send it down a pipe.
+echo
+echo "Running gcm output tests"
+
+if [ -x decrypt ]; then
+    echo "GCM Output Test 01"
+    rm -f output.dat
+    echo "   ./decrypt --mode gcm --iv iv-12.dat key-12.dat cipher-12.dat - > output.dat"
+    ./decrypt --mode gcm --iv iv-12.dat key-12.dat cipher-12.dat - > output.dat 2> /dev/null
+    if checkStatus 1 $?; then
+	if [ -s output.dat ]; then
+	    fail "FAILED - gcm plaintext was written to standard output"
+	else
+	    echo "GCM Output Test 01 PASS"
+	fi
+    else
+	FAIL=1
+    fi
+    rm -f output.dat
+else
+    fail "Since your decrypt program didn't compile, it couldn't be tested"
+fi
+
+# Name one file as both the input and the output, streamed and mapped, which has to be encrypted in place rather than
+# truncated.
+echo
+echo "Running same file tests"
+
+if [ -x encrypt ]; then
+    echo "Same File Test 01"
+    rm -f same.dat
+    cp plain-06.dat same.dat
+    echo "   ./encrypt key-06.dat same.dat same.dat"
+    ./encrypt key-06.dat same.dat same.dat
+    if checkStatus 0 $? && checkFile "Ciphertext output" "cipher-06.dat" "same.dat"; then
+	echo "Same File Test 01 PASS"
+    else
+	FAIL=1
+    fi
+
+    echo "Same File Test 02"
+    cp plain-12.dat same.dat
+    echo "   ./encrypt --mode gcm --iv iv-12.dat key-12.dat same.dat same.dat"
+    ./encrypt --mode gcm --iv iv-12.dat key-12.dat same.dat same.dat 2> stderr.txt
+    if checkStatus 1 $? && checkFile "Unchanged input" "plain-12.dat" "same.dat"; then
+	echo "Same File Test 02 PASS"
+    else
+	FAIL=1
+    fi
+
+    echo "Same File Test 03"
+    cp plain-06.dat same.dat
+    echo "   ./encrypt --mmap key-06.dat same.dat same.dat"
+    ./encrypt --mmap key-06.dat same.dat same.dat
+    if checkStatus 0 $? && checkFile "Ciphertext output" "cipher-06.dat" "same.dat"; then
+	echo "Same File Test 03 PASS"
+    else
+	FAIL=1
+    fi
+    rm -f same.dat
+else
+    fail "Since your encrypt program didn't compile, it couldn't be tested"
+fi
+
+# Encrypt into containers in small chunks across threads, then decrypt them again; the salt is random, so the
+# containers themselves differ every time.
+echo
+echo "Running container tests"
+
+if [ -x encrypt ] && [ -x decrypt ]; then
+    echo "Container Test 01"
+    rm -f container.dat output.dat
+    echo "   ./encrypt -j 3 --container --chunk 4096 key-12.dat plain-18.dat container.dat"
+    ./encrypt -j 3 --container --chunk 4096 key-12.dat plain-18.dat container.dat
+    if checkStatus 0 $?; then
+	echo "   ./decrypt -j 3 --container key-12.dat container.dat output.dat"
+	./decrypt -j 3 --container key-12.dat container.dat output.dat
+	if checkStatus 0 $? && checkFile "Plaintext output" "plain-18.dat" "output.dat"; then
+	    echo "Container Test 01 PASS"
+	else
+	    FAIL=1
+	fi
+    else
+	FAIL=1
+    fi
+
+    echo "Container Test 02"
+    rm -f container.dat output.dat
+    echo "   ./encrypt -j 3 --container --compress --chunk 4096 key-12.dat plain-21.dat container.dat"
+    ./encrypt -j 3 --container --compress --chunk 4096 key-12.dat plain-21.dat container.dat
+    if checkStatus 0 $?; then
+	echo "   ./decrypt --container --range 10000:9000 key-12.dat container.dat output.dat"
+	./decrypt --container --range 10000:9000 key-12.dat container.dat output.dat
+	STATUS=$?
+	tail -c +10001 plain-21.dat | head -c 9000 > expected.dat
+	if checkStatus 0 $STATUS && checkFile "Plaintext output" "expected.dat" "output.dat"; then
+	    if [ $( wc -c < container.dat ) -lt $( wc -c < plain-21.dat ) ]; then
+		echo "Container Test 02 PASS"
+	    else
+		fail "FAILED - the compressed container is no smaller than its input"
+	    fi
+	else
+	    FAIL=1
+	fi
+    else
+	FAIL=1
+    fi
+    rm -f container.dat expected.dat
+else
+    fail "Since your encrypt and decrypt programs didn't compile, they couldn't be tested"
+fi
+
+# Start aesd with two keys and have aesc encrypt and decrypt through it.
+echo
+echo "Running daemon tests"
+
+if [ -x aesd ] && [ -x aesc ]; then
+    rm -f aesd.sock output.dat
+    ./aesd -j 2 --socket aesd.sock key-01.dat key-12.dat &
+    AESD=$!
+    for i in 1 2 3 4 5 6 7 8 9 10; do
+	[ -S aesd.sock ] && break
+	sleep 0.1
+    done
+
+    echo "Daemon Test 01"
+    echo "   ./aesc --socket aesd.sock encrypt 0 plain-01.dat output.dat"
+    ./aesc --socket aesd.sock encrypt 0 plain-01.dat output.dat
+    if checkStatus 0 $? && checkFile "Daemon output" "cipher-01.dat" "output.dat"; then
+	echo "Daemon Test 01 PASS"
+    else
+	FAIL=1
+    fi
+
+    echo "Daemon Test 02"
+    echo "   ./aesc --socket aesd.sock --mode gcm --iv iv-12.dat decrypt 1 cipher-12.dat output.dat"
+    ./aesc --socket aesd.sock --mode gcm --iv iv-12.dat decrypt 1 cipher-12.dat output.dat
+    if checkStatus 0 $? && checkFile "Daemon output" "plain-12.dat" "output.dat"; then
+	echo "Daemon Test 02 PASS"
+    else
+	FAIL=1
+    fi
+
+    echo "Daemon Test 03"
+    echo "   ./aesc --socket aesd.sock encrypt 2 plain-01.dat output.dat"
+    ./aesc --socket aesd.sock encrypt 2 plain-01.dat output.dat 2> /dev/null
+    if checkStatus 1 $?; then
+	echo "Daemon Test 03 PASS"
+    else
+	FAIL=1
+    fi
+
+    kill $AESD
+    wait $AESD
+    if [ -e aesd.sock ]; then
+	fail "FAILED - aesd didn't remove its socket"
+    fi
+
+    # aesd won't start in place of a file that isn't a socket.
+    echo "Daemon Test 04"
+    cp plain-01.dat aesd.sock
+    echo "   ./aesd --socket aesd.sock key-01.dat"
+    ./aesd --socket aesd.sock key-01.dat 2> /dev/null
+    if checkStatus 1 $? && checkFile "Existing file" "plain-01.dat" "aesd.sock"; then
+	echo "Daemon Test 04 PASS"
+    else
+	FAIL=1
+    fi
+    rm -f aesd.sock
+else
+    fail "Since your aesd and aesc programs didn't compile, they couldn't be tested"
+fi
+
+# Split a file into shards, lose as many as the code can stand and rebuild it.
+echo
+echo "Running erasure coding tests"
+
+if [ -x ecencode ] && [ -x ecdecode ]; then
+    echo "Erasure Test 01"
+    rm -f output.dat shard.*
+    echo "   ./ecencode -k 4 -m 2 plain-06.dat shard"
+    ./ecencode -k 4 -m 2 plain-06.dat shard
+    rm -f shard.1 shard.4
+    echo "   ./ecdecode -j 4 shard output.dat"
+    ./ecdecode -j 4 shard output.dat
+    if checkStatus 0 $? && checkFile "Rebuilt output" "plain-06.dat" "output.dat"; then
+	echo "Erasure Test 01 PASS"
+    else
+	FAIL=1
+    fi
+
+    # One shard cut short and another with a byte changed in the middle are both treated as lost.
+    echo "Erasure Test 02"
+    rm -f output.dat shard.*
+    echo "   ./ecencode -k 4 -m 2 plain-21.dat shard"
+    ./ecencode -k 4 -m 2 plain-21.dat shard
+    head -c 6000 shard.0 > shard.tmp && mv shard.tmp shard.0
+    printf 'X' | dd of=shard.3 bs=1 seek=5000 conv=notrunc 2>/dev/null
+    echo "   ./ecdecode shard output.dat"
+    ./ecdecode shard output.dat
+    if checkStatus 0 $? && checkFile "Rebuilt output" "plain-21.dat" "output.dat"; then
+	echo "Erasure Test 02 PASS"
+    else
+	FAIL=1
+    fi
+
+    # With a third shard damaged, there isn't enough left to rebuild from.
+    echo "Erasure Test 03"
+    rm -f output.dat
+    printf 'X' | dd of=shard.5 bs=1 seek=5000 conv=notrunc 2>/dev/null
+    echo "   ./ecdecode shard output.dat"
+    ./ecdecode shard output.dat 2> stderr.txt
+    if checkStatus 1 $?; then
+	echo "Erasure Test 03 PASS"
+    else
+	FAIL=1
+    fi
+    rm -f shard.* stderr.txt
+else
+    fail "Since your ecencode and ecdecode programs didn't compile, they couldn't be tested"
+fi
+
 if [ $FAIL -ne 0 ]; then
   echo "FAILING TESTS!"
   exit 13
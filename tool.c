@@ -0,0 +1,604 @@
+/**
+ * @file tool.c
+ * @author Jimin Yu, jyu34
+ * This file contains the program execution shared by the encrypt and decrypt programs: reading the key, streaming the
+ * input through the cipher and writing the output.
+*/
+
+#include "tool.h"
+#include "aes.h"
+#include "batch.h"
+#include "cli.h"
+#include "container.h"
+#include "io.h"
+#include "modes.h"
+#include "parallel.h"
+#include "stats.h"
+#include "stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Bytes read from each file at a time when several files are encrypted together in CBC mode. */
+#define CBC_STREAM_CHUNK ( STREAM_CHUNK / CBC_INTERLEAVE )
+
+/** Everything needed to run the cipher over part of the input. */
+typedef struct {
+  /** The parsed command line. */
+  Options const *opts;
+
+  /** Whether to encrypt or decrypt. */
+  Direction dir;
+
+  /** Which of the input and output file pairs this is. */
+  int pair;
+
+  /** The context holding the expanded key. */
+  AesContext ctx;
+
+  /** The context holding the expanded tweak key, in XTS mode. */
+  AesContext tweakCtx;
+
+  /** The IV for CBC mode, updated as each chunk is chained on, or the initial counter block for CTR mode. */
+  byte iv[ BLOCK_SIZE ];
+
+  /** The GCM operation, in GCM mode. */
+  GcmContext gcm;
+
+  /** When decrypting a stream in GCM mode, the last bytes seen so far, which may turn out to be the tag. */
+  byte held[ GCM_TAG_SIZE ];
+
+  /** Number of bytes in held. */
+  size_t heldLen;
+
+  /** Set if the GCM tag didn't match. */
+  bool authFailed;
+
+  /** Threads to split the work across. */
+  WorkerPool *pool;
+} Job;
+
+/**
+   Report whether XTS can handle a length: every sector, including a short last one, needs at least one whole block.
+   @param opts the parsed command line.
+   @param len the number of bytes.
+   @return true if the length is fine, or the mode isn't XTS.
+*/
+static bool sectorsFit( Options const *opts, uint64_t len )
+{
+  uint64_t tail = len % opts->sectorSize;
+  return opts->mode != MODE_XTS || tail == 0 || tail >= BLOCK_SIZE;
+}
+
+/**
+   Report whether GCM can handle a length: the whole message has to fit under one IV's 32-bit counter.
+   @param opts the parsed command line.
+   @param dir whether to encrypt or decrypt.
+   @param len bytes of input, including the tag when decrypting.
+   @return true if the length is fine, or the mode isn't GCM.
+*/
+static bool gcmFits( Options const *opts, Direction dir, uint64_t len )
+{
+  return opts->mode != MODE_GCM || len <= GCM_MAX_BYTES + ( dir == DECRYPT ? GCM_TAG_SIZE : 0 );
+}
+
+/**
+   Encrypt or decrypt a range of the input in whichever mode the options ask for.
+   @param job the job being run.
+   @param in the input bytes.
+   @param out where the output goes, which may be the same as in.
+   @param len the number of bytes.
+   @param offset position of the first byte relative to where processing started.
+   @return false if the range isn't a whole number of blocks in a mode that needs that, ends in too short a sector, or
+   takes GCM past its limit.
+*/
+static bool cryptRange( Job *job, byte const *in, byte *out, size_t len, uint64_t offset )
+{
+  // Ranges always start on a sector boundary, so the sector number is just the position over the sector size.
+  if ( job->opts->mode == MODE_XTS ) {
+    if ( !sectorsFit( job->opts, len ) )
+      return false;
+    size_t sectorSize = job->opts->sectorSize;
+    parallelXtsCrypt( job->pool, &job->ctx, &job->tweakCtx, ( job->opts->offset + offset ) / sectorSize, sectorSize,
+                      in, out, len, job->dir == ENCRYPT );
+    return true;
+  }
+
+  if ( job->opts->mode == MODE_CTR ) {
+    parallelCtrCrypt( job->pool, &job->ctx, job->iv, job->opts->offset + offset, in, out, len );
+    return true;
+  }
+
+  if ( job->opts->mode == MODE_GCM && job->dir == ENCRYPT )
+    return gcmEncrypt( &job->gcm, job->pool, in, out, len );
+  if ( job->opts->mode == MODE_GCM )
+    return gcmDecrypt( &job->gcm, job->pool, in, out, len );
+
+  if ( len % BLOCK_SIZE != 0 )
+    return false;
+
+  if ( job->opts->mode == MODE_CBC && job->dir == ENCRYPT ) {
+    CbcStream stream = { in, out, len / BLOCK_SIZE };
+    memcpy( stream.iv, job->iv, BLOCK_SIZE );
+    cbcEncryptStreams( &job->ctx, &stream, 1 );
+    memcpy( job->iv, stream.iv, BLOCK_SIZE );
+  } else if ( job->opts->mode == MODE_CBC )
+    parallelCbcDecrypt( job->pool, &job->ctx, job->iv, in, out, len / BLOCK_SIZE );
+  else if ( job->dir == ENCRYPT )
+    parallelEncryptBlocks( job->pool, &job->ctx, in, out, len / BLOCK_SIZE );
+  else
+    parallelDecryptBlocks( job->pool, &job->ctx, in, out, len / BLOCK_SIZE );
+  return true;
+}
+
+/**
+   Encrypt or decrypt one chunk of the stream in place.
+   @param arg the Job.
+   @param data the chunk.
+   @param len the length of the chunk.
+   @param offset position of the chunk in the input.
+   @param last true for the last chunk.
+   @return false if the chunk can't be processed.
+*/
+static bool cryptChunk( void *arg, byte *data, size_t *len, uint64_t offset, bool last )
+{
+  Job *job = arg;
+  STATS_START( start );
+  if ( !cryptRange( job, data, data, *len, offset ) )
+    return false;
+  STATS_STOP( STAT_COMPUTE, start, *len );
+
+  // The GCM tag goes on the end of the last chunk, in the slack past its data.
+  if ( job->opts->mode == MODE_GCM && last ) {
+    gcmFinal( &job->gcm, data + *len );
+    *len += GCM_TAG_SIZE;
+  }
+  return true;
+}
+
+/**
+   Decrypt one chunk of a GCM stream in place. The tag is the last GCM_TAG_SIZE bytes of the input, which can't be
+   told apart from data until the input ends, so each chunk holds back its tail and the next one starts with it.
+   @param arg the Job.
+   @param data the chunk.
+   @param len the length of the chunk, updated to the number of bytes of plaintext.
+   @param offset position of the chunk in the input.
+   @param last true for the last chunk.
+   @return false if the input was too short to hold a tag, too long for GCM, or the tag didn't match.
+*/
+static bool gcmOpenChunk( void *arg, byte *data, size_t *len, uint64_t offset, bool last )
+{
+  Job *job = arg;
+  size_t total = job->heldLen + *len;
+  memmove( data + job->heldLen, data, *len );
+  memcpy( data, job->held, job->heldLen );
+
+  job->heldLen = total < GCM_TAG_SIZE ? total : GCM_TAG_SIZE;
+  *len = total - job->heldLen;
+  memcpy( job->held, data + *len, job->heldLen );
+  // Input too long for GCM can't be authentic, and what's been written of it has to go the same way.
+  STATS_START( start );
+  if ( !gcmDecrypt( &job->gcm, job->pool, data, data, *len ) ) {
+    job->authFailed = true;
+    return false;
+  }
+  STATS_STOP( STAT_COMPUTE, start, *len );
+
+  if ( !last )
+    return true;
+  if ( job->heldLen < GCM_TAG_SIZE )
+    return false;
+  job->authFailed = !gcmCheckTag( &job->gcm, job->held );
+  return !job->authFailed;
+}
+
+/**
+   Read the IV for one file pair. The IV file holds one IV after another, for each pair in turn.
+   @param opts the parsed command line.
+   @param pair which file pair the IV is for.
+   @param iv where the IV goes.
+*/
+static void readIv( Options const *opts, int pair, byte *iv )
+{
+  size_t want = opts->mode == MODE_GCM ? GCM_IV_SIZE : BLOCK_SIZE;
+  size_t sizeIv = 0;
+  byte *ivs = readBinaryFile( opts->ivFile, &sizeIv );
+  if ( sizeIv != want * opts->filePairs ) {
+    free( ivs );
+    fprintf( stderr, "Bad IV file: %s\n", opts->ivFile );
+    exit( EXIT_FAILURE );
+  }
+  memcpy( iv, ivs + pair * want, want );
+  free( ivs );
+}
+
+/**
+   Read the IV if the mode needs one, and get the mode ready to start.
+   @param job the job to set up.
+*/
+static void setupIv( Job *job )
+{
+  if ( job->opts->mode == MODE_ECB || job->opts->mode == MODE_XTS )
+    return;
+
+  byte iv[ BLOCK_SIZE ];
+  readIv( job->opts, job->pair, iv );
+  if ( job->opts->mode == MODE_GCM )
+    gcmInit( &job->gcm, &job->ctx, iv );
+  else
+    memcpy( job->iv, iv, BLOCK_SIZE );
+}
+
+/**
+   Report ciphertext that failed authentication and exit. The output is removed, since it can't be trusted.
+   @param opts the parsed command line.
+*/
+static void authFailed( Options const *opts )
+{
+  if ( strcmp( opts->outputFile, STDIO_NAME ) != 0 )
+    remove( opts->outputFile );
+  fprintf( stderr, "Authentication failed: %s\n", opts->inputFile );
+  exit( EXIT_FAILURE );
+}
+
+/**
+   Make sure the key is the right size, and expand it. An XTS key is two keys, the data key and then the tweak key,
+   which have to be different.
+   @param ctx the context to initialize.
+   @param tweakCtx the context to initialize with the tweak key, in XTS mode.
+   @param key the contents of the key file.
+   @param sizeKey the size of the key file.
+   @param opts the parsed command line.
+*/
+static void setupKey( AesContext *ctx, AesContext *tweakCtx, byte const *key, size_t sizeKey, Options const *opts )
+{
+  bool xts = opts->mode == MODE_XTS;
+  if ( sizeKey != ( xts ? XTS_KEY_SIZE : BLOCK_SIZE ) || ( xts && memcmp( key, key + BLOCK_SIZE, BLOCK_SIZE ) == 0 ) ) {
+    fprintf( stderr, "Bad key file: %s\n", opts->keyFile );
+    exit( EXIT_FAILURE );
+  }
+
+  // Expand the key once, then reuse it for every block.
+  aesInitCtx( ctx, key );
+  if ( xts )
+    aesInitCtx( tweakCtx, key + BLOCK_SIZE );
+}
+
+/**
+   Report an input that isn't a whole number of blocks and exit.
+   @param name the name of the input file.
+   @param dir whether the input is plaintext or ciphertext.
+*/
+static void badLength( char const *name, Direction dir )
+{
+  fprintf( stderr, "Bad %s file length: %s\n", dir == ENCRYPT ? "plaintext" : "ciphertext", name );
+  exit( EXIT_FAILURE );
+}
+
+/**
+   Report whether a mode only works on whole blocks.
+   @param mode the mode.
+   @return true if the input has to be a multiple of BLOCK_SIZE bytes.
+*/
+static bool wholeBlocks( CipherMode mode )
+{
+  return mode == MODE_ECB || mode == MODE_CBC;
+}
+
+/**
+   Start a pool with as many threads as the options ask for, but no more than are worth using on the given amount of data.
+   @param opts the parsed command line.
+   @param size the number of bytes that will be processed in one call.
+   @return the pool, or NULL for a single thread.
+*/
+static WorkerPool *startPool( Options const *opts, uint64_t size )
+{
+  WorkerPool *pool = poolCreate( parallelThreadsFor( optionThreads( opts ), size / BLOCK_SIZE, MIN_BLOCKS_PER_THREAD ) );
+  STATS_THREADS( poolThreads( pool ) );
+  return pool;
+}
+
+/**
+   Run the cipher with the input and output files mapped into memory, so the engine works straight on the file pages
+   with no copies in between.
+   @param opts the parsed command line.
+   @param dir whether to encrypt or decrypt.
+   @param pair which of the input and output file pairs to process.
+   @param key the contents of the key file.
+   @param sizeKey the size of the key file.
+   @return the exit status for the program.
+*/
+static int runMapped( Options const *opts, Direction dir, int pair, byte const *key, size_t sizeKey )
+{
+  size_t size = 0;
+  byte *in = opts->inPlace ? mapFileInPlace( opts->inputFile, &size ) : mapInputFile( opts->inputFile, &size );
+
+  Job job = { opts, dir, pair };
+  setupKey( &job.ctx, &job.tweakCtx, key, sizeKey, opts );
+  setupIv( &job );
+  if ( wholeBlocks( opts->mode ) && size % BLOCK_SIZE != 0 )
+    badLength( opts->inputFile, dir );
+
+  // Only the selected range is processed; outside CTR mode that's the whole file.
+  size_t start = opts->offset < size ? opts->offset : size;
+  size_t len = opts->length < size - start ? opts->length : size - start;
+
+  // GCM ciphertext ends with the tag, which isn't part of the data.
+  size_t tagLen = opts->mode == MODE_GCM ? GCM_TAG_SIZE : 0;
+  if ( dir == DECRYPT && len < tagLen )
+    badLength( opts->inputFile, dir );
+  size_t dataLen = dir == DECRYPT ? len - tagLen : len;
+  if ( !sectorsFit( opts, dataLen ) || !gcmFits( opts, dir, len ) )
+    badLength( opts->inputFile, dir );
+  size_t outLen = dir == ENCRYPT ? len + tagLen : dataLen;
+
+  byte *out = opts->inPlace ? in : mapOutputFile( opts->outputFile, outLen );
+  byte *dest = opts->inPlace ? in + start : out;
+
+  job.pool = startPool( opts, dataLen );
+  STATS_START( computeStart );
+  cryptRange( &job, in + start, dest, dataLen, 0 );
+  STATS_STOP( STAT_COMPUTE, computeStart, dataLen );
+  poolDestroy( job.pool );
+
+  bool authentic = true;
+  if ( tagLen && dir == ENCRYPT )
+    gcmFinal( &job.gcm, out + dataLen );
+  else if ( tagLen )
+    authentic = gcmCheckTag( &job.gcm, in + dataLen );
+
+  if ( out != in )
+    unmapFile( out, outLen );
+  unmapFile( in, size );
+  if ( !authentic )
+    authFailed( opts );
+  return EXIT_SUCCESS;
+}
+
+/**
+   Run the cipher on the input a chunk at a time through the streaming pipeline.
+   @param opts the parsed command line.
+   @param dir whether to encrypt or decrypt.
+   @param pair which of the input and output file pairs to process.
+   @param key the contents of the key file.
+   @param sizeKey the size of the key file.
+   @return the exit status for the program.
+*/
+static int runStreamed( Options const *opts, Direction dir, int pair, byte const *key, size_t sizeKey )
+{
+  FILE *in = openInputFile( opts->inputFile );
+
+  Job job = { opts, dir, pair };
+  setupKey( &job.ctx, &job.tweakCtx, key, sizeKey, opts );
+  setupIv( &job );
+
+  // When the input is a regular file, a bad length can be caught before any output is written.
+  uint64_t inputSize = STREAM_CHUNK;
+  bool sized = inputFileSize( in, &inputSize );
+  if ( sized && wholeBlocks( opts->mode ) && inputSize % BLOCK_SIZE != 0 )
+    badLength( opts->inputFile, dir );
+
+  skipInput( in, opts->offset, opts->inputFile );
+  if ( sized )
+    inputSize = inputSize > opts->offset ? inputSize - opts->offset : 0;
+  if ( inputSize > opts->length )
+    inputSize = opts->length;
+  if ( sized && ( !sectorsFit( opts, inputSize ) || !gcmFits( opts, dir, inputSize ) ) )
+    badLength( opts->inputFile, dir );
+
+  // No chunk is bigger than STREAM_CHUNK, so there's no point starting threads for more than that.
+  job.pool = startPool( opts, inputSize < STREAM_CHUNK ? inputSize : STREAM_CHUNK );
+
+  FILE *out = openOutputFile( opts->outputFile );
+  ChunkFunction fn = opts->mode == MODE_GCM && dir == DECRYPT ? gcmOpenChunk : cryptChunk;
+
+  // XTS chunks have to end on sector boundaries.
+  size_t chunkSize = STREAM_CHUNK - STREAM_CHUNK % opts->sectorSize;
+  bool ok = streamFile( in, opts->inputFile, out, opts->outputFile, chunkSize, STREAM_SLACK, STREAM_BUFFERS,
+                        opts->length, opts->uring, fn, &job );
+  poolDestroy( job.pool );
+  closeFile( out, opts->outputFile );
+  closeFile( in, opts->inputFile );
+
+  // Input from a pipe can only be checked once it's all been read.
+  if ( job.authFailed )
+    authFailed( opts );
+  if ( !ok )
+    badLength( opts->inputFile, dir );
+
+  return EXIT_SUCCESS;
+}
+
+/**
+   Catch an output file that's the same file as the input, which opening the output would truncate before the input
+   is read. When the output is the same size as the input it's done in place instead; otherwise it's refused.
+   @param pair the options for one file pair, switched to in place if need be.
+*/
+static void checkSameFile( Options *pair )
+{
+  if ( pair->inPlace || !sameFile( pair->inputFile, pair->outputFile ) )
+    return;
+  if ( pair->mode == MODE_GCM || pair->container || pair->offset || pair->length != UINT64_MAX ) {
+    fprintf( stderr, "Input and output are the same file: %s\n", pair->inputFile );
+    exit( EXIT_FAILURE );
+  }
+  pair->inPlace = true;
+  pair->mapFiles = true;
+}
+
+/**
+   Encrypt the input into a container, or decrypt a range of a container's plaintext. Decryption opens the container and
+   checks its index before creating any output, so a bad container leaves nothing behind.
+   @param opts the parsed command line.
+   @param dir whether to encrypt or decrypt.
+   @param key the contents of the key file.
+   @param sizeKey the size of the key file.
+   @return the exit status for the program.
+*/
+static int runContainer( Options const *opts, Direction dir, byte const *key, size_t sizeKey )
+{
+  FILE *in = openInputFile( opts->inputFile );
+  AesContext ctx;
+  setupKey( &ctx, NULL, key, sizeKey, opts );
+
+  char const *error;
+  if ( dir == ENCRYPT ) {
+    skipInput( in, opts->offset, opts->inputFile );
+    FILE *out = openOutputFile( opts->outputFile );
+    error = packStream( in, opts->inputFile, out, opts->outputFile, &ctx, opts->chunkSize, opts->compress,
+                        opts->length, optionThreads( opts ), opts->uring );
+    closeFile( out, opts->outputFile );
+  } else {
+    Container c;
+    error = openContainer( &c, in, opts->inputFile, &ctx );
+    if ( error ) {
+      fprintf( stderr, "%s: %s\n", error, opts->inputFile );
+      exit( EXIT_FAILURE );
+    }
+    FILE *out = openOutputFile( opts->outputFile );
+    error = readContainer( &c, opts->offset, opts->length, optionThreads( opts ), out, opts->outputFile );
+    closeContainer( &c );
+    closeFile( out, opts->outputFile );
+  }
+  closeFile( in, opts->inputFile );
+
+  // Chunks are written as they're checked, so whatever came before a bad one has to go too.
+  if ( error && strcmp( error, "Authentication failed" ) == 0 )
+    authFailed( opts );
+  if ( error ) {
+    fprintf( stderr, "%s: %s\n", error, dir == ENCRYPT ? opts->outputFile : opts->inputFile );
+    exit( EXIT_FAILURE );
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+   Encrypt all the file pairs in CBC mode together. Each file's blocks have to be encrypted one after another, so the
+   files are read a chunk at a time and their blocks interleaved through the engine to keep its lanes full.
+   @param opts the parsed command line.
+   @param key the contents of the key file.
+   @param sizeKey the size of the key file.
+   @return the exit status for the program.
+*/
+static int runCbcStreams( Options const *opts, byte const *key, size_t sizeKey )
+{
+  // The files are interleaved, so none of them can be done in place.
+  int pairs = opts->filePairs;
+  for ( int i = 0; i < pairs; i++ ) {
+    if ( sameFile( opts->inputFiles[ i ], opts->outputFiles[ i ] ) ) {
+      fprintf( stderr, "Input and output are the same file: %s\n", opts->inputFiles[ i ] );
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  FILE *in[ MAX_FILE_PAIRS ];
+  for ( int i = 0; i < pairs; i++ )
+    in[ i ] = openInputFile( opts->inputFiles[ i ] );
+
+  AesContext ctx;
+  setupKey( &ctx, NULL, key, sizeKey, opts );
+
+  CbcStream streams[ MAX_FILE_PAIRS ];
+  bool done[ MAX_FILE_PAIRS ];
+  for ( int i = 0; i < pairs; i++ ) {
+    readIv( opts, i, streams[ i ].iv );
+    uint64_t inputSize;
+    if ( inputFileSize( in[ i ], &inputSize ) && inputSize % BLOCK_SIZE != 0 )
+      badLength( opts->inputFiles[ i ], ENCRYPT );
+    done[ i ] = false;
+  }
+
+  FILE *out[ MAX_FILE_PAIRS ];
+  byte *buffer[ MAX_FILE_PAIRS ];
+  for ( int i = 0; i < pairs; i++ ) {
+    out[ i ] = openOutputFile( opts->outputFiles[ i ] );
+    buffer[ i ] = malloc( CBC_STREAM_CHUNK );
+  }
+  WorkerPool *pool = poolCreate( parallelThreadsFor( optionThreads( opts ), pairs, CBC_INTERLEAVE ) );
+  STATS_THREADS( poolThreads( pool ) );
+
+  for ( bool more = true; more; ) {
+    more = false;
+    for ( int i = 0; i < pairs; i++ ) {
+      size_t len = done[ i ] ? 0 : readChunk( in[ i ], buffer[ i ], CBC_STREAM_CHUNK, opts->inputFiles[ i ] );
+      if ( len % BLOCK_SIZE != 0 )
+        badLength( opts->inputFiles[ i ], ENCRYPT );
+      done[ i ] = len < CBC_STREAM_CHUNK;
+      more = more || !done[ i ];
+      streams[ i ].in = streams[ i ].out = buffer[ i ];
+      streams[ i ].nblocks = len / BLOCK_SIZE;
+    }
+
+    STATS_START( start );
+    parallelCbcEncryptStreams( pool, &ctx, streams, pairs );
+    size_t bytes = 0;
+    for ( int i = 0; i < pairs; i++ )
+      bytes += streams[ i ].nblocks * BLOCK_SIZE;
+    STATS_STOP( STAT_COMPUTE, start, bytes );
+
+    for ( int i = 0; i < pairs; i++ )
+      writeChunk( out[ i ], buffer[ i ], streams[ i ].nblocks * BLOCK_SIZE, opts->outputFiles[ i ] );
+  }
+
+  poolDestroy( pool );
+  for ( int i = 0; i < pairs; i++ ) {
+    free( buffer[ i ] );
+    closeFile( out[ i ], opts->outputFiles[ i ] );
+    closeFile( in[ i ], opts->inputFiles[ i ] );
+  }
+  return EXIT_SUCCESS;
+}
+
+int runTool( Options const *opts, Direction dir )
+{
+  if ( opts->stats )
+    statsBegin();
+
+  if ( opts->batchFile ) {
+    int status = runBatch( opts, dir );
+    if ( opts->stats )
+      statsReport( stderr );
+    return status;
+  }
+
+  // Decrypted GCM output is only trustworthy once the tag has been checked at the end. An output file is removed if
+  // the tag is wrong, but what's gone down a pipe can't be taken back, so GCM plaintext never goes there.
+  for ( int i = 0; i < opts->filePairs; i++ )
+    if ( opts->mode == MODE_GCM && dir == DECRYPT && strcmp( opts->outputFiles[ i ], STDIO_NAME ) == 0 ) {
+      fprintf( stderr, "Can't write unauthenticated plaintext to standard output: %s\n", opts->inputFiles[ i ] );
+      exit( EXIT_FAILURE );
+    }
+
+  size_t sizeKey = 0;
+  byte *key = readBinaryFile( opts->keyFile, &sizeKey );
+
+  int status = EXIT_SUCCESS;
+  if ( opts->mode == MODE_CBC && dir == ENCRYPT && opts->filePairs > 1 ) {
+    status = runCbcStreams( opts, key, sizeKey );
+    free( key );
+    if ( opts->stats )
+      statsReport( stderr );
+    return status;
+  }
+
+  // Other modes handle the file pairs one after another.
+  for ( int i = 0; i < opts->filePairs && status == EXIT_SUCCESS; i++ ) {
+    Options pair = *opts;
+    pair.inputFile = opts->inputFiles[ i ];
+    pair.outputFile = opts->outputFiles[ i ];
+    checkSameFile( &pair );
+
+    // Standard input and output can't be mapped, so they're always streamed.
+    bool mappable = strcmp( pair.inputFile, STDIO_NAME ) != 0 && strcmp( pair.outputFile, STDIO_NAME ) != 0;
+    if ( opts->container )
+      status = runContainer( &pair, dir, key, sizeKey );
+    else if ( pair.mapFiles && mappable )
+      status = runMapped( &pair, dir, i, key, sizeKey );
+    else
+      status = runStreamed( &pair, dir, i, key, sizeKey );
+  }
+  free( key );
+  if ( opts->stats )
+    statsReport( stderr );
+  return status;
+}
@@ -0,0 +1,30 @@
+/**
+ * @file tool.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for tool.c, which holds the work shared by the encrypt and decrypt programs.
+*/
+
+/** Macro used for unit testing */
+#ifndef _TOOL_H_
+/** Macro used for unit testing */
+#define _TOOL_H_
+
+#include "cli.h"
+
+/** Which way a tool runs the cipher. */
+typedef enum {
+  ENCRYPT,
+  DECRYPT
+} Direction;
+
+/**
+ * This function runs the encrypt or decrypt program on the files named in the options. The input is streamed through
+ * the cipher a chunk at a time, so memory use doesn't depend on the size of the input, unless the options ask for the
+ * files to be memory-mapped. Errors are reported on standard error and exit the program.
+ * @param opts the parsed command line
+ * @param dir whether to encrypt or decrypt
+ * @return the exit status for the program
+*/
+int runTool( Options const *opts, Direction dir );
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file uring.c
+ * @author Jimin Yu, jyu34
+ * This file talks to io_uring with the raw system calls, so there's nothing extra to install. The rings are memory
+ * shared with the kernel: we add entries at the submission ring's tail and the kernel takes them from its head, and
+ * the kernel adds completions at the completion ring's tail for us to take from its head.
+*/
+
+#define _GNU_SOURCE
+
+#include "uring.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/**
+   Map one of the ring's regions.
+   @param fd the io_uring file descriptor.
+   @param size the size of the region.
+   @param offset which region it is.
+   @return the mapping, or NULL if it failed.
+*/
+static void *mapRing( int fd, size_t size, off_t offset )
+{
+  void *p = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset );
+  return p == MAP_FAILED ? NULL : p;
+}
+
+bool uringInit( Uring *ring, unsigned entries )
+{
+  memset( ring, 0, sizeof( Uring ) );
+  struct io_uring_params params;
+  memset( &params, 0, sizeof( params ) );
+  ring->fd = syscall( __NR_io_uring_setup, entries, &params );
+  if ( ring->fd < 0 )
+    return false;
+
+  // IORING_OP_READ and IORING_OP_WRITE came in the same release as this feature bit, and there's no older one to
+  // test for them.
+  if ( !( params.features & IORING_FEAT_RW_CUR_POS ) ) {
+    close( ring->fd );
+    return false;
+  }
+
+  ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+  ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+  ring->sqesSize = params.sq_entries * sizeof( struct io_uring_sqe );
+
+  // Newer kernels put both rings in one mapping.
+  if ( params.features & IORING_FEAT_SINGLE_MMAP ) {
+    if ( ring->cqRingSize > ring->sqRingSize )
+      ring->sqRingSize = ring->cqRingSize;
+    ring->cqRingSize = 0;
+  }
+  ring->sqRing = mapRing( ring->fd, ring->sqRingSize, IORING_OFF_SQ_RING );
+  ring->cqRing = ring->cqRingSize ? mapRing( ring->fd, ring->cqRingSize, IORING_OFF_CQ_RING ) : ring->sqRing;
+  ring->sqes = mapRing( ring->fd, ring->sqesSize, IORING_OFF_SQES );
+  if ( !ring->sqRing || !ring->cqRing || !ring->sqes ) {
+    uringFree( ring );
+    return false;
+  }
+
+  char *sq = ring->sqRing, *cq = ring->cqRing;
+  ring->sqHead = ( unsigned * ) ( sq + params.sq_off.head );
+  ring->sqTail = ( unsigned * ) ( sq + params.sq_off.tail );
+  ring->sqMask = *( unsigned * ) ( sq + params.sq_off.ring_mask );
+  ring->sqArray = ( unsigned * ) ( sq + params.sq_off.array );
+  ring->cqHead = ( unsigned * ) ( cq + params.cq_off.head );
+  ring->cqTail = ( unsigned * ) ( cq + params.cq_off.tail );
+  ring->cqMask = *( unsigned * ) ( cq + params.cq_off.ring_mask );
+  ring->cqes = ( struct io_uring_cqe * ) ( cq + params.cq_off.cqes );
+  return true;
+}
+
+void uringFree( Uring *ring )
+{
+  if ( ring->sqes )
+    munmap( ring->sqes, ring->sqesSize );
+  if ( ring->cqRing && ring->cqRingSize )
+    munmap( ring->cqRing, ring->cqRingSize );
+  if ( ring->sqRing )
+    munmap( ring->sqRing, ring->sqRingSize );
+  close( ring->fd );
+}
+
+/**
+   Fill in the next submission entry and add it to the ring. The kernel doesn't see it until uringWait() tells it.
+   @param ring the ring.
+   @param op the operation.
+   @param fd the file.
+   @param data the buffer.
+   @param len the number of bytes.
+   @param offset the position in the file.
+   @param tag the number handed back with the completion.
+*/
+static void queue( Uring *ring, int op, int fd, void const *data, size_t len, uint64_t offset, uint64_t tag )
+{
+  unsigned tail = *ring->sqTail;
+  unsigned index = tail & ring->sqMask;
+  struct io_uring_sqe *sqe = &ring->sqes[ index ];
+  memset( sqe, 0, sizeof( *sqe ) );
+  sqe->opcode = op;
+  sqe->fd = fd;
+  sqe->addr = ( uintptr_t ) data;
+  sqe->len = len;
+  sqe->off = offset;
+  sqe->user_data = tag;
+  ring->sqArray[ index ] = index;
+
+  // The entry has to be filled in before the kernel can see the new tail.
+  __atomic_store_n( ring->sqTail, tail + 1, __ATOMIC_RELEASE );
+  ring->queued++;
+  ring->inFlight++;
+}
+
+void uringRead( Uring *ring, int fd, void *data, size_t len, uint64_t offset, uint64_t tag )
+{
+  queue( ring, IORING_OP_READ, fd, data, len, offset, tag );
+}
+
+void uringWrite( Uring *ring, int fd, void const *data, size_t len, uint64_t offset, uint64_t tag )
+{
+  queue( ring, IORING_OP_WRITE, fd, data, len, offset, tag );
+}
+
+bool uringWait( Uring *ring, uint64_t *tag, int *result )
+{
+  unsigned head = *ring->cqHead;
+
+  // Only go into the kernel if there's something to submit or nothing has finished yet.
+  while ( ring->queued > 0 || head == __atomic_load_n( ring->cqTail, __ATOMIC_ACQUIRE ) ) {
+    unsigned wait = head == __atomic_load_n( ring->cqTail, __ATOMIC_ACQUIRE ) ? 1 : 0;
+    int n = syscall( __NR_io_uring_enter, ring->fd, ring->queued, wait, IORING_ENTER_GETEVENTS, NULL, 0 );
+    if ( n < 0 && errno != EINTR )
+      return false;
+    if ( n > 0 )
+      ring->queued -= n;
+
+    // A completion is already waiting, so the rest can go in on the next call.
+    if ( n == 0 && !wait )
+      break;
+  }
+
+  struct io_uring_cqe *cqe = &ring->cqes[ head & ring->cqMask ];
+  *tag = cqe->user_data;
+  *result = cqe->res;
+
+  // The completion has to be read before the kernel can reuse its slot.
+  __atomic_store_n( ring->cqHead, head + 1, __ATOMIC_RELEASE );
+  ring->inFlight--;
+  return true;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file uring.h
+ * @author Jimin Yu, jyu34
+ * This is the header file for uring.c, a small wrapper around the kernel's io_uring interface. Reads and writes are
+ * queued at explicit file positions, handed to the kernel together, and finish in whatever order the device gets to
+ * them, so one thread can keep several of them going while it does something else.
+*/
+
+/** Macro used for unit testing */
+#ifndef _URING_H_
+/** Macro used for unit testing */
+#define _URING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The submission and completion rings shared with the kernel. */
+typedef struct {
+  /** The io_uring file descriptor. */
+  int fd;
+
+  /** Submission ring: the kernel's head, our tail, the index mask and the array of entry indices. */
+  unsigned *sqHead;
+  unsigned *sqTail;
+  unsigned sqMask;
+  unsigned *sqArray;
+
+  /** Completion ring: our head, the kernel's tail and the index mask. */
+  unsigned *cqHead;
+  unsigned *cqTail;
+  unsigned cqMask;
+
+  /** The submission entries and completion entries. */
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+
+  /** The mappings behind the rings, and their sizes; the completion ring may share the submission ring's. */
+  void *sqRing;
+  size_t sqRingSize;
+  void *cqRing;
+  size_t cqRingSize;
+  size_t sqesSize;
+
+  /** Operations queued but not yet handed to the kernel. */
+  unsigned queued;
+
+  /** Operations queued or submitted whose completions haven't been collected yet. */
+  unsigned inFlight;
+} Uring;
+
+/**
+ * This function sets up a ring. It fails if the kernel doesn't have io_uring, doesn't allow it (seccomp filters and
+ * the io_uring_disabled sysctl both turn it off), or is too old to have plain reads and writes in it.
+ * @param ring the ring to set up
+ * @param entries the most operations that will ever be in flight at once
+ * @return true if the ring is ready, false if the caller should use ordinary reads and writes instead
+*/
+bool uringInit( Uring *ring, unsigned entries );
+
+/**
+ * This function tears down a ring. Every operation must have completed first.
+ * @param ring the ring
+*/
+void uringFree( Uring *ring );
+
+/**
+ * This function queues a read. Nothing is read until the next call to uringWait().
+ * @param ring the ring
+ * @param fd the file to read
+ * @param data where the bytes go
+ * @param len the number of bytes to read
+ * @param offset the position in the file to read from
+ * @param tag a number handed back with the completion
+*/
+void uringRead( Uring *ring, int fd, void *data, size_t len, uint64_t offset, uint64_t tag );
+
+/**
+ * This function queues a write. Nothing is written until the next call to uringWait().
+ * @param ring the ring
+ * @param fd the file to write
+ * @param data the bytes to write
+ * @param len the number of bytes to write
+ * @param offset the position in the file to write at
+ * @param tag a number handed back with the completion
+*/
+void uringWrite( Uring *ring, int fd, void const *data, size_t len, uint64_t offset, uint64_t tag );
+
+/**
+ * This function hands any queued operations to the kernel and waits for one of the operations in flight to finish.
+ * @param ring the ring
+ * @param tag where to put the tag the operation was queued with
+ * @param result where to put the number of bytes read or written, or a negative errno value if it failed
+ * @return false if waiting failed, with errno set
+*/
+bool uringWait( Uring *ring, uint64_t *tag, int *result );
+
+#endif